@@ -0,0 +1,168 @@
+#include <math.h>
+#include <V3DLib.h>
+#include "Support/Settings.h"
+#include "Support/Timer.h"
+#include "Support/debug.h"
+#include "Kernels/FFT.h"
+#include "Kernels/Matrix.h"
+
+using namespace V3DLib;
+using namespace kernels;
+
+
+// ============================================================================
+// Command line handling
+// ============================================================================
+
+std::vector<const char *> const kernel_id = { "fft", "dft", "cpu" };  // First is default
+
+
+CmdParameters params = {
+  "FFT\n\n"
+  "Benchmark for the FFT library kernel.\n"
+  "Compares the FFT with the DFT kernel and with a scalar FFT on the CPU.\n",
+  {{
+    "Kernel",
+    "-k=",
+    kernel_id,
+    "Select the kernel to use\n"
+  },{
+    "Log2 of size",
+    { "-n=","-log2n="},
+    ParamType::POSITIVE_INTEGER,
+    "Log2 of the number of values to transform, must be in the range 6 to 16",
+    10
+  },{
+    "Number of repeats",
+    { "-p=","-repeat="},
+    ParamType::POSITIVE_INTEGER,
+    "The number times to execute the transform",
+    1
+  }}
+};
+
+
+struct FFTSettings : public Settings {
+  int kernel;
+  int log2n;
+  int repeats;
+
+  int size() const { return 1 << log2n; }
+
+  FFTSettings() : Settings(&params, true) {}
+
+  bool init_params() override {
+    auto const &p = parameters();
+
+    kernel  = p["Kernel"           ]->get_int_value();
+    log2n   = p["Log2 of size"     ]->get_int_value();
+    repeats = p["Number of repeats"]->get_int_value();
+
+    if (log2n < FFTPlan::MIN_LOG2N || log2n > FFTPlan::MAX_LOG2N) {
+      printf("Log2 of size must be in the range %d to %d\n", FFTPlan::MIN_LOG2N, FFTPlan::MAX_LOG2N);
+      return false;
+    }
+
+    return true;
+  }
+
+} settings;
+
+
+// ============================================================================
+// Local functions
+// ============================================================================
+
+float input_value(int i) {
+  return (float) (sin(2*M_PI*3*i/settings.size()) + 0.5*sin(2*M_PI*45*i/settings.size()));
+}
+
+
+void run_scalar_kernel() {
+  if (settings.compile_only) return;
+
+  std::vector<complex> a(settings.size());
+  std::vector<complex> result(settings.size());
+
+  for (int i = 0; i < settings.size(); i++) {
+    a[i] = complex(input_value(i), 0.0f);
+  }
+
+  Timer timer;
+  for (int i = 0; i < settings.repeats; ++i) {
+    fft_scalar(a.data(), result.data(), settings.log2n);
+  }
+  timer.end(!settings.silent);
+}
+
+
+void run_fft_kernel() {
+  Timer compile_timer("Compile time");
+  FFTPlan plan(settings.log2n);
+  compile_timer.end(!settings.silent);
+
+  if (settings.compile_only) return;
+
+  plan.setNumQPUs(settings.num_qpus);
+
+  Complex::Array a(settings.size());
+  Complex::Array result(settings.size());
+
+  for (int i = 0; i < settings.size(); i++) {
+    a[i] = complex(input_value(i), 0.0f);
+  }
+
+  Timer timer;
+  for (int i = 0; i < settings.repeats; ++i) {
+    plan.execute(a, result);
+  }
+  timer.end(!settings.silent);
+}
+
+
+void run_dft_kernel() {
+  Float::Array a(settings.size());
+
+  for (int i = 0; i < settings.size(); i++) {
+    a[i] = input_value(i);
+  }
+
+  Timer compile_timer("Compile time");
+  DFT<Float::Array> dft(a);
+  dft.setNumQPUs(settings.num_qpus);
+  dft.compile();
+  compile_timer.end(!settings.silent);
+
+  if (settings.compile_only) return;
+
+  Timer timer;
+  for (int i = 0; i < settings.repeats; ++i) {
+    dft.call();
+  }
+  timer.end(!settings.silent);
+}
+
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, const char *argv[]) {
+  settings.init(argc, argv);
+
+  // Run a kernel as specified by the passed kernel index
+  switch (settings.kernel) {
+    case 0: run_fft_kernel();     break;
+    case 1: run_dft_kernel();     break;
+    case 2: run_scalar_kernel();  break;
+    default: assert(false);       break;
+  }
+
+  if (!settings.silent) {
+    auto name = kernel_id[settings.kernel];
+    printf("Ran kernel '%s' %d time(s) with size %d and %d QPU's.\n",
+           name, settings.repeats, settings.size(), settings.num_qpus);
+  }
+
+  return 0;
+}
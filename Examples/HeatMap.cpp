@@ -40,6 +40,13 @@ CmdParameters params = {
     POSITIVE_INTEGER,
     "Set the number of randomly distributed hot points to start with",
     10
+  }, {
+    "Steps per call",
+    "-block=",
+    POSITIVE_INTEGER,
+    "Set the number of steps to execute per kernel call, maximum 3.\n"
+    "Values > 1 use temporal blocking, which needs fewer kernel calls and less memory traffic",
+    2
   }}
 };
 
@@ -54,6 +61,13 @@ struct HeatMapSettings : public Settings {
   string kernel_name;
   int    num_steps;
   int    num_points;
+  int    block_steps;
+
+  /**
+   * Number of rows per QPU for temporal blocking.
+   * Chosen so that the kernel fits in the registers.
+   */
+  int block_rows() const { return (block_steps <= 2)? 4 : 1; }
 
   HeatMapSettings() : Settings(&params, true) {}
 
@@ -64,6 +78,13 @@ struct HeatMapSettings : public Settings {
     kernel_name = p["Kernel"]->get_string_value();
     num_steps   = p["Number of steps"]->get_int_value();
     num_points  = p["Number of points"]->get_int_value();
+    block_steps = p["Steps per call"]->get_int_value();
+
+    if (block_steps > 3) {
+      printf("The number of steps per call can be at most 3\n");
+      return false;
+    }
+
     return true;
   }
 } settings;
@@ -180,11 +201,40 @@ void heatmap_kernel(Float::Ptr map, Float::Ptr mapOut, Int height, Int width) {
 }
 
 
+/**
+ * Performs multiple steps for the heat transfer in a single kernel call
+ *
+ * Every QPU handles bands of rows; see `TemporalCursor`.
+ */
+void heatmap_temporal_kernel(Float::Ptr map, Float::Ptr mapOut, Int height, Int width) {
+  int const rows = settings.block_rows();
+  TemporalCursor cursor(width, height, rows, settings.block_steps);
+
+  For (Int row = 1 + rows*me(), row < height - 1, row += rows*numQPUs())
+    cursor.run(map, mapOut, row, [&width] (Cursor::Block const &b, Int const &x, Float &output) {
+      Float sum = b.left(0) + b.current(0) + b.right(0) +
+                  b.left(1) +                b.right(1) +
+                  b.left(2) + b.current(2) + b.right(2);
+
+      output = b.current(1) - K * (b.current(1) - sum * 0.125);
+
+      // Ensure left and right borders are zero
+      Int actual_x = x + index();
+      Where (actual_x == 0 || actual_x == width - 1)
+        output = 0.0f;
+      End
+    });
+  End
+}
+
+
 /**
  * The edges always have zero values.
  * i.e. there is constant cold at the edges.
  */
 void run_kernel() {
+  using KernelType = decltype(compile(heatmap_kernel));
+
   // Allocate and initialise input and output maps
   Float::Array mapA(settings.SIZE);
   Float::Array mapB(settings.SIZE);
@@ -194,27 +244,51 @@ void run_kernel() {
   // Inject hot spots
   inject_hotspots(mapA);
 
-  // Compile kernel
+  // Compile kernels, the single step kernel handles the remaining steps
   auto k = compile(heatmap_kernel);
   k.setNumQPUs(settings.num_qpus);
 
-  Timer timer("QPU run time");
+  std::unique_ptr<KernelType> k_block;
+  if (settings.block_steps > 1) {
+    k_block.reset(new KernelType(compile(heatmap_temporal_kernel)));
+    k_block->setNumQPUs(settings.num_qpus);
+  }
 
-  for (int i = 0; i < settings.num_steps; i++) {
-    if (i & 1) {
-      k.load(&mapB, &mapA, settings.HEIGHT, settings.WIDTH);  // Load the uniforms
+  int num_calls = 0;  // Used to alternate input and output maps
+
+  auto call = [&mapA, &mapB, &num_calls] (KernelType &kernel) {
+    if (num_calls & 1) {
+      kernel.load(&mapB, &mapA, settings.HEIGHT, settings.WIDTH);  // Load the uniforms
     } else {
-      k.load(&mapA, &mapB, settings.HEIGHT, settings.WIDTH);  // Load the uniforms
+      kernel.load(&mapA, &mapB, settings.HEIGHT, settings.WIDTH);  // Load the uniforms
     }
 
     // Invoke the kernel
-    settings.process(k);
+    settings.process(kernel);
+    num_calls++;
+  };
+
+  Timer timer("QPU run time");
+
+  int i = 0;
+  if (k_block) {
+    for (; i + settings.block_steps <= settings.num_steps; i += settings.block_steps) {
+      call(*k_block);
+    }
+  }
+
+  for (; i < settings.num_steps; i++) {
+    call(k);
   }
 
   timer.end(!settings.silent);
 
+  if (!settings.silent) {
+    printf("Number of kernel calls: %d\n", num_calls);
+  }
+
   // Output results
-  output_pgm_file(mapB, settings.WIDTH, settings.HEIGHT, 255, "heatmap.pgm");
+  output_pgm_file((num_calls & 1)? mapB : mapA, settings.WIDTH, settings.HEIGHT, 255, "heatmap.pgm");
 }
 
 
@@ -14,7 +14,7 @@ using namespace kernels;
 // Command line handling
 // ============================================================================
 
-std::vector<const char *> const kernel_id = { "qpu", "cpu" };  // First is default
+std::vector<const char *> const kernel_id = { "qpu", "cpu", "tiled" };  // First is default
 
 
 CmdParameters params = {
@@ -130,6 +130,10 @@ int main(int argc, const char *argv[]) {
   switch (settings.kernel) {
     case 0: run_qpu_kernel();     break;  
     case 1: run_scalar_kernel();  break;
+    case 2:
+      kernels::get_matrix_settings().method = kernels::matrix_settings::TILED;
+      run_qpu_kernel();
+      break;
     default: assert(false);       break;
   }
 
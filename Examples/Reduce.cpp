@@ -0,0 +1,216 @@
+#include <sys/time.h>
+#include <V3DLib.h>
+#include "Support/Settings.h"
+#include "Support/Timer.h"
+#include "Support/debug.h"
+#include "Support/Platform.h"
+#include "Kernels/Reduce.h"
+
+using namespace V3DLib;
+using namespace kernels;
+
+
+// ============================================================================
+// Command line handling
+// ============================================================================
+
+std::vector<const char *> const kernel_id = { "sum", "min", "max", "argmax", "scan", "cpu" };  // First is default
+
+
+CmdParameters params = {
+  "Reduce\n\n"
+  "Benchmark for the reduction and scan library kernels.\n"
+  "These are bandwidth-bound; the throughput is shown in GB/s of memory traffic.\n",
+  {{
+    "Kernel",
+    "-k=",
+    kernel_id,
+    "Select the kernel to use. 'cpu' is a scalar sum on the CPU\n"
+  },{
+    "Size",
+    { "-z=","-size="},
+    ParamType::POSITIVE_INTEGER,
+    "Number of values in the input array",
+    1 << 20
+  },{
+    "Number of repeats",
+    { "-p=","-repeat="},
+    ParamType::POSITIVE_INTEGER,
+    "The number times to execute the kernel",
+    10
+  },{
+    "All QPU's",
+    "-all",
+    ParamType::NONE,
+    "Run for all possible numbers of QPU's, instead of the number given with '-n='"
+  }}
+};
+
+
+struct ReduceSettings : public Settings {
+  int  kernel;
+  int  size;
+  int  repeats;
+  bool all_qpus;
+
+  ReduceSettings() : Settings(&params, true) {}
+
+  bool init_params() override {
+    auto const &p = parameters();
+
+    kernel   = p["Kernel"           ]->get_int_value();
+    size     = p["Size"             ]->get_int_value();
+    repeats  = p["Number of repeats"]->get_int_value();
+    all_qpus = p["All QPU's"        ]->get_bool_value();
+
+    return true;
+  }
+
+} settings;
+
+
+// ============================================================================
+// Local functions
+// ============================================================================
+
+float input_value(int i) {
+  return 0.25f*((float) ((i*7) % 23) - 11.0f);
+}
+
+
+double now() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (double) tv.tv_sec + 1.0e-6*((double) tv.tv_usec);
+}
+
+
+/**
+ * Display the throughput of a run
+ *
+ * @param bytes_per_value  memory traffic per value for a single execution
+ */
+void show_throughput(double seconds, int num_qpus, int bytes_per_value) {
+  if (settings.silent) return;
+
+  double bytes = ((double) settings.size)*bytes_per_value*settings.repeats;
+  printf("QPUs: %2d, run time: %.6fs, throughput: %.3f GB/s\n", num_qpus, seconds, bytes/seconds*1.0e-9);
+}
+
+
+/**
+ * @return numbers of QPU's to run with
+ */
+std::vector<int> qpu_counts() {
+  if (!settings.all_qpus) return { settings.num_qpus };
+
+  std::vector<int> ret;
+  if (Platform::has_vc4()) {
+    for (int i = 1; i <= Platform::max_qpus(); i++) ret.push_back(i);
+  } else {
+    ret = { 1, 8 };  // Only values possible on v3d
+  }
+
+  return ret;
+}
+
+
+void run_scalar_kernel() {
+  if (settings.compile_only) return;
+
+  std::vector<float> a(settings.size);
+  for (int i = 0; i < settings.size; i++) a[i] = input_value(i);
+
+  float result = 0;
+  double start = now();
+  for (int i = 0; i < settings.repeats; ++i) {
+    result = reduce_scalar(Reduction::SUM, a.data(), settings.size);
+  }
+  show_throughput(now() - start, 0, 4);
+
+  if (!settings.silent) printf("Result: %f\n", result);
+}
+
+
+void run_reduce_kernel(Reduction::Op op) {
+  Timer compile_timer("Compile time");
+  Reduction r(op);
+  compile_timer.end(!settings.silent);
+
+  if (settings.compile_only) return;
+
+  Float::Array a(settings.size);
+  std::vector<float> a_scalar(settings.size);
+  for (int i = 0; i < settings.size; i++) a[i] = a_scalar[i] = input_value(i);
+
+  int expected_index;
+  float expected = reduce_scalar(op, a_scalar.data(), settings.size, &expected_index);
+
+  for (auto num_qpus : qpu_counts()) {
+    r.setNumQPUs(num_qpus);
+
+    float result = 0;
+    double start = now();
+    for (int i = 0; i < settings.repeats; ++i) {
+      result = r.execute(a);
+    }
+    show_throughput(now() - start, num_qpus, 4);
+
+    if (result != expected || (op == Reduction::ARGMAX && r.index() != expected_index)) {
+      printf("Result %f (index %d) differs from expected %f (index %d)\n",
+             result, r.index(), expected, expected_index);
+    }
+  }
+}
+
+
+void run_scan_kernel() {
+  Timer compile_timer("Compile time");
+  Scan scan;
+  compile_timer.end(!settings.silent);
+
+  if (settings.compile_only) return;
+
+  Float::Array a(settings.size);
+  Float::Array result(settings.size);
+  for (int i = 0; i < settings.size; i++) a[i] = input_value(i);
+
+  for (auto num_qpus : qpu_counts()) {
+    scan.setNumQPUs(num_qpus);
+
+    double start = now();
+    for (int i = 0; i < settings.repeats; ++i) {
+      scan.execute(a, result);
+    }
+
+    // The input is read twice, once to sum the chunks and once to scan, and the output is written
+    show_throughput(now() - start, num_qpus, 12);
+  }
+}
+
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, const char *argv[]) {
+  settings.init(argc, argv);
+
+  // Run a kernel as specified by the passed kernel index
+  switch (settings.kernel) {
+    case 0: run_reduce_kernel(Reduction::SUM);    break;
+    case 1: run_reduce_kernel(Reduction::MIN);    break;
+    case 2: run_reduce_kernel(Reduction::MAX);    break;
+    case 3: run_reduce_kernel(Reduction::ARGMAX); break;
+    case 4: run_scan_kernel();                    break;
+    case 5: run_scalar_kernel();                  break;
+    default: assert(false);                       break;
+  }
+
+  if (!settings.silent) {
+    auto name = kernel_id[settings.kernel];
+    printf("Ran kernel '%s' %d time(s) with size %d.\n", name, settings.repeats, settings.size);
+  }
+
+  return 0;
+}
@@ -1,8 +1,7 @@
 #include "BaseKernel.h"
 #include "Support/basics.h"
-#include "Source/Interpreter.h"
-#include "Target/Emulator.h"
 #include "Target/Pretty.h"
+#include "Common/LaunchQueue.h"
 
 namespace V3DLib {
 
@@ -10,6 +9,14 @@ using ::operator<<;  // C++ weirdness
 
 BaseKernel::BaseKernel() {}
 
+
+/**
+ * Outstanding launches refer to this kernel, so wait for them to complete
+ */
+BaseKernel::~BaseKernel() {
+  wait();
+}
+
 bool BaseKernel::has_vc4() const { return m_vc4_driver.get() != nullptr; }
 bool BaseKernel::has_v3d() const { return m_v3d_driver.get() != nullptr; }
 
@@ -73,13 +80,27 @@ void BaseKernel::pretty(bool output_for_vc4, const char *filename, bool output_q
  * The emulator runs vc4 code.
  */
 void BaseKernel::emu() {
+  if (!prepare_emu()) return;
+  emulate(m_numQPUs, *m_emu_program, uniforms, getBufferObject());
+}
+
+
+/**
+ * @return true if the kernel can run on the emulator, false otherwise
+ */
+bool BaseKernel::prepare_emu() {
   if (vc4().has_errors()) {
     warning("Not running on emulator, there were errors during compile.");
-    return;
+    return false;
   }
 
   assert(uniforms.size() != 0);
-  emulate(m_numQPUs, vc4().targetCode(), vc4().numVars(), uniforms, getBufferObject());
+
+  if (!m_emu_program) {
+    m_emu_program = emu::decode(vc4().targetCode(), vc4().numVars());
+  }
+
+  return true;
 }
 
 
@@ -93,7 +114,12 @@ void BaseKernel::interpret() {
   }
 
   assert(uniforms.size() != 0);
-  interpreter(m_numQPUs, vc4().sourceCode(), vc4().numVars(), uniforms, getBufferObject());
+
+  if (!m_interp_program) {
+    m_interp_program = interp::compile(vc4().sourceCode(), vc4().numVars());
+  }
+
+  interpreter(m_numQPUs, *m_interp_program, uniforms, getBufferObject());
 }
 
 
@@ -128,6 +154,68 @@ void BaseKernel::call() {
 };
 
 
+/**
+ * Invoke the kernel asynchronously
+ *
+ * The kernel is queued for execution on a worker thread, in the same way as `call()`
+ * would run it. Launches are executed in order; the uniforms are copied, so the next launch
+ * can be loaded directly.
+ *
+ * The shared arrays passed to a running kernel should not be touched until it has completed.
+ * Use different arrays per launch to overlap preparation on the host with execution.
+ *
+ * @return future which is ready when the kernel has completed.
+ *         Errors during execution are rethrown by `get()` on the future.
+ */
+std::shared_future<void> BaseKernel::launch() {
+  assert(uniforms.size() != 0);
+
+  IntList params = uniforms;
+  int numQPUs = m_numQPUs;
+  LaunchQueue::Job job;
+
+#ifdef QPU_MODE
+  if (Platform::use_main_memory()) {
+    warning("Main memory selected in QPU mode, running on emulator instead of QPU.");
+  } else {
+    V3DLib::KernelDriver *driver = Platform::has_vc4()? &vc4() : &v3d();
+    driver->prepare_invoke(numQPUs, params);
+
+    job = [driver, numQPUs, params] () mutable {
+      driver->invoke(numQPUs, params);
+    };
+  }
+#endif
+
+  if (!job) {
+    if (!prepare_emu()) {
+      std::promise<void> none;
+      none.set_value();
+      return none.get_future().share();
+    }
+
+    std::shared_ptr<emu::Program> program = m_emu_program;
+
+    job = [program, numQPUs, params] () mutable {
+      emulate(numQPUs, *program, params, getBufferObject());
+    };
+  }
+
+  m_last_launch = LaunchQueue::submit(job);
+  return m_last_launch;
+}
+
+
+/**
+ * Wait for all asynchronous launches of this kernel to complete
+ */
+void BaseKernel::wait() {
+  if (m_last_launch.valid()) {
+    m_last_launch.wait();
+  }
+}
+
+
 std::string BaseKernel::compile_info() const {
   std::string ret;
 
@@ -144,7 +232,7 @@ std::string BaseKernel::compile_info() const {
     }
 
     if (has_v3d()) {
-      ret << "vc4:\n"
+      ret << "v3d:\n"
           << v3d().compile_info() << "\n\n";
     }
   }
@@ -153,6 +241,31 @@ std::string BaseKernel::compile_info() const {
 }
 
 
+/**
+ * Output the per-pass compile timing of the kernel drivers as JSON
+ *
+ * Only the enabled drivers are present. Example:
+ *
+ *     {"vc4": {"total_ms": 1.234, "passes": [{"name": "ast", "count": 1, "time_ms": 0.101, ...}, ...]},
+ *      "v3d": {...}}
+ */
+std::string BaseKernel::compile_profile_json() const {
+  std::string ret = "{";
+
+  if (has_vc4()) {
+    ret << "\"vc4\": " << vc4().compile_profile_json();
+  }
+
+  if (has_v3d()) {
+    if (has_vc4()) ret << ", ";
+    ret << "\"v3d\": " << v3d().compile_profile_json();
+  }
+
+  ret << "}";
+  return ret;
+}
+
+
 void BaseKernel::dump_compile_data(bool output_for_vc4, char const *filename) {
   if (output_for_vc4) {
     vc4().dump_compile_data(filename);
@@ -1,8 +1,11 @@
 #ifndef _V3DLIB_BASEKERNEL_H_
 #define _V3DLIB_BASEKERNEL_H_
 #include <memory>
+#include <future>
 #include "vc4/KernelDriver.h"
 #include "v3d/KernelDriver.h"
+#include "Target/Emulator.h"
+#include "Source/Interpreter.h"
 
 namespace V3DLib {
 
@@ -19,6 +22,8 @@ namespace V3DLib {
  *     - qpu(...)        - run on physical QPUs (only when QPU_MODE enabled))
  *     - call(...)       - depending on QPU_MODE, call `qpu()` or `emu()`
  *                      This is useful for cross-platform compatibility
+ *     - launch(...)     - as `call()`, but returns immediately with a future
+ *                      which becomes ready when the kernel has completed
  *
  *    The interpreter and emulator are useful for development/debugging and 
  *    for equivalence testing for the hardware QPU.
@@ -56,6 +61,7 @@ class BaseKernel {
 public:
   BaseKernel();
   BaseKernel(BaseKernel &&k) = default;
+  ~BaseKernel();
 
   bool has_vc4() const;
   bool has_v3d() const;
@@ -73,11 +79,14 @@ public:
   void emu();
   void interpret();
   void call();
+  std::shared_future<void> launch();
+  void wait();
 #ifdef QPU_MODE
   void qpu();
 #endif  // QPU_MODE
 
   std::string compile_info() const;
+  std::string compile_profile_json() const;
   void dump_compile_data(bool output_for_vc4, char const *filename);
   int v3d_kernel_size() const;
   bool has_errors() const;
@@ -92,6 +101,13 @@ protected:
   // (There are other reasons but this is the main one)
   std::unique_ptr<vc4::KernelDriver> m_vc4_driver;
   std::unique_ptr<v3d::KernelDriver> m_v3d_driver;
+
+  std::shared_ptr<emu::Program> m_emu_program;        // Target code decoded for emulator, created on first call
+  std::shared_ptr<interp::Program> m_interp_program;  // Source code compiled for interpreter, created on first call
+  std::shared_future<void> m_last_launch;              // Completion of most recent asynchronous launch
+
+private:
+  bool prepare_emu();
 };
 
 
@@ -0,0 +1,104 @@
+#include "CompileContext.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include "Support/Platform.h"
+#include "Common/BufferObject.h"
+
+namespace V3DLib {
+namespace {
+
+thread_local CompileContext default_context;
+thread_local CompileContext *current_context = nullptr;
+
+}  // anon namespace
+
+
+/**
+ * @return the compile context for the current thread
+ */
+CompileContext &CompileContext::current() {
+  if (current_context == nullptr) return default_context;
+  return *current_context;
+}
+
+
+CompileContext::Scope::Scope(CompileContext &context) {
+  m_prev = current_context;
+  current_context = &context;
+}
+
+
+CompileContext::Scope::~Scope() {
+  current_context = m_prev;
+}
+
+
+/**
+ * @return the compile data of the current compile context
+ */
+CompileData &compile_data() {
+  return CompileContext::current().data;
+}
+
+
+/**
+ * Run independent compile jobs on a thread pool.
+ *
+ * Each job should construct one or more kernels, e.g. by calling `compile()`.
+ * Since every kernel has its own compile context, the jobs can run concurrently.
+ * The jobs should not share any other state which is changed during compilation,
+ * such as kernel settings which are read while constructing the AST. Such settings
+ * should be `thread_local` and be set within the job itself, on the thread which compiles
+ * the kernel. The library kernels in `Lib/Kernels` do this.
+ *
+ * The calling thread takes part in running the jobs, and returns when all jobs are done.
+ * If a job throws, the exception of the first failing job is rethrown after all jobs are done.
+ *
+ * @param num_threads  Max number of threads to use. If <= 0, use the number of cores
+ */
+void compile_all(std::vector<std::function<void()>> const &jobs, int num_threads) {
+  if (jobs.empty()) return;
+
+  if (num_threads <= 0) {
+    num_threads = (int) std::thread::hardware_concurrency();
+  }
+  num_threads = std::max(1, std::min(num_threads, (int) jobs.size()));
+
+  Platform::has_vc4();  // Initialize the platform info before starting threads
+  getBufferObject();    // Idem for the heap; allocations on it are locked, its creation is not
+
+  std::atomic<int> next(0);
+  std::vector<std::exception_ptr> errors(jobs.size());
+
+  auto run = [&jobs, &next, &errors] () {
+    while (true) {
+      int i = next++;
+      if (i >= (int) jobs.size()) return;
+
+      try {
+        jobs[i]();
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; i++) {
+    threads.emplace_back(run);
+  }
+
+  run();
+
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  for (auto &e : errors) {
+    if (e) std::rethrow_exception(e);
+  }
+}
+
+}  // namespace V3DLib
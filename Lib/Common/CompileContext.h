@@ -0,0 +1,51 @@
+#ifndef _V3DLIB_COMMON_COMPILECONTEXT_H_
+#define _V3DLIB_COMMON_COMPILECONTEXT_H_
+#include <functional>
+#include <vector>
+#include "CompileData.h"
+
+namespace V3DLib {
+
+class StmtStack;
+
+/**
+ * The state used while compiling a kernel.
+ *
+ * Compilation uses generators for fresh variables and labels, the statement stack for
+ * constructing the AST, and the compile data. These are kept per context instead of globally,
+ * so that kernels can be compiled concurrently on separate threads.
+ *
+ * Each thread has a current context, which is used by the compile functions.
+ * A kernel driver owns a context and makes it current while compiling.
+ * Outside of that, a default context per thread is used.
+ */
+class CompileContext {
+public:
+  static CompileContext &current();
+
+  /**
+   * Make a context current on this thread, for the lifetime of the scope object
+   */
+  class Scope {
+  public:
+    Scope(CompileContext &context);
+    ~Scope();
+
+  private:
+    CompileContext *m_prev = nullptr;
+  };
+
+  bool        for_vc4        = true;     // Platform to compile for
+  int         var_count      = 0;        // Number of fresh variables generated
+  int         label_count    = 0;        // Number of fresh labels generated
+  int         prefetch_count = 0;        // Number of prefetch labels generated
+  StmtStack  *stmt_stack     = nullptr;  // Statement stack for the AST under construction
+  CompileData data;
+};
+
+
+void compile_all(std::vector<std::function<void()>> const &jobs, int num_threads = 0);
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_COMMON_COMPILECONTEXT_H_
@@ -1,12 +1,11 @@
 #include "CompileData.h"
 #include "Support/basics.h"
+#include "SharedArray.h"
 
 namespace V3DLib {
 
 //using ::operator<<;  // C++ weirdness
 
-CompileData compile_data;
-
 std::string CompileData::dump() const {
   std::string ret;
 
@@ -44,6 +43,20 @@ void CompileData::clear() {
   allocated_registers_dump.clear();
   num_accs_introduced = 0;
   num_instructions_combined = 0;
+  num_packed_slots = 0;
+  num_delay_slots_filled = 0;
+  num_consts_folded = 0;
+  num_cse_removed = 0;
+  num_invariants_hoisted = 0;
+  num_dead_removed = 0;
+  num_consts_cached = 0;
+  num_const_uniforms = 0;
+  num_moves_removed = 0;
+  num_spills = 0;
+  num_loops_unrolled = 0;
+  num_loops_pipelined = 0;
+  spill_buffer.reset();
+  profile.clear();
 }
 
 }  // namespace V3DLib
@@ -2,10 +2,14 @@
 #define _V3DLIB_COMMON_COMPILEDATA_H_
 #include <string>
 #include <vector>
+#include <memory>
 #include "Target/instr/Reg.h"
+#include "CompileProfile.h"
 
 namespace V3DLib {
 
+template<typename T> class SharedArray;
+
 struct CompileData {
   std::string liveness_dump;
   std::string target_code_before_optimization;
@@ -15,12 +19,26 @@ struct CompileData {
   std::string reg_usage_dump;
   int num_accs_introduced = 0;
   int num_instructions_combined = 0;
+  int num_packed_slots = 0;                               // v3d, number of instructions saved by scheduling
+  int num_delay_slots_filled = 0;                         // Number of branch delay slots filled with useful instructions
+  int num_consts_folded = 0;                              // Number of instructions replaced by a constant
+  int num_cse_removed = 0;                                // Number of redundant computations and copies removed
+  int num_invariants_hoisted = 0;                         // Number of instructions moved out of loops
+  int num_dead_removed = 0;                               // Number of instructions removed with unused results
+  int num_consts_cached = 0;                              // v3d, number of constants loaded once and kept in registers
+  int num_const_uniforms = 0;                             // v3d, number of cached constants passed as uniform
+  int num_moves_removed = 0;                              // Number of moves removed by coalescing
+  int num_spills = 0;                                     // Number of variables spilled to memory
+  int num_loops_unrolled = 0;                             // Number of source loops unrolled by loop hint
+  int num_loops_pipelined = 0;                            // Number of source loops with pipelined loads
+  std::shared_ptr<SharedArray<uint32_t>> spill_buffer;   // Scratch memory for spilled variables
+  CompileProfile profile;                                 // Timing per compile pass
 
   std::string dump() const;
   void clear();
 };
 
-extern CompileData compile_data;
+CompileData &compile_data();
 
 }  // namespace V3DLib
 
@@ -0,0 +1,176 @@
+#include "CompileProfile.h"
+#include <cstdio>
+#include <malloc.h>
+#include "Support/basics.h"
+#include "CompileData.h"
+
+namespace V3DLib {
+
+using ::operator<<;  // C++ weirdness
+
+namespace {
+
+/**
+ * @return size of the allocated heap memory in KB, 0 if not available.
+ *
+ * This is for the whole process, with concurrent compilation the values per pass are rough.
+ */
+long heap_in_use_kb() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return (long) (mallinfo2().uordblks/1024);
+#elif defined(__GLIBC__)
+  return (long) ((unsigned) mallinfo().uordblks/1024);  // Older glibc, wraps above 4GB
+#else
+  return 0;
+#endif
+}
+
+
+std::string ms(double val) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.3f", val);
+  return buf;
+}
+
+
+std::string count(int val) {
+  if (val < 0) return "-";
+  return std::to_string(val);
+}
+
+
+std::string json_count(int val) {
+  if (val < 0) return "null";
+  return std::to_string(val);
+}
+
+
+std::string pad(std::string const &str, int width, bool left = false) {
+  if ((int) str.size() >= width) return str;
+  std::string fill(width - str.size(), ' ');
+  return left? (str + fill) : (fill + str);
+}
+
+}  // anon namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class CompileProfile
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Add the measurements of a pass run.
+ *
+ * If the pass ran before, the measurements are accumulated in the existing entry.
+ */
+void CompileProfile::add(PassProfile const &pass) {
+  for (auto &p : m_passes) {
+    if (p.name != pass.name) continue;
+
+    p.count         += pass.count;
+    p.time_ms       += pass.time_ms;
+    p.heap_delta_kb += pass.heap_delta_kb;
+    if (p.instrs_before == -1) p.instrs_before = pass.instrs_before;
+    if (pass.instrs_after != -1) p.instrs_after = pass.instrs_after;
+    return;
+  }
+
+  m_passes.push_back(pass);
+}
+
+
+/**
+ * @return profile of the pass with given name, nullptr if the pass did not run
+ */
+PassProfile const *CompileProfile::find(std::string const &name) const {
+  for (auto const &p : m_passes) {
+    if (p.name == name) return &p;
+  }
+
+  return nullptr;
+}
+
+
+/**
+ * Output the profile as a table, for `compile_info()`
+ */
+std::string CompileProfile::dump() const {
+  std::string ret;
+
+  ret << "  compile time (ms)              : " << ms(m_total_ms) << "\n"
+      << "    " << pad("pass", 16, true) << pad("count", 6) << pad("time (ms)", 11)
+      << pad("instrs before", 15) << pad("instrs after", 14) << pad("heap (KB)", 11);
+
+  for (auto const &p : m_passes) {
+    ret << "\n"
+        << "    " << pad(p.name, 16, true) << pad(count(p.count), 6) << pad(ms(p.time_ms), 11)
+        << pad(count(p.instrs_before), 15) << pad(count(p.instrs_after), 14)
+        << pad(std::to_string(p.heap_delta_kb), 11);
+  }
+
+  return ret;
+}
+
+
+/**
+ * Output the profile as a JSON object, for tracking compile times with external tools
+ *
+ * Instruction counts which are not applicable are output as `null`.
+ */
+std::string CompileProfile::json() const {
+  std::string ret;
+
+  ret << "{\"total_ms\": " << ms(m_total_ms) << ", \"passes\": [";
+
+  bool first = true;
+  for (auto const &p : m_passes) {
+    if (!first) ret << ", ";
+    first = false;
+
+    ret << "{\"name\": \"" << p.name << "\""
+        << ", \"count\": " << p.count
+        << ", \"time_ms\": " << ms(p.time_ms)
+        << ", \"instrs_before\": " << json_count(p.instrs_before)
+        << ", \"instrs_after\": " << json_count(p.instrs_after)
+        << ", \"heap_delta_kb\": " << p.heap_delta_kb
+        << "}";
+  }
+
+  ret << "]}";
+  return ret;
+}
+
+
+void CompileProfile::clear() {
+  m_passes.clear();
+  m_total_ms = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class PassTimer
+///////////////////////////////////////////////////////////////////////////////
+
+PassTimer::PassTimer(char const *name) {
+  m_pass.name  = name;
+  m_pass.count = 1;
+  m_heap_start = heap_in_use_kb();
+  m_start      = std::chrono::steady_clock::now();
+}
+
+
+PassTimer::~PassTimer() {
+  auto elapsed = std::chrono::steady_clock::now() - m_start;
+  m_pass.time_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+  m_pass.heap_delta_kb = heap_in_use_kb() - m_heap_start;
+
+  if (m_instrs_after != -1) {
+    m_pass.instrs_after = m_instrs_after;
+  } else if (m_count) {
+    m_pass.instrs_after = m_count();
+  }
+
+  compile_data().profile.add(m_pass);
+}
+
+}  // namespace V3DLib
@@ -0,0 +1,75 @@
+#ifndef _V3DLIB_COMMON_COMPILEPROFILE_H_
+#define _V3DLIB_COMMON_COMPILEPROFILE_H_
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace V3DLib {
+
+/**
+ * Measurements for a single compile pass
+ *
+ * If a pass runs multiple times during compilation, the measurements are accumulated.
+ */
+struct PassProfile {
+  std::string name;
+  int    count         = 0;    // Number of times the pass ran
+  double time_ms       = 0;    // Wall time
+  int    instrs_before = -1;   // Number of instructions before the first run, -1 if not applicable
+  int    instrs_after  = -1;   // Number of instructions after the last run, -1 if not applicable
+  long   heap_delta_kb = 0;    // Change in allocated heap memory
+};
+
+
+/**
+ * Per-pass timing report of the compilation of a kernel
+ */
+class CompileProfile {
+public:
+  void add(PassProfile const &pass);
+  void total_ms(double val) { m_total_ms = val; }
+  double total_ms() const { return m_total_ms; }
+  std::vector<PassProfile> const &passes() const { return m_passes; }
+  PassProfile const *find(std::string const &name) const;
+
+  std::string dump() const;
+  std::string json() const;
+  void clear();
+
+private:
+  std::vector<PassProfile> m_passes;  // In order of first run
+  double m_total_ms = 0;
+};
+
+
+/**
+ * Record the profile of a compile pass in the current compile data, for the lifetime of this object
+ *
+ * If a sequence of instructions is passed, its size is taken before and after the pass.
+ */
+class PassTimer {
+public:
+  PassTimer(char const *name);
+
+  template<typename List>
+  PassTimer(char const *name, List const &instrs) : PassTimer(name) {
+    m_count = [&instrs] () { return (int) instrs.size(); };
+    m_pass.instrs_before = m_count();
+  }
+
+  ~PassTimer();
+
+  void instrs_after(int val) { m_instrs_after = val; }
+
+private:
+  PassProfile m_pass;
+  std::function<int()> m_count;
+  int m_instrs_after = -1;
+  long m_heap_start = 0;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_COMMON_COMPILEPROFILE_H_
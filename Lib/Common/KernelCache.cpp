@@ -0,0 +1,387 @@
+#include "KernelCache.h"
+#include <cstdio>
+#include <cstring>          // memcpy
+#include <functional>       // std::hash
+#include <thread>
+#include <sys/stat.h>       // mkdir
+#include <unistd.h>         // getpid
+#include "Support/basics.h"
+#include "LibSettings.h"
+
+namespace V3DLib {
+
+using ::operator<<;  // C++ weirdness
+
+namespace KernelCache {
+namespace {
+
+// Bump this when the code generation changes in a way that invalidates existing cache files
+uint32_t const FORMAT_VERSION = 3;
+char const MAGIC[4] = { 'V', '3', 'D', 'K' };
+
+// Instructions are stored in their in-memory layout, so a cache file is only valid for the
+// library build which wrote it. The Makefile recompiles this file whenever another library
+// object changes, so that the compile time identifies the build.
+char const BUILD_ID[] = __DATE__ " " __TIME__;
+uint32_t const INSTR_SIZE = (uint32_t) sizeof(Instr);
+
+
+// ============================================================================
+// Hashing of the source AST
+// ============================================================================
+
+/**
+ * 64-bit FNV-1a hash over the elements of the source AST.
+ *
+ * A dedicated walker is used instead of hashing `Stmt::dump()`, because the
+ * dump does not output all fields and loses precision on float literals.
+ */
+class Hasher {
+public:
+  uint64_t value() const { return m_hash; }
+
+  void add(void const *data, size_t size) {
+    auto p = (uint8_t const *) data;
+
+    for (size_t i = 0; i < size; ++i) {
+      m_hash ^= p[i];
+      m_hash *= 0x100000001b3ull;
+    }
+  }
+
+  void add(int val) { add(&val, sizeof(val)); }
+
+  void add(std::string const &str) {
+    add((int) str.size());
+    add(str.data(), str.size());
+  }
+
+  void add(Var const &v) {
+    add((int) v.tag());
+    add(v.id());
+    add((int) v.is_uniform_ptr());
+  }
+
+  void add(Expr::Ptr e) {
+    if (e.get() == nullptr) {
+      add(-1);
+      return;
+    }
+
+    add((int) e->tag());
+
+    switch (e->tag()) {
+      case Expr::INT_LIT:
+        add(e->intLit);
+        break;
+
+      case Expr::FLOAT_LIT:
+        add(&e->floatLit, sizeof(e->floatLit));  // bits, so that no precision is lost
+        break;
+
+      case Expr::VAR:
+        add(e->var());
+        break;
+
+      case Expr::APPLY:
+        add((int) e->apply_op().op);
+        add((int) e->apply_op().type);
+        add(e->lhs());
+        add(e->rhs());
+        break;
+
+      case Expr::DEREF:
+        add(e->deref_ptr());
+        break;
+    }
+  }
+
+  void add(BExpr::Ptr b) {
+    assert(b.get() != nullptr);
+    add((int) b->tag());
+
+    switch (b->tag()) {
+      case NOT:
+        add(b->neg());
+        break;
+
+      case AND:
+      case OR:
+        add(b->lhs());
+        add(b->rhs());
+        break;
+
+      case CMP:
+        add((int) b->cmp.op());
+        add((int) b->cmp.type());
+        add(b->cmp_lhs());
+        add(b->cmp_rhs());
+        break;
+    }
+  }
+
+  void add(CExpr::Ptr c) {
+    assert(c.get() != nullptr);
+    add((int) c->tag());
+    add(c->bexpr());
+  }
+
+  void add(Stmts const &stmts) {
+    add((int) stmts.size());
+
+    for (auto const &s : stmts) {
+      add(*s);
+    }
+  }
+
+  void add(Stmt &s) {
+    add((int) s.tag);
+
+    switch (s.tag) {
+      case Stmt::SKIP:
+      case Stmt::GATHER_PREFETCH:
+        break;
+
+      case Stmt::ASSIGN:
+        add(s.assign_lhs());
+        add(s.assign_rhs());
+        break;
+
+      case Stmt::SEQ:
+        add(s.body());
+        break;
+
+      case Stmt::WHERE:
+        add(s.where_cond());
+        add(s.then_block());
+        add(s.else_block());
+        break;
+
+      case Stmt::IF:
+        add(s.if_cond());
+        add(s.then_block());
+        add(s.else_block());
+        break;
+
+      case Stmt::WHILE:
+        add(s.loop_cond());
+        add(s.body());
+        break;
+
+      case Stmt::LOAD_RECEIVE:
+        add(s.address());
+        break;
+
+      default:
+        // DMA statements; the pretty output contains all relevant fields
+        assertq(DMA::Stmt::is_dma_tag(s.tag), "KernelCache: unexpected stmt-tag in AST", true);
+        add(s.dma.pretty(0, s.tag));
+        break;
+    }
+  }
+
+private:
+  uint64_t m_hash = 0xcbf29ce484222325ull;
+};
+
+
+// ============================================================================
+// File handling
+// ============================================================================
+
+std::string file_name(uint64_t key) {
+  char buf[32];
+  sprintf(buf, "%016llx.v3dk", (unsigned long long) key);
+
+  std::string ret = LibSettings::kernel_cache_dir();
+  ret << "/" << buf;
+  return ret;
+}
+
+
+template<typename T>
+void write_raw(std::string &buf, T const &val) {
+  buf.append((char const *) &val, sizeof(T));
+}
+
+
+template<typename T>
+bool read_raw(std::string const &buf, size_t &pos, T &val) {
+  if (pos + sizeof(T) > buf.size()) return false;
+
+  memcpy(&val, buf.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+
+bool read_file(std::string const &filename, std::string &buf) {
+  FILE *f = fopen(filename.c_str(), "rb");
+  if (f == nullptr) return false;
+
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    buf.append(chunk, n);
+  }
+
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+}  // anon namespace
+
+
+bool enabled() {
+  return !LibSettings::kernel_cache_dir().empty();
+}
+
+
+/**
+ * Determine the cache key for a given kernel.
+ *
+ * Apart from the AST, this takes into account the target platform and
+ * the library settings which influence code generation.
+ */
+uint64_t key(Stmts const &body, bool for_vc4) {
+  Hasher h;
+  h.add((int) FORMAT_VERSION);
+  h.add(std::string(BUILD_ID));
+  h.add((int) INSTR_SIZE);
+  h.add((int) for_vc4);
+  h.add((int) LibSettings::use_tmu_for_load());
+  h.add((int) LibSettings::use_v3d_scheduler());
+  h.add((int) LibSettings::use_v3d_delay_slots());
+  h.add((int) LibSettings::use_ssa_optimizer());
+  h.add((int) LibSettings::use_constant_caching());
+  h.add(body);
+  return h.value();
+}
+
+
+/**
+ * Load a previously compiled kernel from the cache.
+ *
+ * @return true if found, false otherwise. An unreadable or corrupt file counts as not found.
+ */
+bool load(uint64_t key, Entry &entry) {
+  if (!enabled()) return false;
+
+  std::string buf;
+  if (!read_file(file_name(key), buf)) return false;
+
+  size_t   pos = 0;
+  char     magic[4];
+  uint32_t version;
+  char     build_id[sizeof(BUILD_ID)];
+  uint32_t instr_size;
+  uint64_t file_key;
+  int32_t  num_vars;
+  uint32_t num_instrs;
+
+  bool ok = read_raw(buf, pos, magic)
+         && read_raw(buf, pos, version)
+         && read_raw(buf, pos, build_id)
+         && read_raw(buf, pos, instr_size)
+         && read_raw(buf, pos, file_key)
+         && read_raw(buf, pos, num_vars)
+         && read_raw(buf, pos, num_instrs);
+
+  if (!ok || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != FORMAT_VERSION) {
+    return false;
+  }
+
+  if (memcmp(build_id, BUILD_ID, sizeof(BUILD_ID)) != 0 || instr_size != INSTR_SIZE || file_key != key) {
+    return false;  // Written by another library build
+  }
+
+  Entry ret;
+  ret.num_vars = num_vars;
+
+  for (uint32_t i = 0; i < num_instrs; ++i) {
+    Instr instr;
+    if (!instr.deserialize(buf, pos)) return false;
+    ret.target_code << instr;
+  }
+
+  uint32_t num_uniforms;
+  if (!read_raw(buf, pos, num_uniforms)) return false;
+
+  for (uint32_t i = 0; i < num_uniforms; ++i) {
+    int32_t val;
+    if (!read_raw(buf, pos, val)) return false;
+    ret.uniforms << val;
+  }
+
+  uint32_t num_opcodes;
+  if (!read_raw(buf, pos, num_opcodes)) return false;
+  if (pos + num_opcodes*sizeof(uint64_t) != buf.size()) return false;
+
+  ret.opcodes.resize(num_opcodes);
+  memcpy(ret.opcodes.data(), buf.data() + pos, num_opcodes*sizeof(uint64_t));
+
+  entry = ret;
+  return true;
+}
+
+
+/**
+ * Store a compiled kernel in the cache.
+ *
+ * The file is written under a temporary name and then renamed, so that concurrent
+ * runs and threads never see a partially written file.
+ *
+ * @return true if stored, false otherwise
+ */
+bool store(uint64_t key, Entry const &entry) {
+  if (!enabled()) return false;
+
+  std::string buf;
+  write_raw(buf, MAGIC);
+  write_raw(buf, FORMAT_VERSION);
+  write_raw(buf, BUILD_ID);
+  write_raw(buf, INSTR_SIZE);
+  write_raw(buf, key);
+  write_raw(buf, (int32_t) entry.num_vars);
+  write_raw(buf, (uint32_t) entry.target_code.size());
+
+  for (int i = 0; i < entry.target_code.size(); ++i) {
+    entry.target_code[i].serialize(buf);
+  }
+
+  write_raw(buf, (uint32_t) entry.uniforms.size());
+  for (int i = 0; i < entry.uniforms.size(); ++i) {
+    write_raw(buf, (int32_t) entry.uniforms[i]);
+  }
+
+  write_raw(buf, (uint32_t) entry.opcodes.size());
+  buf.append((char const *) entry.opcodes.data(), entry.opcodes.size()*sizeof(uint64_t));
+
+  mkdir(LibSettings::kernel_cache_dir().c_str(), 0755);  // Fails harmlessly if already present
+
+  std::string filename = file_name(key);
+  std::string tmp_name = filename;
+  int thread_id = (int) (std::hash<std::thread::id>()(std::this_thread::get_id()) & 0x7fffffff);
+  tmp_name << "." << (int) getpid() << "." << thread_id << ".tmp";
+
+  FILE *f = fopen(tmp_name.c_str(), "wb");
+  if (f == nullptr) {
+    warning("KernelCache: could not write to cache directory");
+    return false;
+  }
+
+  bool ok = (fwrite(buf.data(), 1, buf.size(), f) == buf.size());
+  ok = (fclose(f) == 0) && ok;
+  ok = ok && (rename(tmp_name.c_str(), filename.c_str()) == 0);
+
+  if (!ok) {
+    remove(tmp_name.c_str());
+    warning("KernelCache: failed to store compiled kernel");
+  }
+
+  return ok;
+}
+
+}  // namespace KernelCache
+}  // namespace V3DLib
@@ -0,0 +1,42 @@
+#ifndef _V3DLIB_COMMON_KERNELCACHE_H_
+#define _V3DLIB_COMMON_KERNELCACHE_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Source/Stmt.h"
+#include "Target/instr/Instr.h"
+
+namespace V3DLib {
+
+/**
+ * On-disk cache for compiled kernels.
+ *
+ * Compiling a kernel is expensive, mainly due to register allocation.
+ * Since the generated code depends only on the source AST and a handful of
+ * library settings, the result of a compile can be stored on disk and reused
+ * in later runs of the same program.
+ *
+ * The cache is disabled by default; it is enabled by setting a cache directory
+ * with `LibSettings::kernel_cache_dir()`.
+ */
+namespace KernelCache {
+
+/**
+ * The compile output retained in the cache
+ */
+struct Entry {
+  Instr::List           target_code;  // Target code, after register allocation
+  int                   num_vars = 0; // Number of variables after compilation
+  IntList               uniforms;     // Uniforms generated during compilation
+  std::vector<uint64_t> opcodes;      // Encoded instructions for the platform compiled for
+};
+
+bool enabled();
+uint64_t key(Stmts const &body, bool for_vc4);
+bool load(uint64_t key, Entry &entry);
+bool store(uint64_t key, Entry const &entry);
+
+}  // namespace KernelCache
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_COMMON_KERNELCACHE_H_
@@ -0,0 +1,116 @@
+#include "LaunchQueue.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace V3DLib {
+namespace {
+
+/**
+ * Worker thread with FIFO job queue
+ *
+ * The destructor runs all remaining jobs before stopping the thread,
+ * so that launches are not lost on program exit.
+ */
+class Worker {
+public:
+  ~Worker() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+  }
+
+  std::shared_future<void> submit(LaunchQueue::Job job) {
+    std::packaged_task<void()> task(job);
+    std::shared_future<void> ret = task.get_future().share();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      if (!m_thread.joinable()) {
+        m_thread = std::thread([this] () { run(); });
+      }
+
+      m_queue.push_back(std::move(task));
+      m_last = ret;
+    }
+
+    m_cv.notify_all();
+    return ret;
+  }
+
+  void wait_all() {
+    std::shared_future<void> last;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      last = m_last;
+    }
+
+    if (last.valid()) {
+      last.wait();  // Jobs run in order, so all previous jobs are done as well
+    }
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::packaged_task<void()>> m_queue;
+  std::shared_future<void> m_last;
+  std::thread m_thread;
+  bool m_stop = false;
+
+  void run() {
+    while (true) {
+      std::packaged_task<void()> task;
+
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] () { return m_stop || !m_queue.empty(); });
+
+        if (m_queue.empty()) return;  // Only if stopping
+
+        task = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+
+      task();  // Any exception is stored in the future
+    }
+  }
+};
+
+
+Worker &worker() {
+  static Worker w;
+  return w;
+}
+
+}  // anon namespace
+
+
+/**
+ * Add a job to the launch queue.
+ *
+ * @return future which becomes ready when the job has completed.
+ *         An exception thrown by the job is rethrown by `get()` on the future.
+ */
+std::shared_future<void> LaunchQueue::submit(Job job) {
+  return worker().submit(job);
+}
+
+
+/**
+ * Wait until all jobs submitted so far have completed
+ */
+void LaunchQueue::wait_all() {
+  worker().wait_all();
+}
+
+}  // namespace V3DLib
@@ -0,0 +1,28 @@
+#ifndef _V3DLIB_COMMON_LAUNCHQUEUE_H_
+#define _V3DLIB_COMMON_LAUNCHQUEUE_H_
+#include <functional>
+#include <future>
+
+namespace V3DLib {
+
+/**
+ * Queue for asynchronous kernel launches.
+ *
+ * Launches are executed in order of submission on a single worker thread,
+ * which is started on first use. The calling thread is free to prepare the
+ * next launch while a previous one is running.
+ *
+ * There is one queue for the entire process, since the QPUs can run only
+ * one kernel at a time anyway.
+ */
+class LaunchQueue {
+public:
+  using Job = std::function<void()>;
+
+  static std::shared_future<void> submit(Job job);
+  static void wait_all();
+};
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_COMMON_LAUNCHQUEUE_H_
@@ -8,6 +8,49 @@ BaseSharedArray::BaseSharedArray(BufferObject *heap, uint32_t element_size) :
 {}
 
 
+/**
+ * The allocation is transferred to the new instance; `a` is left empty.
+ */
+BaseSharedArray::BaseSharedArray(BaseSharedArray &&a) noexcept :
+  m_element_size(a.m_element_size)
+{
+  take(a);
+}
+
+
+BaseSharedArray &BaseSharedArray::operator=(BaseSharedArray &&a) {
+  if (this != &a) {
+    assertq(m_element_size == a.m_element_size, "SharedArray: can not move between arrays of different element size", true);
+    dealloc();
+    take(a);
+  }
+
+  return *this;
+}
+
+
+/**
+ * Take over the allocation of given array, leaving it empty.
+ *
+ * **Pre:** the current instance is not allocated, element sizes are the same
+ */
+void BaseSharedArray::take(BaseSharedArray &rhs) {
+  assert(m_element_size == rhs.m_element_size);
+  assert(!allocated());
+
+  m_heap         = rhs.m_heap;
+  m_usraddr      = rhs.m_usraddr;
+  m_phyaddr      = rhs.m_phyaddr;
+  m_size         = rhs.m_size;
+  m_is_heap_view = rhs.m_is_heap_view;
+
+  rhs.m_usraddr      = nullptr;
+  rhs.m_phyaddr      = 0;
+  rhs.m_size         = 0;
+  rhs.m_is_heap_view = false;
+}
+
+
 bool BaseSharedArray::allocated() const {
   if (m_size > 0) {
     assert(m_heap != nullptr);
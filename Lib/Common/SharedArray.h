@@ -1,16 +1,23 @@
 #ifndef _V3DLIB_COMMON_SHAREDARRAY_H_
 #define _V3DLIB_COMMON_SHAREDARRAY_H_
 #include <vector>
+#include <algorithm>   // fill_n
+#include <type_traits>
+#include <cstring>     // memcpy
 #include "BufferObject.h"
+#include "Span.h"
 #include "../Support/basics.h"
 #include "../Support/Platform.h"  // has_vc4
+#include "../Support/MemCopy.h"
 
 namespace V3DLib {
 
 class BaseSharedArray {
+  friend class SharedArrayPool;
+
 public:
-  BaseSharedArray(BaseSharedArray &&a) = default;
-  BaseSharedArray &operator=(BaseSharedArray &&a) = default; 
+  BaseSharedArray(BaseSharedArray &&a) noexcept;
+  BaseSharedArray &operator=(BaseSharedArray &&a);
 
   void alloc(uint32_t n);
   void dealloc();
@@ -38,6 +45,7 @@ private:
 
   BaseSharedArray(BaseSharedArray const &a) = delete;  // Disallow copy
 
+  void take(BaseSharedArray &rhs);
 };
 
 
@@ -70,10 +78,15 @@ public:
 
   void fill(T val) {
     assertq(allocated(), "Can not fill unallocated array", true);
-    for (int i = 0; i < (int) size(); i++)
-      (*this)[i] = val;
+    std::fill_n(ptr(), size(), val);
   }
 
+  /**
+   * Direct view on the array contents, for reading and writing without copying
+   */
+  Span<T>       view()       { return Span<T>(ptr(), size()); }
+  Span<T const> view() const { return Span<T const>(ptr(), size()); }
+
 
   T& operator[] (int i)       { return access(i); }
   T  operator[] (int i) const { return access(i); }
@@ -90,34 +103,33 @@ public:
 
 
   void copyFrom(T const *src, uint32_t in_size) {
+    static_assert(std::is_trivially_copyable<T>::value, "SharedArray: element type must be trivially copyable");
     assert(src != nullptr);
     assert(in_size <= size());
 
-    // TODO: consider using memcpy() instead
-    for (uint32_t offset = 0; offset < in_size; ++offset) {
-      (*this)[offset] = src[offset];
-    }
+    bulk_copy(ptr(), src, in_size*sizeof(T));
   }
 
   void copyFrom(std::vector<T> const &src) {
     assert(!src.empty());
-    assert(src.size() <= size());
+    copyFrom(src.data(), (uint32_t) src.size());
+  }
 
-    // TODO: consider using memcpy() instead
-    for (uint32_t offset = 0; offset < src.size(); ++offset) {
-      (*this)[offset] = src[offset];
+  void copyTo(T *dst, uint32_t in_size) const {
+    static_assert(std::is_trivially_copyable<T>::value, "SharedArray: element type must be trivially copyable");
+    assert(dst != nullptr);
+    assert(in_size <= size());
+
+    if (in_size > 0) {
+      memcpy(dst, ptr(), in_size*sizeof(T));  // Not bulk_copy(), the host will read dst soon
     }
   }
 
-  void copyTo(std::vector<T> &dst) {
+  void copyTo(std::vector<T> &dst) const {
     assert(!empty());
 
     dst.resize(size());
-
-    // TODO: consider using memcpy() instead
-    for (uint32_t offset = 0; offset < size(); ++offset) {
-      dst[offset] = (*this)[offset];
-    }
+    copyTo(dst.data(), size());
   }
 
 
@@ -230,6 +242,7 @@ public:
   using Parent::fill;
   using Parent::getAddress;
   using Parent::allocated;
+  using Parent::view;
 
   Parent const &get_parent() { return (Parent const &) *this; }  // explicit cast
 
@@ -237,19 +250,23 @@ public:
   int columns() const { return m_columns; }
 
   /**
-   * Copy values from square array `a` to array `b`, tranposing the array in the process
+   * Copy values from array `rhs` to this array, transposing the array in the process
+   *
+   * If this array is not allocated, it is allocated with the transposed dimensions of `rhs`.
+   *
+   * @param num_threads  number of threads to use. If <= 0, determine from array size
    */
-  void copy_transposed(Shared2DArray const &rhs) {
-    assertq(is_square() && rhs.is_square(), "copy_transposed(): can only transpose if both arrays are square");
-    assertq(m_rows == rhs.m_rows, "copy_transposed(): can only copy if arrays have same dimension");
+  void copy_transposed(Shared2DArray const &rhs, int num_threads = 0) {
+    assertq(rhs.allocated(), "copy_transposed(): source array not allocated");
 
-    int dim = m_rows;
-
-    for (int r = 0; r < dim; r++) {
-      for (int c = 0; c < dim; c++) {
-        (*this)[c][r] = rhs[r][c];
-      }
+    if (!allocated()) {
+      alloc(rhs.m_columns, rhs.m_rows);
     }
+
+    assertq(m_rows == rhs.m_columns && m_columns == rhs.m_rows,
+            "copy_transposed(): dimensions of arrays must be transposed of each other");
+
+    transpose(ptr(), rhs.ptr(), rhs.m_rows, rhs.m_columns, sizeof(T), num_threads);
   }
 
   bool is_square() const {
@@ -303,18 +320,52 @@ public:
   }
 
 
-  void copyTo(std::vector<T> &dst) {
+  void copyTo(std::vector<T> &dst) const {
     assert(rows() > 0);
     assert(columns() > 0);
 
     dst.resize(rows()*columns());
+    Parent::copyTo(dst.data(), (uint32_t) dst.size());
+  }
 
-    for (int r = 0; r < rows(); ++r) {
-      for (int c = 0; c < columns(); ++c) {
-        int offset = r*columns() + c;
-        dst[offset] = (*this)[r][c];
-      }
-    }
+
+  /**
+   * Copy rows from a host buffer with given row stride
+   *
+   * @param src_stride  distance in elements between the starts of consecutive rows in `src`
+   */
+  void copyFrom(T const *src, int src_stride) {
+    assert(src != nullptr);
+    assert(src_stride >= columns());
+
+    copy_strided(ptr(), columns()*sizeof(T), src, src_stride*sizeof(T), columns()*sizeof(T), rows(), true);
+  }
+
+
+  /**
+   * Copy rows to a host buffer with given row stride
+   *
+   * @param dst_stride  distance in elements between the starts of consecutive rows in `dst`
+   */
+  void copyTo(T *dst, int dst_stride) const {
+    assert(dst != nullptr);
+    assert(dst_stride >= columns());
+
+    copy_strided(dst, dst_stride*sizeof(T), ptr(), columns()*sizeof(T), columns()*sizeof(T), rows(), false);
+  }
+
+
+  /**
+   * Direct view on a single row
+   */
+  Span<T> row_view(int row) {
+    assert(0 <= row && row < m_rows);
+    return Span<T>(ptr() + row*m_columns, m_columns);
+  }
+
+  Span<T const> row_view(int row) const {
+    assert(0 <= row && row < m_rows);
+    return Span<T const>(ptr() + row*m_columns, m_columns);
   }
 
 private:
@@ -0,0 +1,80 @@
+#include "SharedArrayPool.h"
+
+namespace V3DLib {
+
+SharedArrayPool::~SharedArrayPool() {
+  assert(m_num_leased == 0);  // Leases refer to the pool
+  clear();
+}
+
+
+/**
+ * Deallocate all arrays which are currently not leased
+ */
+void SharedArrayPool::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto &item : m_idle) {
+    for (auto &arr : item.second) {
+      arr.dealloc();
+    }
+  }
+
+  m_idle.clear();
+}
+
+
+int SharedArrayPool::num_idle() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  int ret = 0;
+  for (auto const &item : m_idle) {
+    ret += (int) item.second.size();
+  }
+
+  return ret;
+}
+
+
+int SharedArrayPool::num_leased() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_num_leased;
+}
+
+
+/**
+ * Hand over an idle array of `n` elements to `dst`, if present.
+ *
+ * @return true if an array was handed over, false if `dst` needs to be allocated by the caller
+ */
+bool SharedArrayPool::take(BaseSharedArray &dst, uint32_t n) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_num_leased++;
+
+  auto it = m_idle.find(Key(dst.m_element_size, n));
+  if (it == m_idle.end() || it->second.empty()) {
+    m_num_allocs++;
+    return false;
+  }
+
+  dst.take(it->second.back());
+  it->second.pop_back();
+  return true;
+}
+
+
+/**
+ * Return the array of a lease to the pool
+ */
+void SharedArrayPool::put_back(BaseSharedArray &src) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  assert(m_num_leased > 0);
+  m_num_leased--;
+
+  if (!src.allocated()) return;  // Deallocated while leased, nothing to keep
+  assert(!src.m_is_heap_view);
+
+  m_idle[Key(src.m_element_size, src.size())].emplace_back(std::move(src));
+}
+
+}  // namespace V3DLib
@@ -0,0 +1,98 @@
+#ifndef _V3DLIB_COMMON_SHAREDARRAYPOOL_H_
+#define _V3DLIB_COMMON_SHAREDARRAYPOOL_H_
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "SharedArray.h"
+
+namespace V3DLib {
+
+/**
+ * Pool for reusing shared arrays.
+ *
+ * Arrays are handed out as leases. When a lease goes out of scope, its array is returned
+ * to the pool instead of being deallocated. A following request for an array with the same
+ * element size and number of elements reuses it, without calling the heap manager.
+ *
+ * Arrays of different types but with the same element size are interchangeable.
+ *
+ * The pool must outlive its leases.
+ */
+class SharedArrayPool {
+public:
+  template<typename T>
+  class Lease {
+  public:
+    Lease(Lease &&rhs) : m_pool(rhs.m_pool), m_array(std::move(rhs.m_array)) { rhs.m_pool = nullptr; }
+    ~Lease() { release(); }
+
+    SharedArray<T> &get()        { return m_array; }
+    SharedArray<T> &operator*()  { return m_array; }
+    SharedArray<T> *operator->() { return &m_array; }
+
+    /**
+     * Return the array to the pool before the lease goes out of scope
+     */
+    void release() {
+      if (m_pool != nullptr) {
+        m_pool->put_back(m_array);
+        m_pool = nullptr;
+      }
+    }
+
+  private:
+    friend class SharedArrayPool;
+
+    SharedArrayPool *m_pool = nullptr;
+    SharedArray<T>   m_array;
+
+    Lease(SharedArrayPool *pool, BufferObject *heap) : m_pool(pool), m_array(*heap) {}
+    Lease(SharedArrayPool *pool) : m_pool(pool) {}
+    Lease(Lease const &rhs) = delete;
+  };
+
+  SharedArrayPool() = default;
+  SharedArrayPool(BufferObject &heap) : m_heap(&heap) {}
+  ~SharedArrayPool();
+
+  /**
+   * Get an array with `n` elements from the pool.
+   *
+   * The contents of a reused array are not cleared.
+   */
+  template<typename T>
+  Lease<T> acquire(uint32_t n) {
+    assert(n > 0);
+    Lease<T> ret = (m_heap != nullptr)? Lease<T>(this, m_heap) : Lease<T>(this);
+
+    if (!take(ret.m_array, n)) {
+      ret.m_array.alloc(n);
+    }
+
+    return ret;
+  }
+
+  void clear();
+  int num_idle() const;
+  int num_leased() const;
+  int num_allocs() const { return m_num_allocs; }
+
+private:
+  using Key = std::pair<uint32_t, uint32_t>;  // element size, number of elements
+
+  mutable std::mutex m_mutex;
+  BufferObject *m_heap = nullptr;              // If null, use global heap
+  std::map<Key, std::vector<BaseSharedArray>> m_idle;
+  int m_num_leased = 0;
+  int m_num_allocs = 0;                        // Number of times memory had to be allocated
+
+  SharedArrayPool(SharedArrayPool const &rhs) = delete;
+
+  bool take(BaseSharedArray &dst, uint32_t n);
+  void put_back(BaseSharedArray &src);
+};
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_COMMON_SHAREDARRAYPOOL_H_
@@ -0,0 +1,44 @@
+#ifndef _V3DLIB_COMMON_SPAN_H_
+#define _V3DLIB_COMMON_SPAN_H_
+#include <cstddef>
+#include "../Support/debug.h"
+
+namespace V3DLib {
+
+/**
+ * Non-owning view of a contiguous range of elements.
+ *
+ * Stand-in for `std::span`, which is not available in C++17.
+ * Used for reading and writing shared arrays without copying.
+ */
+template<typename T>
+class Span {
+public:
+  Span() = default;
+  Span(T *data, size_t size) : m_data(data), m_size(size) {}
+
+  T *data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  T *begin() const { return m_data; }
+  T *end() const { return m_data + m_size; }
+
+  T &operator[](size_t i) const {
+    assertq(i < m_size, "Span::[]: index outside of possible range", true);
+    return m_data[i];
+  }
+
+  Span subspan(size_t offset, size_t count) const {
+    assert(offset + count <= m_size);
+    return Span(m_data + offset, count);
+  }
+
+private:
+  T     *m_data = nullptr;
+  size_t m_size = 0;
+};
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_COMMON_SPAN_H_
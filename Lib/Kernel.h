@@ -1,8 +1,11 @@
 #ifndef _V3DLIB_KERNEL_H_
 #define _V3DLIB_KERNEL_H_
 #include <tuple>
+#include <memory>
+#include <vector>
 #include <algorithm>  // std::move
 #include "BaseKernel.h"
+#include "Common/CompileContext.h"
 #include "Source/Complex.h"
 //#include "Support/assign.h"
 
@@ -129,6 +132,36 @@ Kernel<ts...> compile(void (*f)(ts... params), CompileFor compile_for = BOTH) {
   return std::move(k);
 }
 
+
+/**
+ * Compile multiple kernels with the same parameter types on a thread pool.
+ *
+ * The kernel functions should not depend on state which differs per kernel,
+ * see `compile_all()` in `Common/CompileContext.h`.
+ *
+ * @return compiled kernels, in the order of the passed functions
+ */
+template <typename... ts>
+std::vector<Kernel<ts...>> compile_all(std::vector<void (*)(ts... params)> const &fs, CompileFor compile_for = BOTH) {
+  std::vector<std::unique_ptr<Kernel<ts...>>> kernels(fs.size());
+  std::vector<std::function<void()>> jobs;
+
+  for (size_t i = 0; i < fs.size(); i++) {
+    jobs.push_back([&kernels, &fs, i, compile_for] () {
+      kernels[i].reset(new Kernel<ts...>(fs[i], compile_for));
+    });
+  }
+
+  compile_all(jobs);
+
+  std::vector<Kernel<ts...>> ret;
+  for (auto &k : kernels) {
+    ret.push_back(std::move(*k));
+  }
+
+  return ret;
+}
+
 }  // namespace V3DLib
 
 #endif  // _V3DLIB_KERNEL_H_
@@ -1,5 +1,6 @@
 #include "KernelDriver.h"
 #include <iostream>            // cout
+#include <chrono>
 #include "Support/basics.h"
 #include "Support/Platform.h"
 #include "Source/StmtStack.h"
@@ -7,9 +8,12 @@
 #include "Source/Translate.h"
 #include "Source/Lang.h"       // initStmt
 #include "Target/Satisfy.h"
+#include "Liveness/SSA.h"
+#include "LibSettings.h"
 #include "SourceTranslate.h"
 #include "Support/Timer.h"
 #include "Target/instr/Mnemonics.h"
+#include "Common/KernelCache.h"
 
 namespace V3DLib {
 
@@ -119,16 +123,23 @@ void loadStorePass(Instr::List &instrs) {
 void compile_postprocess(Instr::List &targetCode) {
   assertq(!targetCode.empty(), "compile_postprocess(): passed target code is empty");
 
+  if (LibSettings::use_ssa_optimizer()) {
+    PassTimer t("ssa", targetCode);
+    optimize_ssa(targetCode);
+  }
+
   if (Platform::compiling_for_vc4()) {
+    PassTimer t("loadStorePass", targetCode);
     loadStorePass(targetCode);
   }
 
-  //compile_data.target_code_before_regalloc = targetCode.dump();
+  //compile_data().target_code_before_regalloc = targetCode.dump();
 
   // Perform register allocation
   getSourceTranslate().regAlloc(targetCode);  // performance hog 32/33s
 
   // Satisfy target code constraints
+  PassTimer t("satisfy", targetCode);
   satisfy(targetCode);
 }
 
@@ -142,13 +153,17 @@ KernelDriver::~KernelDriver() {}
 /**
  * Reset the state for compilation
  *
+ * The platform to compile for is taken over from the current compile context of the caller.
  */
 void KernelDriver::init_compile() {
+  m_context.for_vc4 = Platform::compiling_for_vc4();
+  CompileContext::Scope scope(m_context);
+
   initStack(m_stmtStack);
   VarGen::reset();
   resetFreshLabelGen();
   Pointer::reset_increment();
-  compile_data.clear();
+  compile_data().clear();
 
   // Initialize reserved general-purpose variables
   Int qpuId, qpuCount;
@@ -173,16 +188,76 @@ void KernelDriver::obtain_ast() {
 }
 
 
+/**
+ * Retrieve the compiled kernel from the kernel cache, if present.
+ *
+ * To be called directly after `obtain_ast()`.
+ *
+ * @return true if the kernel was loaded from cache and compilation can be skipped,
+ *         false otherwise
+ */
+bool KernelDriver::load_from_cache() {
+  if (!KernelCache::enabled()) return false;
+
+  m_cache_key = KernelCache::key(m_body, Platform::compiling_for_vc4());
+
+  KernelCache::Entry entry;
+  if (!KernelCache::load(m_cache_key, entry)) return false;
+
+  m_targetCode = entry.target_code;
+  m_numVars    = entry.num_vars;
+  m_uniforms   = entry.uniforms;
+  cache_opcodes(entry.opcodes);
+  m_from_cache = true;
+  return true;
+}
+
+
+/**
+ * Store the compiled kernel in the kernel cache.
+ *
+ * To be called at the end of compilation, after encoding.
+ */
+void KernelDriver::store_in_cache() {
+  if (!KernelCache::enabled()) return;
+  if (has_errors()) return;
+  if (compile_data().spill_buffer) return;  // Code contains the address of the kernel's own spill buffer
+
+  KernelCache::Entry entry;
+  entry.target_code = m_targetCode;
+  entry.num_vars    = VarGen::count();
+  entry.uniforms    = m_uniforms;
+  entry.opcodes     = cache_opcodes();
+  KernelCache::store(m_cache_key, entry);
+}
+
+
 /**
  * Entry point for compilation of source code to target code.
  *
  * This method is here to just handle thrown exceptions.
  */
 void KernelDriver::compile(std::function<void()> create_ast) {
+  CompileContext::Scope scope(m_context);
+  auto start = std::chrono::steady_clock::now();
+
+  // Set the total compile time before the compile data is taken over
+  auto set_total = [start] () {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    compile_data().profile.total_ms(std::chrono::duration<double, std::milli>(elapsed).count());
+  };
+
   try {
-    create_ast();
+    {
+      PassTimer t("ast");
+      create_ast();
+    }
+
     compile_intern();
-    m_numVars = VarGen::count();
+
+    if (!m_from_cache) {
+      m_numVars = VarGen::count();
+    }
   } catch (V3DLib::Exception const &e) {
     std::string msg = "Exception occured during compilation: ";
     msg << e.msg();
@@ -192,13 +267,20 @@ void KernelDriver::compile(std::function<void()> create_ast) {
     if (e.msg().compare(0, 5, "ERROR") == 0) {
       errors << msg;
     } else {
-      m_compile_data = compile_data;
+      set_total();
+      m_compile_data = compile_data();
+      compile_data().spill_buffer.reset();
       throw;  // Must be a fatal()
     }
 
   }
 
-  m_compile_data = compile_data;
+  set_total();
+  m_compile_data = compile_data();
+
+  // The spill buffer belongs to this kernel. The compile data of the context is
+  // only for use during compilation, so it should not keep a reference.
+  compile_data().spill_buffer.reset();
 }
 
 
@@ -246,6 +328,8 @@ Stmts &KernelDriver::sourceCode() {
 * @param filename  if specified, print the output to this file. Otherwise, print to stdout
 */
 void KernelDriver::pretty(char const *filename, bool output_qpu_code) {
+  CompileContext::Scope scope(m_context);
+
   FILE *f = open_file(filename, "pretty");
   if (f == nullptr) return;
 
@@ -297,14 +381,53 @@ void KernelDriver::invoke(int numQPUs, IntList &params) {
 }
 
 
+/**
+ * Perform the checks and allocations for invoking the kernel.
+ *
+ * This is for asynchronous launches; it must be called on the thread which
+ * manages the shared memory, before `invoke()` is called on the worker thread.
+ * All shared memory needed for the invocation is allocated here, so that `invoke()`
+ * does not touch the heap. Calling `invoke()` directly does not require this.
+ */
+void KernelDriver::prepare_invoke(int numQPUs, IntList const &params) {
+  if (handle_errors()) {
+    fatal("Errors during kernel compilation/encoding, can't continue.");
+  }
+
+  prepare_invoke_intern(numQPUs, params);
+}
+
+
 std::string KernelDriver::compile_info() const {
   std::string ret;
 
   ret << "  compile num generated variables: " << numVars() << "\n"
       << "  num accs introduced            : " << numAccs() << "\n"
-      << "  num compile errors             : " << errors.size();
+      << "  num loops unrolled             : " << m_compile_data.num_loops_unrolled << "\n"
+      << "  num loops pipelined            : " << m_compile_data.num_loops_pipelined << "\n"
+      << "  num consts folded              : " << m_compile_data.num_consts_folded << "\n"
+      << "  num common subexprs removed    : " << m_compile_data.num_cse_removed << "\n"
+      << "  num invariants hoisted         : " << m_compile_data.num_invariants_hoisted << "\n"
+      << "  num dead instructions removed  : " << m_compile_data.num_dead_removed << "\n"
+      << "  num constants cached (v3d)     : " << m_compile_data.num_consts_cached << "\n"
+      << "  num constant uniforms (v3d)    : " << m_compile_data.num_const_uniforms << "\n"
+      << "  num moves coalesced            : " << m_compile_data.num_moves_removed << "\n"
+      << "  num packed slots (v3d)         : " << m_compile_data.num_packed_slots << "\n"
+      << "  num delay slots filled         : " << m_compile_data.num_delay_slots_filled << "\n"
+      << "  num spilled variables          : " << numSpills() << "\n"
+      << "  num compile errors             : " << errors.size() << "\n"
+      << "  loaded from kernel cache       : " << (m_from_cache? "yes" : "no") << "\n"
+      << m_compile_data.profile.dump();
 
   return ret;
 }
 
+
+/**
+ * @return per-pass timing of the compilation as JSON object
+ */
+std::string KernelDriver::compile_profile_json() const {
+  return m_compile_data.profile.json();
+}
+
 }  // namespace V3DLib
@@ -5,6 +5,7 @@
 #include <functional>
 #include "Common/BufferType.h"
 #include "Common/CompileData.h"
+#include "Common/CompileContext.h"
 #include "Source/StmtStack.h"
 
 namespace V3DLib {
@@ -19,34 +20,47 @@ public:
   void compile(std::function<void()> create_ast);
   virtual void encode() = 0;
   void invoke(int numQPUs, IntList &params);
+  void prepare_invoke(int numQPUs, IntList const &params);
   bool has_errors() const { return !errors.empty(); }
   std::string get_errors() const;
   int numVars() const { return m_numVars; }
+  int numSpills() const { return m_compile_data.num_spills; }
   Instr::List &targetCode() { return m_targetCode; }
   Stmts &sourceCode();
 
   void pretty(char const *filename = nullptr, bool output_qpu_code = true);
   std::string compile_info() const;
+  std::string compile_profile_json() const;
+  CompileProfile const &compile_profile() const { return m_compile_data.profile; }
   void dump_compile_data(char const *filename) const;
 
 protected:
   Instr::List m_targetCode;           // Target code generated from AST
   Stmts       m_body;
+  IntList     m_uniforms;             // Uniforms generated during compilation, passed after the kernel parameters
 
   int qpuCodeMemOffset = 0;
   std::vector<std::string> errors;
 
   virtual void emit_opcodes(FILE *f) {} 
   void obtain_ast();
+  bool load_from_cache();
+  void store_in_cache();
 
 private:
   BufferType const buffer_type;
   StmtStack m_stmtStack;
   int m_numVars = 0;                  // The number of variables in the source code for vc4
   CompileData m_compile_data;
+  CompileContext m_context;           // State used during compilation of this kernel
+  uint64_t m_cache_key = 0;
+  bool m_from_cache = false;          // If true, compiled code was loaded from the kernel cache
 
   virtual void compile_intern() = 0;
   virtual void invoke_intern(int numQPUs, IntList &params) = 0;
+  virtual void prepare_invoke_intern(int numQPUs, IntList const &params) {}
+  virtual std::vector<uint64_t> cache_opcodes() = 0;
+  virtual void cache_opcodes(std::vector<uint64_t> const &code) = 0;
 
   int numAccs() const { return m_compile_data.num_accs_introduced; }
 
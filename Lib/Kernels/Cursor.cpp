@@ -1,6 +1,7 @@
 #include "Cursor.h"
 #include "Source/Lang.h"
 #include "Source/gather.h"
+#include "Support/Platform.h"
 
 
 namespace V3DLib {
@@ -9,10 +10,10 @@ namespace V3DLib {
 // Class Cursor::Block
 ///////////////////////////////////////////////////////////////////////////////
 
-Cursor::Block::Block(Cursor const &c, int in_first_index) : m_cursor(c), first_index(in_first_index) {
+Cursor::Block::Block(Line const *lines) : m_lines(lines) {
   for (int i = 0; i < 3; i++) {
-    c.row[first_index - 1 + i].shiftLeft(m_right[i]);
-    c.row[first_index - 1 + i].shiftRight(m_left[i]);
+    m_lines[i].shiftLeft(m_right[i]);
+    m_lines[i].shiftRight(m_left[i]);
   }
 }
 
@@ -53,25 +54,58 @@ void Cursor::Line::advance() {
 }
 
 
+/**
+ * Advance the cursor line by one vector, using a passed value as the next vector
+ */
+void Cursor::Line::advance(Float const &in_next) {
+  prev    = current;
+  current = next;
+  next    = in_next;
+}
+
+
 void Cursor::Line::finish() {
   receive(next);
 }
 
 
 /**
- * Shift-left the current vector by one element,
- * using the value of the `next` vector
+ * Get the values of the current vector at a horizontal offset `dx`
+ *
+ * Element `i` of the result is the value at position `i + dx` relative to the current vector.
+ * Values from the `prev` and `next` vectors are shifted in as required, hence `|dx| < 16`.
  *
  * The operation `rotate(x, n)` will rotate 16-vector
  *`x` right by `n` places where `n` is a integer in the range 0 to 15.
  * Rotating right by 15 is the same as rotating left by 1.
  */
+void Cursor::Line::shift(int dx, Float &result) const {
+  assert(-16 < dx && dx < 16);
+
+  if (dx == 0) {
+    result = current;
+  } else if (dx > 0) {
+    result = rotate(current, 16 - dx); comment("Cursor shift left");
+    Float nextRot = rotate(next, 16 - dx);
+    Where (index() >= 16 - dx)
+      result = nextRot;
+    End
+  } else {
+    result = rotate(current, -dx); comment("Cursor shift right");
+    Float prevRot = rotate(prev, -dx);
+    Where (index() < -dx)
+      result = prevRot;
+    End
+  }
+}
+
+
+/**
+ * Shift-left the current vector by one element,
+ * using the value of the `next` vector
+ */
 void Cursor::Line::shiftLeft(Float& result) const {
-  result = rotate(current, 15); comment("Cursor shiftLeft");
-  Float nextRot = rotate(next, 15);
-  Where (index() == 15)
-    result = nextRot;
-  End
+  shift(1, result);
 }
 
 
@@ -80,11 +114,7 @@ void Cursor::Line::shiftLeft(Float& result) const {
  * using the value of the prev vector.
  */
 void Cursor::Line::shiftRight(Float& result) const {
-  result = rotate(current, 1); comment("Cursor shiftRight");
-  Float prevRot = rotate(prev, 1);
-  Where (index() == 0)
-    result = prevRot;
-  End
+  shift(-1, result);
 }
 
 
@@ -119,7 +149,7 @@ void Cursor::step(std::function<void(Block const &, Float &)> f) {
 
   for (int i = 1; i < m_num_lines - 1; ++i) {
     assert(row[i].has_dst);
-    Block b(*this, i);
+    Block b(&row[i - 1]);
 
     Float output = 0.0f;
     f(b, output);
@@ -139,4 +169,137 @@ void Cursor::finish() {
   for (int i = 0; i < m_num_lines; i++) row[i].finish();
 }
 
+
+///////////////////////////////////////////////////////////////////////////////
+// Class TemporalCursor
+///////////////////////////////////////////////////////////////////////////////
+
+TemporalCursor::TemporalCursor(Int const &width, Int const &height, int rows, int steps) :
+  m_width(width),
+  m_height(height),
+  m_rows(rows),
+  m_steps(steps)
+{
+  assertq(rows >= 1, "TemporalCursor: there must be at least one row", true);
+  assertq(steps >= 1, "TemporalCursor: there must be at least one step", true);
+}
+
+
+/**
+ * Compute `steps()` time steps for the output rows starting at `first_row`.
+ *
+ * `first_row` must be at least 1. Output rows past the second-last row of the map are not written.
+ */
+void TemporalCursor::run(Float::Ptr const &src, Float::Ptr const &dst, Int const &first_row, Stencil f) {
+  // Lines per time step, excluding the final one. Every time step has one halo row less on both sides
+  std::vector<std::vector<Line>> levels(m_steps);
+
+  for (int t = 0; t < m_steps; t++) {
+    levels[t].resize(m_rows + 2*(m_steps - t));
+
+    for (auto &line : levels[t]) {
+      line.current = 0.0f;  comment("TemporalCursor init");
+      line.next    = 0.0f;
+    }
+  }
+
+  load(levels[0], src, first_row, 0);
+
+  // Continue past the end of the row until the final time step has caught up
+  For (Int x = 0, x < m_width + 16*(m_steps - 1), x += 16)
+    load(levels[0], src, first_row, x + 16);
+
+    for (int t = 1; t <= m_steps; t++) {
+      auto *out_lines = (t < m_steps)? &levels[t] : nullptr;
+      compute(levels[t - 1], out_lines, dst, t, first_row, x - 16*(t - 1), f);
+    }
+  End
+}
+
+
+/**
+ * Load the input lines with the vectors at position `x`
+ *
+ * Rows outside the map are clamped to the border rows; values past the end of a row are zero.
+ */
+void TemporalCursor::load(std::vector<Line> &lines, Float::Ptr const &src, Int const &first_row, Int const &x) {
+  int const num_lines = (int) lines.size();
+  int const group     = Platform::gather_limit();
+
+  Int offset = x;  comment("TemporalCursor load");
+  Where (offset >= m_width)
+    offset = 0;
+  End
+
+  for (int i = 0; i < num_lines; i += group) {
+    int end = std::min(i + group, num_lines);
+
+    for (int j = i; j < end; j++) {
+      Int y = first_row + (j - m_steps);
+      Where (y < 0)
+        y = 0;
+      End
+      Where (y >= m_height)
+        y = m_height - 1;
+      End
+
+      gather(src + (y*m_width + offset));
+    }
+
+    for (int j = i; j < end; j++) {
+      Float val;
+      receive(val);
+
+      Where (x >= m_width)
+        val = 0.0f;
+      End
+
+      lines[j].advance(val);
+    }
+  }
+}
+
+
+/**
+ * Compute time step `level` at position `x` from the lines of the previous time step.
+ *
+ * If `out_lines` is null, this is the final time step and the output is written to `dst`.
+ * Otherwise, the lines in `out_lines` are advanced with the result.
+ */
+void TemporalCursor::compute(
+  std::vector<Line> const &src, std::vector<Line> *out_lines, Float::Ptr const &dst,
+  int level, Int const &first_row, Int const &x,
+  Stencil f
+) {
+  int const num_out = (int) src.size() - 2;
+  bool const last   = (out_lines == nullptr);
+  assert(last == (level == m_steps));
+
+  for (int j = 0; j < num_out; j++) {
+    Int y = first_row + (j - (m_steps - level));  comment("TemporalCursor compute");
+
+    Cursor::Block b(&src[j]);
+    Float output = 0.0f;
+    f(b, x, output);
+
+    if (last) {
+      If (x >= 0 && y < m_height - 1)
+        Float::Ptr out = dst + (y*m_width + x);
+        *out = output;
+      End
+    } else {
+      // The border rows never change
+      Where (y <= 0 || y >= m_height - 1)
+        output = src[j + 1].current;
+      End
+
+      Where (x < 0 || x >= m_width)
+        output = 0.0f;
+      End
+
+      (*out_lines)[j].advance(output);
+    }
+  }
+}
+
 }  // namespace V3DLib
@@ -43,19 +43,40 @@ namespace V3DLib {
  */
 class Cursor {
 public:
+  /**
+   * A line of values, as a sliding window of three consecutive vectors
+   */
+  struct Line {
+    void init(Float::Ptr in_src);
+    void init(Float::Ptr in_src, Float::Ptr const &in_dst);
+
+    void prime();
+    void advance();
+    void advance(Float const &in_next);
+    void finish();
+    void shift(int dx, Float &result) const;
+    void shiftLeft(Float& result) const;
+    void shiftRight(Float& result) const;
+
+    Float::Ptr src;
+    Float::Ptr dst;
+    bool has_dst = false;
+    Float prev, current, next;
+  };
+
+
   /**
    * Represent a 3x3 block of values which are currently active
    */
   struct Block {
-    Block(Cursor const &c, int in_first_index);
+    Block(Line const *lines);
 
     Float const &left(int n)    const  { return m_left[n]; }
-    Float const &current(int n) const  { return m_cursor.row[first_index - 1 + n].current; }
+    Float const &current(int n) const  { return m_lines[n].current; }
     Float const &right(int n)   const  { return m_right[n]; }
 
   private:
-    Cursor const &m_cursor;
-    int    first_index;
+    Line const *m_lines;  // The three consecutive lines of the block
     Float  m_left[3];
     Float  m_right[3];
   };
@@ -69,28 +90,62 @@ public:
   void finish();
 
 private:
+  void advance();
 
-  struct Line {
-    void init(Float::Ptr in_src);
-    void init(Float::Ptr in_src, Float::Ptr const &in_dst);
+  std::vector<Line> row;
+  int m_num_lines = 3;
+  Int m_width;
+};
 
-    void prime();
-    void advance();
-    void finish();
-    void shiftLeft(Float& result) const;
-    void shiftRight(Float& result) const;
 
-    Float::Ptr src;
-    Float::Ptr dst;
-    bool has_dst = false;
-    Float prev, current, next;
-  };
+/**
+ * Stencil cursor which performs multiple time steps per kernel call.
+ *
+ * This is temporal blocking for sliding window algorithms such as HeatMap.
+ * Every call of `run()` computes a band of `rows()` output rows, `steps()` time steps
+ * further than the input. The band is extended with `steps()` halo rows on both sides,
+ * which are computed redundantly. Hence, the bands of different QPUs are independent and
+ * no synchronization between the QPUs is required.
+ *
+ * The lines of all intermediate time steps are held in registers. The window of time step `t`
+ * lags one vector behind the window of time step `t - 1`, so that the values for the right
+ * neighbour are always available. This way, the input is read once and the output is written once
+ * for all the time steps.
+ *
+ * The values of the first and last row of the map are kept constant, and the values to the
+ * left and right of a row are zero.
+ *
+ * Every line of every time step takes three registers. The number of rows and steps is
+ * therefore limited by the register file. Up to 4 rows with 2 steps, or a single row with
+ * 3 steps, compile without spilling.
+ */
+class TemporalCursor {
+public:
+  /**
+   * Function to compute a single vector of output values.
+   *
+   * `x` is the index within the row of the first vector element.
+   */
+  using Stencil = std::function<void(Cursor::Block const &b, Int const &x, Float &output)>;
 
-  void advance();
+  TemporalCursor(Int const &width, Int const &height, int rows, int steps);
+
+  int rows() const  { return m_rows; }
+  int steps() const { return m_steps; }
+
+  void run(Float::Ptr const &src, Float::Ptr const &dst, Int const &first_row, Stencil f);
+
+private:
+  using Line = Cursor::Line;
 
-  std::vector<Line> row;
-  int m_num_lines = 3;
   Int m_width;
+  Int m_height;
+  int m_rows;
+  int m_steps;
+
+  void load(std::vector<Line> &lines, Float::Ptr const &src, Int const &first_row, Int const &x);
+  void compute(std::vector<Line> const &src, std::vector<Line> *out_lines, Float::Ptr const &dst,
+               int level, Int const &first_row, Int const &x, Stencil f);
 };
 
 }  // namespace V3DLib
@@ -0,0 +1,310 @@
+#include "FFT.h"
+#include <cmath>
+#include <functional>
+#include "Support/basics.h"
+#include "Support/Platform.h"
+#include "Source/gather.h"
+#include "Common/CompileContext.h"
+
+namespace kernels {
+
+using namespace V3DLib;
+using ::operator<<;  // C++ weirdness
+
+namespace {
+
+/**
+ * Settings for the stage kernel, set by the compile job of each stage in `FFTPlan`.
+ */
+struct fft_stage_settings {
+  int  log2n = -1;
+  int  level = -1;
+  int  radix =  2;
+  bool first = false;  // If true, read the input in bit-reversed order
+};
+
+thread_local fft_stage_settings stage_settings;
+
+
+unsigned bit_reverse(unsigned x, int log2n) {
+  unsigned ret = 0;
+
+  for (int i = 0; i < log2n; i++) {
+    ret = (ret << 1) | (x & 1);
+    x >>= 1;
+  }
+
+  return ret;
+}
+
+
+/**
+ * Gather complex values, taking the gather limit of the platform into account
+ */
+void fetch(std::vector<Complex> &dst, std::vector<Complex::Ptr> const &src) {
+  assert(dst.size() == src.size());
+  int n     = (int) src.size();
+  int group = Platform::gather_limit()/2;  // A complex value takes two gathers
+
+  for (int i = 0; i < n; i += group) {
+    int end = std::min(i + group, n);
+
+    for (int j = i; j < end; j++) gather(src[j]);
+    for (int j = i; j < end; j++) receive(dst[j]);
+  }
+}
+
+
+/**
+ * Kernel for a single stage of the FFT.
+ *
+ * Every QPU handles a subset of the output vectors. The output values are computed
+ * in the pull form of the decimation in time FFT. For a stage with butterfly span `m`
+ * and input distance `m2 = m/2`, output `q` is:
+ *
+ *     y[q] = x[q & ~m2] + W^((q mod m)*N/m) * x[q | m2]    with W = exp(-2*pi*i/N)
+ *
+ * The twiddle index includes the sign of the butterfly, since W^(k + N/2) == -W^k.
+ * A radix-4 stage combines two consecutive radix-2 stages.
+ *
+ * The first stage reads the input in bit-reversed order, optionally strided.
+ */
+void fft_stage_kernel(
+  Complex::Ptr src, Complex::Ptr dst,
+  Complex::Ptr twiddles, Int::Ptr bitrev,
+  Int num_vecs, Int batch_stride, Int elem_stride
+) {
+  auto const &s = stage_settings;
+  assert(s.radix == 2 || s.radix == 4);
+
+  int const n_mask = (1 << s.log2n) - 1;
+  int const m2     = 1 << s.level;
+
+  src      -= index();
+  twiddles -= index();
+  bitrev   -= index();
+
+  For (Int v = me(), v < num_vecs, v += numQPUs())
+    Int p = (v << 4) + index();  comment("FFT stage: index of output value");
+    Int q = p & n_mask;
+
+    // Indexes of the butterfly inputs within the transform
+    std::vector<Int> in(s.radix);
+    if (s.radix == 2) {
+      in[0] = q & ~m2;
+      in[1] = q | m2;
+    } else {
+      in[0] = q & ~(3*m2);
+      in[1] = in[0] | m2;
+      in[2] = in[0] | (2*m2);
+      in[3] = in[0] | (3*m2);
+    }
+
+    std::vector<Complex::Ptr> addr;
+
+    if (s.first) {
+      Int b_offset = (p >> s.log2n)*batch_stride;
+
+      std::vector<Int> offset(s.radix);
+      for (int k = 0; k < s.radix; k++) gather(bitrev + in[k]);
+      for (int k = 0; k < s.radix; k++) receive(offset[k]);
+
+      for (int k = 0; k < s.radix; k++) {
+        addr.emplace_back(src + (b_offset + offset[k]*elem_stride));
+      }
+    } else {
+      Int b_offset = p - q;
+
+      for (int k = 0; k < s.radix; k++) {
+        addr.emplace_back(src + (b_offset + in[k]));
+      }
+    }
+
+    // Twiddle factors, for radix 4 one per combined stage
+    addr.emplace_back(twiddles + ((q & (2*m2 - 1)) << (s.log2n - s.level - 1)));
+    if (s.radix == 4) {
+      addr.emplace_back(twiddles + ((q & (4*m2 - 1)) << (s.log2n - s.level - 2)));
+    }
+
+    std::vector<Complex> x(addr.size());
+    fetch(x, addr);
+
+    Complex y;
+    if (s.radix == 2) {
+      y = x[0] + x[2]*x[1];
+    } else {
+      Complex z1 = x[0] + x[4]*x[1];
+      Complex z2 = x[2] + x[4]*x[3];
+      y = z1 + x[5]*z2;
+    }
+
+    Complex::Ptr out = dst + (v << 4);
+    *out = y;
+  End
+}
+
+}  // anon namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class FFTPlan
+///////////////////////////////////////////////////////////////////////////////
+
+FFTPlan::FFTPlan(int log2n) :
+  m_log2n(log2n),
+  m_twiddles(1 << log2n),
+  m_bitrev(1 << log2n)
+{
+  if (log2n < MIN_LOG2N || log2n > MAX_LOG2N) {
+    std::string msg = "FFTPlan: log2 of size must be in the range ";
+    msg << MIN_LOG2N << " to " << MAX_LOG2N << ", got " << log2n;
+    assertq(false, msg, true);
+  }
+
+  int n = size();
+
+  for (int k = 0; k < n; k++) {
+    double phase = -2.0*M_PI*k/n;
+    m_twiddles[k] = complex((float) cos(phase), (float) sin(phase));
+    m_bitrev[k]   = (int) bit_reverse(k, log2n);
+  }
+
+  // Single radix-2 stage first for odd sizes, radix-4 for the rest
+  int level = 0;
+  if (log2n % 2 == 1) {
+    m_stages.push_back({2, level});
+    level++;
+  }
+
+  for (; level < log2n; level += 2) {
+    m_stages.push_back({4, level});
+  }
+
+  // Compile the stage kernels concurrently
+  m_kernels.resize(m_stages.size());
+  std::vector<std::function<void()>> jobs;
+
+  for (int i = 0; i < num_stages(); i++) {
+    jobs.push_back([this, i] () {
+      auto &s = stage_settings;
+      s.log2n = m_log2n;
+      s.level = m_stages[i].level;
+      s.radix = m_stages[i].radix;
+      s.first = (i == 0);
+
+      m_kernels[i].reset(new StageKernel(V3DLib::compile(fft_stage_kernel)));
+    });
+  }
+
+  V3DLib::compile_all(jobs);
+}
+
+
+bool FFTPlan::has_errors() const {
+  for (auto const &k : m_kernels) {
+    if (k->has_errors()) return true;
+  }
+
+  return false;
+}
+
+
+void FFTPlan::setNumQPUs(int val) {
+  assert(val >= 1);
+  m_num_qpus = val;
+}
+
+
+/**
+ * Perform FFT's on consecutive data
+ *
+ * @param batch  number of transforms. `in` and `out` should contain at least `batch*size()` values.
+ */
+void FFTPlan::execute(Complex::Array &in, Complex::Array &out, int batch) {
+  assertq((int) in.size()  >= batch*size(), "FFTPlan: input array too small");
+  assertq((int) out.size() >= batch*size(), "FFTPlan: output array too small");
+
+  execute_strided(in, out, batch, size(), 1);
+}
+
+
+/**
+ * @return scratch buffer with at least the given number of values
+ */
+Complex::Array &FFTPlan::scratch(int size) {
+  if (!m_scratch || (int) m_scratch->size() < size) {
+    m_scratch.reset();  // Release first, to free heap space
+    m_scratch.reset(new Complex::Array(size));
+  }
+
+  return *m_scratch;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class FFT2DPlan
+///////////////////////////////////////////////////////////////////////////////
+
+FFT2DPlan::FFT2DPlan(int log2_rows, int log2_columns) :
+  m_cols_plan(log2_rows),
+  m_rows_plan(log2_columns),
+  m_tmp(1 << (log2_rows + log2_columns))
+{}
+
+
+void FFT2DPlan::setNumQPUs(int val) {
+  m_cols_plan.setNumQPUs(val);
+  m_rows_plan.setNumQPUs(val);
+}
+
+
+/**
+ * Perform a 2D FFT
+ *
+ * The columns are transformed first, into a transposed intermediate result.
+ * Transforming the columns of the intermediate result gives the output in the original layout.
+ * The transposes are done by the strided input of the first stage.
+ *
+ * `in` and `out` may be the same array.
+ */
+void FFT2DPlan::execute(Complex::Array2D &in, Complex::Array2D &out) {
+  assertq(in.rows() == rows() && in.columns() == columns(), "FFT2DPlan: input has wrong dimensions");
+  assertq(out.rows() == rows() && out.columns() == columns(), "FFT2DPlan: output has wrong dimensions");
+
+  m_cols_plan.execute_strided(in, m_tmp, columns(), 1, columns());
+  m_rows_plan.execute_strided(m_tmp, out, rows(), 1, rows());
+}
+
+
+/**
+ * Scalar FFT, to compare with the QPU version.
+ *
+ * Radix-2 decimation in time.
+ */
+void fft_scalar(complex const *in, complex *out, int log2n) {
+  int n = 1 << log2n;
+
+  for (int i = 0; i < n; i++) {
+    out[bit_reverse(i, log2n)] = in[i];
+  }
+
+  for (int s = 1; s <= log2n; s++) {
+    int m  = 1 << s;
+    int m2 = m >> 1;
+
+    for (int j = 0; j < m2; j++) {
+      double phase = -2.0*M_PI*j/m;
+      complex w((float) cos(phase), (float) sin(phase));
+
+      for (int k = j; k < n; k += m) {
+        complex t = w*out[k + m2];
+        complex u = out[k];
+        out[k]       = u;
+        out[k]      += t;
+        out[k + m2]  = u - t;
+      }
+    }
+  }
+}
+
+}  // namespace kernels
@@ -0,0 +1,138 @@
+#ifndef _V3DLIB_KERNELS_FFT_H_
+#define _V3DLIB_KERNELS_FFT_H_
+#include <memory>
+#include <vector>
+#include "V3DLib.h"
+
+namespace kernels {
+
+using namespace V3DLib;
+
+/**
+ * Plan for the FFT of a given size.
+ *
+ * The plan contains the twiddle factors and the bit-reversal offsets for the size,
+ * and the compiled kernels for the stages. Create a plan once and reuse it for all
+ * transforms of the same size.
+ *
+ * The FFT is done with radix-4 stages, with a single radix-2 stage for odd powers of two.
+ * Each stage is a separate kernel call, which serves as synchronization between the QPUs.
+ *
+ * Each output value of a stage gathers its butterfly inputs and is written consecutively.
+ * Computing the butterflies per output value doubles the arithmetic, but no scattered
+ * writes are needed. This way, the FFT works on vc4 as well as v3d.
+ *
+ * Supported sizes are 2^6 up to 2^16.
+ */
+class FFTPlan {
+public:
+  enum {
+    MIN_LOG2N = 6,
+    MAX_LOG2N = 16
+  };
+
+  FFTPlan(int log2n);
+
+  int log2n() const { return m_log2n; }
+  int size() const { return 1 << m_log2n; }
+  int num_stages() const { return (int) m_stages.size(); }
+  int radix(int stage) const { return m_stages[stage].radix; }
+  bool has_errors() const;
+
+  void setNumQPUs(int val);
+  int  numQPUs() const { return m_num_qpus; }
+
+  void execute(Complex::Array &in, Complex::Array &out, int batch = 1);
+
+  template<typename In, typename Out>
+  void execute_strided(In &in, Out &out, int batch, int batch_stride, int elem_stride);
+
+private:
+  using StageKernel = V3DLib::Kernel<Complex::Ptr, Complex::Ptr, Complex::Ptr, Int::Ptr, Int, Int, Int>;
+
+  struct Stage {
+    int radix;
+    int level;  // log2 of the distance between the first two inputs of a butterfly
+  };
+
+  int m_log2n;
+  int m_num_qpus = 1;
+  std::vector<Stage> m_stages;
+  std::vector<std::unique_ptr<StageKernel>> m_kernels;
+  Complex::Array m_twiddles;
+  Int::Array     m_bitrev;
+  std::unique_ptr<Complex::Array> m_scratch;
+
+  Complex::Array &scratch(int size);
+};
+
+
+/**
+ * Run the transforms of the plan on the QPUs.
+ *
+ * Transform `b` reads its element `i` from index `b*batch_stride + i*elem_stride` in `in`.
+ * The output is always written consecutively, transform `b` starts at index `b*size()` in `out`.
+ *
+ * `in` is not changed. The stages alternate between the output and a scratch buffer,
+ * so `in` and `out` must be different arrays.
+ *
+ * @param batch  number of transforms to perform
+ */
+template<typename In, typename Out>
+void FFTPlan::execute_strided(In &in, Out &out, int batch, int batch_stride, int elem_stride) {
+  assertq(!has_errors(), "FFTPlan: can not execute, there are compile errors");
+  assertq(batch >= 1, "FFTPlan: batch size must be at least 1");
+  assertq((void *) &in != (void *) &out, "FFTPlan: input and output must be different arrays");
+
+  int num_vecs = batch*size()/16;
+  auto &tmp = scratch(batch*size());
+  int last = num_stages() - 1;
+
+  auto run = [this, num_vecs, batch_stride, elem_stride] (int i, auto *src, auto *dst) {
+    auto &k = *m_kernels[i];
+    k.setNumQPUs(m_num_qpus);
+    k.load(src, dst, &m_twiddles, &m_bitrev, num_vecs, batch_stride, elem_stride);
+    k.call();
+  };
+
+  // Let the final stage write to the output
+  for (int i = 0; i <= last; i++) {
+    bool to_out = ((last - i) % 2 == 0);
+
+    if (i == 0) {
+      if (to_out) run(i, &in, &out); else run(i, &in, &tmp);
+    } else {
+      if (to_out) run(i, &tmp, &out); else run(i, &out, &tmp);
+    }
+  }
+}
+
+
+/**
+ * Plan for 2D FFT's of a given size
+ *
+ * Both dimensions must be powers of two within the range supported by `FFTPlan`.
+ */
+class FFT2DPlan {
+public:
+  FFT2DPlan(int log2_rows, int log2_columns);
+
+  int rows() const { return m_cols_plan.size(); }
+  int columns() const { return m_rows_plan.size(); }
+  bool has_errors() const { return m_cols_plan.has_errors() || m_rows_plan.has_errors(); }
+  void setNumQPUs(int val);
+
+  void execute(Complex::Array2D &in, Complex::Array2D &out);
+
+private:
+  FFTPlan m_cols_plan;     // FFT over the columns, size is number of rows
+  FFTPlan m_rows_plan;     // FFT over the rows, size is number of columns
+  Complex::Array m_tmp;    // Transposed intermediate result
+};
+
+
+void fft_scalar(complex const *in, complex *out, int log2n);
+
+}  // namespace kernels
+
+#endif  // _V3DLIB_KERNELS_FFT_H_
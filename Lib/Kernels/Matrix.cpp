@@ -2,6 +2,7 @@
 #include <functional>
 #include "Support/basics.h"
 #include "Source/Functions.h"
+#include "Source/gather.h"
 
 namespace kernels {
 
@@ -72,13 +73,31 @@ void matrix_settings::num_blocks(int val) {
 }
 
 
+/**
+ * The number of output rows in a tile for method TILED.
+ *
+ * This is the largest value up to MAX_TILE_ROWS which divides the number of rows,
+ * so that the kernel does not need to check for partial tiles over the rows.
+ */
+int matrix_settings::tile_rows() const {
+  assert(rows > 0);
+
+  for (int ret = MAX_TILE_ROWS; ret > 1; ret--) {
+    if (rows % ret == 0) return ret;
+  }
+
+  return 1;
+}
+
+
 std::string matrix_settings::dump() const {
   std::string msg;
 
   msg << "settings "
       << "rows: " << rows << ", columns: " << columns
       << ", width: " << width() << ", inner: " << inner
-      << ", num blocks: " << m_num_blocks;
+      << ", num blocks: " << m_num_blocks
+      << ", method: " << ((method == TILED)?"tiled":"dot product");
 
   return msg;
 }
@@ -98,53 +117,7 @@ using namespace V3DLib;
 
 namespace {
 
-matrix_settings settings;
-
-
-////////////////////////////////////////////////////////////////////////////////
-// Kernel Helper Functions
-////////////////////////////////////////////////////////////////////////////////
-
-#if 0
-/**
- * Works, but does not improve the performance of matrix in any way.
- * The reason for this is that the dotvector product is already unrolled.
- *
- * Will still be useful in other contexts.
- *
- * ## Usage
- *
- * Given a loop:
- * 
- *   For (Int b_index = 0, b_index < DIM, b_index++)
- *     // Code possibly using b_index
- *   End
- *
- * Replace with following:
- *
- *   loop_unroll(DIM, 8, [&] (Int const &n) {  // n is loop index (watch out for conflict with `index()`)
- *     // Same code as in loop above
- *   });
- */
-void loop_unroll(int size, int unroll, std::function<void(Int const &)> f) {
-  assert(size > 0);
-  assert(unroll > 0);
-  assert(size >= unroll);
-  assertq(size % unroll == 0, "loop_unroll(): size must be a multiple of unroll");
-
-  std::string cmt("Loop unroll ");
-  cmt << unroll << " for size " << size;
-
-  Int i = 0;  comment(cmt);
-  For (, i < size, i += unroll)
-    for (int j = 0; j < unroll; ++j) {
-      f(i + j);
-      cmt = "End loop unroll ";
-      comment(cmt << j << "/" << unroll);
-    }
-  End
-}
-#endif  // 0
+thread_local matrix_settings settings;
 
 }  // anon namespace
 
@@ -175,6 +148,107 @@ void matrix_mult_scalar(int N, float *dst, float *a, float *b) {
 }
 
 
+/**
+ * Register-blocked matrix multiplication.
+ *
+ * Computes tiles of `tile_rows()` output rows by 16 output columns. Every vector lane
+ * handles one output column, so every output value is accumulated in its own lane and
+ * no horizontal reduction with `rotate_sum()` is needed.
+ *
+ * There is no broadcast of a single value to all lanes, so a straight outer product
+ * is not possible. Instead, the inner dimension is handled in blocks of 16 values, in
+ * diagonal order. For block offset `k` and shift `s`, lane `j` uses inner index
+ * `k + (j + s) mod 16`:
+ *
+ *   - the values of `b` are gathered per lane along this diagonal
+ *   - the row vectors of `a` are rotated by `s`, to line up with the diagonal
+ *
+ * The 16 diagonals cover all inner indexes of the block. Every gathered vector of `b` is
+ * used for all rows in the tile, which reduces the TMU loads of `b` by the number of tile rows.
+ *
+ * Input matrix `b` needs to be in transposed form, as for `matrix_mult()`.
+ */
+void matrix_mult_tiled(Float::Ptr dst, Float::Ptr a, Float::Ptr b) {
+  auto &settings = get_matrix_settings();
+  assert(settings.inner > 0 && (settings.inner % 16 == 0));
+
+  int const tile_rows = settings.tile_rows();
+  int const stride    = settings.inner;
+  int const group     = Platform::gather_limit();
+  int const columns   = settings.columns;
+  int const dst_cols  = settings.cols_result();
+
+  b -= index();  // Addresses of b are calculated per lane
+
+  Int owner = 0;  comment("matrix_mult_tiled");
+
+  For (Int row = 0, row < settings.rows, row += tile_rows)
+    For (Int col = 0, col < dst_cols, col += 16)
+      If (owner == me())
+        // Columns past the end of b are padding in the result; read the last column instead
+        Int b_col = col + index();
+        Where (b_col >= columns)
+          b_col = columns - 1;
+        End
+
+        Float::Ptr a_tile = a + row*stride;
+        Float::Ptr b_tile = b + b_col*stride;
+
+        std::vector<Float> acc(tile_rows);
+        for (int r = 0; r < tile_rows; r++) acc[r] = 0;
+
+        For (Int k = 0, k < settings.width(), k += 16)
+          std::vector<Float> a_vec(tile_rows);
+
+          for (int r = 0; r < tile_rows; r += group) {
+            int end = std::min(r + group, tile_rows);
+            for (int i = r; i < end; i++) gather(a_tile + (k + i*stride));
+            for (int i = r; i < end; i++) receive(a_vec[i]);
+          }
+
+          for (int s = 0; s < 16; s += group) {
+            int end = std::min(s + group, 16);
+            std::vector<Float> b_vec(end - s);
+
+            for (int i = s; i < end; i++) gather(b_tile + (k + ((index() + i) & 15)));
+            for (int i = s; i < end; i++) receive(b_vec[i - s]);
+
+            for (int i = s; i < end; i++) {
+              for (int r = 0; r < tile_rows; r++) {
+                if (i == 0) {
+                  acc[r] += a_vec[r]*b_vec[i - s];
+                } else {
+                  acc[r] += rotate(a_vec[r], 16 - i)*b_vec[i - s];
+                }
+              }
+            }
+          }
+        End
+
+        for (int r = 0; r < tile_rows; r++) {
+          Float::Ptr dst_local = dst + ((row + r)*dst_cols + col);
+
+          if (columns % 16 == 0) {
+            pre_write(dst_local, acc[r], settings.add_result);
+          } else {
+            If (col + 16 <= columns)
+              pre_write(dst_local, acc[r], settings.add_result);
+            Else
+              pre_write(dst_local, acc[r], settings.add_result, columns - col);
+            End
+          }
+        }
+      End
+
+      owner += 1;
+      If (owner == numQPUs())
+        owner = 0;
+      End
+    End
+  End
+}
+
+
 void create_block_kernel(Int const &in_offset, std::function<void (Int const &offset)> f) {
   auto &settings = get_matrix_settings();
 
@@ -15,12 +15,22 @@ namespace kernels {
 using namespace V3DLib;
 
 struct matrix_settings {
+  enum Method {
+    DOT_PRODUCT,                              // Every output value is a dot product, see matrix_mult()
+    TILED                                     // Register-blocked tiles of output values, see matrix_mult_tiled()
+  };
+
+  enum {
+    MAX_TILE_ROWS = 4                         // Max number of output rows in a tile for method TILED
+  };
+
   int rows;                                   // Num rows of the result array
   int inner;                                  // Inner dimension of the multiplication
                                               // inner == columns of a == rows of b (which is transposed)
   int columns;                                // Num columns of the result array
   bool add_result  = false;
   bool use_multi_kernel_calls = false;
+  Method method = DOT_PRODUCT;                // Only used for Float matrices, not reset by set()
 
   void set(int in_rows, int in_inner, int in_columns);
 
@@ -30,6 +40,7 @@ struct matrix_settings {
   int stride() const { return rows; }             //< Number of cells till next row
   int num_blocks() const;
   void num_blocks(int val);
+  int tile_rows() const;
 
   std::string dump() const;
 
@@ -92,7 +103,8 @@ void init_result_array(Array2D &result) {
  *
  * - Load one entire row of a into the QPU for fetching one single time
  * - Use prefetching for TMU reads
- * - unroll the internal loop (tried it but does not help, discarded)
+ * - unroll the internal loop: tried it but does not help, because the dot product is already
+ *   unrolled. For loops elsewhere, see `loop_unroll()` and `loop_pipeline()`
  * - Use all QPU's
  * - All QPU's iterate over b together -> increase cache hits (when iterating over rows)
  */
@@ -174,6 +186,9 @@ void blockmatrix_loop(
 }
 
 
+void matrix_mult_tiled(Float::Ptr dst, Float::Ptr a, Float::Ptr b);
+
+
 /**
  * Multiply two matrixes
  *
@@ -181,6 +196,9 @@ void blockmatrix_loop(
  *
  * Input matrix `b` needs to be in transposed form before usage.
  * Template parameters N is dimension of square matrix in blocks of 16 values.
+ *
+ * For Float matrices, `matrix_settings::method` selects the kernel code.
+ * Complex matrices always use the dot product.
  */
 template<
   typename Ptr,
@@ -190,6 +208,13 @@ void matrix_mult(Ptr dst, Ptr a, Ptr b) {
   using DotVecType = typename std::conditional<std::is_same<Ptr, Float::Ptr>::value, DotVector, ComplexDotVector>::type;
   auto &settings = get_matrix_settings();
 
+  if constexpr (std::is_same<Ptr, Float::Ptr>::value) {
+    if (settings.method == matrix_settings::TILED) {
+      matrix_mult_tiled(dst, a, b);
+      return;
+    }
+  }
+
   blockmatrix_loop<Ptr, Ptr, T, DotVecType>(dst, a, [&settings, &b] (DotVecType &dot_vector, Int &b_index, T &dst) {
     Ptr b_local = b + b_index*settings.inner;
     dot_vector.dot_product(b_local, dst);
@@ -496,7 +521,8 @@ public:
     ret << "Num blocks       : " << m_num_blocks  << "\n"
         << "Num QPUs         : " << m_num_qpus    << "\n"
         << "Kernel calls     : " << (use_multi_kernel_calls(CALL)?"multi":"single") << "\n"
-        << "Force multi-calls: " << (m_force_multi_kernels_calls?"true":"false") << "\n";
+        << "Force multi-calls: " << (m_force_multi_kernels_calls?"true":"false") << "\n"
+        << "Method           : " << ((m_method == kernels::matrix_settings::TILED)?"tiled":"dot product") << "\n";
 
     if (m_k_first) {
       ret << "First kernel:\n" << m_k_first->info();
@@ -542,7 +568,8 @@ protected:
     if (m_k.get() != nullptr) {
       // Kernel already compiled. Don't recompile if nothing changed
       if (settings.num_blocks() == num_blocks()
-       && settings.use_multi_kernel_calls == use_multi_kernel_calls(call_type)) {
+       && settings.use_multi_kernel_calls == use_multi_kernel_calls(call_type)
+       && settings.method == m_method) {
         //debug("Unchanged block");
         return;
       }
@@ -551,6 +578,7 @@ protected:
 
     settings.num_blocks(num_blocks());
     settings.use_multi_kernel_calls = use_multi_kernel_calls(call_type);
+    m_method = settings.method;
     kernels::init_result_array(m_result);
 
 /*
@@ -564,22 +592,31 @@ protected:
 */
 
 
-    settings.add_result = false;
-    m_k_first.reset(new BlockKernelType(V3DLib::compile(kernel)));
+    // Compile both kernels in parallel. The settings are per thread, pass them on
+    auto compile_block = [kernel, settings] (BlockKernelPtr &k, bool add_result) {
+      auto &thread_settings = kernels::get_matrix_settings();
+      thread_settings = settings;
+      thread_settings.add_result = add_result;
+      k.reset(new BlockKernelType(V3DLib::compile(kernel)));
+    };
+
+    V3DLib::compile_all({
+      [this, &compile_block] () { compile_block(m_k_first, false); },
+      [this, &compile_block] () { compile_block(m_k, true); }
+    });
+
+    settings.add_result = true;
 
     if (m_k_first->has_errors()) {
       warning("compile failed of first kernel");
       m_k.reset(nullptr);
-      return;
     }
-
-    settings.add_result = true;
-    m_k.reset(new BlockKernelType(V3DLib::compile(kernel)));
   }
 
 
 private:
   int m_num_blocks = DEFAULT_NUM_BLOCKS;
+  kernels::matrix_settings::Method m_method = kernels::matrix_settings::DOT_PRODUCT;  // Method of compiled kernels
   ResultArray m_result;
 
   std::unique_ptr<BlockKernelType> m_k_first;
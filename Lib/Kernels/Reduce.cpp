@@ -0,0 +1,445 @@
+#include "Reduce.h"
+#include <cfloat>
+#include <functional>
+#include <vector>
+#include "Support/basics.h"
+#include "Support/Platform.h"
+#include "Source/gather.h"
+#include "Source/Functions.h"
+#include "Common/CompileContext.h"
+#include "DotVector.h"  // pre_write()
+
+namespace kernels {
+
+using namespace V3DLib;
+
+namespace {
+
+/**
+ * Settings for the reduction and scan kernels.
+ *
+ * `Scan` compiles its sum and scan kernels as separate jobs, each sets its own values.
+ */
+struct reduce_kernel_settings {
+  Reduction::Op op = Reduction::SUM;
+  bool inclusive   = true;
+};
+
+thread_local reduce_kernel_settings kernel_settings;
+
+
+float identity(Reduction::Op op) {
+  switch (op) {
+    case Reduction::SUM:    return 0.0f;
+    case Reduction::MIN:    return FLT_MAX;
+    case Reduction::MAX:
+    case Reduction::ARGMAX: return -FLT_MAX;
+  }
+
+  assert(false);
+  return 0.0f;
+}
+
+
+/**
+ * Number of vectors handled by each QPU
+ */
+int vecs_per_qpu(int size, int num_qpus) {
+  int num_vecs = (size + 15)/16;
+  return (num_vecs + num_qpus - 1)/num_qpus;
+}
+
+
+/**
+ * Allocate a buffer with at least the given number of values
+ */
+template<typename Array>
+Array &buffer(std::unique_ptr<Array> &buf, int size) {
+  if (!buf || (int) buf->size() < size) {
+    buf.reset();  // Release first, to free heap space
+    buf.reset(new Array(size));
+  }
+
+  return *buf;
+}
+
+
+/**
+ * Load a group of consecutive vectors, starting at index `first`.
+ *
+ * Lanes at or beyond `limit` read the first value of the array, and are set to the identity value.
+ * The identity is passed as a variable, since loading a large immediate within a `Where` block
+ * is a conditional first assignment of a temporary, which the liveness analysis rejects.
+ *
+ * @param src  pointer to the start of the array, without the lane offsets
+ * @param idx  output, index of the value in each lane
+ */
+void load_group(
+  std::vector<Float> &x, std::vector<Int> &idx,
+  Float::Ptr const &src, Int const &first, Int const &limit,
+  Float const &ident
+) {
+  int group = (int) x.size();
+
+  for (int g = 0; g < group; g++) {
+    idx[g] = first + (16*g) + index();
+    Int offset = idx[g];
+    Where (offset >= limit)
+      offset = 0;
+    End
+    gather(src + offset);
+  }
+
+  for (int g = 0; g < group; g++) {
+    receive(x[g]);
+    Where (idx[g] >= limit)
+      x[g] = ident;
+    End
+  }
+}
+
+
+/**
+ * Range of values handled by the current QPU
+ */
+void chunk(Int const &size, Int const &vecs_per_qpu, Int &first, Int &limit) {
+  first = me()*(vecs_per_qpu << 4);
+  limit = min(first + (vecs_per_qpu << 4), size);
+}
+
+
+/**
+ * Conditional assignment, used instead of `min()` and `max()` for float, which have no v3d translation
+ */
+void take_if(BoolExpr cond, Float &dst, Float const &src) {
+  Where (cond)
+    dst = src;
+  End
+}
+
+
+/**
+ * Reduce the values in the lanes of acc. On return, all lanes contain the result.
+ */
+void reduce_lanes(Reduction::Op op, Float &acc, Int &acc_index) {
+  if (op == Reduction::SUM) {
+    Float tmp = acc;
+    rotate_sum(tmp, acc);
+    return;
+  }
+
+  for (int k = 1; k < 16; k *= 2) {
+    Float other = rotate(acc, k);
+
+    if (op == Reduction::MIN) {
+      take_if(other < acc, acc, other);
+    } else if (op == Reduction::MAX) {
+      take_if(other > acc, acc, other);
+    } else {
+      Int other_index = rotate(acc_index, k);
+
+      Where (other > acc || (other == acc && other_index < acc_index))
+        acc       = other;
+        acc_index = other_index;
+      End
+    }
+  }
+}
+
+
+/**
+ * Reduce the chunk of the current QPU.
+ *
+ * The result is written to the vector at index `me()` of `partials`, all lanes have the same value.
+ * For `ARGMAX`, the index of the result is written to `partial_index` in the same way.
+ */
+void reduce_kernel(Float::Ptr src, Float::Ptr partials, Int::Ptr partial_index, Int size, Int vecs_per_qpu) {
+  auto const op   = kernel_settings.op;
+  int const group = Platform::gather_limit();
+
+  Int first, limit;
+  chunk(size, vecs_per_qpu, first, limit);
+  src -= index();
+
+  Float ident = identity(op);
+  Float acc   = ident;
+  Int acc_index = size;
+
+  For (Int i = first, i < limit, i += 16*group)
+    std::vector<Float> x(group);
+    std::vector<Int>   idx(group);
+    load_group(x, idx, src, i, limit, ident);
+
+    for (int g = 0; g < group; g++) {
+      switch (op) {
+        case Reduction::SUM: acc += x[g];                     break;
+        case Reduction::MIN: take_if(x[g] < acc, acc, x[g]);  break;
+        case Reduction::MAX: take_if(x[g] > acc, acc, x[g]);  break;
+        case Reduction::ARGMAX:
+          // Values are visited in increasing index, so the first index is kept on ties
+          Where (x[g] > acc)
+            acc       = x[g];
+            acc_index = idx[g];
+          End
+          break;
+      }
+    }
+  End
+
+  reduce_lanes(op, acc, acc_index);
+
+  Float::Ptr dst = partials + (me() << 4);
+  *dst = acc;
+
+  if (op == Reduction::ARGMAX) {
+    Int::Ptr dst_index = partial_index + (me() << 4);
+    *dst_index = acc_index;
+  }
+}
+
+
+/**
+ * Prefix sum of the chunk of the current QPU, starting from the vector at index `me()` in `offsets`.
+ */
+void scan_kernel(Float::Ptr src, Float::Ptr dst, Float::Ptr offsets, Int size, Int vecs_per_qpu) {
+  bool const inclusive = kernel_settings.inclusive;
+  int const group      = Platform::gather_limit();
+
+  Int first, limit;
+  chunk(size, vecs_per_qpu, first, limit);
+  src -= index();
+
+  Float zero = 0.0f;
+  Float carry;
+  gather(offsets + (me() << 4));
+  receive(carry);
+
+  For (Int i = first, i < limit, i += 16*group)
+    std::vector<Float> x(group);
+    std::vector<Int>   idx(group);
+    load_group(x, idx, src, i, limit, zero);
+
+    for (int g = 0; g < group; g++) {
+      // Prefix sum within the vector
+      Float y = x[g];  comment("Scan: prefix sum of vector");
+      for (int k = 1; k < 16; k *= 2) {
+        Float tmp = rotate(y, k);
+        Where (index() < k)
+          tmp = 0.0f;
+        End
+        y += tmp;
+      }
+
+      Float result;
+      if (inclusive) {
+        result = carry + y;
+      } else {
+        Float tmp = rotate(y, 1);
+        Where (index() == 0)
+          tmp = 0.0f;
+        End
+        result = carry + tmp;
+      }
+
+      Float total;
+      rotate_sum(x[g], total);
+      carry += total;
+
+      Float::Ptr out = dst + (i + 16*g);
+      Int remaining  = limit - (i + 16*g);
+
+      If (remaining >= 16)
+        *out = result;
+      Else
+        If (remaining > 0)
+          pre_write(out, result, false, remaining);
+        End
+      End
+    }
+  End
+}
+
+}  // anon namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Reduction
+///////////////////////////////////////////////////////////////////////////////
+
+Reduction::Reduction(Op op) : m_op(op) {
+  kernel_settings.op = op;
+  m_k.reset(new KernelType(V3DLib::compile(reduce_kernel)));
+}
+
+
+bool Reduction::has_errors() const {
+  return m_k->has_errors();
+}
+
+
+void Reduction::setNumQPUs(int val) {
+  assert(val >= 1);
+  m_num_qpus = val;
+}
+
+
+/**
+ * Reduce the first `size` values of `in`.
+ *
+ * @param size  number of values to reduce. If -1, the entire array is used.
+ *
+ * @return result of the reduction. For `ARGMAX`, this is the maximum value.
+ */
+float Reduction::execute(Float::Array &in, int size) {
+  if (size == -1) size = (int) in.size();
+  assertq(!has_errors(), "Reduction: can not execute, there are compile errors");
+  assertq(size >= 1 && size <= (int) in.size(), "Reduction: size out of range");
+
+  auto &partials      = buffer(m_partials, 16*m_num_qpus);
+  auto &partial_index = buffer(m_partial_index, 16*m_num_qpus);
+
+  m_k->setNumQPUs(m_num_qpus);
+  m_k->load(&in, &partials, &partial_index, size, vecs_per_qpu(size, m_num_qpus));
+  m_k->call();
+
+  // Combine the partials of the QPUs
+  float ret = partials[0];
+  m_index   = (m_op == ARGMAX)? partial_index[0] : -1;
+
+  for (int q = 1; q < m_num_qpus; q++) {
+    float val = partials[16*q];
+
+    switch (m_op) {
+      case SUM: ret += val;               break;
+      case MIN: ret  = std::min(ret, val); break;
+      case MAX: ret  = std::max(ret, val); break;
+      case ARGMAX:
+        // QPUs with higher numbers have higher indexes, so the first index is kept on ties
+        if (val > ret) {
+          ret     = val;
+          m_index = partial_index[16*q];
+        }
+        break;
+    }
+  }
+
+  return ret;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Scan
+///////////////////////////////////////////////////////////////////////////////
+
+Scan::Scan(bool inclusive) : m_inclusive(inclusive) {
+  V3DLib::compile_all({
+    [this] () {
+      kernel_settings.op = Reduction::SUM;
+      m_k_sum.reset(new SumKernel(V3DLib::compile(reduce_kernel)));
+    },
+    [this] () {
+      kernel_settings.inclusive = m_inclusive;
+      m_k_scan.reset(new ScanKernel(V3DLib::compile(scan_kernel)));
+    }
+  });
+}
+
+
+bool Scan::has_errors() const {
+  return m_k_sum->has_errors() || m_k_scan->has_errors();
+}
+
+
+void Scan::setNumQPUs(int val) {
+  assert(val >= 1);
+  m_num_qpus = val;
+}
+
+
+/**
+ * Prefix sum of the first `size` values of `in`.
+ *
+ * Only the first `size` values of `out` are written.
+ *
+ * @param size  number of values to scan. If -1, the entire input array is used.
+ */
+void Scan::execute(Float::Array &in, Float::Array &out, int size) {
+  if (size == -1) size = (int) in.size();
+  assertq(!has_errors(), "Scan: can not execute, there are compile errors");
+  assertq(size >= 1 && size <= (int) in.size(), "Scan: size out of range");
+  assertq(size <= (int) out.size(), "Scan: output array too small");
+
+  int per_qpu         = vecs_per_qpu(size, m_num_qpus);
+  auto &partials      = buffer(m_partials, 16*m_num_qpus);
+  auto &partial_index = buffer(m_partial_index, 16*m_num_qpus);
+  auto &offsets       = buffer(m_offsets, 16*m_num_qpus);
+
+  m_k_sum->setNumQPUs(m_num_qpus);
+  m_k_sum->load(&in, &partials, &partial_index, size, per_qpu);
+  m_k_sum->call();
+
+  // Starting offset of each chunk, in all lanes
+  float offset = 0.0f;
+  for (int q = 0; q < m_num_qpus; q++) {
+    for (int i = 0; i < 16; i++) {
+      offsets[16*q + i] = offset;
+    }
+
+    offset += partials[16*q];
+  }
+
+  m_k_scan->setNumQPUs(m_num_qpus);
+  m_k_scan->load(&in, &out, &offsets, size, per_qpu);
+  m_k_scan->call();
+}
+
+
+/**
+ * Scalar reduction, to compare with the QPU version.
+ *
+ * @param index  if not null, receives the index of the result for `MIN`, `MAX` and `ARGMAX`.
+ */
+float reduce_scalar(Reduction::Op op, float const *in, int size, int *index) {
+  assert(size >= 1);
+  float ret = in[0];
+  int ret_index = 0;
+
+  for (int i = 1; i < size; i++) {
+    switch (op) {
+      case Reduction::SUM:
+        ret += in[i];
+        break;
+      case Reduction::MIN:
+        if (in[i] < ret) { ret = in[i]; ret_index = i; }
+        break;
+      case Reduction::MAX:
+      case Reduction::ARGMAX:
+        if (in[i] > ret) { ret = in[i]; ret_index = i; }
+        break;
+    }
+  }
+
+  if (index != nullptr) *index = (op == Reduction::SUM)? -1 : ret_index;
+  return ret;
+}
+
+
+/**
+ * Scalar prefix sum, to compare with the QPU version.
+ */
+void scan_scalar(float const *in, float *out, int size, bool inclusive) {
+  float sum = 0.0f;
+
+  for (int i = 0; i < size; i++) {
+    float val = in[i];
+    if (inclusive) {
+      sum += val;
+      out[i] = sum;
+    } else {
+      out[i] = sum;
+      sum += val;
+    }
+  }
+}
+
+}  // namespace kernels
@@ -0,0 +1,102 @@
+#ifndef _V3DLIB_KERNELS_REDUCE_H_
+#define _V3DLIB_KERNELS_REDUCE_H_
+#include <memory>
+#include "V3DLib.h"
+
+namespace kernels {
+
+using namespace V3DLib;
+
+/**
+ * Reduction of an array of arbitrary length over all QPUs.
+ *
+ * This is done in two levels. Each QPU reduces a contiguous chunk of the input to a partial
+ * result. The partials, one per QPU, are combined on the host. The QPUs don't need to
+ * wait for each other, so no synchronization between the QPUs is needed.
+ *
+ * Per QPU, the input is read in groups of vectors up to the gather limit, so that
+ * multiple loads are in flight. The values are combined per lane, the lanes are
+ * combined at the end of the chunk.
+ *
+ * For `ARGMAX`, the index of the maximum value is available with `index()` after `execute()`.
+ * If the maximum occurs multiple times, the lowest index is returned.
+ */
+class Reduction {
+public:
+  enum Op {
+    SUM,
+    MIN,
+    MAX,
+    ARGMAX
+  };
+
+  Reduction(Op op);
+
+  Op   op() const { return m_op; }
+  bool has_errors() const;
+
+  void setNumQPUs(int val);
+  int  numQPUs() const { return m_num_qpus; }
+
+  float execute(Float::Array &in, int size = -1);
+  int   index() const { return m_index; }
+
+private:
+  using KernelType = V3DLib::Kernel<Float::Ptr, Float::Ptr, Int::Ptr, Int, Int>;
+
+  Op  m_op;
+  int m_num_qpus = 1;
+  int m_index    = -1;
+
+  std::unique_ptr<KernelType>   m_k;
+  std::unique_ptr<Float::Array> m_partials;
+  std::unique_ptr<Int::Array>   m_partial_index;
+};
+
+
+/**
+ * Inclusive or exclusive prefix sum of an array of arbitrary length over all QPUs.
+ *
+ * This takes two kernel calls, which serve as synchronization between the QPUs:
+ *
+ *   1. each QPU sums a contiguous chunk of the input, as in `Reduction`
+ *   2. the host determines the starting offset of each chunk from the chunk sums.
+ *      Each QPU then scans its chunk, vector by vector, starting from its offset.
+ *
+ * Within a vector, the prefix sum is done in 4 steps with lane rotations.
+ *
+ * `in` and `out` may be the same array.
+ */
+class Scan {
+public:
+  Scan(bool inclusive = true);
+
+  bool inclusive() const { return m_inclusive; }
+  bool has_errors() const;
+
+  void setNumQPUs(int val);
+  int  numQPUs() const { return m_num_qpus; }
+
+  void execute(Float::Array &in, Float::Array &out, int size = -1);
+
+private:
+  using SumKernel  = V3DLib::Kernel<Float::Ptr, Float::Ptr, Int::Ptr, Int, Int>;
+  using ScanKernel = V3DLib::Kernel<Float::Ptr, Float::Ptr, Float::Ptr, Int, Int>;
+
+  bool m_inclusive;
+  int  m_num_qpus = 1;
+
+  std::unique_ptr<SumKernel>    m_k_sum;
+  std::unique_ptr<ScanKernel>   m_k_scan;
+  std::unique_ptr<Float::Array> m_partials;
+  std::unique_ptr<Int::Array>   m_partial_index;  // Not used, needed for the sum kernel
+  std::unique_ptr<Float::Array> m_offsets;
+};
+
+
+float reduce_scalar(Reduction::Op op, float const *in, int size, int *index = nullptr);
+void scan_scalar(float const *in, float *out, int size, bool inclusive = true);
+
+}  // namespace kernels
+
+#endif  // _V3DLIB_KERNELS_REDUCE_H_
@@ -0,0 +1,447 @@
+#include "Stencil.h"
+#include <functional>
+#include "Support/basics.h"
+#include "Support/Platform.h"
+#include "Source/gather.h"
+#include "Common/CompileContext.h"
+#include "Cursor.h"
+
+namespace kernels {
+
+using namespace V3DLib;
+using ::operator<<;  // C++ weirdness
+
+namespace {
+
+/**
+ * Settings for the convolution kernels: the filter mask of the pass being compiled.
+ */
+struct convolution_settings {
+  int radius_x = 0;
+  int radius_y = 0;
+  std::vector<float> mask;  // (2*radius_y + 1) rows of (2*radius_x + 1) values
+
+  float coefficient(int dy, int dx) const {
+    return mask[(dy + radius_y)*(2*radius_x + 1) + (dx + radius_x)];
+  }
+};
+
+thread_local convolution_settings conv_settings;
+
+
+/**
+ * Load consecutive rows of an image into cursor lines, one vector at a time.
+ *
+ * If the number of lines fits within the gather limit, the vectors for the next
+ * position are prefetched. Otherwise, the lines are loaded in groups.
+ *
+ * Rows outside the image and values past the end of a row are set to zero.
+ */
+class LineLoader {
+public:
+  LineLoader(std::vector<Cursor::Line> &lines, Float::Ptr const &src, Int const &first_row, Int const &width, Int const &height) :
+    m_lines(lines),
+    m_src(src),
+    m_first_row(first_row),
+    m_width(width),
+    m_height(height),
+    m_prefetch((int) lines.size() <= Platform::gather_limit())
+  {}
+
+
+  /**
+   * Load the first vector of the lines.
+   *
+   * The values left of the row are zero.
+   */
+  void start() {
+    for (auto &line : m_lines) {
+      line.current = 0.0f;  comment("LineLoader start");
+      line.next    = 0.0f;
+    }
+
+    fetch(0);
+
+    if (m_prefetch) {
+      gather_all(16);
+    }
+  }
+
+
+  /**
+   * Advance the lines, so that the current vector is at position `x`
+   */
+  void advance(Int const &x) {
+    if (m_prefetch) {
+      receive_all(x + 16);
+      gather_all(x + 32);
+    } else {
+      fetch(x + 16);
+    }
+  }
+
+
+  /**
+   * Receive the outstanding prefetches
+   */
+  void finish() {
+    if (!m_prefetch) return;
+
+    for (int j = 0; j < (int) m_lines.size(); j++) {
+      Float dummy;
+      receive(dummy);
+    }
+  }
+
+private:
+  std::vector<Cursor::Line> &m_lines;
+  Float::Ptr const &m_src;
+  Int const &m_first_row;
+  Int const &m_width;
+  Int const &m_height;
+  bool m_prefetch;
+
+
+  void gather_line(int j, Int const &offset) {
+    Int y = m_first_row + j;
+    Where (y < 0)
+      y = 0;
+    End
+    Where (y >= m_height)
+      y = m_height - 1;
+    End
+
+    gather(m_src + (y*m_width + offset));
+  }
+
+
+  void receive_line(int j, Int const &x) {
+    Float val;
+    receive(val);
+
+    Int y = m_first_row + j;
+    Where (x >= m_width || y < 0 || y >= m_height)
+      val = 0.0f;
+    End
+
+    m_lines[j].advance(val);
+  }
+
+
+  /**
+   * Gather the vectors at position `x` for all lines
+   */
+  void gather_all(Int const &x) {
+    Int offset = x;  comment("LineLoader gather");
+    Where (offset >= m_width)
+      offset = 0;
+    End
+
+    for (int j = 0; j < (int) m_lines.size(); j++) gather_line(j, offset);
+  }
+
+
+  void receive_all(Int const &x) {
+    for (int j = 0; j < (int) m_lines.size(); j++) receive_line(j, x);
+  }
+
+
+  /**
+   * Load the vectors at position `x` for all lines, in groups within the gather limit
+   */
+  void fetch(Int const &x) {
+    int const num_lines = (int) m_lines.size();
+    int const group     = Platform::gather_limit();
+
+    Int offset = x;  comment("LineLoader fetch");
+    Where (offset >= m_width)
+      offset = 0;
+    End
+
+    for (int i = 0; i < num_lines; i += group) {
+      int end = std::min(i + group, num_lines);
+      for (int j = i; j < end; j++) gather_line(j, offset);
+      for (int j = i; j < end; j++) receive_line(j, x);
+    }
+  }
+};
+
+
+/**
+ * Convolution kernel with a 2D mask, also used for the row pass of separable convolutions.
+ *
+ * Every QPU handles complete output rows. The input rows for an output row are held in
+ * cursor lines, which slide along the row one vector at a time.
+ */
+void convolution_kernel(Float::Ptr src, Float::Ptr dst, Int width, Int height) {
+  auto const &s = conv_settings;
+  int const num_lines = 2*s.radius_y + 1;
+
+  For (Int y = me(), y < height, y += numQPUs())
+    std::vector<Cursor::Line> lines(num_lines);
+    Int first_row = y - s.radius_y;
+    LineLoader loader(lines, src, first_row, width, height);
+    loader.start();
+
+    For (Int x = 0, x < width, x += 16)
+      loader.advance(x);
+
+      Float acc = 0.0f;  comment("convolution_kernel sum");
+
+      for (int dy = -s.radius_y; dy <= s.radius_y; dy++) {
+        for (int dx = -s.radius_x; dx <= s.radius_x; dx++) {
+          float c = s.coefficient(dy, dx);
+          if (c == 0.0f) continue;
+
+          Float val;
+          lines[dy + s.radius_y].shift(dx, val);
+          acc += c*val;
+        }
+      }
+
+      Float::Ptr out = dst + (y*width + x);
+      *out = acc;
+    End
+
+    loader.finish();
+  End
+}
+
+
+/**
+ * Column pass of a separable convolution
+ *
+ * Every QPU handles columns of vectors. The values for the output are held
+ * in a window of registers which slides down over the rows. Only one new
+ * vector needs to be loaded per output vector; it is prefetched.
+ */
+void convolution_columns_kernel(Float::Ptr src, Float::Ptr dst, Int width, Int height) {
+  auto const &s = conv_settings;
+  assert(s.radius_x == 0);
+  int const r = s.radius_y;
+  int const n = 2*r + 1;
+
+  // Gather the vector at column offset x of row y, rows outside the image are clamped
+  auto gather_row = [&src, &width, &height] (Int const &y, Int const &x) {
+    Int row = y;  comment("convolution_columns_kernel gather");
+    Where (row < 0)
+      row = 0;
+    End
+    Where (row >= height)
+      row = height - 1;
+    End
+
+    gather(src + (row*width + x));
+  };
+
+  auto receive_row = [&height] (Int const &y, Float &dst) {
+    receive(dst);
+    Where (y < 0 || y >= height)
+      dst = 0.0f;
+    End
+  };
+
+  For (Int x = 16*me(), x < width, x += 16*numQPUs())
+    std::vector<Float> window(n);
+
+    // Load rows -r to r - 1 into the top of the window, in groups within the gather limit
+    int const group = Platform::gather_limit();
+    for (int i = 1; i < n; i += group) {
+      int end = std::min(i + group, n);
+      for (int j = i; j < end; j++) gather_row(j - 1 - r, x);
+      for (int j = i; j < end; j++) receive_row(j - 1 - r, window[j]);
+    }
+
+    gather_row(r, x);
+
+    For (Int y = 0, y < height, y += 1)
+      for (int j = 0; j < n - 1; j++) {
+        window[j] = window[j + 1];
+      }
+
+      receive_row(y + r, window[n - 1]);
+      gather_row(y + r + 1, x);
+
+      Float acc = 0.0f;  comment("convolution_columns_kernel sum");
+      for (int dy = -r; dy <= r; dy++) {
+        float c = s.coefficient(dy, 0);
+        if (c == 0.0f) continue;
+
+        acc += c*window[dy + r];
+      }
+
+      Float::Ptr out = dst + (y*width + x);
+      *out = acc;
+    End
+
+    Float dummy;
+    receive(dummy);
+  End
+}
+
+
+int filter_radius(std::vector<float> const &filter, int max_radius) {
+  int size = (int) filter.size();
+
+  if (size % 2 == 0 || size/2 > max_radius) {
+    std::string msg;
+    msg << "Convolution: filter must have an odd size of at most " << (2*max_radius + 1)
+        << " values, got " << size;
+    assertq(false, msg, true);
+  }
+
+  return size/2;
+}
+
+}  // anon namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Convolution
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Convolution with a full 2D mask.
+ *
+ * @param radius  the mask has `2*radius + 1` rows and columns
+ * @param mask    coefficients of the mask, row by row
+ */
+Convolution::Convolution(int radius, std::vector<float> const &mask) : m_radius(radius) {
+  assertq(1 <= radius && radius <= MAX_RADIUS, "Convolution: radius out of range", true);
+  int side = 2*radius + 1;
+  assertq((int) mask.size() == side*side, "Convolution: mask size does not match radius", true);
+
+  auto &s = conv_settings;
+  s.radius_x = radius;
+  s.radius_y = radius;
+  s.mask     = mask;
+  m_k.reset(new KernelType(V3DLib::compile(convolution_kernel)));
+}
+
+
+/**
+ * Separable convolution.
+ *
+ * The result is the same as a convolution with mask `outer(row_filter, column_filter)`.
+ * Both filters must have the same odd number of values.
+ */
+Convolution::Convolution(std::vector<float> const &row_filter, std::vector<float> const &column_filter) :
+  m_separable(true)
+{
+  m_radius = filter_radius(row_filter, MAX_SEPARABLE_RADIUS);
+  assertq(filter_radius(column_filter, MAX_SEPARABLE_RADIUS) == m_radius,
+          "Convolution: row and column filter must have the same size", true);
+
+  // Compile both passes in parallel. The settings are per thread, so set them in the job
+  V3DLib::compile_all({
+    [this, &row_filter] () {
+      auto &s = conv_settings;
+      s.radius_x = m_radius;
+      s.radius_y = 0;
+      s.mask     = row_filter;
+      m_k.reset(new KernelType(V3DLib::compile(convolution_kernel)));
+    },
+    [this, &column_filter] () {
+      auto &s = conv_settings;
+      s.radius_x = 0;
+      s.radius_y = m_radius;
+      s.mask     = column_filter;
+      m_k_columns.reset(new KernelType(V3DLib::compile(convolution_columns_kernel)));
+    }
+  });
+}
+
+
+bool Convolution::has_errors() const {
+  if (m_k->has_errors()) return true;
+  return (m_k_columns && m_k_columns->has_errors());
+}
+
+
+void Convolution::setNumQPUs(int val) {
+  assert(val >= 1);
+  m_num_qpus = val;
+}
+
+
+/**
+ * Perform the convolution.
+ *
+ * For separable convolutions, `in` and `out` may be the same array.
+ */
+void Convolution::execute(Float::Array2D &in, Float::Array2D &out) {
+  assertq(!has_errors(), "Convolution: can not execute, there are compile errors");
+  assertq(in.columns() % 16 == 0, "Convolution: width of image must be a multiple of 16");
+  assertq(in.rows() == out.rows() && in.columns() == out.columns(), "Convolution: input and output must have the same size");
+
+  if (!m_separable) {
+    assertq(&in != &out, "Convolution: input and output must be different arrays");
+    call(*m_k, in, out);
+    return;
+  }
+
+  if (!m_tmp || m_tmp->rows() != in.rows() || m_tmp->columns() != in.columns()) {
+    m_tmp.reset();  // Release first, to free heap space
+    m_tmp.reset(new Float::Array2D(in.rows(), in.columns()));
+  }
+
+  call(*m_k, in, *m_tmp);
+  call(*m_k_columns, *m_tmp, out);
+}
+
+
+void Convolution::call(KernelType &k, Float::Array2D &in, Float::Array2D &out) {
+  k.setNumQPUs(m_num_qpus);
+  k.load(&in, &out, in.columns(), in.rows());
+  k.call();
+}
+
+
+/**
+ * @return 2D mask of a separable filter
+ */
+std::vector<float> Convolution::outer(std::vector<float> const &row_filter, std::vector<float> const &column_filter) {
+  std::vector<float> ret;
+
+  for (auto c : column_filter) {
+    for (auto r : row_filter) {
+      ret.push_back(c*r);
+    }
+  }
+
+  return ret;
+}
+
+
+/**
+ * Scalar convolution, to compare with the QPU version.
+ *
+ * Values outside of the image are zero.
+ */
+void convolution_scalar(
+  float const *in, float *out, int width, int height,
+  int radius_x, int radius_y, std::vector<float> const &mask
+) {
+  int const side = 2*radius_x + 1;
+  assert((int) mask.size() == side*(2*radius_y + 1));
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      float acc = 0.0f;
+
+      for (int dy = -radius_y; dy <= radius_y; dy++) {
+        if (y + dy < 0 || y + dy >= height) continue;
+
+        for (int dx = -radius_x; dx <= radius_x; dx++) {
+          if (x + dx < 0 || x + dx >= width) continue;
+
+          acc += mask[(dy + radius_y)*side + (dx + radius_x)]*in[(y + dy)*width + (x + dx)];
+        }
+      }
+
+      out[y*width + x] = acc;
+    }
+  }
+}
+
+}  // namespace kernels
@@ -0,0 +1,73 @@
+#ifndef _V3DLIB_KERNELS_STENCIL_H_
+#define _V3DLIB_KERNELS_STENCIL_H_
+#include <memory>
+#include <vector>
+#include "V3DLib.h"
+
+namespace kernels {
+
+using namespace V3DLib;
+
+/**
+ * Generator for 2D stencil and convolution kernels.
+ *
+ * The coefficients are fixed at compile time. Coefficients which are zero are skipped,
+ * so the mask also selects which neighbours are used.
+ *
+ * Two forms are supported:
+ *
+ *   - a full 2D mask, with a radius of at most `MAX_RADIUS` (i.e. up to 7x7)
+ *   - a separable filter, given as a row filter and a column filter. This is done in two passes,
+ *     a pass over the rows followed by a pass over the columns. This needs `2r + 1` multiplications
+ *     per value for each pass, instead of `(2r + 1)^2`.
+ *
+ * Horizontal neighbours are obtained by lane rotation of consecutive vectors in a row,
+ * see `Cursor::Line::shift()`. The input rows are prefetched if they fit within the gather limit.
+ *
+ * Values outside of the image are taken to be zero.
+ * The width of the image must be a multiple of 16.
+ */
+class Convolution {
+public:
+  enum {
+    MAX_RADIUS           = 3,  // Max radius for a full 2D mask
+    MAX_SEPARABLE_RADIUS = 8   // Max radius for the filters of a separable convolution
+  };
+
+  Convolution(int radius, std::vector<float> const &mask);
+  Convolution(std::vector<float> const &row_filter, std::vector<float> const &column_filter);
+
+  int  radius() const    { return m_radius; }
+  bool separable() const { return m_separable; }
+  bool has_errors() const;
+
+  void setNumQPUs(int val);
+  int  numQPUs() const { return m_num_qpus; }
+
+  void execute(Float::Array2D &in, Float::Array2D &out);
+
+  static std::vector<float> outer(std::vector<float> const &row_filter, std::vector<float> const &column_filter);
+
+private:
+  using KernelType = V3DLib::Kernel<Float::Ptr, Float::Ptr, Int, Int>;
+
+  int  m_radius    = 0;
+  bool m_separable = false;
+  int  m_num_qpus  = 1;
+
+  std::unique_ptr<KernelType> m_k;         // Full mask, or row pass for separable
+  std::unique_ptr<KernelType> m_k_columns; // Column pass for separable
+  std::unique_ptr<Float::Array2D> m_tmp;   // Intermediate result for separable
+
+  void call(KernelType &k, Float::Array2D &in, Float::Array2D &out);
+};
+
+
+void convolution_scalar(
+  float const *in, float *out, int width, int height,
+  int radius_x, int radius_y, std::vector<float> const &mask
+);
+
+}  // namespace kernels
+
+#endif  // _V3DLIB_KERNELS_STENCIL_H_
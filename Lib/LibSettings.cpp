@@ -11,6 +11,17 @@ struct SettingsInternal {
   int  qpu_timeout = -1;                  // seconds, time to wait for response from QPU
   bool use_tmu_for_load = true;           // vc4 only, ignored for v3d. If false, use DMA
   bool use_high_precision_sincos = false; // If true, add extra precision to sin/cos calculation for function version
+  bool use_parallel_emulator = false;     // If true, emulator runs each QPU on a separate thread
+  bool use_v3d_scheduler = false;         // v3d only. If true, reorder and pack instructions within basic blocks.
+                                          // Off by default; not yet verified on hardware
+  bool use_v3d_delay_slots = false;       // v3d only. If true, fill branch delay slots. Off by default, since
+                                          // the emulator runs vc4 code only; not yet verified on hardware
+  bool use_ssa_optimizer = false;         // If true, run CSE, constant folding, LICM and DCE before register allocation.
+                                          // Off by default; only validated on the emulator (vc4 code)
+  bool use_constant_caching = false;      // v3d only. If true, load expensive constants once, passing them as uniform where cheaper,
+                                          // and use the shortest load sequence per constant.
+                                          // Off by default; changes the uniform layout, not yet verified on hardware
+  std::string kernel_cache_dir;           // Directory for compiled kernels. If empty, kernel cache is disabled
 } settings;
 
 }  // anon namespace
@@ -65,4 +76,34 @@ void LibSettings::use_tmu_for_load(bool val) { settings.use_tmu_for_load = val;
 bool LibSettings::use_high_precision_sincos()         { return settings.use_high_precision_sincos; }
 void LibSettings::use_high_precision_sincos(bool val) { settings.use_high_precision_sincos = val; }
 
+
+bool LibSettings::use_parallel_emulator()         { return settings.use_parallel_emulator; }
+void LibSettings::use_parallel_emulator(bool val) { settings.use_parallel_emulator = val; }
+
+
+bool LibSettings::use_v3d_scheduler()         { return settings.use_v3d_scheduler; }
+void LibSettings::use_v3d_scheduler(bool val) { settings.use_v3d_scheduler = val; }
+
+
+bool LibSettings::use_v3d_delay_slots()         { return settings.use_v3d_delay_slots; }
+void LibSettings::use_v3d_delay_slots(bool val) { settings.use_v3d_delay_slots = val; }
+
+
+bool LibSettings::use_ssa_optimizer()         { return settings.use_ssa_optimizer; }
+void LibSettings::use_ssa_optimizer(bool val) { settings.use_ssa_optimizer = val; }
+
+
+bool LibSettings::use_constant_caching()         { return settings.use_constant_caching; }
+void LibSettings::use_constant_caching(bool val) { settings.use_constant_caching = val; }
+
+
+/**
+ * Set the directory for the on-disk kernel cache.
+ *
+ * Compiled kernels are stored here and reused on subsequent compiles of the same source.
+ * The directory is created if not present. Pass an empty string to disable the cache.
+ */
+std::string const &LibSettings::kernel_cache_dir()         { return settings.kernel_cache_dir; }
+void LibSettings::kernel_cache_dir(std::string const &val) { settings.kernel_cache_dir = val; }
+
 }  // namespace V3DLib
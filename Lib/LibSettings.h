@@ -1,5 +1,6 @@
 #ifndef _V3DLIB_LIBSETTINGS_H_
 #define _V3DLIB_LIBSETTINGS_H_
+#include <string>
 
 namespace V3DLib {
 
@@ -19,6 +20,24 @@ public:
 
   static bool use_high_precision_sincos();
   static void use_high_precision_sincos(bool val);
+
+  static bool use_parallel_emulator();
+  static void use_parallel_emulator(bool val);
+
+  static bool use_v3d_scheduler();
+  static void use_v3d_scheduler(bool val);
+
+  static bool use_v3d_delay_slots();
+  static void use_v3d_delay_slots(bool val);
+
+  static bool use_ssa_optimizer();
+  static void use_ssa_optimizer(bool val);
+
+  static bool use_constant_caching();
+  static void use_constant_caching(bool val);
+
+  static std::string const &kernel_cache_dir();
+  static void kernel_cache_dir(std::string const &val);
 };
 
 }  // namespace V3DLib
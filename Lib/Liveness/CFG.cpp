@@ -1,9 +1,36 @@
 #include "CFG.h"
 #include <iostream>
+#include <algorithm>  // lower_bound
 #include "Support/basics.h"
 
 namespace V3DLib {
 
+///////////////////////////////////////////////////////////////////////////////
+// Class Succs
+///////////////////////////////////////////////////////////////////////////////
+
+void Succs::insert(InstrId i) {
+  auto it = std::lower_bound(begin(), end(), i);
+  if (it != end() && *it == i) return;
+  std::vector<InstrId>::insert(it, i);
+}
+
+
+std::string Succs::dump() const {
+  std::string ret;
+
+  ret << "(";
+
+  for (auto i : *this) {
+    ret << i << ", ";
+  }
+
+  ret << ")";
+
+  return ret;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Class CFG::Blocks
 ///////////////////////////////////////////////////////////////////////////////
@@ -289,6 +316,56 @@ void CFG::build(Instr::List &instrs) {
   delete [] labelMap;
 
   blocks.build(*this);
+  build_basic_blocks();
+}
+
+
+/**
+ * Partition the instructions into basic blocks and link these up.
+ *
+ * A new block starts at the first instruction, at each jump target, and after
+ * each instruction which does not simply pass on to the next instruction.
+ */
+void CFG::build_basic_blocks() {
+  int const num_instrs = (int) size();
+  if (num_instrs == 0) return;
+
+  std::vector<bool> leader(num_instrs, false);
+  leader[0] = true;
+
+  for (int i = 0; i < num_instrs; ++i) {
+    if (is_regular(i)) continue;
+
+    if (i + 1 < num_instrs) leader[i + 1] = true;
+
+    for (auto succ : (*this)[i]) {
+      leader[succ] = true;
+    }
+  }
+
+  std::vector<int> block_of(num_instrs);
+
+  for (int i = 0; i < num_instrs; ++i) {
+    if (leader[i]) {
+      m_basic_blocks.emplace_back();
+      m_basic_blocks.back().first = i;
+    }
+
+    m_basic_blocks.back().last = i;
+    block_of[i] = (int) m_basic_blocks.size() - 1;
+  }
+
+  for (int b = 0; b < (int) m_basic_blocks.size(); ++b) {
+    auto &block = m_basic_blocks[b];
+
+    for (auto succ : (*this)[block.last]) {
+      int succ_block = block_of[succ];
+      assert(m_basic_blocks[succ_block].first == succ);
+
+      block.succs.push_back(succ_block);
+      m_basic_blocks[succ_block].preds.push_back(b);
+    }
+  }
 }
 
 
@@ -303,6 +380,7 @@ int CFG::block_at(InstrId line_num) const {
 void CFG::clear() {
   Parent::clear();
   blocks.clear();
+  m_basic_blocks.clear();
 }
 
 
@@ -8,7 +8,32 @@
 namespace V3DLib {
 
 typedef int InstrId;                  // Index of instruction in instruction list
-using Succs = RegIdSet;               // Set of successors.
+
+
+/**
+ * Set of successors of an instruction.
+ *
+ * There are at most two successors, so a sorted vector does better here than a `std::set`.
+ */
+class Succs : public std::vector<InstrId> {
+public:
+  void insert(InstrId i);
+  int first() const { assert(!empty()); return front(); }
+  std::string dump() const;
+};
+
+
+/**
+ * Basic block: maximal sequence of instructions with a single entry and exit.
+ *
+ * Control enters only at the first instruction and leaves only at the last one.
+ */
+struct BasicBlock {
+  InstrId first = -1;
+  InstrId last  = -1;
+  std::vector<int> succs;  // Indexes of successor basic blocks
+  std::vector<int> preds;  // Indexes of predecessor basic blocks
+};
 
 
 /**
@@ -26,9 +51,15 @@ public:
   bool is_parent_block(InstrId line_num, int block) const;
   void clear();
 
+  std::vector<BasicBlock> const &basic_blocks() const { return m_basic_blocks; }
+
   std::string dump() const;
 
 private:
+  std::vector<BasicBlock> m_basic_blocks;
+
+  void build_basic_blocks();
+
 
   /**
    * Blocks are numbered uniquely and consecutively as encountered.
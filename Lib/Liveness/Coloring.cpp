@@ -0,0 +1,238 @@
+#include "Coloring.h"
+#include <algorithm>
+#include "Support/basics.h"
+#include "LiveSet.h"
+#include "RegUsage.h"
+
+namespace V3DLib {
+namespace {
+
+/**
+ * @return true if instruction is a plain register to register move
+ */
+bool is_reg_move(Instr const &instr) {
+  return instr.tag == ALU
+      && instr.ALU.op == ALUOp::A_BOR
+      && instr.ALU.srcA.is_reg()
+      && instr.ALU.srcA == instr.ALU.srcB;
+}
+
+}  // anon namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Coloring
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @param num_regs  number of registers available for allocation
+ */
+Coloring::Coloring(Instr::List &instrs, LiveSets &live_with, RegUsage &alloc, int num_regs) :
+  m_alloc(alloc),
+  m_moves(alloc.size()),
+  m_operands(alloc.size()),
+  m_imm_uses(alloc.size(), 0)
+{
+  assert(num_regs > 0);
+  init_partners(instrs);
+  init_order(live_with, num_regs);
+}
+
+
+/**
+ * Select a register from the possible registers, preferring the register of a move partner.
+ */
+RegId Coloring::choose_register(int var, std::vector<bool> &possible, RegTag reg_tag) const {
+  for (auto p : m_moves[var]) {
+    Reg const &reg = m_alloc[p].reg;
+
+    if (reg.tag == reg_tag && 0 <= reg.regId && reg.regId < (int) possible.size() && possible[reg.regId]) {
+      return reg.regId;
+    }
+  }
+
+  return LiveSets::choose_register(possible, false);
+}
+
+
+/**
+ * @return true if a move partner of `var` has been allocated the given register
+ */
+bool Coloring::move_partner_in(int var, RegId reg_id, RegTag reg_tag) const {
+  for (auto p : m_moves[var]) {
+    if (m_alloc[p].reg == Reg(reg_tag, reg_id)) return true;
+  }
+
+  return false;
+}
+
+
+/**
+ * Count the regfile conflicts when `var` would be placed in the given register file (vc4 only).
+ *
+ * These are:
+ *  - the other register operands of the same instruction, which are already allocated in that file
+ *  - for regfile B, the instructions in which `var` is combined with a small immediate
+ */
+int Coloring::conflicts(int var, RegTag reg_tag) const {
+  assert(reg_tag == REG_A || reg_tag == REG_B);
+  int ret = 0;
+
+  for (auto p : m_operands[var]) {
+    if (m_alloc[p].reg.tag == reg_tag) ret++;
+  }
+
+  if (reg_tag == REG_B) {
+    ret += m_imm_uses[var];
+  }
+
+  return ret;
+}
+
+
+void Coloring::init_partners(Instr::List &instrs) {
+  int const num_vars = (int) m_alloc.size();
+
+  auto is_var = [num_vars] (Reg const &reg) -> bool {
+    return reg.tag == REG_A && reg.regId < num_vars;
+  };
+
+  for (int i = 0; i < instrs.size(); i++) {
+    auto const &instr = instrs[i];
+    if (instr.tag != ALU) continue;
+
+    if (is_reg_move(instr)) {
+      Reg dst = instr.dst_a_reg();
+      Reg src = instr.ALU.srcA.reg();
+
+      if (is_var(dst) && is_var(src) && dst.regId != src.regId) {
+        m_moves[dst.regId].push_back(src.regId);
+        m_moves[src.regId].push_back(dst.regId);
+      }
+      continue;
+    }
+
+    auto const &srcA = instr.ALU.srcA;
+    auto const &srcB = instr.ALU.srcB;
+
+    if (srcA.is_reg() && srcB.is_reg()) {
+      Reg a = srcA.reg();
+      Reg b = srcB.reg();
+
+      if (is_var(a) && is_var(b) && a.regId != b.regId) {
+        m_operands[a.regId].push_back(b.regId);
+        m_operands[b.regId].push_back(a.regId);
+      }
+    } else if (srcA.is_reg() && srcB.is_imm() && is_var(srcA.reg())) {
+      m_imm_uses[srcA.reg().regId]++;
+    } else if (srcB.is_reg() && srcA.is_imm() && is_var(srcB.reg())) {
+      m_imm_uses[srcB.reg().regId]++;
+    }
+  }
+}
+
+
+/**
+ * Determine the allocation order with the simplify step of Chaitin-Briggs.
+ *
+ * Variables which already have a register are not part of the ordering,
+ * but they do count as neighbours.
+ */
+void Coloring::init_order(LiveSets &live_with, int num_regs) {
+  int const num_vars = (int) m_alloc.size();
+
+  std::vector<bool> active(num_vars);
+  std::vector<bool> removed(num_vars, false);
+  std::vector<int>  degree(num_vars, 0);
+  std::vector<int>  low;                   // Candidates with less neighbours than registers
+  int remaining = 0;
+
+  for (int v = 0; v < num_vars; v++) {
+    active[v] = (m_alloc[v].reg.tag == NONE);
+    if (!active[v]) continue;
+
+    remaining++;
+    degree[v] = live_with[v].count();
+    if (degree[v] < num_regs) low.push_back(v);
+  }
+
+  std::vector<int> stack;
+  stack.reserve(remaining);
+
+  while (remaining > 0) {
+    int v = -1;
+
+    while (!low.empty()) {
+      int c = low.back();
+      low.pop_back();
+
+      if (!removed[c]) {
+        v = c;
+        break;
+      }
+    }
+
+    if (v == -1) {
+      // No variable is certain to get a register; optimistically take out the most constrained one
+      for (int u = 0; u < num_vars; u++) {
+        if (!active[u] || removed[u]) continue;
+        if (v == -1 || degree[u] > degree[v]) v = u;
+      }
+    }
+
+    assert(v != -1);
+    removed[v] = true;
+    remaining--;
+    stack.push_back(v);
+
+    for (auto u : live_with[v]) {
+      if (!active[u] || removed[u]) continue;
+
+      degree[u]--;
+      if (degree[u] == num_regs - 1) low.push_back(u);
+    }
+  }
+
+  m_order.assign(stack.rbegin(), stack.rend());
+}
+
+
+/**
+ * Remove moves with the same source and destination register.
+ *
+ * These are the result of move coalescing during register allocation.
+ * Moves with conditions, flag settings or comments are left alone.
+ *
+ * @return number of removed moves
+ */
+int remove_redundant_moves(Instr::List &instrs) {
+  Instr::List ret(instrs.size());
+  int count = 0;
+
+  for (int i = 0; i < instrs.size(); i++) {
+    auto const &instr = instrs[i];
+
+    bool redundant = is_reg_move(instr)
+      && instr.dst_reg() == instr.ALU.srcA.reg()
+      && (instr.dst_reg().tag == REG_A || instr.dst_reg().tag == REG_B)
+      && instr.is_always()
+      && !instr.set_cond().flags_set()
+      && instr.header().empty()
+      && instr.comment().empty();
+
+    if (redundant) {
+      count++;
+    } else {
+      ret << instr;
+    }
+  }
+
+  if (count > 0) {
+    instrs.clear();
+    instrs << ret;
+  }
+
+  return count;
+}
+
+}  // namespace V3DLib
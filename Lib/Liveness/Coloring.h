@@ -0,0 +1,56 @@
+#ifndef _V3DLIB_LIVENESS_COLORING_H_
+#define _V3DLIB_LIVENESS_COLORING_H_
+#include <vector>
+#include "Target/instr/Instr.h"
+
+namespace V3DLib {
+
+class LiveSets;
+struct RegUsage;
+
+/**
+ * Graph-coloring support for register allocation.
+ *
+ * The interference graph is given by `LiveSets`. This class determines the order in
+ * which the variables get a register, along the lines of Chaitin-Briggs:
+ *
+ *  - simplify: repeatedly take out a variable with less neighbours than there are registers.
+ *    If there is none, optimistically take out the variable with the most neighbours.
+ *  - select: allocate registers in the reverse order of taking out.
+ *
+ * Variables which can always be allocated are thus handled last, and the variables
+ * which are hard to allocate get first pick.
+ *
+ * Moves are coalesced by biased selection: a variable gets the register of a move
+ * partner if it is available. The move then becomes redundant and is removed with
+ * `remove_redundant_moves()` after allocation.
+ *
+ * For vc4, `conflicts()` gives the number of operand conflicts a register file would incur.
+ * These are the instructions for which `insertMoves_vc4()` would need to add a move.
+ */
+class Coloring {
+public:
+  Coloring(Instr::List &instrs, LiveSets &live_with, RegUsage &alloc, int num_regs);
+
+  std::vector<int> const &order() const { return m_order; }
+  RegId choose_register(int var, std::vector<bool> &possible, RegTag reg_tag = REG_A) const;
+  bool move_partner_in(int var, RegId reg_id, RegTag reg_tag) const;
+  int conflicts(int var, RegTag reg_tag) const;
+
+private:
+  RegUsage &m_alloc;
+  std::vector<int> m_order;                 // Order in which to allocate registers to variables
+  std::vector<std::vector<int>> m_moves;    // Per variable, the variables it is moved from or to
+  std::vector<std::vector<int>> m_operands; // Per variable, the other register operands in the same instructions
+  std::vector<int> m_imm_uses;              // Per variable, number of instructions combining it with an immediate
+
+  void init_partners(Instr::List &instrs);
+  void init_order(LiveSets &live_with, int num_regs);
+};
+
+
+int remove_redundant_moves(Instr::List &instrs);
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_LIVENESS_COLORING_H_
@@ -10,31 +10,27 @@ namespace V3DLib {
 // Class LiveSets
 ///////////////////////////////////////////////////////////////////////////////
 
-LiveSets::LiveSets(int size) : m_size(size) {
+LiveSets::LiveSets(int size) : m_sets(size, BitSet(size)) {
   assert(size > 0);
-  m_sets = new RegIdSet[size];
-}
-
-
-LiveSets::~LiveSets() {
-  delete [] m_sets;
 }
 
 
 void LiveSets::init(Instr::List &instrs, Liveness &live) {
-  RegIdSet liveOut;
+  BitSet liveOut;
 
   for (int i = 0; i < instrs.size(); i++) {
     live.computeLiveOut(i, liveOut);
-    //UseDef useDefSet(instrs[i]);
     Reg rd = instrs[i].dst_a_reg();
 
+    // All variables in liveOut interfere with each other
     for (auto rx : liveOut) {
-      for (auto ry : liveOut) {
-        if (rx != ry) (*this)[rx].insert(ry);
-      }
+      auto &item = (*this)[rx];
+      item.add(liveOut);
+      item.remove(rx);
+    }
 
-      if (rd.tag != NONE) {
+    if (rd.tag != NONE) {
+      for (auto rx : liveOut) {
         if (rd.regId != rx) {
           (*this)[rx].insert(rd.regId);
           (*this)[rd.regId].insert(rx);
@@ -45,8 +41,8 @@ void LiveSets::init(Instr::List &instrs, Liveness &live) {
 }
 
 
-RegIdSet &LiveSets::operator[](int index) {
-  assert(index >=0 && index < m_size);
+BitSet &LiveSets::operator[](int index) {
+  assert(index >=0 && index < (int) m_sets.size());
   return m_sets[index];
 }
 
@@ -65,7 +61,7 @@ std::vector<bool> LiveSets::possible_registers(int index, RegUsage &alloc, RegTa
   for (int j = 0; j < NUM_REGS; j++)
     possible[j] = true;
 
-  RegIdSet &set = (*this)[index];
+  BitSet &set = (*this)[index];
 
   // Eliminate impossible choices of register for this variable
   for (auto j : set) {
@@ -127,7 +123,7 @@ RegId LiveSets::choose_register(std::vector<bool> &possible, bool check_limit) {
 std::string LiveSets::dump() const {
   std::string ret;
 
-  for (int j = 0; j < m_size; j++) {
+  for (int j = 0; j < (int) m_sets.size(); j++) {
     if (m_sets[j].empty()) continue;
     ret << j << ": " << m_sets[j].dump() << "\n";
   }
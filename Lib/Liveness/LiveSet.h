@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include "Target/instr/Instr.h"
+#include "Support/BitSet.h"
 
 namespace V3DLib {
 
@@ -13,10 +14,9 @@ class RegUsage;
 class LiveSets {
 public:
   LiveSets(int size);
-  ~LiveSets();
 
   void init(Instr::List &instrs, Liveness &live);
-  RegIdSet &operator[](int index);
+  BitSet &operator[](int index);
   std::vector<bool> possible_registers(int index, RegUsage &alloc, RegTag reg_tag = REG_A);
 
   static RegId choose_register(std::vector<bool> &possible, bool check_limit = true);  
@@ -25,8 +25,7 @@ public:
   std::string dump() const;
 
 private:
-  int m_size = 0;
-  RegIdSet *m_sets = nullptr;
+  std::vector<BitSet> m_sets;  // Per variable, the variables live at the same time
 };
 
 }  // namespace V3DLib
@@ -121,6 +121,28 @@ Instr::List  remove_replaced_instructions(Instr::List &instrs) {
   return ret;
 }
 
+
+/**
+ * The 'use' and 'def' of an instruction, as needed for the liveness data flow
+ */
+struct InstrUseDef {
+  int def = -1;          // Variable assigned to, -1 if none
+  std::vector<int> use;  // Variables read
+
+  /**
+   * Apply the instruction to the given live set, going backward.
+   *
+   * Removes the 'def' from the live-out set and adds the 'use', giving the live-in set.
+   */
+  void apply(BitSet &live) const {
+    if (def != -1) live.remove(def);
+
+    for (auto r : use) {
+      live.insert(r);
+    }
+  }
+};
+
 }  // anon namespace
 
 
@@ -128,106 +150,150 @@ Instr::List  remove_replaced_instructions(Instr::List &instrs) {
 // Class Liveness
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Sanity check for a conditional assignment which is also the first assignment of its variable.
+ *
+ * In this case, we expect the variable to be in the condition assign block only.
+ *
+ * Notably, this assertion fails for init of variables without an explicit init value.
+ * This can be extremely confusing, hence this comment.
+ */
+void Liveness::check_cond_assign(Instr::List &instrs, int i, bool also_set_used) {
+  if (also_set_used) return;
+
+  Reg dst = instrs[i].dst_a_reg();
+  auto &item = m_reg_usage[dst.regId];
+
+  AssignCond assign_cond = instrs[i].assign_cond();
+  for (int j = item.first_usage(); j <= item.last_usage(); j++) {
+    assertq((assign_cond == instrs[j].assign_cond())            // expected usage
+         || (instrs[j].is_always() && !instrs[j].is_branch()),  // Interim basic usage allowed (happens)
+      "Expected variable to be in condition assign block only", true
+    );
+  }
+}
+
+
 /**
  * Determine the liveness sets for each instruction.
+ *
+ * This is a standard backward data-flow analysis, done on the level of basic blocks:
+ *
+ *   live_in(B)  = use(B) + (live_out(B) - def(B))
+ *   live_out(B) = union of live_in(S) for all successors S of B
+ *
+ * A worklist holds the blocks to (re)evaluate. When the live-in set of a block changes,
+ * its predecessors are put back on the worklist. Once the block sets are stable, they are
+ * expanded to the individual instructions in a single pass.
+ *
+ * The live sets are bitsets over all variables, so that the set operations are a couple of
+ * word operations per 64 variables.
  */
 void Liveness::compute_liveness(Instr::List &instrs) {
   //Timer t("compute_liveness", true);
+  int const num_instrs = instrs.size();
 
-  // Initialise live mapping to have one entry per instruction
-  setSize(instrs.size());
-/*
-  // Went wrong with Seq<>, you never know later on
-  for (int i = 0; i < (int) m_set.size(); i++) {
-    assert(m_set[i].empty());
-  }
-*/
+  // The 'use' and 'def' of each instruction do not change during the analysis; determine them once
+  std::vector<InstrUseDef> use_defs(num_instrs);
 
-  // For temporarily storing live-in and live-out variables
-  RegIdSet liveIn;
-  RegIdSet liveOut;
+  for (int i = 0; i < num_instrs; i++) {
+    auto &instr = instrs[i];
 
-  bool changed = true;
-  int count = 0;
+    bool also_set_used = false;
 
-  //Timer t2("compute_liveness loop intern");
-  //Timer t3("compute liveOut");
-  //Timer t4("compute use/def rest");
-  //Timer t5("compute insert");
-
-  // Iterate until no change, i.e. fixed point
-  while (changed) {
-    changed = false;
-
-    // Propagate live variables backwards
-    for (int i = instrs.size() - 1; i >= 0; i--) {
-      auto &instr = instrs[i];
-
-      bool also_set_used = false;
-
-      if (instr.isCondAssign()) {  // no performance impact ~ 1.5%
-        Reg dst = instr.dst_a_reg();
-
-        if (dst.tag != NONE) {
-          auto &item = m_reg_usage[dst.regId];
-
-          // If the dst variable is not used before, it should not be set as used as well
-          assert(item.first_dst() <= i);
-          also_set_used = (item.first_dst() < i);
-
-          if (!also_set_used) {
-            //
-            // Sanity check: in this case, we expect the variable to be in the condition assign block only
-            //
-            // Notably, this assertion fails for init of variables without an explicit init value.
-            // This can be extremely confusing, hence this comment.
-            //
-            AssignCond assign_cond = instr.assign_cond();
-            for (int j = item.first_usage(); j <= item.last_usage(); j++) {
-              assertq((assign_cond == instrs[j].assign_cond())            // expected usage
-                   || (instrs[j].is_always() && !instrs[j].is_branch()),  // Interim basic usage allowed (happens)
-                "Expected variable to be in condition assign block only", true
-              );
-            }
-          }
-        }
+    if (instr.isCondAssign()) {  // no performance impact ~ 1.5%
+      Reg dst = instr.dst_a_reg();
+
+      if (dst.tag != NONE) {
+        auto &item = m_reg_usage[dst.regId];
+
+        // If the dst variable is not used before, it should not be set as used as well
+        assert(item.first_dst() <= i);
+        also_set_used = (item.first_dst() < i);
+        check_cond_assign(instrs, i, also_set_used);
       }
+    }
 
-      //t2.start();
-      // Compute 'use' and 'def' sets
-      UseDef useDef(instr, also_set_used);
+    UseDef useDef(instr, also_set_used);
 
-      //t3.start();
-      computeLiveOut(i, liveOut);
-      //t3.stop();
+    if (useDef.def.tag != NONE) {
+      use_defs[i].def = useDef.def.regId;
+    }
+    use_defs[i].use.assign(useDef.use.begin(), useDef.use.end());
+  }
 
-      //t4.start();
-      liveIn = liveOut;
-      if (useDef.def.tag != NONE) {
-        liveIn.remove(useDef.def.regId);  // Remove the 'def' set from the live-out set to give live-in set
-      }
-      liveIn.add(useDef.use);
-      //t4.stop();
+  // Summarize the use and def of each basic block
+  auto const &blocks = m_cfg.basic_blocks();
+  int const num_blocks = (int) blocks.size();
+
+  std::vector<BitSet> block_use(num_blocks, BitSet(m_num_vars));
+  std::vector<BitSet> block_def(num_blocks, BitSet(m_num_vars));
+  std::vector<BitSet> block_in(num_blocks, BitSet(m_num_vars));
+  std::vector<BitSet> block_out(num_blocks, BitSet(m_num_vars));
 
-      //t5.start();
-      if (insert(i, liveIn)) {
-        changed = true;
+  for (int b = 0; b < num_blocks; b++) {
+    for (int i = blocks[b].last; i >= blocks[b].first; i--) {
+      use_defs[i].apply(block_use[b]);
+
+      if (use_defs[i].def != -1) {
+        block_def[b].insert(use_defs[i].def);
       }
-      //t5.stop();
-      //t2.stop();
     }
+  }
+
+  // Iterate over the worklist until no change, i.e. fixed point.
+  // Popping from the back handles the last blocks first, which suits a backward analysis.
+  std::vector<int>  worklist;
+  std::vector<bool> in_worklist(num_blocks, true);
+
+  for (int b = 0; b < num_blocks; b++) {
+    worklist.push_back(b);
+  }
+
+  BitSet live_in(m_num_vars);
+  int count = 0;
 
+  while (!worklist.empty()) {
+    int b = worklist.back();
+    worklist.pop_back();
+    in_worklist[b] = false;
     count++;
+
+    auto &out = block_out[b];
+    out.clear();
+    for (auto succ : blocks[b].succs) {
+      out.add(block_in[succ]);
+    }
+
+    live_in = out;
+    live_in.remove(block_def[b]);
+    live_in.add(block_use[b]);
+
+    if (live_in == block_in[b]) continue;
+    block_in[b] = live_in;
+
+    for (auto pred : blocks[b].preds) {
+      if (in_worklist[pred]) continue;
+      in_worklist[pred] = true;
+      worklist.push_back(pred);
+    }
   }
 
-  //t2.end();
-  //t3.end();
-  //t4.end();
-  //t5.end();
+  // Expand the block sets to the instructions
+  m_set.assign(num_instrs, BitSet(m_num_vars));
+
+  for (int b = 0; b < num_blocks; b++) {
+    BitSet live = block_out[b];
+
+    for (int i = blocks[b].last; i >= blocks[b].first; i--) {
+      use_defs[i].apply(live);
+      m_set[i] = live;
+    }
+  }
 
 /*
   std::string msg;
-  msg << "compute_liveness num iterations: " << count;
+  msg << "compute_liveness num blocks: " << num_blocks << ", num block evaluations: " << count;
   debug(msg);
 */
 }
@@ -253,20 +319,19 @@ void Liveness::compute(Instr::List &instrs) {
 
   m_reg_usage.set_live(*this);
 
-  compile_data.reg_usage_dump = m_reg_usage.dump(true);
-  compile_data.liveness_dump = dump();
+  compile_data().reg_usage_dump = m_reg_usage.dump(true);
+  compile_data().liveness_dump = dump();
 
   m_reg_usage.check();
 }
 
 
 /**
- * Compute live sets for each instruction
- *
  * Compute the live-out variables of an instruction, given the live-in
  * variables of all instructions and the CFG.
  */
-void Liveness::computeLiveOut(InstrId i, RegIdSet &liveOut) {
+void Liveness::computeLiveOut(InstrId i, BitSet &liveOut) {
+  liveOut.resize(m_num_vars);
   liveOut.clear();
 
   for (auto const &val : m_cfg[i]) {
@@ -275,23 +340,6 @@ void Liveness::computeLiveOut(InstrId i, RegIdSet &liveOut) {
 }
 
 
-void Liveness::setSize(int size) {
-  m_set.resize(size);
-}
-
-
-/**
- * @return true if something inserted, false otherwise
- */
-bool Liveness::insert(int index, RegIdSet const &set) {
-  auto &item = m_set[index];
-
-  int prev_size = (int) item.size();
-  item.add(set);
-  return ((int) item.size() != prev_size);
-}
-
-
 std::string Liveness::dump() {
   std::string ret;
 
@@ -332,7 +380,7 @@ std::string Liveness::dump() {
  */
 void Liveness::optimize(Instr::List &instrs, int numVars) {
   assertq(count_skips(instrs) == 0, "optimize(): SKIPs detected in instruction list");
-  compile_data.target_code_before_optimization = instrs.dump();
+  compile_data().target_code_before_optimization = instrs.dump();
 
   //Timer t1("live compute");
   Liveness live(numVars);
@@ -351,7 +399,7 @@ void Liveness::optimize(Instr::List &instrs, int numVars) {
 
   //Timer t3("introduceAccum");
   int prev_count_skips = count_skips(instrs);
-  compile_data.num_accs_introduced = introduceAccum(live, instrs);
+  compile_data().num_accs_introduced = introduceAccum(live, instrs);
   assertq(prev_count_skips == count_skips(instrs), "SKIP count changed after introduceAccum()");
 	//t3.end();
 
@@ -361,7 +409,7 @@ void Liveness::optimize(Instr::List &instrs, int numVars) {
   assertq(count_skips(instrs) == 0, "optimize(): SKIPs detected in instruction list after cleanup");
 
   //std::cout << count_reg_types(instrs).dump() << std::endl;
-  compile_data.target_code_before_liveness = instrs.dump();
+  compile_data().target_code_before_liveness = instrs.dump();
 }
 
 
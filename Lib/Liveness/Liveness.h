@@ -9,6 +9,7 @@
 #include "CFG.h"
 #include "RegUsage.h"
 #include "LiveSet.h"
+#include "Support/BitSet.h"
 
 namespace V3DLib {
 
@@ -34,29 +35,30 @@ namespace V3DLib {
  */
 class Liveness {
 public:
-  Liveness(int numVars) : m_reg_usage(numVars) {}
+  Liveness(int numVars) : m_num_vars(numVars), m_reg_usage(numVars) {}
 
   CFG const &cfg() const { return m_cfg; }
   int size() const { return (int) m_set.size(); }
+  int num_vars() const { return m_num_vars; }
   RegUsage &reg_usage() { return m_reg_usage; }
-  RegIdSet &operator[](int index) { return get(index); }
+  BitSet &operator[](int index) { return get(index); }
 
   void compute(Instr::List &instrs);
-  void computeLiveOut(InstrId i, RegIdSet &liveOut);
+  void computeLiveOut(InstrId i, BitSet &liveOut);
   std::string dump();
 
   static void optimize(Instr::List &instrs, int numVars);
 
 private:
+  int          m_num_vars;
   CFG          m_cfg;
-  std::vector<RegIdSet> m_set;
+  std::vector<BitSet> m_set;  // Live-in variables per instruction
   RegUsage     m_reg_usage;
 
-  RegIdSet &get(int index) { return m_set[index]; }
+  BitSet &get(int index) { return m_set[index]; }
   void clear();
   void compute_liveness(Instr::List &instrs);
-  void setSize(int size);
-  bool insert(int index, RegIdSet const &set);
+  void check_cond_assign(Instr::List &instrs, int i, bool also_set_used);
 };
 
 
@@ -29,8 +29,12 @@ void replace_acc(Instr::List &instrs, RegUsageItem &item, int var_id, int acc_id
 
 /**
  * Not as useful as I would have hoped. range_size > 1 in practice happens, but seldom.
+ *
+ * Only variables which are not live after their last use are replaced. A variable which is defined
+ * before a loop and used within it is live around the back edge, even if its use range is short.
  */
-int peephole_0(int range_size, Instr::List &instrs, RegUsage &allocated_vars) {
+int peephole_0(int range_size, Liveness &live, Instr::List &instrs, RegUsage &allocated_vars) {
+  BitSet liveOut;
   if (range_size == 0) {
     warning("peephole_0(): range_size == 0 passed in. This does nothing, not bothering");
     return 0;
@@ -53,6 +57,9 @@ int peephole_0(int range_size, Instr::List &instrs, RegUsage &allocated_vars) {
       continue;
     }
 
+    live.computeLiveOut(item.last_usage(), liveOut);
+    if (liveOut.member(var_id)) continue;  // Live around a loop
+
     //
     // NOTE: There may be a slight issue here:
     //       in line of first use, src acc's may be used for vars which have
@@ -111,7 +118,7 @@ int peephole_0(int range_size, Instr::List &instrs, RegUsage &allocated_vars) {
  * @return Number of substitutions performed;
  */
 int peephole_1(Liveness &live, Instr::List &instrs, RegUsage &allocated_vars) {
-  RegIdSet liveOut;
+  BitSet liveOut;
   int subst_count = 0;
 
   for (int i = 1; i < instrs.size(); i++) {
@@ -450,7 +457,7 @@ int introduceAccum(Liveness &live, Instr::List &instrs) {
   // Picks up a lot usually, but range_size > 1 seldom results in something
   //Timer t("peephole_0");
   for (int range_size = 1; range_size <= MAX_RANGE_SIZE; range_size++) {
-    int count = peephole_0(range_size, instrs, allocated_vars);
+    int count = peephole_0(range_size, live, instrs, allocated_vars);
 
 /*
     if (count > 0 && range_size > 1) {
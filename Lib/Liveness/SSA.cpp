@@ -0,0 +1,792 @@
+#include "SSA.h"
+#include <map>
+#include <set>
+#include <tuple>
+#include <algorithm>
+#include "CFG.h"
+#include "Common/CompileData.h"
+#include "Support/Platform.h"
+#include "Support/basics.h"
+#include "Target/EmuSupport.h"
+#include "Target/SmallLiteral.h"
+#include "Target/instr/Mnemonics.h"
+
+namespace V3DLib {
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+// Support functions
+///////////////////////////////////////////////////////////////////////////////
+
+bool is_var(RegOrImm const &src) {
+  return src.is_reg() && src.reg().tag == REG_A;
+}
+
+
+/**
+ * @return true if reading the operand has no side effects and gives the same value
+ *         throughout the kernel, apart from variables
+ */
+bool is_pure_src(RegOrImm const &src) {
+  if (src.is_imm()) return true;
+
+  Reg r = src.reg();
+  if (r.tag == REG_A) return true;
+  return r.tag == SPECIAL && (r.regId == SPECIAL_ELEM_NUM || r.regId == SPECIAL_QPU_NUM);
+}
+
+
+bool is_pure_op(ALUOp const &op) {
+  switch (op.value()) {
+    case ALUOp::NOP:
+    case ALUOp::NONE:
+    case ALUOp::M_ROTATE:
+    case ALUOp::A_TMUWT:
+      return false;
+    default:
+      return true;
+  }
+}
+
+
+/**
+ * Check if instruction only computes a value from its operands and writes it
+ * unconditionally to a variable.
+ *
+ * Such instructions can be removed, moved and duplicated freely.
+ */
+bool is_pure(Instr const &instr) {
+  if (instr.tag != InstrTag::LI && instr.tag != InstrTag::ALU) return false;
+  if (instr.dest().tag != REG_A) return false;
+  if (!instr.is_always() || instr.set_cond().flags_set() || instr.break_point()) return false;
+  if (instr.tag == InstrTag::LI) return instr.LI.imm.tag() != Imm::IMM_MASK;
+
+  return is_pure_op(instr.ALU.op) && is_pure_src(instr.ALU.srcA) && is_pure_src(instr.ALU.srcB);
+}
+
+
+/**
+ * Check if the instruction can be removed when the variable it writes to is not used
+ */
+bool is_removable(Instr const &instr) {
+  if (instr.tag != InstrTag::LI && instr.tag != InstrTag::ALU) return false;
+  if (instr.dest().tag != REG_A) return false;
+  if (instr.set_cond().flags_set() || instr.break_point()) return false;
+  if (instr.tag == InstrTag::LI) return true;
+  if (!is_pure_op(instr.ALU.op)) return false;
+
+  auto readable = [] (RegOrImm const &src) -> bool {
+    return is_pure_src(src) || src.reg().tag == ACC;
+  };
+
+  return readable(instr.ALU.srcA) && readable(instr.ALU.srcB);
+}
+
+
+/**
+ * Decode a small immediate if it is an integer
+ */
+bool small_int(RegOrImm const &src, int &val) {
+  if (!src.is_imm()) return false;
+  int encoded = src.imm().val;
+
+  if (Platform::compiling_for_vc4()) {
+    if (encoded < 0 || encoded >= 32) return false;
+  } else {
+    if (encoded < -16 || encoded > 15) return false;
+  }
+
+  val = decodeSmallLit(encoded).intVal;
+  return true;
+}
+
+
+bool is_foldable(ALUOp const &op) {
+  switch (op.value()) {
+    case ALUOp::A_ADD:
+    case ALUOp::A_SUB:
+    case ALUOp::A_SHR:
+    case ALUOp::A_ASR:
+    case ALUOp::A_ROR:
+    case ALUOp::A_SHL:
+    case ALUOp::A_MIN:
+    case ALUOp::A_MAX:
+    case ALUOp::A_BAND:
+    case ALUOp::A_BOR:
+    case ALUOp::A_BXOR:
+    case ALUOp::A_BNOT:
+    case ALUOp::A_CLZ:
+    case ALUOp::M_MUL24:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+bool is_shift(ALUOp const &op) {
+  switch (op.value()) {
+    case ALUOp::A_SHR:
+    case ALUOp::A_ASR:
+    case ALUOp::A_ROR:
+    case ALUOp::A_SHL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+bool is_commutative(ALUOp const &op) {
+  switch (op.value()) {
+    case ALUOp::A_FADD:
+    case ALUOp::A_FMIN:
+    case ALUOp::A_FMAX:
+    case ALUOp::A_FMINABS:
+    case ALUOp::A_FMAXABS:
+    case ALUOp::A_ADD:
+    case ALUOp::A_MIN:
+    case ALUOp::A_MAX:
+    case ALUOp::A_BAND:
+    case ALUOp::A_BOR:
+    case ALUOp::A_BXOR:
+    case ALUOp::M_FMUL:
+    case ALUOp::M_MUL24:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+/**
+ * Remove the instructions marked as SKIP
+ */
+void remove_skips(Instr::List &instrs) {
+  Instr::List ret(instrs.size());
+
+  for (int i = 0; i < instrs.size(); i++) {
+    if (instrs[i].tag != InstrTag::SKIP) ret << instrs[i];
+  }
+
+  instrs.clear();
+  instrs << ret;
+}
+
+
+int count_vars(Instr::List const &instrs) {
+  int ret = 0;
+
+  for (int i = 0; i < instrs.size(); i++) {
+    auto const &instr = instrs[i];
+
+    Reg dst = instr.dst_a_reg();
+    if (dst.tag != NONE) ret = std::max(ret, dst.regId + 1);
+
+    for (auto r : instr.src_a_regs()) {
+      ret = std::max(ret, r + 1);
+    }
+  }
+
+  return ret;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Dominators
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Dominator tree of the basic blocks in a CFG.
+ *
+ * Uses the iterative algorithm of Cooper, Harvey and Kennedy.
+ * Unreachable blocks are not part of the tree.
+ */
+class Dominators {
+public:
+  explicit Dominators(std::vector<BasicBlock> const &blocks) {
+    int const num_blocks = (int) blocks.size();
+    m_idom.assign(num_blocks, -1);
+    m_depth.assign(num_blocks, 0);
+    if (num_blocks == 0) return;
+
+    // Reverse post-order, iterative DFS
+    std::vector<int> order;
+    std::vector<int> rpo_index(num_blocks, -1);
+    {
+      std::vector<bool> visited(num_blocks, false);
+      std::vector<std::pair<int, int>> stack;  // Block and index of next successor
+      stack.emplace_back(0, 0);
+      visited[0] = true;
+
+      while (!stack.empty()) {
+        auto &top = stack.back();
+        auto const &succs = blocks[top.first].succs;
+
+        if (top.second < (int) succs.size()) {
+          int next = succs[top.second++];
+          if (!visited[next]) {
+            visited[next] = true;
+            stack.emplace_back(next, 0);
+          }
+        } else {
+          order.push_back(top.first);
+          stack.pop_back();
+        }
+      }
+
+      std::reverse(order.begin(), order.end());
+      for (int i = 0; i < (int) order.size(); i++) {
+        rpo_index[order[i]] = i;
+      }
+    }
+
+    auto intersect = [this, &rpo_index] (int a, int b) -> int {
+      while (a != b) {
+        while (rpo_index[a] > rpo_index[b]) a = m_idom[a];
+        while (rpo_index[b] > rpo_index[a]) b = m_idom[b];
+      }
+      return a;
+    };
+
+    m_idom[0] = 0;
+    bool changed = true;
+
+    while (changed) {
+      changed = false;
+
+      for (int i = 1; i < (int) order.size(); i++) {
+        int b = order[i];
+        int new_idom = -1;
+
+        for (auto p : blocks[b].preds) {
+          if (m_idom[p] == -1) continue;
+          new_idom = (new_idom == -1)? p : intersect(p, new_idom);
+        }
+
+        if (new_idom != m_idom[b]) {
+          m_idom[b] = new_idom;
+          changed = true;
+        }
+      }
+    }
+
+    for (int i = 1; i < (int) order.size(); i++) {
+      int b = order[i];
+      m_depth[b] = m_depth[m_idom[b]] + 1;
+    }
+  }
+
+
+  /**
+   * @return true if block `a` dominates block `b`
+   */
+  bool dominates(int a, int b) const {
+    if (a == b) return true;
+    if (m_idom[a] == -1 || m_idom[b] == -1) return false;
+
+    while (m_depth[b] > m_depth[a]) b = m_idom[b];
+    return a == b;
+  }
+
+private:
+  std::vector<int> m_idom;
+  std::vector<int> m_depth;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Analysis
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Determine which variables have a known value at a given instruction.
+ *
+ * A variable is considered to be in SSA form if it is assigned exactly once, unconditionally,
+ * and the assignment dominates all its uses. These variables always have the value of their
+ * single definition, which is what makes moving and merging their definitions safe.
+ * Most variables generated during translation, such as temporaries for address calculations,
+ * satisfy this.
+ *
+ * Other variables are only stable when they can not be assigned anymore. This is the case
+ * for the QPU id and the uniform pointers, which are adjusted in the init code.
+ */
+class Analysis {
+public:
+  Analysis(Instr::List &instrs) {
+    m_cfg.build(instrs);
+
+    auto const &blocks = m_cfg.basic_blocks();
+    m_block_of.resize(instrs.size());
+    for (int b = 0; b < (int) blocks.size(); b++) {
+      for (int i = blocks[b].first; i <= blocks[b].last; i++) {
+        m_block_of[i] = b;
+      }
+    }
+
+    m_dom.reset(new Dominators(blocks));
+
+    int count = count_vars(instrs);
+    std::vector<bool> cond_def(count, false);
+    m_defs.resize(count);
+
+    for (int i = 0; i < instrs.size(); i++) {
+      Reg dst = instrs[i].dst_a_reg();
+      if (dst.tag == NONE) continue;
+
+      m_defs[dst.regId].push_back(i);
+      if (!instrs[i].is_always()) cond_def[dst.regId] = true;
+    }
+
+    m_ssa.assign(count, false);
+    for (int v = 0; v < count; v++) {
+      m_ssa[v] = (m_defs[v].size() == 1 && !cond_def[v]);
+    }
+
+    for (int i = 0; i < instrs.size(); i++) {
+      for (auto v : instrs[i].src_a_regs()) {
+        if (m_ssa[v] && !dominates(m_defs[v][0], i)) m_ssa[v] = false;
+      }
+    }
+
+    //
+    // Determine from which position on variables can not be assigned anymore.
+    //
+    // Control only moves backward through the branches at the end of loops.
+    // An assignment can therefore only be reached again from positions within a loop
+    // which also contains the assignment.
+    //
+    std::vector<std::pair<int, int>> loops;  // Start and end of each loop
+    {
+      std::map<Label, int> label_at;
+      for (int i = 0; i < instrs.size(); i++) {
+        if (instrs[i].is_label()) label_at[instrs[i].label()] = i;
+      }
+
+      for (int i = 0; i < instrs.size(); i++) {
+        if (!instrs[i].is_branch_label()) continue;
+
+        int start = label_at[instrs[i].branch_label()];
+        if (start < i) loops.emplace_back(start, i);
+      }
+    }
+
+    m_fixed_from.assign(count, instrs.size());
+    for (int v = 0; v < count; v++) {
+      if (m_defs[v].empty()) continue;  // Never assigned, keep it simple
+
+      int last_def = m_defs[v].back();
+      int pos = last_def + 1;
+
+      bool changed = true;
+      while (changed) {
+        changed = false;
+
+        for (auto const &loop : loops) {
+          if (loop.first <= last_def && pos <= loop.second) {
+            pos = loop.second + 1;
+            changed = true;
+          }
+        }
+      }
+
+      m_fixed_from[v] = pos;
+    }
+  }
+
+  bool ssa(int var) const { return m_ssa[var]; }
+  int def_at(int var) const { return m_defs[var].front(); }
+  int num_vars() const { return (int) m_ssa.size(); }
+
+  /**
+   * @return true if every path to instruction `j` passes instruction `i` first
+   */
+  bool dominates(int i, int j) const {
+    int bi = m_block_of[i];
+    int bj = m_block_of[j];
+
+    if (bi == bj) return i < j;
+    return m_dom->dominates(bi, bj);
+  }
+
+  /**
+   * @return true if the variable has the same value at instruction `i`
+   *         and at all instructions reachable from it
+   */
+  bool fixed(int var, int i) const {
+    return i >= m_fixed_from[var];
+  }
+
+  /**
+   * @return true if the value of the variable at instruction `i` can be reused
+   *         at all instructions dominated by `i`
+   */
+  bool stable(int var, int i) const {
+    return m_ssa[var] || fixed(var, i);
+  }
+
+  /**
+   * Check if a variable has the same value at instructions `i` and `j`.
+   *
+   * Instruction `i` must dominate `j`.
+   */
+  bool same_value(int var, int i, int j) const {
+    if (stable(var, i)) return true;
+    if (m_block_of[i] != m_block_of[j]) return false;
+
+    // Same basic block, check that there is no assignment in between
+    auto const &defs = m_defs[var];
+    auto it = std::upper_bound(defs.begin(), defs.end(), i);
+    return it == defs.end() || *it >= j;
+  }
+
+private:
+  CFG m_cfg;
+  std::vector<int> m_block_of;
+  std::unique_ptr<Dominators> m_dom;
+  std::vector<std::vector<int>> m_defs;  // Positions of assignments per variable
+  std::vector<bool> m_ssa;
+  std::vector<int>  m_fixed_from;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Passes
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Global value numbering, with constant folding and copy propagation.
+ *
+ * The instructions are visited in order. For each pure instruction writing an SSA variable:
+ *
+ *  - if all operands are integer constants, the instruction is replaced by a load immediate
+ *  - if it is a move of a stable variable, the destination is replaced by the source
+ *  - if a dominating instruction computes the same value, the destination is replaced
+ *    by the destination of that instruction. Within a basic block, this also works for
+ *    operands which are not stable.
+ */
+void value_numbering(Instr::List &instrs, int &num_folded, int &num_removed) {
+  using Operand = std::pair<int, int>;  // Kind and value
+  using Key     = std::tuple<int, int, Operand, Operand>;
+
+  int const MAX_CANDIDATES = 16;  // Max number of earlier instructions to check per instruction
+
+  Analysis an(instrs);
+
+  std::vector<int> rep(an.num_vars());
+  for (int v = 0; v < (int) rep.size(); v++) rep[v] = v;
+
+  auto find = [&rep] (int v) -> int {
+    while (rep[v] != v) v = rep[v];
+    return v;
+  };
+
+  auto rename = [&find] (RegOrImm &src) {
+    if (is_var(src)) src = Reg(REG_A, find(src.reg().regId));
+  };
+
+  auto operand = [] (RegOrImm const &src) -> Operand {
+    if (src.is_imm()) return Operand(0, src.imm().val);
+    if (src.reg().tag == REG_A) return Operand(1, src.reg().regId);
+    return Operand(2, src.reg().regId);
+  };
+
+  std::map<int, int> const_val;  // SSA variables with a known integer value
+  std::map<Key, std::vector<int>> table;
+
+  auto get_int = [&const_val] (RegOrImm const &src, int &val) -> bool {
+    if (small_int(src, val)) return true;
+    if (!is_var(src)) return false;
+
+    auto it = const_val.find(src.reg().regId);
+    if (it == const_val.end()) return false;
+    val = it->second;
+    return true;
+  };
+
+  for (int i = 0; i < instrs.size(); i++) {
+    auto &instr = instrs[i];
+
+    if (instr.tag == InstrTag::ALU) {
+      rename(instr.ALU.srcA);
+      rename(instr.ALU.srcB);
+    }
+
+    if (!is_pure(instr)) continue;
+
+    int dst = instr.dest().regId;
+    if (!an.ssa(dst)) continue;
+
+    if (instr.tag == InstrTag::ALU) {
+      auto const &alu = instr.ALU;
+
+      // Constant folding
+      int a, b;
+      if (is_foldable(alu.op) && get_int(alu.srcA, a) && get_int(alu.srcB, b)
+       && !(is_shift(alu.op) && (b < 0 || b >= 32))) {
+        Vec result;
+        result.apply(alu.op, Vec(a), Vec(b));
+
+        Instr tmp = Target::instr::li(instr.dest(), Imm(result[0].intVal));
+        tmp.transfer_comments(instr);
+        instr = tmp;
+        num_folded++;
+      } else if (alu.op.value() == ALUOp::A_BOR && alu.srcA == alu.srcB && is_var(alu.srcA)
+              && an.stable(alu.srcA.reg().regId, i)) {
+        // Copy propagation
+        rep[dst] = alu.srcA.reg().regId;
+        instr.tag = InstrTag::SKIP;
+        num_removed++;
+        continue;
+      }
+    }
+
+    if (instr.tag == InstrTag::LI && instr.LI.imm.is_int()) {
+      const_val[dst] = instr.LI.imm.intVal();
+    }
+
+    Key key;
+    if (instr.tag == InstrTag::LI) {
+      auto const &imm = instr.LI.imm;
+      key = Key(InstrTag::LI, imm.tag(), Operand(0, (int) imm.encode()), Operand(0, 0));
+    } else {
+      auto const &alu = instr.ALU;
+      Operand a = operand(alu.srcA);
+      Operand b = operand(alu.srcB);
+      if (is_commutative(alu.op) && b < a) std::swap(a, b);
+      key = Key(InstrTag::ALU, (int) alu.op.value(), a, b);
+    }
+
+    auto &candidates = table[key];
+    int found = -1;
+
+    auto same_operands = [&an, &instr, i] (int k) -> bool {
+      for (auto v : instr.src_a_regs()) {
+        if (!an.same_value(v, k, i)) return false;
+      }
+
+      return true;
+    };
+
+    for (int k = (int) candidates.size() - 1; k >= 0 && k >= (int) candidates.size() - MAX_CANDIDATES; k--) {
+      if (an.dominates(candidates[k], i) && same_operands(candidates[k])) {
+        found = candidates[k];
+        break;
+      }
+    }
+
+    if (found == -1) {
+      candidates.push_back(i);
+      continue;
+    }
+
+    rep[dst] = instrs[found].dest().regId;
+    instr.tag = InstrTag::SKIP;
+    num_removed++;
+  }
+
+  // Uses not dominated by their definitions in instruction order
+  for (int i = 0; i < instrs.size(); i++) {
+    auto &instr = instrs[i];
+    if (instr.tag != InstrTag::ALU) continue;
+
+    rename(instr.ALU.srcA);
+    rename(instr.ALU.srcB);
+  }
+
+  remove_skips(instrs);
+}
+
+
+/**
+ * Loop-invariant code motion.
+ *
+ * Pure instructions in a loop which only depend on variables defined before the loop,
+ * are moved to directly before the start label of the loop. Translated loops are entered
+ * by falling through to this label, so the moved instructions are executed once per loop.
+ *
+ * Loops are handled innermost first, so that invariant code can move out of multiple levels.
+ */
+int hoist_loop_invariants(Instr::List &instrs) {
+  int count = 0;
+  std::set<Label> done;
+
+  struct Loop {
+    Label label;
+    int start;  // Position of start label
+    int end;    // Position of last branch back to start
+  };
+
+  while (true) {
+    std::map<Label, int> label_at;
+    for (int i = 0; i < instrs.size(); i++) {
+      if (instrs[i].is_label()) label_at[instrs[i].label()] = i;
+    }
+
+    std::map<Label, Loop> loops;
+    for (int i = 0; i < instrs.size(); i++) {
+      if (!instrs[i].is_branch_label()) continue;
+
+      Label label = instrs[i].branch_label();
+      int start = label_at[label];
+      if (start >= i || done.count(label) > 0) continue;
+
+      auto &loop = loops[label];
+      loop.label = label;
+      loop.start = start;
+      loop.end   = i;
+    }
+
+    if (loops.empty()) break;
+
+    // Innermost first
+    Loop loop = loops.begin()->second;
+    for (auto const &it : loops) {
+      if (it.second.end - it.second.start < loop.end - loop.start) loop = it.second;
+    }
+    done.insert(loop.label);
+
+    auto in_loop = [&loop] (int i) -> bool { return loop.start <= i && i <= loop.end; };
+
+    // The loop must only be entered by falling through to the start label
+    if (loop.start == 0) continue;
+
+    {
+      auto const &prev = instrs[loop.start - 1];
+      if (prev.tag == InstrTag::END) continue;
+      if (prev.is_branch_label() && prev.branch_cond().is_always()) continue;
+    }
+
+    bool entered_from_outside = false;
+    for (int i = 0; i < instrs.size() && !entered_from_outside; i++) {
+      if (in_loop(i) || !instrs[i].is_branch_label()) continue;
+
+      int target = label_at[instrs[i].branch_label()];
+      if (in_loop(target)) entered_from_outside = true;
+    }
+    if (entered_from_outside) continue;
+
+    //
+    // Find the invariant instructions
+    //
+    Analysis an(instrs);
+    std::vector<bool> invariant(an.num_vars(), false);
+    std::vector<bool> hoist(instrs.size(), false);
+    int num_hoisted = 0;
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+
+      for (int i = loop.start; i <= loop.end; i++) {
+        if (hoist[i]) continue;
+
+        auto const &instr = instrs[i];
+        if (!is_pure(instr)) continue;
+
+        int dst = instr.dest().regId;
+        if (!an.ssa(dst)) continue;
+
+        bool ok = true;
+        for (auto v : instr.src_a_regs()) {
+          if (invariant[v]) continue;
+          if (an.fixed(v, loop.start)) continue;
+          if (an.ssa(v) && an.def_at(v) < loop.start) continue;
+          ok = false;
+        }
+        if (!ok) continue;
+
+        hoist[i] = true;
+        invariant[dst] = true;
+        num_hoisted++;
+        changed = true;
+      }
+    }
+
+    if (num_hoisted == 0) continue;
+
+    Instr::List ret(instrs.size());
+
+    for (int i = 0; i < instrs.size(); i++) {
+      if (i == loop.start) {
+        for (int j = loop.start; j <= loop.end; j++) {
+          if (hoist[j]) ret << instrs[j];
+        }
+      }
+
+      if (!hoist[i]) ret << instrs[i];
+    }
+
+    instrs.clear();
+    instrs << ret;
+    count += num_hoisted;
+  }
+
+  return count;
+}
+
+
+/**
+ * Remove instructions which write to variables that are never read.
+ *
+ * @return number of instructions removed
+ */
+int remove_dead_code(Instr::List &instrs) {
+  std::vector<int> uses(count_vars(instrs), 0);
+
+  for (int i = 0; i < instrs.size(); i++) {
+    for (auto v : instrs[i].src_a_regs()) {
+      uses[v]++;
+    }
+  }
+
+  int count = 0;
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (int i = instrs.size() - 1; i >= 0; i--) {
+      auto &instr = instrs[i];
+      if (instr.tag == InstrTag::SKIP || !is_removable(instr)) continue;
+      if (uses[instr.dest().regId] > 0) continue;
+
+      for (auto v : instr.src_a_regs()) {
+        uses[v]--;
+      }
+
+      instr.tag = InstrTag::SKIP;
+      count++;
+      changed = true;
+    }
+  }
+
+  remove_skips(instrs);
+  return count;
+}
+
+}  // anon namespace
+
+
+/**
+ * Machine-independent optimizations on the target code, before register allocation.
+ *
+ * These work on the variables in SSA form, see class `Analysis`. In effect, this is an SSA
+ * optimizer for the subset of variables which are assigned once. Other variables, like loop
+ * counters and conditionally assigned variables, are left alone.
+ *
+ * The passes are:
+ *
+ *  - global value numbering with constant folding and copy propagation
+ *  - loop-invariant code motion
+ *  - dead code elimination
+ *
+ * The number of changes per pass are registered in `compile_data`.
+ */
+void optimize_ssa(Instr::List &instrs) {
+  value_numbering(instrs, compile_data().num_consts_folded, compile_data().num_cse_removed);
+  compile_data().num_invariants_hoisted += hoist_loop_invariants(instrs);
+  compile_data().num_dead_removed       += remove_dead_code(instrs);
+}
+
+}  // namespace V3DLib
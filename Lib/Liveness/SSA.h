@@ -0,0 +1,11 @@
+#ifndef _V3DLIB_LIVENESS_SSA_H_
+#define _V3DLIB_LIVENESS_SSA_H_
+#include "Target/instr/Instr.h"
+
+namespace V3DLib {
+
+void optimize_ssa(Instr::List &instrs);
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_LIVENESS_SSA_H_
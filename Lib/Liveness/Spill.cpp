@@ -0,0 +1,365 @@
+#include "Spill.h"
+#include <memory>
+#include "Support/basics.h"
+#include "Support/Platform.h"
+#include "Common/SharedArray.h"
+#include "Common/CompileData.h"
+#include "Source/Var.h"
+#include "Source/Int.h"
+#include "Target/Subst.h"
+#include "Target/instr/Mnemonics.h"
+#include "vc4/DMA/LoadStore.h"
+#include "Liveness.h"
+
+namespace V3DLib {
+
+using ::operator<<;  // C++ weirdness
+using namespace V3DLib::Target::instr;
+
+namespace {
+
+int const NUM_RESERVED = 3;  // Variables for QPU id, num QPUs and devnull; never spilled
+int const VEC_SIZE     = 16; // Elements per vector
+int const NUM_REGIONS  = 16; // Regions per slot, one per QPU. Covers QPU numbers of both vc4 and v3d
+int const SLOT_SIZE    = NUM_REGIONS*VEC_SIZE;  // In words
+
+
+Reg freshReg() {
+  return Reg(REG_A, VarGen::fresh().id());
+}
+
+
+bool is_special(Reg const &reg, Special id) {
+  return reg.tag == SPECIAL && reg.regId == id;
+}
+
+
+bool is_sfu(Reg const &reg) {
+  return reg.tag == SPECIAL && reg.regId >= SPECIAL_SFU_RECIP && reg.regId <= SPECIAL_SFU_LOG;
+}
+
+
+/**
+ * Determine the positions in the code where spill code can be inserted.
+ *
+ * A position is not safe if:
+ *  - an accumulator holds a value which is still needed. Spill code and the
+ *    downstream handling of it may overwrite accumulators.
+ *  - TMU loads are waiting to be received. A reload would receive the wrong value.
+ *  - a TMU store (v3d) or a VPM/DMA access (vc4) is being set up.
+ *
+ * Note that for v3d, TMUD and TMUA are the same registers as VPM_WRITE and DMA_ST_ADDR.
+ *
+ * This is a linear scan, control flow is not taken into account. Memory accesses and
+ * accumulator usage do not cross branches in the generated code, so this works.
+ *
+ * @param first  first position to consider, all positions before this are unsafe
+ *
+ * @return for each instruction, true if spill code may be inserted directly before it
+ */
+std::vector<bool> safe_points(Instr::List const &instrs, int first) {
+  int const num_instrs = instrs.size();
+  bool const for_vc4 = Platform::compiling_for_vc4();
+
+  // Accumulators live before each instruction
+  std::vector<uint32_t> acc_live(num_instrs + 1, 0);
+
+  for (int i = num_instrs - 1; i >= 0; i--) {
+    auto const &instr = instrs[i];
+    uint32_t live = acc_live[i + 1];
+    Reg dst = instr.dst_reg();
+
+    if (instr.is_always()) {
+      if (dst.tag == ACC) live &= ~(1u << dst.regId);
+      if (is_sfu(dst))    live &= ~(1u << 4);  // SFU result arrives in r4
+    }
+
+    for (auto const &reg : instr.src_regs(false)) {
+      if (reg.tag == ACC) live |= (1u << reg.regId);
+    }
+
+    acc_live[i] = live;
+  }
+
+  std::vector<bool> ret(num_instrs + 1, false);
+
+  int  tmu_pending = 0;      // TMU loads not yet received
+  bool tmu_store   = false;  // v3d: TMU store data written, address not yet
+  bool vpm_busy    = false;  // vc4: VPM/DMA access in progress
+
+  for (int i = 0; i < num_instrs; i++) {
+    auto const &instr = instrs[i];
+
+    ret[i] = (i >= first && tmu_pending == 0 && !tmu_store && !vpm_busy && acc_live[i] == 0);
+
+    if (instr.tag == RECV) tmu_pending--;
+
+    for (auto const &reg : instr.src_regs(false)) {
+      if (is_special(reg, SPECIAL_VPM_READ)) vpm_busy = false;
+    }
+
+    Reg dst = instr.dst_reg();
+    if (dst.tag != SPECIAL) continue;
+
+    switch (dst.regId) {
+      case SPECIAL_TMU0_S:
+        tmu_pending++;
+        break;
+
+      case SPECIAL_VPM_WRITE:
+        if (for_vc4) {
+          vpm_busy = true;
+        } else {
+          tmu_store = true;  // TMUD for v3d
+        }
+        break;
+
+      case SPECIAL_RD_SETUP:
+      case SPECIAL_WR_SETUP:
+      case SPECIAL_DMA_LD_ADDR:
+        vpm_busy = true;
+        break;
+
+      case SPECIAL_DMA_ST_ADDR:  // TMUA for v3d
+        vpm_busy  = false;
+        tmu_store = false;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return ret;
+}
+
+}  // anon namespace
+
+
+/**
+ * Spill a variable to memory, to resolve the failed register allocation of variable `var`.
+ *
+ * Either `var` itself or one of the variables live at the same time is spilled.
+ * The instruction list is rewritten; liveness and register allocation need to be redone after this.
+ *
+ * @return true if a variable was spilled, false if no suitable variable was found
+ */
+bool Spiller::spill(Liveness &live, LiveSets &live_with, int var) {
+  if (m_base_index == -1) {
+    insert_base();
+  }
+
+  int selected = select(live, live_with, var);
+  if (selected == -1) return false;
+
+  int slot = (int) m_spilled.size();
+  m_spilled.push_back(selected);
+  rewrite(selected, slot);
+
+  compile_data().num_spills = (int) m_spilled.size();
+  return true;
+}
+
+
+/**
+ * Allocate the scratch buffer and set its address in the code
+ *
+ * The buffer is kept in the compile data, so that it stays around as long as the compiled kernel.
+ */
+void Spiller::finish() {
+  if (m_spilled.empty()) return;
+
+  auto buffer = std::make_shared<Data>((uint32_t) (m_spilled.size()*SLOT_SIZE));
+  buffer->fill(0);
+
+  auto &instr = m_instrs.get(m_base_index);
+  assert(instr.tag == LI && instr.dest() == m_base);
+  instr.LI.imm = Imm((int) buffer->getAddress());
+
+  compile_data().spill_buffer = buffer;
+}
+
+
+/**
+ * Insert the code for determining the address of the scratch buffer region for the current QPU.
+ *
+ * This is placed directly after the initialization code, so that any code after it
+ * can use the address. The address of the buffer itself is filled in in `finish()`.
+ */
+void Spiller::insert_base() {
+  bool const for_vc4 = Platform::compiling_for_vc4();
+
+  int index = for_vc4? m_instrs.lastUniformOffset() : m_instrs.tag_index(INIT_END);
+  assert(index >= 0);
+  index++;
+
+  m_first_own_var = VarGen::count();
+  m_base = freshReg();
+  Reg qpu = freshReg();
+
+  Instr::List ret;
+  ret << li(m_base, 0).comment("Start spill init, address scratch buffer")
+      << shl(qpu, Reg(REG_A, RSV_QPU_ID), 6)  // 64 bytes per QPU in each slot
+      << add(m_base, m_base, qpu);
+
+  if (!for_vc4) {
+    // TMU accesses are per element, DMA for vc4 takes the address of the first element only
+    Reg elem = freshReg();
+    ret << mov(elem, ELEM_ID)        // Special case for v3d, only available through mov
+        << shl(elem, elem, 2)
+        << add(m_base, m_base, elem);
+  }
+
+  ret.back().comment("End spill init");
+
+  m_base_index = index;
+  m_init_end   = index + ret.size() - 1;
+  m_instrs.insert(index, ret);
+}
+
+
+/**
+ * Select the variable to spill.
+ *
+ * Candidates are `var` and the variables interfering with it. Of these, the variable
+ * with the longest live range is selected. This frees a register over the largest
+ * stretch of code.
+ *
+ * @return id of variable to spill, -1 if none could be selected
+ */
+int Spiller::select(Liveness &live, LiveSets &live_with, int var) {
+  int const num_vars = live.num_vars();
+  auto safe = safe_points(m_instrs, m_init_end + 1);
+
+  // Determine which variables have all their spill code at safe positions
+  std::vector<bool> ok(num_vars, true);
+
+  for (int i = 0; i < m_instrs.size(); i++) {
+    auto const &instr = m_instrs[i];
+
+    for (auto r : instr.src_a_regs(true)) {
+      if (r < num_vars && !safe[i]) ok[r] = false;
+    }
+
+    Reg dst = instr.dst_a_reg();
+    if (dst.tag != NONE && dst.regId < num_vars) {
+      if (!safe[i + 1] || instr.isUniformLoad()) ok[dst.regId] = false;
+    }
+  }
+
+  auto can_spill = [this, &live, &ok] (int v) -> bool {
+    if (v < NUM_RESERVED) return false;
+    if (v >= m_first_own_var) return false;  // Spill code only has short live ranges
+    if (!ok[v]) return false;
+    return live.reg_usage()[v].regular_use();
+  };
+
+  int ret = -1;
+  int ret_range = -1;
+
+  auto consider = [&] (int v) {
+    if (!can_spill(v)) return;
+
+    int range = live.reg_usage()[v].live_range();
+    if (range > ret_range) {
+      ret = v;
+      ret_range = range;
+    }
+  };
+
+  consider(var);
+
+  for (auto v : live_with[var]) {
+    consider(v);
+  }
+
+  return ret;
+}
+
+
+/**
+ * Replace all usage of variable `var` with reloads and stores to the given slot
+ */
+void Spiller::rewrite(int var, int slot) {
+  Reg const reg(REG_A, var);
+  Instr::List ret(m_instrs.size() + 16);
+
+  for (int i = 0; i < m_instrs.size(); i++) {
+    Instr instr = m_instrs[i];
+
+    bool uses = instr.src_a_regs(true).member(var);  // Conditional assignment counts as usage
+    bool defs = (instr.dst_a_reg() == reg);
+
+    if (!uses && !defs) {
+      ret << instr;
+      continue;
+    }
+
+    Reg tmp = freshReg();
+
+    if (uses) {
+      ret << reload(tmp, slot);
+      renameUses(instr, reg, tmp);
+    }
+
+    if (defs) {
+      instr.rename_dest(reg, tmp);
+    }
+
+    ret << instr;
+
+    if (defs) {
+      ret << store(tmp, slot);
+    }
+  }
+
+  m_instrs.clear();
+  m_instrs << ret;
+}
+
+
+Instr::List Spiller::reload(Reg dst, int slot) {
+  Reg addr = freshReg();
+
+  Instr::List ret;
+  ret << li(addr, 4*slot*SLOT_SIZE)
+      << add(addr, addr, m_base);
+
+  if (Platform::compiling_for_vc4()) {
+    ret << DMA::loadRequest(dst, addr, true);
+  } else {
+    ret << mov(TMU0_S, addr)
+        << recv(dst);
+  }
+
+  std::string cmt;
+  cmt << "Spill reload slot " << slot;
+  ret.front().comment(cmt);
+
+  return ret;
+}
+
+
+Instr::List Spiller::store(Reg src, int slot) {
+  Var addr = VarGen::fresh();
+
+  Instr::List ret;
+  ret << li(addr, 4*slot*SLOT_SIZE)
+      << add(addr, addr, m_base);
+
+  if (Platform::compiling_for_vc4()) {
+    ret << DMA::storeRequest(addr, Var(STANDARD, src.regId));
+  } else {
+    ret << mov(TMUD, src)
+        << mov(TMUA, addr)
+        << tmuwt();
+  }
+
+  std::string cmt;
+  cmt << "Spill store slot " << slot;
+  ret.front().comment(cmt);
+
+  return ret;
+}
+
+}  // namespace V3DLib
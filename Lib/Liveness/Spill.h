@@ -0,0 +1,52 @@
+#ifndef _V3DLIB_LIVENESS_SPILL_H_
+#define _V3DLIB_LIVENESS_SPILL_H_
+#include <vector>
+#include "Target/instr/Instr.h"
+
+namespace V3DLib {
+
+class Liveness;
+class LiveSets;
+
+/**
+ * Move variables out of the register file into memory, for when register allocation
+ * runs out of registers.
+ *
+ * A spilled variable gets a slot in a scratch buffer in shared memory. Each assignment to the
+ * variable is followed by a store to the slot, and each usage is preceded by a reload from the slot.
+ * Both go through short-lived temporary variables. Each slot holds a 16-element vector per QPU.
+ *
+ * Stores and reloads use the TMU for v3d and VPM/DMA for vc4.
+ *
+ * Spill code is only inserted where it does not interfere with memory accesses or
+ * accumulator usage in progress. Variables which are used or assigned elsewhere are not
+ * considered for spilling.
+ *
+ * Usage: call `spill()` each time allocation fails and redo liveness and allocation.
+ * Call `finish()` at the end.
+ */
+class Spiller {
+public:
+  Spiller(Instr::List &instrs) : m_instrs(instrs) {}
+
+  bool spill(Liveness &live, LiveSets &live_with, int var);
+  void finish();
+
+private:
+  Instr::List &m_instrs;
+  std::vector<int> m_spilled;      // Spilled variables; index is the slot
+  int m_first_own_var = -1;        // Variables from this id upward were generated for spill code
+  int m_base_index    = -1;        // Index of the instruction loading the scratch buffer address
+  int m_init_end      = -1;        // Index of the last instruction of the spill init code
+  Reg m_base;                      // Address of the slot region of the current QPU
+
+  void insert_base();
+  int  select(Liveness &live, LiveSets &live_with, int var);
+  void rewrite(int var, int slot);
+  Instr::List reload(Reg dst, int slot);
+  Instr::List store(Reg src, int slot);
+};
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_LIVENESS_SPILL_H_
@@ -1,5 +1,4 @@
 #include "Source/Interpreter.h"
-#include <algorithm>  // reverse()
 #include "Common/SharedArray.h"
 #include "Source/Stmt.h"
 #include "Common/BufferObject.h"
@@ -12,8 +11,6 @@ using ::operator<<;  // C++ weirdness
 
 namespace {
 
-Vec const Always(1);
-
 // State of a single core.
 struct CoreState {
   int id;                        // Core id
@@ -23,26 +20,12 @@ struct CoreState {
   int readStride = 0;            // Read stride
   int writeStride = 0;           // Write stride
 
-  Stmts stack;                   // Control stack
+  int pc = 0;                    // Index of next operation to execute
+  bool running = false;          // Has core not reached end of program yet?
+  std::vector<Vec> slots;        // Variables, constants and temporaries, see `interp::Program`
   Data emuHeap;
 
-  ~CoreState() {
-    delete [] m_env;
-  }
-
-  void init_env(int numVars) {
-    assert(numVars >= 0);
-    m_env   = new Vec [numVars + 1];
-    sizeEnv = numVars + 1;
-  }
-
-  Vec &env(int env_id) {
-    assert(0 <= env_id && env_id < sizeEnv);
-    assert(nullptr != m_env);
-    return m_env[env_id];
-  } 
-
-  void store_to_heap(Vec const &index, Vec &val);
+  void store_to_heap(Vec const &index, Vec const &val);
   Vec  load_from_heap(Vec const &index);
 
   static void reset_count() {
@@ -51,9 +34,6 @@ struct CoreState {
   }
 
 private:
-  Vec *m_env  = nullptr;      // Environment mapping vars to values
-  int sizeEnv = -1;           // Size of the environment
-
   static int load_show_count;
   static int store_show_count;
 };
@@ -71,7 +51,7 @@ struct InterpreterState : public EmuState {
 };
 
 
-void CoreState::store_to_heap(Vec const &index, Vec &val) {
+void CoreState::store_to_heap(Vec const &index, Vec const &val) {
   assert(writeStride == 0);  // usage of writeStride is probably wrong!
 
   int const show_count = 3;
@@ -143,312 +123,541 @@ Vec CoreState::load_from_heap(Vec const &index) {
   return v;
 }
 
+
+// ============================================================================
+// Evaluate comparison
+// ============================================================================
+
+Vec compare(CmpOp const &cmp, Vec const &a, Vec const &b) {
+  Vec v;
+
+  if (cmp.type() == FLOAT) {
+    // Floating-point comparison
+    for (int i = 0; i < NUM_LANES; i++) {
+      float x = a[i].floatVal;
+      float y = b[i].floatVal;
+      switch (cmp.op()) {
+        case CmpOp::EQ:  v[i].intVal = x == y; break;
+        case CmpOp::NEQ: v[i].intVal = x != y; break;
+        case CmpOp::LT:  v[i].intVal = x <  y; break;
+        case CmpOp::GT:  v[i].intVal = x >  y; break;
+        case CmpOp::LE:  v[i].intVal = x <= y; break;
+        case CmpOp::GE:  v[i].intVal = x >= y; break;
+        default:  assert(false);
+      }
+    }
+  } else {
+    // Integer comparison
+    for (int i = 0; i < NUM_LANES; i++) {
+      int32_t x = a[i].intVal;
+      int32_t y = b[i].intVal;
+
+      switch (cmp.op()) {
+        case CmpOp::EQ:  v[i].intVal = x == y; break;
+        case CmpOp::NEQ: v[i].intVal = x != y; break;
+        // Ideally compiler would implement:
+        // case CmpOp::LT:  v[i].intVal = x <  y; break;
+        // case CmpOp::GT:  v[i].intVal = x >  y; break;
+        // case CmpOp::LE:  v[i].intVal = x <= y; break;
+        // case CmpOp::GE:  v[i].intVal = x >= y; break;
+        // But currently it implements:
+        case CmpOp::LT: v[i].intVal = ((x-y) & 0x80000000) != 0; break;
+        case CmpOp::GE: v[i].intVal = ((x-y) & 0x80000000) == 0; break;
+        case CmpOp::LE: v[i].intVal = ((y-x) & 0x80000000) == 0; break;
+        case CmpOp::GT: v[i].intVal = ((y-x) & 0x80000000) != 0; break;
+        default:  assert(false);
+      }
+    }
+  }
+
+  return v;
+}
+
 }  // anon namespace
 
 
+namespace interp {
+
 // ============================================================================
-// Evaluate an arithmetic expression
+// Class Operation
 // ============================================================================
 
+/**
+ * Single operation of the compiled source code
+ *
+ * Operands are indexes into the slots of a core, see `Program`.
+ */
+struct Operation {
+  enum Tag {
+    ALU,              // dst = alu_op(a, b)
+    RECIP,            // dst = SFU op(a)
+    RECIPSQRT,
+    EXP,
+    LOG,
+    CMP,              // dst = cmp(a, b), condition vector
+    NOT,              // dst = !a, condition vectors
+    AND,              // dst = a && b, condition vectors
+    OR,               // dst = a || b, condition vectors
+    MOVE,             // dst = a
+    MOVE_WHERE,       // dst = a, for the lanes set in condition vector b
+    UNIFORM,          // dst = next uniform value
+    LOAD,             // dst = value in heap at address a
+    STORE,            // store b in heap at address a
+    TMU_LOAD,         // add value in heap at address a to load buffer
+    LOAD_RECEIVE,     // dst = first value in load buffer
+    JUMP,             // continue at target
+    JUMP_UNLESS_ALL,  // continue at target, unless all lanes of condition vector a are set
+    JUMP_UNLESS_ANY,  // continue at target, unless any lane of condition vector a is set
+    SEMA_INC,         // target is semaphore id
+    SEMA_DEC,
+    READ_STRIDE,      // read stride = a
+    WRITE_STRIDE,     // write stride = a
+    FAIL,             // Unsupported by interpreter, error if executed
+    BREAKPOINT
+  };
+
+  Operation(Tag in_tag) : tag(in_tag) {}
+
+  Tag tag;
+  int dst = -1;
+  int a = -1;
+  int b = -1;
+  int target = -1;
+  ALUOp alu_op;
+  CmpOp cmp;
+  Stmt const *stmt = nullptr;  // For breakpoint only
+  char const *msg = nullptr;   // For fail only
+};
 
-Vec eval(InterpreterState &is, CoreState* s, Expr::Ptr e) {
-  Vec v;
 
-  switch (e->tag()) {
-    case Expr::INT_LIT:   v = e->intLit;   break;
-    case Expr::FLOAT_LIT: v = e->floatLit; break;
-    case Expr::APPLY:     v.apply(e->apply_op(), eval(is, s, e->lhs()), eval(is, s, e->rhs())); break;
-    case Expr::DEREF:     v = s->load_from_heap(eval(is, s, e->deref_ptr())); break;
+// ============================================================================
+// Class Program
+// ============================================================================
 
-    case Expr::VAR: {
-      Var var = e->var();
+/**
+ * Source code compiled to a flat list of operations, for the interpreter
+ *
+ * Each core has an array of slots which contain all values used:
+ *
+ *   - first come the source variables, with the var id as index
+ *   - then the literal values used in the source
+ *   - then the temporaries for intermediate values of expressions and `where` conditions
+ *
+ * All slots are resolved during compilation.
+ * Each core starts with a copy of `init_slots()`.
+ */
+class Program {
+public:
+  Program(Stmts const &stmts, int numVars);
 
-      switch (var.tag()) {
-        case STANDARD: v = s->env(var.id()); break;
-        case UNIFORM:  v = is.get_uniform(s->id, s->nextUniform); break;
-        case ELEM_NUM: v = EmuState::index_vec; break;
+  std::vector<Vec> const &init_slots() const { return m_init_slots; }
+  int size() const { return (int) m_ops.size(); }
+  Operation const &op(int pc) const { return m_ops[pc]; }
 
-        default:
-          assertq(false, "eval(): unhandled var tag");
-          break;
-      }
-    }
-    break;
+private:
+  Stmts m_stmts;                     // Local copy, breakpoints refer to this
+  int const m_num_vars;
+  std::vector<Operation> m_ops;
+  std::vector<Vec> m_init_slots;     // Variables and constants; temporaries are added at the end
+  int m_next_temp = 0;               // Next free temporary, relative to the end of the constants
+  int m_num_temps = 0;               // Max number of temporaries used
+
+  int emit(Operation const &op) { m_ops.push_back(op); return size() - 1; }
+  int var(Var const &v) const;
+  int constant(Vec const &v);
+  int temp();
+  int emit_result(Operation op);
+  int emit_fail(char const *msg);
+
+  int expr(Expr::Ptr e);
+  int bexpr(BExpr::Ptr e);
+  void assign_to_var(Var const &v, int src, int cond);
+  void stmt(Stmt::Ptr s, int cond);
+  void stmts(Stmt::Array const &arr, int cond);
+  void resolve_temps();
+};
 
-    default:
-      assertq(false, "eval(): unhandled Expr tag");
-      break;
+
+Program::Program(Stmts const &stmts, int numVars) :
+  m_stmts(stmts),
+  m_num_vars(numVars),
+  m_init_slots(numVars + 1)
+{
+  assert(numVars >= 0);
+  this->stmts(m_stmts, -1);
+  resolve_temps();
+}
+
+
+/**
+ * Get the slot of a standard variable
+ */
+int Program::var(Var const &v) const {
+  assertq(v.tag() == STANDARD, "interpreter: expected standard var");
+  assertq(0 <= v.id() && v.id() <= m_num_vars, "interpreter: var id out of range");
+  return v.id();
+}
+
+
+int Program::constant(Vec const &v) {
+  for (int i = m_num_vars + 1; i < (int) m_init_slots.size(); i++) {
+    if (m_init_slots[i] == v) return i;
   }
 
-  return v;
+  m_init_slots.push_back(v);
+  return (int) m_init_slots.size() - 1;
 }
 
 
-// ============================================================================
-// Evaluate boolean expression
-// ============================================================================
+/**
+ * Allocate a temporary
+ *
+ * Temporaries are allocated as a stack; they are released again by resetting `m_next_temp`.
+ * During compilation, temporaries are given negative slot values starting at -2,
+ * because the number of constants is not known yet. See `resolve_temps()`.
+ */
+int Program::temp() {
+  int ret = m_next_temp++;
+  m_num_temps = std::max(m_num_temps, m_next_temp);
+  return -(ret + 2);
+}
+
+
+/**
+ * Emit an operation which stores its result in a new temporary
+ *
+ * @return slot of the temporary
+ */
+int Program::emit_result(Operation op) {
+  op.dst = temp();
+  emit(op);
+  return op.dst;
+}
+
+
+/**
+ * Emit an operation which signals an error when executed
+ *
+ * Unsupported source code is only an error if it is actually reached, same as for the emulator.
+ *
+ * @return slot of a dummy temporary, in case a result is expected
+ */
+int Program::emit_fail(char const *msg) {
+  Operation op(Operation::FAIL);
+  op.msg = msg;
+  return emit_result(op);
+}
 
-Vec evalBool(InterpreterState &is, CoreState* s, BExpr::Ptr e) {
-  Vec v;
 
+/**
+ * Translate the slots of the temporaries to actual slots, after the constants
+ */
+void Program::resolve_temps() {
+  int base = (int) m_init_slots.size();
+
+  auto resolve = [base] (int &slot) {
+    if (slot < -1) slot = base + (-slot - 2);
+  };
+
+  for (auto &op : m_ops) {
+    resolve(op.dst);
+    resolve(op.a);
+    resolve(op.b);
+  }
+
+  m_init_slots.resize(base + m_num_temps);
+}
+
+
+/**
+ * Compile an arithmetic expression
+ *
+ * @return slot containing the value of the expression
+ */
+int Program::expr(Expr::Ptr e) {
   switch (e->tag()) {
-    // Negation
-    case NOT:
-      v = evalBool(is, s, e->neg());
-      for (int i = 0; i < NUM_LANES; i++)
-        v[i].intVal = !v[i].intVal;
-      return v;
-
-    // Conjunction
-    case AND: {
-      Vec a = evalBool(is, s, e->lhs());
-      Vec b = evalBool(is, s, e->rhs());
+    case Expr::INT_LIT: return constant(Vec(e->intLit));
 
-      for (int i = 0; i < NUM_LANES; i++)
-        v[i].intVal = a[i].intVal && b[i].intVal;
-      return v;
+    case Expr::FLOAT_LIT: {
+      Vec v;
+      v = e->floatLit;
+      return constant(v);
     }
 
-    // Disjunction
-    case OR: {
-      Vec a = evalBool(is, s, e->lhs());
-      Vec b = evalBool(is, s, e->rhs());
+    case Expr::VAR: {
+      Var v = e->var();
 
-      for (int i = 0; i < NUM_LANES; i++)
-        v[i].intVal = a[i].intVal || b[i].intVal;
-      return v;
-    }
+      switch (v.tag()) {
+        case STANDARD: return var(v);
+        case UNIFORM:  return emit_result(Operation(Operation::UNIFORM));
+        case ELEM_NUM: return constant(EmuState::index_vec);
 
-    // Comparison
-    case CMP: {
-      Vec a = eval(is, s, e->cmp_lhs());
-      Vec b = eval(is, s, e->cmp_rhs());
-      if (e->cmp.type() == FLOAT) {
-        // Floating-point comparison
-        for (int i = 0; i < NUM_LANES; i++) {
-          float x = a[i].floatVal;
-          float y = b[i].floatVal;
-          switch (e->cmp.op()) {
-            case CmpOp::EQ:  v[i].intVal = x == y; break;
-            case CmpOp::NEQ: v[i].intVal = x != y; break;
-            case CmpOp::LT:  v[i].intVal = x <  y; break;
-            case CmpOp::GT:  v[i].intVal = x >  y; break;
-            case CmpOp::LE:  v[i].intVal = x <= y; break;
-            case CmpOp::GE:  v[i].intVal = x >= y; break;
-            default:  assert(false);
-          }
-        }
-        return v;
+        default:
+          return emit_fail("interpreter: unhandled var tag in expression");
       }
-      else {
-        // Integer comparison
-        for (int i = 0; i < NUM_LANES; i++) {
-          int32_t x = a[i].intVal;
-          int32_t y = b[i].intVal;
-
-          switch (e->cmp.op()) {
-            case CmpOp::EQ:  v[i].intVal = x == y; break;
-            case CmpOp::NEQ: v[i].intVal = x != y; break;
-            // Ideally compiler would implement:
-            // case CmpOp::LT:  v[i].intVal = x <  y; break;
-            // case CmpOp::GT:  v[i].intVal = x >  y; break;
-            // case CmpOp::LE:  v[i].intVal = x <= y; break;
-            // case CmpOp::GE:  v[i].intVal = x >= y; break;
-            // But currently it implements:
-            case CmpOp::LT: v[i].intVal = ((x-y) & 0x80000000) != 0; break;
-            case CmpOp::GE: v[i].intVal = ((x-y) & 0x80000000) == 0; break;
-            case CmpOp::LE: v[i].intVal = ((y-x) & 0x80000000) == 0; break;
-            case CmpOp::GT: v[i].intVal = ((y-x) & 0x80000000) != 0; break;
-            default:  assert(false);
-          }
-        }
-        return v;
+    }
+
+    case Expr::APPLY: {
+      Op const &apply_op = e->apply_op();
+      Operation op(Operation::ALU);
+
+      switch (apply_op.op) {
+        case RECIP    : op.tag = Operation::RECIP;     break;
+        case RECIPSQRT: op.tag = Operation::RECIPSQRT; break;
+        case EXP      : op.tag = Operation::EXP;       break;
+        case LOG      : op.tag = Operation::LOG;       break;
+        default       : op.alu_op = ALUOp(apply_op);   break;
       }
+
+      op.a = expr(e->lhs());
+      op.b = expr(e->rhs());
+      return emit_result(op);
+    }
+
+    case Expr::DEREF: {
+      Operation op(Operation::LOAD);
+      op.a = expr(e->deref_ptr());
+      return emit_result(op);
     }
   }
 
-  // Unreachable
-  assert(false);
-  return Vec();
+  assertq(false, "interpreter: unhandled Expr tag");
+  return -1;
 }
 
 
-// ============================================================================
-// Evaulate condition
-// ============================================================================
+/**
+ * Compile a boolean expression
+ *
+ * @return slot containing the resulting condition vector
+ */
+int Program::bexpr(BExpr::Ptr e) {
+  switch (e->tag()) {
+    case NOT: {
+      Operation op(Operation::NOT);
+      op.a = bexpr(e->neg());
+      return emit_result(op);
+    }
 
-bool evalCond(InterpreterState &is, CoreState* s, CExpr::Ptr e) {
-  Vec v = evalBool(is, s, e->bexpr());
+    case AND: {
+      Operation op(Operation::AND);
+      op.a = bexpr(e->lhs());
+      op.b = bexpr(e->rhs());
+      return emit_result(op);
+    }
 
-  switch (e->tag()) {
-    case ALL: {
-      bool b = true;
-      for (int i = 0; i < NUM_LANES; i++)
-        b = b && v[i].intVal;
-      return b;
+    case OR: {
+      Operation op(Operation::OR);
+      op.a = bexpr(e->lhs());
+      op.b = bexpr(e->rhs());
+      return emit_result(op);
     }
-      
-    case ANY: {
-      bool b = false;
-      for (int i = 0; i < NUM_LANES; i++)
-        b = b || v[i].intVal;
-      return b;
+
+    case CMP: {
+      Operation op(Operation::CMP);
+      op.cmp = e->cmp;
+      op.a = expr(e->cmp_lhs());
+      op.b = expr(e->cmp_rhs());
+      return emit_result(op);
     }
   }
 
-  // Unreachable
-  assert(false);
-  return false;
+  assertq(false, "interpreter: unhandled BExpr tag");
+  return -1;
 }
 
 
 /**
- * Assign to a variable
+ * Compile assignment of a value to a variable
+ *
+ * @param src   slot containing value to assign
+ * @param cond  slot containing condition vector for assignment, -1 if unconditional
  */
-void assignToVar(CoreState* s, Vec cond, Var v, Vec x) {
+void Program::assign_to_var(Var const &v, int src, int cond) {
   switch (v.tag()) {
-    // Normal variable
-    case STANDARD:
-      for (int i = 0; i < NUM_LANES; i++) {
-        if (cond[i].intVal) {
-          s->env(v.id())[i] = x[i];
-        }
+    case STANDARD: {
+      int dst = var(v);
+
+      if (cond != -1) {
+        Operation op(Operation::MOVE_WHERE);
+        op.dst = dst;
+        op.a = src;
+        op.b = cond;
+        emit(op);
+      } else if (src < -1 && !m_ops.empty() && m_ops.back().dst == src) {
+        m_ops.back().dst = dst;  // Value was just calculated in a temporary; store it directly in var
+      } else {
+        Operation op(Operation::MOVE);
+        op.dst = dst;
+        op.a = src;
+        emit(op);
       }
-      break;
+    }
+    break;
 
     case TMU0_ADDR: {  // Load via TMU
-      assert(s->loadBuffer.size() < 8);
-      Vec w =  s->load_from_heap(x);
-      s->loadBuffer.append(w);
-      break;
+      Operation op(Operation::TMU_LOAD);
+      op.a = src;
+      emit(op);
     }
+    break;
 
     default:
-      assertq(false, "assignToVar(): unhandled var-tag", true);
+      emit_fail("interpreter: unhandled var-tag in assignment");
       break;
   }
 }
 
 
-/**
- * Execute assignment
- */
-void execAssign(InterpreterState &is, CoreState* s, Vec cond, Expr::Ptr lhs, Expr::Ptr rhs) {
-  Vec val = eval(is, s, rhs);
-
-  switch (lhs->tag()) {
-    case Expr::VAR:
-      assignToVar(s, cond, lhs->var(), val);
-      break;
-
-    case Expr::DEREF: {
-      Vec index = eval(is, s, lhs->deref_ptr());
-      s->store_to_heap(index, val);
-    }
-    break;
-
-    default:
-      assert(false);
-    break;
+void Program::stmts(Stmt::Array const &arr, int cond) {
+  for (auto const &s : arr) {
+    stmt(s, cond);
   }
 }
 
 
-// ============================================================================
-// Condition vector auxiliaries
-// ============================================================================
-
-
 /**
- * And two condition vectors
+ * Compile a statement
+ *
+ * @param cond  slot containing the condition vector of the enclosing `where`, -1 if none
  */
-Vec vecAnd(Vec x, Vec y) {
-  Vec v;
-  for (int i = 0; i < NUM_LANES; i++)
-    v[i].intVal = x[i].intVal && y[i].intVal;
-  return v;
-}
-
-// ============================================================================
-// Execute where statement
-// ============================================================================
-
-void execWhere(InterpreterState &is, CoreState *s, Vec cond, Stmt::Ptr stmt);
-
+void Program::stmt(Stmt::Ptr s, int cond) {
+  assertq(s != nullptr, "interpreter: not expecting nullptr for stmt", true);
 
-void execWhere(InterpreterState &is, CoreState *s, Vec cond, Stmt::Array const &stmts) {
-  for (int i = 0; i < (int) stmts.size(); i++) {
-    execWhere(is, s, cond, stmts[i]);
+  if (s->do_break_point()) {
+    Operation op(Operation::BREAKPOINT);
+    op.stmt = s.get();
+    emit(op);
   }
-}
 
+  int const temp_mark = m_next_temp;  // Temporaries are released at end of statement
+
+  auto check_not_in_where = [cond] () {
+    assertq(cond == -1, "V3DLib: only assignments and nested 'where' statements can occur in a 'where' statement");
+  };
 
-void execWhere(InterpreterState &is, CoreState *s, Vec cond, Stmt::Ptr stmt) {
-  if (!stmt) return;
+  auto jump_unless = [this] (CExpr::Ptr c) -> int {
+    Operation op((c->tag() == ALL)? Operation::JUMP_UNLESS_ALL : Operation::JUMP_UNLESS_ANY);
+    op.a = bexpr(c->bexpr());
+    return emit(op);
+  };
 
-  switch (stmt->tag) {
-    // No-ops
+  switch (s->tag) {
     case Stmt::GATHER_PREFETCH:
     case Stmt::SKIP:
-      return;
+      break;
 
-    // Sequential composition
-    case Stmt::SEQ: {
-      breakpoint
-      execWhere(is, s, cond, stmt->body());
-      return;
+    case Stmt::ASSIGN: {
+      Expr::Ptr lhs = s->assign_lhs();
+      int src = expr(s->assign_rhs());
+
+      switch (lhs->tag()) {
+        case Expr::VAR:
+          assign_to_var(lhs->var(), src, cond);
+          break;
+
+        case Expr::DEREF: {
+          assertq(cond == -1, "V3DLib: only var assignments permitted in 'where'");
+          Operation op(Operation::STORE);
+          op.a = expr(lhs->deref_ptr());
+          op.b = src;
+          emit(op);
+        }
+        break;
+
+        default:
+          assertq(false, "interpreter: unhandled lhs in assignment");
+          break;
+      }
     }
+    break;
 
-    // Assignment
-    case Stmt::ASSIGN:
-      assertq(stmt->assign_lhs()->tag() == Expr::VAR, "V3DLib: only var assignments permitted in 'where'");
-      execAssign(is, s, cond, stmt->assign_lhs(), stmt->assign_rhs());
-      return;
+    case Stmt::SEQ:
+      stmts(s->body(), cond);
+      break;
 
-    // Nested where
     case Stmt::WHERE: {
-      Vec b = evalBool(is, s, stmt->where_cond());
-      execWhere(is, s, vecAnd(b, cond), stmt->then_block());
-      execWhere(is, s, vecAnd(b.negate(), cond), stmt->else_block());
-      return;
+      int b = bexpr(s->where_cond());
+
+      Operation not_b(Operation::NOT);
+      not_b.a = b;
+      int else_cond = emit_result(not_b);
+      int then_cond = b;
+
+      if (cond != -1) {
+        Operation op(Operation::AND);
+        op.a = then_cond;
+        op.b = cond;
+        then_cond = emit_result(op);
+
+        op.a = else_cond;
+        else_cond = emit_result(op);
+      }
+
+      stmts(s->then_block(), then_cond);
+      stmts(s->else_block(), else_cond);
     }
+    break;
 
-    default:
-      assertq(false, "V3DLib: only assignments and nested 'where' statements can occur in a 'where' statement");
-      return;
-  }
-}
+    case Stmt::IF: {
+      check_not_in_where();
+      int to_else = jump_unless(s->if_cond());
+      m_next_temp = temp_mark;
 
+      stmts(s->then_block(), -1);
 
-// ============================================================================
-// Execute load receive & store request statements
-// ============================================================================
+      if (!s->else_block().empty()) {
+        int to_end = emit(Operation(Operation::JUMP));
+        m_ops[to_else].target = size();
+        stmts(s->else_block(), -1);
+        m_ops[to_end].target = size();
+      } else {
+        m_ops[to_else].target = size();
+      }
+    }
+    break;
 
-void execLoadReceive(CoreState* s, Expr::Ptr e) {
-  assert(s->loadBuffer.size() > 0);
-  assert(e->tag() == Expr::VAR);
-  Vec val = s->loadBuffer.remove(0);
-  assignToVar(s, Always, e->var(), val);
-}
+    case Stmt::WHILE: {
+      check_not_in_where();
+      int top = size();
+      int to_end = jump_unless(s->loop_cond());
+      m_next_temp = temp_mark;
 
+      stmts(s->body(), -1);
 
-// ============================================================================
-// Execute code
-// ============================================================================
+      Operation op(Operation::JUMP);
+      op.target = top;
+      emit(op);
+      m_ops[to_end].target = size();
+    }
+    break;
+
+    case Stmt::LOAD_RECEIVE: {
+      check_not_in_where();
+      Expr::Ptr e = s->address();
+      assert(e->tag() == Expr::VAR);
 
-bool dma_exec(InterpreterState &is, CoreState* s, Stmt::Ptr &stmt) {
-  bool ret = true;
+      Operation op(Operation::LOAD_RECEIVE);
+      op.dst = var(e->var());
+      emit(op);
+    }
+    break;
 
-  switch (stmt->tag) {
-    case Stmt::SET_READ_STRIDE: {
-      Vec v = eval(is, s, stmt->dma.stride_internal());
-      s->readStride = v[0].intVal;
+    case Stmt::SEMA_INC:
+    case Stmt::SEMA_DEC: {
+      check_not_in_where();
+      Operation op((s->tag == Stmt::SEMA_INC)? Operation::SEMA_INC : Operation::SEMA_DEC);
+      op.target = s->dma.semaId();
+      emit(op);
     }
     break;
 
+    case Stmt::SET_READ_STRIDE:
     case Stmt::SET_WRITE_STRIDE: {
-      Vec v = eval(is, s, stmt->dma.stride_internal());
-      s->writeStride = v[0].intVal;
+      check_not_in_where();
+      Operation op((s->tag == Stmt::SET_READ_STRIDE)? Operation::READ_STRIDE : Operation::WRITE_STRIDE);
+      op.a = expr(s->dma.stride_internal());
+      emit(op);
     }
     break;
 
@@ -464,101 +673,141 @@ bool dma_exec(InterpreterState &is, CoreState* s, Stmt::Ptr &stmt) {
 
     case Stmt::DMA_START_READ:
     case Stmt::DMA_START_WRITE:
-      fatal("V3DLib: DMA access not supported by interpreter\n");
+      emit_fail("V3DLib: DMA access not supported by interpreter");
       break;
 
     default:
-      ret = false;
+      assertq(false, "interpreter: unexpected stmt-tag in compile");
       break;
   }
 
-  return ret;
-}
-
-
-void append_stack(CoreState &s, Stmt::Array const &stmts) {
-  // statements need to be placed reversed on the stack, which pushes and pops on the back
-  for (int i = (int) stmts.size() - 1; i >= 0; i--) {
-    s.stack << stmts[i];
-  }
+  m_next_temp = temp_mark;
 }
 
+}  // namespace interp
 
-void exec(InterpreterState &is, int core_index) {
-  CoreState *s = &is.core[core_index];
-  assert(s->stack.size() > 0);
-
-  // Get next statement
-  Stmt::Ptr stmt = s->stack.back();
-  s->stack.pop_back();
-
-  if (stmt == nullptr) { // Apparently this happened
-    assertq(false, " Interpreter: not expecting nullptr for stmt", true);
-    return;
-  }
 
-  if (stmt->do_break_point()) {
-#ifdef DEBUG
-    printf("Interpreter: hit breakpoint for stmt: %s\n", stmt->dump().c_str());
-    breakpoint
-#endif
-  }
+// ============================================================================
+// Execute code
+// ============================================================================
 
-  switch (stmt->tag) {
-    case Stmt::GATHER_PREFETCH: // Ignore
-    case Stmt::SKIP:
-      break;
+namespace {
 
-    case Stmt::ASSIGN:          // Assignment
-      execAssign(is, s, Always, stmt->assign_lhs(), stmt->assign_rhs());
-      break;
+using interp::Operation;
 
-    case Stmt::SEQ:             // Sequential composition
-      append_stack(*s, stmt->body());
-      break;
+/**
+ * Execute operations on given core, until it halts, blocks on a semaphore,
+ * accesses main memory or has executed `max_ops` operations.
+ */
+void exec(InterpreterState &is, int core_index, interp::Program const &program, int max_ops) {
+  CoreState *s = &is.core[core_index];
+  Vec *slot = s->slots.data();
 
-    case Stmt::WHERE: {         // Conditional assignment
-      Vec b = evalBool(is, s, stmt->where_cond());
-      execWhere(is, s, b, stmt->then_block());
-      execWhere(is, s, b.negate(), stmt->else_block());
+  for (int count = 0; count < max_ops; count++) {
+    if (s->pc >= program.size()) {
+      s->running = false;
+      return;
     }
-    break;
-
-    case Stmt::IF:
-      if (evalCond(is, s, stmt->if_cond()))
-        append_stack(*s, stmt->then_block());
-      else if (!stmt->else_block().empty()) {  // This test shouldn't matter much
-        append_stack(*s, stmt->else_block());
-      }
-      break;
 
-    case Stmt::WHILE:
-      if (evalCond(is, s, stmt->loop_cond())) {
-        s->stack << stmt;
-        append_stack(*s, stmt->body());
+    Operation const &op = program.op(s->pc++);
+
+    switch (op.tag) {
+      case Operation::ALU:       slot[op.dst].apply(op.alu_op, slot[op.a], slot[op.b]); break;
+      case Operation::RECIP:     slot[op.dst] = slot[op.a].recip();                      break;
+      case Operation::RECIPSQRT: slot[op.dst] = slot[op.a].recip_sqrt();                 break;
+      case Operation::EXP:       slot[op.dst] = slot[op.a].exp();                        break;
+      case Operation::LOG:       slot[op.dst] = slot[op.a].log();                        break;
+      case Operation::CMP:       slot[op.dst] = compare(op.cmp, slot[op.a], slot[op.b]); break;
+      case Operation::NOT:       slot[op.dst] = slot[op.a].negate();                     break;
+      case Operation::AND:       slot[op.dst] = slot[op.a].cond_and(slot[op.b]);         break;
+      case Operation::OR:        slot[op.dst] = slot[op.a].cond_or(slot[op.b]);          break;
+      case Operation::MOVE:      slot[op.dst] = slot[op.a];                              break;
+      case Operation::MOVE_WHERE: slot[op.dst].assign_where(slot[op.b], slot[op.a]);     break;
+      case Operation::UNIFORM:   slot[op.dst] = is.get_uniform(s->id, s->nextUniform);   break;
+
+      // Cores can communicate via main memory. After each access, other cores get a turn,
+      // so that the ordering of memory accesses between cores stays fine-grained.
+      case Operation::LOAD:
+        slot[op.dst] = s->load_from_heap(slot[op.a]);
+        return;
+
+      case Operation::STORE:
+        s->store_to_heap(slot[op.a], slot[op.b]);
+        return;
+
+      case Operation::TMU_LOAD:
+        assert(s->loadBuffer.size() < 8);
+        s->loadBuffer.append(s->load_from_heap(slot[op.a]));
+        return;
+
+      case Operation::LOAD_RECEIVE:
+        assert(s->loadBuffer.size() > 0);
+        slot[op.dst] = s->loadBuffer.remove(0);
+        break;
+
+      case Operation::JUMP:
+        s->pc = op.target;
+        break;
+
+      case Operation::JUMP_UNLESS_ALL:
+        if (!slot[op.a].all()) s->pc = op.target;
+        break;
+
+      case Operation::JUMP_UNLESS_ANY:
+        if (!slot[op.a].any()) s->pc = op.target;
+        break;
+
+      case Operation::SEMA_INC:
+      case Operation::SEMA_DEC: {
+        bool blocked = (op.tag == Operation::SEMA_INC)? is.sema_inc(op.target) : is.sema_dec(op.target);
+        if (blocked) {
+          s->pc--;  // Retry later, give other cores a chance
+          return;
+        }
       }
       break;
 
-    case Stmt::LOAD_RECEIVE:
-      execLoadReceive(s, stmt->address());
-      break;
+      case Operation::READ_STRIDE:  s->readStride  = slot[op.a][0].intVal; break;
+      case Operation::WRITE_STRIDE: s->writeStride = slot[op.a][0].intVal; break;
 
-    case Stmt::SEMA_INC: if (is.sema_inc(stmt->dma.semaId())) s->stack << stmt; break;
-    case Stmt::SEMA_DEC: if (is.sema_dec(stmt->dma.semaId())) s->stack << stmt; break;
+      case Operation::FAIL:
+        assertq(false, op.msg, true);
+        break;
 
-    default:
-      if (!dma_exec(is, s, stmt)) {
-        assertq(false, "interpreter: unexpected stmt-tag in exec()");
-      }
-      break;
+      case Operation::BREAKPOINT:
+#ifdef DEBUG
+        printf("Interpreter: hit breakpoint for stmt: %s\n", op.stmt->dump().c_str());
+        breakpoint
+#endif
+        break;
+    }
   }
 }
 
+}  // anon namespace
+
 
 // ============================================================================
 // Interpreter
 // ============================================================================
 
+namespace interp {
+
+/**
+ * Compile source code for the interpreter
+ *
+ * This needs to be done only once per kernel; the result can be reused for multiple runs.
+ *
+ * @param stmts    Source code
+ * @param numVars  Max var id used in source
+ */
+std::shared_ptr<Program> compile(Stmts const &stmts, int numVars) {
+  return std::make_shared<Program>(stmts, numVars);
+}
+
+}  // namespace interp
+
+
 /**
  * Run the interpreter
  *
@@ -573,7 +822,6 @@ void exec(InterpreterState &is, int core_index) {
  * @param numVars   Max var id used in source
  * @param uniforms  Kernel parameters
  * @param heap
- * @param output    Output from print statements (if NULL, stdout is used)
  */
 void interpreter(
   int numCores,
@@ -582,24 +830,35 @@ void interpreter(
   IntList &uniforms,
   BufferObject &heap
 ) {
+  interp::Program program(stmts, numVars);
+  interpreter(numCores, program, uniforms, heap);
+}
+
+
+/**
+ * Run the interpreter on source code which has been compiled in advance
+ *
+ * Cores are run in turn, see `exec()` for the length of a turn.
+ */
+void interpreter(
+  int numCores,
+  interp::Program const &program,
+  IntList &uniforms,
+  BufferObject &heap
+) {
+  int const TIME_SLICE = 1024;  // Max number of operations per core per turn
+
   InterpreterState state(numCores, uniforms);
 
   // Initialise state
   for (int i = 0; i < numCores; i++) {
     CoreState &s = state.core[i];
     s.id          = i;
-    s.init_env(numVars);
+    s.running     = true;
+    s.slots       = program.init_slots();
     s.emuHeap.heap_view(heap);
   }
 
-  // Put statement on each core's control stack
-  // Note the reversal, to use it as an actual stack
-  for (int i = 0; i < numCores; i++) {
-    auto &stack = state.core[i].stack;
-    stack = stmts;
-    std::reverse(stack.begin(), stack.end());
-  }
-
   CoreState::reset_count();
 
   // Run code
@@ -607,9 +866,9 @@ void interpreter(
   while (running) {
     running = false;
     for (int i = 0; i < numCores; i++) {
-      if (state.core[i].stack.size() > 0) {
+      if (state.core[i].running) {
         running = true;
-        exec(state, i);
+        exec(state, i, program, TIME_SLICE);
       }
     }
   }
@@ -1,6 +1,7 @@
 #ifndef _V3DLIB_INTERPRETER_H_
 #define _V3DLIB_INTERPRETER_H_
 #include <stdint.h>
+#include <memory>
 #include "Source/Stmt.h"
 
 namespace V3DLib {
@@ -10,6 +11,14 @@ class BufferObject;
 template<typename T>
 class Seq;
 
+namespace interp {
+
+class Program;  // Source code compiled for the interpreter, defined in Interpreter.cpp
+
+std::shared_ptr<Program> compile(Stmts const &stmts, int numVars);
+
+}  // namespace interp
+
 void interpreter(
   int numCores,
   Stmts const &stmts,
@@ -18,6 +27,13 @@ void interpreter(
   BufferObject &heap
 );
 
+void interpreter(
+  int numCores,
+  interp::Program const &program,
+  IntList &uniforms,
+  BufferObject &heap
+);
+
 }  // namespace V3DLib
 
 #endif  // _V3DLIB_INTERPRETER_H_
@@ -3,10 +3,19 @@
 #include "Support/basics.h"  // fatal()
 #include "Source/Int.h"
 #include "StmtStack.h"
+#include "LoopTransform.h"
 
 namespace V3DLib {
 namespace {
 
+/**
+ * Pass the pending loop hint to a new loop statement
+ */
+void set_loop_hint(Stmt::Ptr s) {
+  s->loop_hint(stmtStack().take_loop_hint());
+}
+
+
 void prepare_stack(Stmt::Ptr s) {
   auto &stack = stmtStack();
   stack.push();
@@ -58,7 +67,12 @@ void End_() {
   }
 
   stmtStack().pop();
-  stmtStack().append(s);
+
+  if (s->tag == Stmt::WHILE && !s->loop_hint().empty()) {
+    stmtStack().append(transform_loop(s, *stmtStack().top()));
+  } else {
+    stmtStack().append(s);
+  }
 }
 
 
@@ -78,6 +92,7 @@ void If_(BoolExpr b) { If_(any(b)); }
 void While_(Cond c) {
   Stmt::Ptr s = Stmt::create(Stmt::WHILE);
   s->cond(c.cexpr());
+  set_loop_hint(s);
   prepare_stack(s);
 }
 
@@ -87,6 +102,7 @@ void While_(BoolExpr c) { While_(any(c)); }
 void For_(Cond c) {
   Stmt::Ptr s = Stmt::create(Stmt::FOR);
   s->cond(c.cexpr());
+  set_loop_hint(s);
   prepare_stack(s);
 }
 
@@ -137,4 +153,44 @@ void break_point(bool val) {
   }
 }
 
+
+
+//=============================================================================
+// Loop hints
+//=============================================================================
+
+/**
+ * Unroll the next loop.
+ *
+ * The loop body is copied `factor` times, so that the loop condition is checked
+ * and the loop branch taken only once per `factor` iterations.
+ * This gives the instruction scheduling more to work with.
+ *
+ * The trip count of the loop must be known at compile time, otherwise the hint is ignored.
+ * See `transform_loop()` for details.
+ */
+void loop_unroll(int factor) {
+  assertq(factor >= 1, "loop_unroll(): factor must be positive", true);
+  stmtStack().loop_hint().unroll = factor;
+}
+
+
+/**
+ * Software-pipeline the memory loads in the next loop.
+ *
+ * The loads `x = *p` at the top level of the loop body are issued `depth` iterations
+ * ahead, so that the TMU fetches the data while the preceding iterations are computed.
+ * The loads must not depend on stores in the loop itself.
+ *
+ * The trip count of the loop must be known at compile time, otherwise the hint is ignored.
+ * See `transform_loop()` for details.
+ *
+ * @param depth  number of iterations to load ahead. If -1, use the maximum allowed
+ *               by the TMU queue size (see `Platform::gather_limit()`)
+ */
+void loop_pipeline(int depth) {
+  assertq(depth >= -1, "loop_pipeline(): invalid depth", true);
+  stmtStack().loop_hint().pipeline = depth;
+}
+
 }  // namespace V3DLib
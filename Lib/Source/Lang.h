@@ -45,6 +45,13 @@ inline void comment(std::string const &str) { comment(str.c_str()); }
 
 void break_point(bool val = true);
 
+//=============================================================================
+// Loop hints, these apply to the next 'For' or 'While'
+//=============================================================================
+
+void loop_unroll(int factor);
+void loop_pipeline(int depth = -1);
+
 }  // namespace V3DLib
 
 #endif  // _V3DLIB_SOURCE_LANG_H_
@@ -0,0 +1,528 @@
+#include "LoopTransform.h"
+#include <map>
+#include <functional>
+#include "Support/basics.h"
+#include "Support/debug.h"
+#include "Support/Platform.h"
+#include "Common/CompileData.h"
+#include "StmtStack.h"
+#include "gather.h"
+
+namespace V3DLib {
+namespace {
+
+int const MAX_TRIP_COUNT = 1 << 16;  // Loops with more iterations are considered to have an unknown trip count
+
+
+bool is_var(Expr::Ptr e, Var const &v) {
+  return e->tag() == Expr::VAR && e->var().tag() == v.tag() && e->var().id() == v.id();
+}
+
+
+/**
+ * Call `f` for the given statement and all statements nested within it
+ */
+void each_stmt(Stmt::Ptr s, std::function<void(Stmt &)> const &f) {
+  f(*s);
+
+  switch (s->tag) {
+    case Stmt::SEQ:
+    case Stmt::WHILE:
+      for (auto &item : s->body()) each_stmt(item, f);
+      break;
+
+    case Stmt::IF:
+    case Stmt::WHERE:
+      for (auto &item : s->then_block()) each_stmt(item, f);
+      for (auto &item : s->else_block()) each_stmt(item, f);
+      break;
+
+    default: break;
+  }
+}
+
+
+/**
+ * @return number of statements, nested ones included, which write to the given variable
+ */
+int num_writes(Stmt::Ptr s, Var const &v) {
+  int ret = 0;
+
+  each_stmt(s, [&ret, &v] (Stmt &item) {
+    if (item.tag == Stmt::ASSIGN       && is_var(item.assign_lhs(), v)) ret++;
+    if (item.tag == Stmt::LOAD_RECEIVE && is_var(item.address(), v))   ret++;
+  });
+
+  return ret;
+}
+
+
+int num_writes(Stmts const &stmts, Var const &v) {
+  int ret = 0;
+
+  for (auto const &s : stmts) {
+    ret += num_writes(s, v);
+  }
+
+  return ret;
+}
+
+
+bool has_deref(Expr::Ptr e) {
+  switch (e->tag()) {
+    case Expr::DEREF: return true;
+    case Expr::APPLY: return has_deref(e->lhs()) || has_deref(e->rhs());
+    default:          return false;
+  }
+}
+
+
+bool has_deref(BExpr::Ptr b) {
+  switch (b->tag()) {
+    case NOT: return has_deref(b->neg());
+    case AND:
+    case OR:  return has_deref(b->lhs()) || has_deref(b->rhs());
+    case CMP: return has_deref(b->cmp_lhs()) || has_deref(b->cmp_rhs());
+  }
+
+  return false;
+}
+
+
+void collect_vars(Expr::Ptr e, std::vector<Var> &vars) {
+  switch (e->tag()) {
+    case Expr::VAR:   vars.push_back(e->var()); break;
+    case Expr::APPLY: collect_vars(e->lhs(), vars); collect_vars(e->rhs(), vars); break;
+    case Expr::DEREF: collect_vars(e->deref_ptr(), vars); break;
+    default: break;
+  }
+}
+
+
+/**
+ * Variable which is changed by a constant amount in each iteration of a loop
+ */
+struct Induction {
+  int pos     = -1;     // Position of the update in the loop body
+  bool negate = false;  // If true, step is subtracted
+  int lit     = 0;      // Step, if a literal
+  Expr::Ptr step_var;   // Step, if a loop-invariant variable
+
+  /**
+   * @return expression for the value of the variable `k` iterations further on
+   */
+  Expr::Ptr advance(Var const &v, int k) const {
+    if (k == 0) return mkVar(v);
+
+    Expr::Ptr offset;
+    if (step_var.get() == nullptr) {
+      offset = mkIntLit(k*lit);
+    } else if (k == 1) {
+      offset = step_var;
+    } else {
+      offset = mkApply(step_var, Op(MUL, INT32), mkIntLit(k));
+    }
+
+    return mkApply(mkVar(v), Op(negate? SUB : ADD, INT32), offset);
+  }
+};
+
+
+/**
+ * Find the single update `v = v + step` or `v = v - step` of a variable in the loop body.
+ *
+ * The update must be at the top level of the body, so that it is executed in each iteration.
+ * The step must be a literal, or a variable which is either loop-invariant or set
+ * to a literal before the update (as done by `Pointer::inc()`).
+ */
+bool find_induction(Stmts const &body, Var const &v, Induction &ind) {
+  if (v.tag() != STANDARD || num_writes(body, v) != 1) return false;
+
+  for (int i = 0; i < (int) body.size(); i++) {
+    auto const &s = *body[i];
+    if (s.tag != Stmt::ASSIGN || !is_var(s.assign_lhs(), v)) continue;
+
+    Expr::Ptr rhs = s.assign_rhs();
+    if (rhs->tag() != Expr::APPLY || rhs->apply_op().type != INT32) return false;
+
+    Expr::Ptr step;
+    auto op = rhs->apply_op().op;
+
+    if (op == ADD && is_var(rhs->lhs(), v)) {
+      step = rhs->rhs();
+    } else if (op == ADD && is_var(rhs->rhs(), v)) {
+      step = rhs->lhs();
+    } else if (op == SUB && is_var(rhs->lhs(), v)) {
+      step = rhs->rhs();
+      ind.negate = true;
+    } else {
+      return false;
+    }
+
+    ind.pos = i;
+
+    if (step->tag() == Expr::INT_LIT) {
+      ind.lit = step->intLit;
+      return true;
+    }
+
+    if (step->tag() != Expr::VAR || step->var().tag() != STANDARD) return false;
+
+    int writes = num_writes(body, step->var());
+    if (writes == 0) {
+      ind.step_var = step;
+      return true;
+    }
+
+    if (writes != 1) return false;
+
+    for (int j = 0; j < i; j++) {
+      auto const &t = *body[j];
+
+      if (t.tag == Stmt::ASSIGN && is_var(t.assign_lhs(), step->var()) && t.assign_rhs()->tag() == Expr::INT_LIT) {
+        ind.lit = t.assign_rhs()->intLit;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  return false;
+}
+
+
+/**
+ * Loop with a trip count known at compile time
+ */
+struct CountedLoop {
+  Var var = Var(STANDARD, 0);  // Loop variable
+  int init  = 0;               // Initial value of the loop variable
+  int step  = 0;               // Change of the loop variable per iteration
+  int count = 0;               // Number of iterations
+};
+
+
+bool compare(CmpOp::Id op, int a, int b) {
+  switch (op) {
+    case CmpOp::EQ:  return a == b;
+    case CmpOp::NEQ: return a != b;
+    case CmpOp::LT:  return a <  b;
+    case CmpOp::GT:  return a >  b;
+    case CmpOp::LE:  return a <= b;
+    case CmpOp::GE:  return a >= b;
+  }
+
+  return false;
+}
+
+
+/**
+ * Determine the trip count of a loop.
+ *
+ * This is possible if:
+ *   - the loop condition compares a variable with a literal
+ *   - the variable is set to a literal directly before the loop
+ *   - the variable is changed by a literal step in each iteration
+ */
+bool counted_loop(Stmt &loop, Stmts const &preceding, CountedLoop &ret) {
+  BExpr::Ptr b = loop.loop_cond()->bexpr();
+  if (b->tag() != CMP || b->cmp.type() != INT32) return false;
+
+  auto op = b->cmp.op();
+  Expr::Ptr bound = b->cmp_rhs();
+  bool var_lhs = true;
+
+  if (b->cmp_lhs()->tag() == Expr::VAR && bound->tag() == Expr::INT_LIT) {
+    ret.var = b->cmp_lhs()->var();
+  } else if (b->cmp_rhs()->tag() == Expr::VAR && b->cmp_lhs()->tag() == Expr::INT_LIT) {
+    ret.var = b->cmp_rhs()->var();
+    bound   = b->cmp_lhs();
+    var_lhs = false;
+  } else {
+    return false;
+  }
+
+  Induction ind;
+  if (!find_induction(loop.body(), ret.var, ind) || ind.step_var.get() != nullptr) return false;
+  ret.step = ind.negate? -ind.lit : ind.lit;
+
+  // Find the initialization
+  bool found = false;
+  for (int i = (int) preceding.size() - 1; i >= 0; i--) {
+    if (num_writes(preceding[i], ret.var) == 0) continue;
+
+    auto const &s = *preceding[i];
+    if (s.tag != Stmt::ASSIGN || !is_var(s.assign_lhs(), ret.var) || s.assign_rhs()->tag() != Expr::INT_LIT) {
+      return false;
+    }
+
+    ret.init = s.assign_rhs()->intLit;
+    found = true;
+    break;
+  }
+
+  if (!found) return false;
+
+  // Run the loop
+  int64_t value = ret.init;
+  ret.count = 0;
+
+  while (var_lhs? compare(op, (int) value, bound->intLit) : compare(op, bound->intLit, (int) value)) {
+    value += ret.step;
+    ret.count++;
+
+    if (ret.count > MAX_TRIP_COUNT || value != (int) value) return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * Load `x = *addr` at the top level of a loop body
+ */
+struct Load {
+  int pos;
+  Var dst = Var(STANDARD, 0);
+  Expr::Ptr addr;
+};
+
+
+/**
+ * Find the loads in the loop body which can be pipelined.
+ *
+ * The address of a load may only contain loop-invariant variables and induction variables,
+ * so that the address of a later iteration can be determined.
+ *
+ * @return true if all memory loads in the body can be pipelined, false otherwise
+ */
+bool find_loads(Stmts const &body, std::vector<Load> &loads, std::map<int, Induction> &inductions) {
+  bool ok = true;
+
+  for (int i = 0; i < (int) body.size() && ok; i++) {
+    auto s = body[i];
+
+    if (s->tag == Stmt::ASSIGN && s->assign_lhs()->tag() == Expr::VAR && s->assign_rhs()->tag() == Expr::DEREF) {
+      Expr::Ptr addr = s->assign_rhs()->deref_ptr();
+      if (has_deref(addr)) return false;
+
+      std::vector<Var> vars;
+      collect_vars(addr, vars);
+
+      for (auto const &v : vars) {
+        if (v.tag() == ELEM_NUM || v.tag() == QPU_NUM) continue;
+        if (v.tag() != STANDARD) return false;
+        if (num_writes(body, v) == 0) continue;  // Loop-invariant
+
+        Induction ind;
+        if (!find_induction(body, v, ind)) return false;
+        inductions[v.id()] = ind;
+      }
+
+      Load load;
+      load.pos  = i;
+      load.dst  = s->assign_lhs()->var();
+      load.addr = addr;
+      loads.push_back(load);
+      continue;
+    }
+
+    // Anything else may not use the TMU
+    each_stmt(s, [&ok] (Stmt &item) {
+      switch (item.tag) {
+        case Stmt::SKIP:
+        case Stmt::SEQ:
+          break;
+
+        case Stmt::ASSIGN:
+          if (item.assign_lhs()->tag() == Expr::VAR && item.assign_lhs()->var().tag() == TMU0_ADDR) ok = false;
+          if (has_deref(item.assign_rhs())) ok = false;
+          if (item.assign_lhs()->tag() == Expr::DEREF && has_deref(item.assign_lhs()->deref_ptr())) ok = false;
+          break;
+
+        case Stmt::IF:    if (has_deref(item.if_cond()->bexpr()))   ok = false; break;
+        case Stmt::WHILE: if (has_deref(item.loop_cond()->bexpr())) ok = false; break;
+        case Stmt::WHERE: if (has_deref(item.where_cond()))         ok = false; break;
+
+        default:
+          ok = false;  // Includes prefetches, receives and DMA
+          break;
+      }
+    });
+  }
+
+  return ok;
+}
+
+
+/**
+ * @return address expression with the induction variables advanced by the given number of iterations
+ */
+Expr::Ptr advance(Expr::Ptr e, std::map<int, Induction> const &inductions, std::function<int(Induction const &)> k) {
+  switch (e->tag()) {
+    case Expr::VAR: {
+      if (e->var().tag() != STANDARD) return e;
+
+      auto it = inductions.find(e->var().id());
+      if (it == inductions.end()) return e;
+
+      return it->second.advance(e->var(), k(it->second));
+    }
+
+    case Expr::APPLY:
+      return mkApply(advance(e->lhs(), inductions, k), e->apply_op(), advance(e->rhs(), inductions, k));
+
+    default:
+      return e;
+  }
+}
+
+}  // anon namespace
+
+
+/**
+ * Apply the loop hints to a loop.
+ *
+ * The trip count of the loop must be known at compile time, otherwise the loop is returned as is.
+ * Given trip count `N`, unroll factor `U` and pipeline depth `D`, the loop is replaced by:
+ *
+ *   - prologue: the loads of the first `D` iterations
+ *   - `(N - D) % U` copies of the loop body
+ *   - a loop with `U` copies of the loop body, running `(N - D)/U` times
+ *   - epilogue: `D` copies of the loop body, which do not load ahead
+ *
+ * The first `(N - D) % U` iterations are peeled off, so that the loop condition
+ * only needs to be checked once per `U` iterations.
+ *
+ * In the pipelined loop body, each load `x = *addr` is replaced by a receive of the value
+ * loaded earlier, followed by a load of `addr` for iteration `i + D`. This is the same
+ * gather/receive mechanism used by `prefetch()`. Loops in kernels which already use `prefetch()`
+ * are not pipelined, because the TMU queue may hold loads which are received after the loop.
+ *
+ * @param loop       loop statement with hints
+ * @param preceding  statements preceding the loop at the same level, used to find the initial
+ *                   value of the loop variable
+ *
+ * @return statements to replace the loop with
+ */
+Stmts transform_loop(Stmt::Ptr loop, Stmts const &preceding) {
+  assert(loop->tag == Stmt::WHILE);
+  LoopHint const &hint = loop->loop_hint();
+
+  Stmts ret;
+
+  CountedLoop counted;
+  if (!counted_loop(*loop, preceding, counted)) {
+    warning("Loop hint ignored, the trip count of the loop is not known at compile time");
+    ret.push_back(loop);
+    return ret;
+  }
+
+  Stmts const &body = loop->body();
+  int unroll = hint.unroll;
+  int depth  = 0;
+
+  std::vector<Load> loads;
+  std::map<int, Induction> inductions;
+
+  if (hint.pipeline != 0) {
+    if (!stmtStack().prefetch_pending() && find_loads(body, loads, inductions) && !loads.empty()) {
+      int max_depth = Platform::gather_limit()/((int) loads.size());
+      depth = (hint.pipeline == -1)? max_depth : std::min(hint.pipeline, max_depth);
+      depth = std::min(depth, counted.count);
+    }
+
+    if (depth == 0) {
+      warning("loop_pipeline() hint ignored, the loads in the loop can not be pipelined");
+    }
+  }
+
+  //
+  // Construct the loop bodies
+  //
+  auto make_body = [&] (bool load_ahead) -> Stmts {
+    if (depth == 0) return body;
+
+    Stmts ret;
+    int l = 0;
+
+    for (int i = 0; i < (int) body.size(); i++) {
+      if (l < (int) loads.size() && loads[l].pos == i) {
+        auto recv = Stmt::create(Stmt::LOAD_RECEIVE, mkVar(loads[l].dst), nullptr);
+        recv->transfer_comments(*body[i]);
+        ret.push_back(recv);
+
+        if (load_ahead) {
+          ret.push_back(gatherExpr(advance(loads[l].addr, inductions, [depth] (Induction const &) {
+            return depth;
+          })));
+        }
+
+        l++;
+      } else {
+        ret.push_back(body[i]);
+      }
+    }
+
+    return ret;
+  };
+
+  Stmts pipelined = make_body(true);
+  Stmts last      = make_body(false);
+
+  int main   = counted.count - depth;  // Number of iterations which load ahead
+  int peel   = main % unroll;
+  int blocks = main / unroll;
+
+  //
+  // Assemble
+  //
+  for (int s = 0; s < depth; s++) {
+    for (auto const &load : loads) {
+      auto gather = gatherExpr(advance(load.addr, inductions, [s, &load] (Induction const &ind) {
+        return s + ((ind.pos < load.pos)? 1 : 0);  // Updated before the load in the same iteration
+      }));
+
+      if (ret.empty()) gather->comment("Loop pipeline prologue");
+      ret.push_back(gather);
+    }
+  }
+
+  for (int i = 0; i < peel; i++) {
+    ret.insert(ret.end(), pipelined.begin(), pipelined.end());
+  }
+
+  if (blocks > 0) {
+    Stmts block;
+    for (int i = 0; i < unroll; i++) {
+      block.insert(block.end(), pipelined.begin(), pipelined.end());
+    }
+
+    auto w = Stmt::create(Stmt::WHILE);
+
+    if (depth == 0) {
+      w->cond(loop->loop_cond());
+    } else {
+      // Stop `depth` iterations before the end
+      int end = counted.init + main*counted.step;
+      auto b = std::make_shared<BExpr>(mkVar(counted.var), CmpOp(CmpOp::NEQ, INT32), mkIntLit(end));
+      w->cond(mkAny(b));
+    }
+
+    w->add_block(block);
+    w->transfer_comments(*loop);
+    ret.push_back(w);
+  }
+
+  for (int i = 0; i < depth; i++) {
+    ret.insert(ret.end(), last.begin(), last.end());
+  }
+
+  if (unroll > 1) compile_data().num_loops_unrolled++;
+  if (depth > 0)  compile_data().num_loops_pipelined++;
+
+  return ret;
+}
+
+}  // namespace V3DLib
@@ -0,0 +1,11 @@
+#ifndef _V3DLIB_SOURCE_LOOPTRANSFORM_H_
+#define _V3DLIB_SOURCE_LOOPTRANSFORM_H_
+#include "Stmt.h"
+
+namespace V3DLib {
+
+Stmts transform_loop(Stmt::Ptr loop, Stmts const &preceding);
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_SOURCE_LOOPTRANSFORM_H_
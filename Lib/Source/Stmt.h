@@ -8,6 +8,17 @@
 
 namespace V3DLib {
 
+/**
+ * Optimization hints for a loop, see `loop_unroll()` and `loop_pipeline()`
+ */
+struct LoopHint {
+  int unroll   = 1;  // Number of copies of the loop body per iteration
+  int pipeline = 0;  // Number of iterations to load ahead, -1 for the maximum possible
+
+  bool empty() const { return unroll <= 1 && pipeline == 0; }
+};
+
+
 // ============================================================================
 // Class Stmt
 // ============================================================================
@@ -114,6 +125,9 @@ struct Stmt : public InstructionComment {
   void break_point() { m_break_point = true; }
   bool do_break_point() const { return m_break_point; }
 
+  LoopHint const &loop_hint() const { return m_loop_hint; }
+  void loop_hint(LoopHint const &val) { m_loop_hint = val; }
+
 private:
   BExpr::Ptr m_where_cond;
 
@@ -126,6 +140,7 @@ private:
   CExpr::Ptr m_cond;
 
   bool m_break_point = false;
+  LoopHint m_loop_hint;         // WHILE and FOR only
 
   static Ptr create(Tag in_tag, Ptr s0, Ptr s1);
   void init(Tag in_tag);
@@ -2,18 +2,18 @@
 #include <iostream>          // std::cout
 #include "Support/basics.h"
 #include "Source/gather.h"
+#include "Common/CompileContext.h"
 
 namespace V3DLib {
 namespace {
 
-StmtStack *p_stmtStack = nullptr;
-
 StmtStack::Ptr tempStack(StackCallback f) {
   StmtStack::Ptr stack;
   stack.reset(new StmtStack);
   stack->reset();
 
   // Temporarily replace global stack
+  StmtStack *&p_stmtStack = CompileContext::current().stmt_stack;
   StmtStack *global_stack = p_stmtStack;
   p_stmtStack = stack.get();
 
@@ -166,6 +166,29 @@ void StmtStack::resolve_prefetches() {
 }
 
 
+/**
+ * @return true if prefetches have been issued in the current kernel.
+ *         The TMU queue may then contain loads which are received later on.
+ */
+bool StmtStack::prefetch_pending() const {
+  for (auto const &item : prefetches) {
+    if (!item.second.tags_empty()) return true;
+  }
+
+  return false;
+}
+
+
+/**
+ * Retrieve the hint for the next loop and clear it
+ */
+LoopHint StmtStack::take_loop_hint() {
+  LoopHint ret = m_loop_hint;
+  m_loop_hint = LoopHint();
+  return ret;
+}
+
+
 void StmtStack::push(Stmt::Ptr s) {
   if (empty()) {
     push();
@@ -205,6 +228,7 @@ void StmtStack::reset() {
   push();
 
   prefetches.clear();
+  m_loop_hint = LoopHint();
 }
 
 
@@ -261,12 +285,15 @@ Stmt *StmtStack::first_in_seq() const {
 
 
 StmtStack &stmtStack() {
+  StmtStack *p_stmtStack = CompileContext::current().stmt_stack;
   assert(p_stmtStack != nullptr);
   return *p_stmtStack;
 }
 
 
 void clearStack() {
+  StmtStack *&p_stmtStack = CompileContext::current().stmt_stack;
+
   if (p_stmtStack == nullptr) {  // May occur if error during initialization
     return;
   }
@@ -277,6 +304,7 @@ void clearStack() {
 
 
 void initStack(StmtStack &stmtStack) {
+  StmtStack *&p_stmtStack = CompileContext::current().stmt_stack;
   assert(p_stmtStack == nullptr);
   stmtStack.reset();
   p_stmtStack = &stmtStack;
@@ -287,8 +315,7 @@ void initStack(StmtStack &stmtStack) {
  * Generate a new prefetch label
  */
 int prefetch_label() {
-  static int count = 0;
-  return ++count;
+  return ++CompileContext::current().prefetch_count;
 }
 
 }  // namespace V3DLib
@@ -37,6 +37,10 @@ public:
   void add_prefetch(Pointer &exp, int prefetch_label);
   void add_prefetch(PointerExpr const &exp, int prefetch_label);
   void resolve_prefetches();
+  bool prefetch_pending() const;
+
+  LoopHint &loop_hint() { return m_loop_hint; }
+  LoopHint take_loop_hint();
 
 private:
   class PrefetchContext {
@@ -56,6 +60,7 @@ private:
   };
 
   std::map<int, PrefetchContext> prefetches;
+  LoopHint m_loop_hint;  // Hint for the next loop
 
   void add_prefetch_label(int prefetch_label);
 };
@@ -1,12 +1,8 @@
 #include "Var.h"
 #include "Support/basics.h"
+#include "Common/CompileContext.h"
 
 namespace V3DLib {
-namespace {
-
-int globalVarId = 0;  // Used for fresh variable generation
-
-}  // anon namespace
 
 
 Var::Var(VarTag tag, bool is_uniform_ptr) : m_tag(tag), m_is_uniform_ptr(is_uniform_ptr)  {
@@ -63,7 +59,7 @@ std::string Var::dump() const {
  * @return a new standard variable
  */
 Var VarGen::fresh() {
-  return Var(STANDARD, globalVarId++);
+  return Var(STANDARD, CompileContext::current().var_count++);
 }
 
 
@@ -71,7 +67,7 @@ Var VarGen::fresh() {
  * Returns number of fresh vars used
  */
 int VarGen::count() {
-  return globalVarId;
+  return CompileContext::current().var_count;
 }
 
 
@@ -80,7 +76,7 @@ int VarGen::count() {
  */
 void VarGen::reset(int val) {
   assert(val >= 0);
-  globalVarId = val;
+  CompileContext::current().var_count = val;
 }
 
 }  // namespace V3DLib
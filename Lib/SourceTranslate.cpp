@@ -1,19 +1,10 @@
 #include "SourceTranslate.h"
-#include <memory>
 #include "Support/debug.h"
 #include "Support/Platform.h"
 #include "vc4/SourceTranslate.h"
 #include "v3d/SourceTranslate.h"
 #include "Target/instr/Mnemonics.h"
 
-namespace {
-
-std::unique_ptr<V3DLib::ISourceTranslate> _vc4_source_translate;
-std::unique_ptr<V3DLib::ISourceTranslate> _v3d_source_translate;
-
-}  // anon namespace
-
-
 namespace V3DLib {
 
 /**
@@ -69,16 +60,14 @@ Instr::List add_uniform_pointer_offset(Instr::List &code) {
 
 
 ISourceTranslate &getSourceTranslate() {
+  // Static locals, so that creation is thread-safe
+  static vc4::SourceTranslate vc4_source_translate;
+  static v3d::SourceTranslate v3d_source_translate;
+
   if (Platform::compiling_for_vc4()) {
-    if (_vc4_source_translate.get() == nullptr) {
-      _vc4_source_translate.reset(new vc4::SourceTranslate());
-    }
-    return *_vc4_source_translate.get();
+    return vc4_source_translate;
   } else {
-    if (_v3d_source_translate.get() == nullptr) {
-      _v3d_source_translate.reset(new v3d::SourceTranslate());
-    }
-    return *_v3d_source_translate.get();
+    return v3d_source_translate;
   }
 }
 
@@ -0,0 +1,119 @@
+#include "BitSet.h"
+#include "basics.h"
+
+namespace V3DLib {
+
+/**
+ * Set the upper bound of the values in the set.
+ *
+ * Any values outside the new range are dropped.
+ */
+void BitSet::resize(int max_size) {
+  assert(max_size >= 0);
+  m_max_size = max_size;
+  m_words.resize((size_t) ((max_size + WORD_BITS - 1)/WORD_BITS), 0);
+
+  // Clear the bits past the end, so that comparison and count stay correct
+  if (max_size % WORD_BITS != 0) {
+    m_words.back() &= bit(max_size) - 1;
+  }
+}
+
+
+/**
+ * Add all members of `rhs` to this set.
+ *
+ * @return true if this set changed, false otherwise
+ */
+bool BitSet::add(BitSet const &rhs) {
+  assert(m_max_size == rhs.m_max_size);
+  Word changed = 0;
+
+  for (size_t i = 0; i < m_words.size(); ++i) {
+    Word prev = m_words[i];
+    m_words[i] |= rhs.m_words[i];
+    changed |= prev ^ m_words[i];
+  }
+
+  return changed != 0;
+}
+
+
+void BitSet::remove(BitSet const &rhs) {
+  assert(m_max_size == rhs.m_max_size);
+
+  for (size_t i = 0; i < m_words.size(); ++i) {
+    m_words[i] &= ~rhs.m_words[i];
+  }
+}
+
+
+void BitSet::clear() {
+  for (auto &w : m_words) {
+    w = 0;
+  }
+}
+
+
+bool BitSet::empty() const {
+  for (auto w : m_words) {
+    if (w != 0) return false;
+  }
+
+  return true;
+}
+
+
+int BitSet::count() const {
+  int ret = 0;
+
+  for (auto w : m_words) {
+    ret += __builtin_popcountll(w);
+  }
+
+  return ret;
+}
+
+
+int BitSet::first() const {
+  assert(!empty());
+  return *begin();
+}
+
+
+/**
+ * Find the first member with value >= `from`.
+ *
+ * @return value of member if found, `max_size()` otherwise
+ */
+int BitSet::next_member(int from) const {
+  if (from >= m_max_size) return m_max_size;
+
+  size_t index = (size_t) (from/WORD_BITS);
+  Word w = m_words[index] & ~(bit(from) - 1);  // Skip bits below `from`
+
+  while (w == 0) {
+    index++;
+    if (index == m_words.size()) return m_max_size;
+    w = m_words[index];
+  }
+
+  return (int) index*WORD_BITS + __builtin_ctzll(w);
+}
+
+
+std::string BitSet::dump() const {
+  std::string ret;
+
+  ret << "(";
+
+  for (auto val : *this) {
+    ret << val << ", ";
+  }
+
+  ret << ")";
+
+  return ret;
+}
+
+}  // namespace V3DLib
@@ -0,0 +1,85 @@
+#ifndef _LIB_SUPPORT_BITSET_H
+#define _LIB_SUPPORT_BITSET_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "debug.h"
+
+namespace V3DLib {
+
+/**
+ * Dense set of non-negative integers with a fixed upper bound.
+ *
+ * Drop-in for `RegIdSet` in the places where the range of values is known in advance
+ * and the sets are dense, notably the live sets of the liveness analysis.
+ * Union and difference are done a word at a time.
+ *
+ * Iteration yields the members in increasing order, same as `RegIdSet`.
+ */
+class BitSet {
+  using Word = uint64_t;
+  static int const WORD_BITS = 64;
+
+public:
+  class const_iterator {
+  public:
+    const_iterator(BitSet const &set, int index) : m_set(set), m_index(index) { next(); }
+
+    int operator*() const { return m_index; }
+    bool operator!=(const_iterator const &rhs) const { return m_index != rhs.m_index; }
+    const_iterator &operator++() { m_index++; next(); return *this; }
+
+  private:
+    BitSet const &m_set;
+    int m_index;
+
+    void next() { m_index = m_set.next_member(m_index); }
+  };
+
+  BitSet() = default;
+  BitSet(int max_size) { resize(max_size); }
+
+  void resize(int max_size);
+  int max_size() const { return m_max_size; }
+
+  bool member(int val) const {
+    assert(0 <= val && val < m_max_size);
+    return (m_words[(size_t) (val/WORD_BITS)] & bit(val)) != 0;
+  }
+
+  void insert(int val) {
+    assert(0 <= val && val < m_max_size);
+    m_words[(size_t) (val/WORD_BITS)] |= bit(val);
+  }
+
+  void remove(int val) {
+    assert(0 <= val && val < m_max_size);
+    m_words[(size_t) (val/WORD_BITS)] &= ~bit(val);
+  }
+
+  bool add(BitSet const &rhs);
+  void remove(BitSet const &rhs);
+  void clear();
+  bool empty() const;
+  int count() const;
+  int first() const;
+
+  bool operator==(BitSet const &rhs) const { return m_words == rhs.m_words; }
+  bool operator!=(BitSet const &rhs) const { return !(*this == rhs); }
+
+  const_iterator begin() const { return const_iterator(*this, 0); }
+  const_iterator end() const   { return const_iterator(*this, m_max_size); }
+
+  std::string dump() const;
+
+private:
+  int m_max_size = 0;
+  std::vector<Word> m_words;
+
+  static Word bit(int val) { return ((Word) 1) << (val % WORD_BITS); }
+  int next_member(int from) const;
+};
+
+}  // namespace V3DLib
+
+#endif  // _LIB_SUPPORT_BITSET_H
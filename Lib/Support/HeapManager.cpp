@@ -1,13 +1,6 @@
 #include "HeapManager.h"
 #include "Support/basics.h"  // fatal()
 
-namespace  {
-
-int const INITIAL_FREE_RANGE_SIZE = 32;
-
-}  // anon namespace
-
-
 namespace V3DLib {
 
 void HeapManager::alloc(uint32_t size_in_bytes) {
@@ -26,24 +19,7 @@ void HeapManager::alloc_mem(uint32_t size_in_bytes) {
 }
 
 
-unsigned HeapManager::FreeRange::size() const {
-  int ret = (int) right - (int) left + 1;
-  assert(ret >= 0);  // empty range will have left + 1 == right
-
-  return (unsigned) ret;
-}
-
-
-std::string HeapManager::FreeRange::dump() const {
-  std::string ret;
-  ret << "[" << left << ", " << right << "]";
-  return ret;
-}
-
-
-HeapManager::HeapManager() {
-  m_free_ranges.reserve(INITIAL_FREE_RANGE_SIZE);
-}
+HeapManager::HeapManager() {}
 
 
 void HeapManager::set_size(uint32_t val) {
@@ -66,45 +42,61 @@ bool HeapManager::check_available(uint32_t n) {
 
 
 void HeapManager::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_size = 0;
   m_offset = 0;
-  m_free_ranges.clear();
+  m_used = 0;
+  m_free_by_addr.clear();
+  m_free_by_size.clear();
 }
 
 
 bool HeapManager::is_cleared() const {
   if  (m_size == 0) {
     assert(m_offset == 0);
-    assert(m_free_ranges.empty());
+    assert(m_used == 0);
+    assert(m_free_by_addr.empty());
+    assert(m_free_by_size.empty());
   }
 
   return (m_size == 0);
 }
 
 
+void HeapManager::add_free_range(uint32_t offset, uint32_t size) {
+  assert(size > 0);
+  m_free_by_addr[offset] = size;
+  m_free_by_size.insert(SizeKey(size, offset));
+}
+
+
+void HeapManager::remove_free_range(std::map<uint32_t, uint32_t>::iterator it) {
+  auto count = m_free_by_size.erase(SizeKey(it->second, it->first));
+  assert(count == 1);
+  (void) count;
+  m_free_by_addr.erase(it);
+}
+
+
 /**
+ * Allocate a memory range.
+ *
+ * The smallest free range which is large enough is used. If there is none,
+ * space is reserved from the top of the heap.
+ *
  * @param size_in_bytes number of bytes to allocate
  *
  * @return Start offset into heap if allocated, -1 if could not allocate.
  */
 int HeapManager::alloc_array(uint32_t size_in_bytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
   assert(m_size > 0);
   assert(size_in_bytes > 0);
   assert(size_in_bytes % 4 == 0);
 
-  // Find the first available space that is large enough
-  int found_index = -1;
-  for (int i = 0; i < (int) m_free_ranges.size(); ++i) {
-    auto &cur = m_free_ranges[i];
+  auto best = m_free_by_size.lower_bound(SizeKey(size_in_bytes, 0));
 
-    if (size_in_bytes <= cur.size()) {
-      found_index = i;
-      break;
-    }
-  }
-
-
-  if (found_index == -1) {
+  if (best == m_free_by_size.end()) {
     // Didn't find a freed location, reserve from the end
     if (!check_available(size_in_bytes)) {
       return -1;
@@ -112,20 +104,21 @@ int HeapManager::alloc_array(uint32_t size_in_bytes) {
 
     uint32_t prev_offset = m_offset;
     m_offset += size_in_bytes;
+    m_used   += size_in_bytes;
     return (int) prev_offset;
   }
 
-  int ret = -1;
+  uint32_t offset = best->second;
+  uint32_t remain = best->first - size_in_bytes;
+
+  remove_free_range(m_free_by_addr.find(offset));
 
-  auto &cur = m_free_ranges[found_index];
-  ret = cur.left;
-  cur.left += size_in_bytes;
-  if (cur.empty()) {
-    // remove from list
-    m_free_ranges.erase(m_free_ranges.begin() + found_index);
+  if (remain > 0) {
+    add_free_range(offset + size_in_bytes, remain);
   }
 
-  return ret;
+  m_used += size_in_bytes;
+  return (int) offset;
 }
 
 
@@ -135,122 +128,128 @@ int HeapManager::alloc_array(uint32_t size_in_bytes) {
  * This should be called from deallocating SharedArray instances, which allocated
  * from this BO.
  *
- * The goal is to detect if the entire BO is free of use. When that's the case, the
- * allocated size can be reset and the BO can be reused from scratch.
- *
- * Better would be to reuse empty spaces if possible; I'm pushing this ahead of me for now.
- * TODO Examine this
+ * The range is merged with adjacent free ranges. If it borders on the top of the heap,
+ * it is returned to the unreserved space. When all arrays are deallocated, the heap
+ * is thus fully reset.
  *
  * @param index  index of memory range to deallocate
  * @param size   number of bytes to deallocate
  */
 void HeapManager::dealloc_array(uint32_t index, uint32_t size) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  assert(m_size > 0);
   assert(size > 0);
   assert((index + size - 1) < m_size);
+  assert(index + size <= m_offset);
+  assert(m_used >= size);
 
-  dealloc_array(FreeRange(index, index + size -1));
-}
-
+  uint32_t left  = index;
+  uint32_t right = index + size;  // exclusive
 
-void HeapManager::dealloc_array(FreeRange const in_range) {
-  assert(m_size > 0);
+  auto next = m_free_by_addr.lower_bound(left);
 
 #ifdef DEBUG
   // Check if incoming range is already deallocated
-  for (int i = 0; i < (int) m_free_ranges.size(); ++i) {
-    auto &cur = m_free_ranges[i];
+  {
+    bool overlaps = (next != m_free_by_addr.end() && next->first < right);
 
-    if (!cur.overlaps(in_range)) continue;
+    if (!overlaps && next != m_free_by_addr.begin()) {
+      auto prev = std::prev(next);
+      overlaps = (prev->first + prev->second > left);
+    }
 
-    std::string msg;
-    msg << "HeapManager::dealloc_array(): "
-        << "range to deallocate " << in_range.dump() << " "
-        << "overlaps with free range " << cur.dump();
-    assertq(msg, true);
+    if (overlaps) {
+      std::string msg;
+      msg << "HeapManager::dealloc_array(): "
+          << "range to deallocate [" << left << ", " << (right - 1) << "] "
+          << "overlaps with a free range";
+      assertq(msg, true);
+    }
   }
 #endif
 
-  // Find adjacent matches in current free range list
-  int left_match_index  = -1;
-  int right_match_index = -1;
+  // Merge with adjacent free ranges
+  if (next != m_free_by_addr.end() && next->first == right) {
+    right += next->second;
+    auto tmp = next;
+    ++next;
+    remove_free_range(tmp);
+  }
 
-  for (int i = 0; i < (int) m_free_ranges.size(); ++i) {
-    auto &cur = m_free_ranges[i];
+  if (next != m_free_by_addr.begin()) {
+    auto prev = std::prev(next);
 
-    if (in_range.right + 1 == cur.left) {
-      assert(right_match_index == -1);  // Expecting at most one match
-      right_match_index = i;
+    if (prev->first + prev->second == left) {
+      left = prev->first;
+      remove_free_range(prev);
     }
+  }
 
-    if (in_range.left == cur.right + 1) {
-      assert(left_match_index == -1); // At most one match
-      left_match_index = i;
-    }
+  m_used -= size;
+
+  if (right == m_offset) {
+    m_offset = left;  // Return to unreserved space
+  } else {
+    add_free_range(left, right - left);
   }
 
+  if (m_offset == 0) {
+    assert(m_used == 0);
+    assert(m_free_by_addr.empty());
+  }
+}
 
-  if (left_match_index != -1) {
-    if (right_match_index != -1) {
-      // Both sides match
-      assert(left_match_index != right_match_index);
 
-      // Merge the three ranges to one
-      m_free_ranges[left_match_index].right = m_free_ranges[right_match_index].right;
+HeapManager::Stats HeapManager::stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats ret;
+  ret.size            = m_size;
+  ret.used            = m_used;
+  ret.free            = m_size - m_used;
+  ret.num_free_ranges = num_free_ranges();
+  ret.largest_free    = m_size - m_offset;
 
-      // Move the last range to the one we want to delete
-      auto tmp = m_free_ranges.back();
-      m_free_ranges.pop_back();
-      if (right_match_index != (int) m_free_ranges.size()) {
-        m_free_ranges[right_match_index] = tmp;
-      } else {
-      }
+  if (!m_free_by_size.empty()) {
+    uint32_t largest_range = m_free_by_size.rbegin()->first;
 
-    } else {
-      // Only left side matches
-      m_free_ranges[left_match_index].right = in_range.right;
+    if (largest_range > ret.largest_free) {
+      ret.largest_free = largest_range;
     }
-  } else if (right_match_index != -1) {
-    // Only right side matches
-      m_free_ranges[right_match_index].left = in_range.left;
-  } else {
-    // No match, add given range to list
-    m_free_ranges.push_back(in_range);
-
-    assert(m_free_ranges.size() < INITIAL_FREE_RANGE_SIZE);  // Warn me when this ever happens
-                                                             // (possible, currently not likely)
   }
 
-  // When fully deallocated, there should be one single range of the entire used space
-  bool is_empty = false;
-  if (m_free_ranges.size() == 1) {
-    auto &tmp = m_free_ranges.front();
-    is_empty = (tmp.left == 0) && (tmp.right == m_offset - 1);
-  }
+  return ret;
+}
 
-  if (is_empty) {
-    // We're done, reset the buffer
-    assert(m_offset > 0);  // paranoia
-    m_offset = 0;          // yes, it's that simple
-    m_free_ranges.clear();
-    //debug("BufferObject empty again!");
-  }
+
+/**
+ * Fraction of free memory which can not be used for the largest possible allocation.
+ *
+ * @return value between 0 (no fragmentation) and 1
+ */
+float HeapManager::Stats::fragmentation() const {
+  if (free == 0) return 0.0f;
+  return 1.0f - ((float) largest_free)/((float) free);
 }
 
 
-std::string HeapManager::dump() const {
+std::string HeapManager::Stats::dump() const {
   std::string ret;
 
-  uint32_t used_size = m_offset;
+  ret << "  Size/used      : " << size << ", " << used << "\n"
+      << "  Num free ranges: " << num_free_ranges << "\n"
+      << "  Largest free   : " << largest_free << "\n"
+      << "  Fragmentation  : " << fragmentation() << "\n";
 
-  for (int i = 0; i < (int) m_free_ranges.size(); i++) {
-    auto const &item = m_free_ranges[i];
-    used_size -= item.size();
-  }
+  return ret;
+}
+
+
+std::string HeapManager::dump() const {
+  std::string ret;
 
   ret << "HeapManager Usage\n"
       << "-----------------\n"
-      << "  Size/used      : " << size() << ", " << used_size << "\n"
-      << "  Num free ranges: " << num_free_ranges() << "\n";
+      << stats().dump();
 
   return ret;
 }
@@ -2,7 +2,10 @@
 #define _V3DLIB_SUPPORT_HEAPMANAGER_H_
 #include <stdint.h>
 #include <string>
-#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <utility>
 
 namespace V3DLib {
 
@@ -10,19 +13,46 @@ namespace V3DLib {
  * Memory manager for controlled heap objects.
  *
  * Keeps track of allocated and freed memory, handles space allocation.
+ *
+ * Memory is reserved from the start of the heap upward. Freed ranges are kept
+ * in two ordered containers:
+ *
+ * - by size, for best-fit allocation
+ * - by address, for coalescing adjacent free ranges
+ *
+ * Both allocation and deallocation are O(log n) in the number of free ranges.
+ * A free range which borders on the unreserved top of the heap is returned to it.
+ *
+ * Allocation and deallocation are thread-safe. Kernels may be compiled concurrently (see `compile_all()`),
+ * and compilation allocates code and scratch memory from the heap.
  */
 class HeapManager {
 public:
+  /**
+   * Usage and fragmentation statistics
+   */
+  struct Stats {
+    uint32_t size            = 0;  // Total size of the heap
+    uint32_t used            = 0;  // Bytes in use by allocated arrays
+    uint32_t free            = 0;  // Bytes available for allocation, in free ranges and at the top
+    uint32_t num_free_ranges = 0;
+    uint32_t largest_free    = 0;  // Size of largest block that can be allocated
+
+    float fragmentation() const;
+    std::string dump() const;
+  };
+
   HeapManager();
   HeapManager(HeapManager *object) = delete;
 
   void alloc(uint32_t size_in_bytes);
   uint32_t size() const { return m_size; }
   bool empty() const { return m_offset == 0; }
+  Stats stats() const;
   std::string dump() const;
 
   // Intended for unit tests
-  uint32_t num_free_ranges() const { return (uint32_t) m_free_ranges.size(); }
+  uint32_t num_free_ranges() const { return (uint32_t) m_free_by_addr.size(); }
 
 protected:
   virtual void alloc_mem(uint32_t size_in_bytes);
@@ -37,28 +67,19 @@ private:
   void operator=(HeapManager a);
   void operator=(HeapManager& a);
 
-  uint32_t m_size   = 0;  // Total allocated size of derived heap/buffer object
-  uint32_t m_offset = 0;
-
-  struct FreeRange {
-    uint32_t left  = 0;
-    uint32_t right = 0;
-
-    FreeRange(uint32_t l, uint32_t r) : left(l), right(r) {}  // required by std::vector
-    unsigned size() const;
-    bool empty() const { return size() == 0; }
-
-    bool overlaps(FreeRange const &rhs) const {
-      return !(rhs.left > right || rhs.right < left);
-    }
+  using SizeKey = std::pair<uint32_t, uint32_t>;  // size, offset
 
-    std::string dump() const;
-  };
+  uint32_t m_size   = 0;  // Total allocated size of derived heap/buffer object
+  uint32_t m_offset = 0;  // Start of unreserved space at top of heap
+  uint32_t m_used   = 0;  // Number of bytes currently allocated
+  mutable std::mutex m_mutex;
 
-  std::vector<FreeRange> m_free_ranges;
+  std::map<uint32_t, uint32_t> m_free_by_addr;  // offset -> size of free range
+  std::set<SizeKey>            m_free_by_size;
 
   bool check_available(uint32_t n);
-  void dealloc_array(FreeRange const in_range);
+  void add_free_range(uint32_t offset, uint32_t size);
+  void remove_free_range(std::map<uint32_t, uint32_t>::iterator it);
 };
 
 }  // namespace V3DLib
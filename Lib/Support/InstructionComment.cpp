@@ -54,6 +54,15 @@ void InstructionComment::comment(std::string msg) {
 }
 
 
+/**
+ * Set the comments verbatim, as previously obtained from `header()` and `comment()`
+ */
+void InstructionComment::restore_comments(std::string const &header, std::string const &comment) {
+  m_header  = header;
+  m_comment = comment;
+}
+
+
 std::string InstructionComment::emit_header() const {
   if (m_header.empty()) return "";
 
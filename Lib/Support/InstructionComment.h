@@ -20,6 +20,7 @@ public:
 protected:
   void header(std::string const &msg);
   void comment(std::string msg);
+  void restore_comments(std::string const &header, std::string const &comment);
 
 private:
   std::string m_header;
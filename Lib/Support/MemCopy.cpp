@@ -0,0 +1,285 @@
+#include "MemCopy.h"
+#include <cstdint>
+#include <cstring>   // memcpy
+#include <algorithm> // min
+#include <thread>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "Support/debug.h"
+
+namespace V3DLib {
+namespace {
+
+#ifdef __SSE2__
+
+/**
+ * Copy with non-temporal stores.
+ *
+ * Used for large transfers to shared memory, which will not be read back by the CPU soon.
+ * Streaming past the cache avoids evicting the working set of the host.
+ */
+void stream_copy(void *dst, void const *src, size_t num_bytes) {
+  auto d = (uint8_t *) dst;
+  auto s = (uint8_t const *) src;
+
+  // Align destination to 16 bytes
+  size_t head = (16 - ((uintptr_t) d & 15)) & 15;
+  if (head > num_bytes) head = num_bytes;
+  memcpy(d, s, head);
+  d += head;
+  s += head;
+  num_bytes -= head;
+
+  size_t blocks = num_bytes / 64;
+
+  for (size_t i = 0; i < blocks; ++i) {
+    __m128i a = _mm_loadu_si128((__m128i const *) (s +  0));
+    __m128i b = _mm_loadu_si128((__m128i const *) (s + 16));
+    __m128i c = _mm_loadu_si128((__m128i const *) (s + 32));
+    __m128i e = _mm_loadu_si128((__m128i const *) (s + 48));
+    _mm_stream_si128((__m128i *) (d +  0), a);
+    _mm_stream_si128((__m128i *) (d + 16), b);
+    _mm_stream_si128((__m128i *) (d + 32), c);
+    _mm_stream_si128((__m128i *) (d + 48), e);
+    d += 64;
+    s += 64;
+  }
+
+  _mm_sfence();  // Make streamed stores visible before any following (GPU) access
+
+  memcpy(d, s, num_bytes % 64);
+}
+
+#endif  // __SSE2__
+
+
+// ============================================================================
+// Transpose
+// ============================================================================
+
+int const TILE_SIZE = 32;                     // Tile side in elements; 32x32 floats fit in L1 for src and dst
+int const MIN_ELEMENTS_PER_THREAD = 256*256;  // Below this, starting threads costs more than it gains
+
+
+/**
+ * Scalar transpose of a block within a tile
+ */
+template<typename T>
+inline void transpose_scalar(T *dst, T const *src, int rows, int columns, int r0, int r1, int c0, int c1) {
+  for (int r = r0; r < r1; ++r) {
+    for (int c = c0; c < c1; ++c) {
+      dst[c*rows + r] = src[r*columns + c];
+    }
+  }
+}
+
+
+#if defined(__GNUC__) && !defined(__clang__) && !defined(V3DLIB_NO_SIMD)
+
+typedef uint32_t Vec4 __attribute__((vector_size(4*sizeof(uint32_t))));
+typedef uint32_t Mask4 __attribute__((vector_size(4*sizeof(uint32_t))));
+
+
+/**
+ * Transpose a 4x4 block of 32-bit values in registers.
+ *
+ * The shuffles map onto zip/trn instructions for NEON and unpck instructions for SSE.
+ */
+inline void transpose_4x4(uint32_t *dst, uint32_t const *src, int rows, int columns) {
+  Vec4 a, b, c, d;
+  memcpy(&a, src + 0*columns, sizeof(Vec4));
+  memcpy(&b, src + 1*columns, sizeof(Vec4));
+  memcpy(&c, src + 2*columns, sizeof(Vec4));
+  memcpy(&d, src + 3*columns, sizeof(Vec4));
+
+  Vec4 t0 = __builtin_shuffle(a, b, Mask4{0, 4, 1, 5});  // a0 b0 a1 b1
+  Vec4 t1 = __builtin_shuffle(a, b, Mask4{2, 6, 3, 7});  // a2 b2 a3 b3
+  Vec4 t2 = __builtin_shuffle(c, d, Mask4{0, 4, 1, 5});  // c0 d0 c1 d1
+  Vec4 t3 = __builtin_shuffle(c, d, Mask4{2, 6, 3, 7});  // c2 d2 c3 d3
+
+  Vec4 o0 = __builtin_shuffle(t0, t2, Mask4{0, 1, 4, 5});
+  Vec4 o1 = __builtin_shuffle(t0, t2, Mask4{2, 3, 6, 7});
+  Vec4 o2 = __builtin_shuffle(t1, t3, Mask4{0, 1, 4, 5});
+  Vec4 o3 = __builtin_shuffle(t1, t3, Mask4{2, 3, 6, 7});
+
+  memcpy(dst + 0*rows, &o0, sizeof(Vec4));
+  memcpy(dst + 1*rows, &o1, sizeof(Vec4));
+  memcpy(dst + 2*rows, &o2, sizeof(Vec4));
+  memcpy(dst + 3*rows, &o3, sizeof(Vec4));
+}
+
+
+template<typename T>
+inline void transpose_tile(T *dst, T const *src, int rows, int columns, int r0, int r1, int c0, int c1) {
+  transpose_scalar(dst, src, rows, columns, r0, r1, c0, c1);
+}
+
+
+template<>
+inline void transpose_tile<uint32_t>(uint32_t *dst, uint32_t const *src, int rows, int columns, int r0, int r1, int c0, int c1) {
+  int r4 = r0 + ((r1 - r0) & ~3);
+  int c4 = c0 + ((c1 - c0) & ~3);
+
+  for (int r = r0; r < r4; r += 4) {
+    for (int c = c0; c < c4; c += 4) {
+      transpose_4x4(dst + c*rows + r, src + r*columns + c, rows, columns);
+    }
+  }
+
+  // Edges not covered by 4x4 blocks
+  transpose_scalar(dst, src, rows, columns, r0, r4, c4, c1);
+  transpose_scalar(dst, src, rows, columns, r4, r1, c0, c1);
+}
+
+#else
+
+template<typename T>
+inline void transpose_tile(T *dst, T const *src, int rows, int columns, int r0, int r1, int c0, int c1) {
+  transpose_scalar(dst, src, rows, columns, r0, r1, c0, c1);
+}
+
+#endif  // SIMD
+
+
+/**
+ * Transpose the source rows in range [row_begin, row_end), tile by tile
+ */
+template<typename T>
+void transpose_rows(T *dst, T const *src, int rows, int columns, int row_begin, int row_end) {
+  for (int r0 = row_begin; r0 < row_end; r0 += TILE_SIZE) {
+    int r1 = std::min(r0 + TILE_SIZE, row_end);
+
+    for (int c0 = 0; c0 < columns; c0 += TILE_SIZE) {
+      int c1 = std::min(c0 + TILE_SIZE, columns);
+      transpose_tile(dst, src, rows, columns, r0, r1, c0, c1);
+    }
+  }
+}
+
+
+template<typename T>
+void transpose_typed(void *in_dst, void const *in_src, int rows, int columns, int num_threads) {
+  auto dst = (T *) in_dst;
+  auto src = (T const *) in_src;
+
+  if (num_threads <= 0) {
+    num_threads = (int) std::thread::hardware_concurrency();
+    num_threads = std::min(num_threads, (rows*columns)/MIN_ELEMENTS_PER_THREAD);
+  }
+
+  // Distribute whole tile rows over the threads
+  int tile_rows = (rows + TILE_SIZE - 1)/TILE_SIZE;
+  num_threads = std::max(1, std::min(num_threads, tile_rows));
+
+  if (num_threads == 1) {
+    transpose_rows(dst, src, rows, columns, 0, rows);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < num_threads; ++i) {
+    int begin = std::min(rows, TILE_SIZE*((tile_rows*i)/num_threads));
+    int end   = std::min(rows, TILE_SIZE*((tile_rows*(i + 1))/num_threads));
+
+    threads.emplace_back([=] () {
+      transpose_rows(dst, src, rows, columns, begin, end);
+    });
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+}  // anon namespace
+
+
+/**
+ * Copy a contiguous memory range from the host to shared memory.
+ *
+ * Large copies use non-temporal stores where the platform supports this (currently x86 with SSE2).
+ * Otherwise, this is a plain `memcpy()`, which is already vectorized by the C library.
+ *
+ * Don't use this for copies into host buffers: the host will likely read these soon,
+ * so they should stay in the cache. Use `memcpy()` for these.
+ */
+void bulk_copy(void *dst, void const *src, size_t num_bytes) {
+  if (num_bytes == 0) return;
+  assert(dst != nullptr && src != nullptr);
+
+#ifdef __SSE2__
+  if (num_bytes >= STREAM_COPY_THRESHOLD) {
+    stream_copy(dst, src, num_bytes);
+    return;
+  }
+#endif
+
+  memcpy(dst, src, num_bytes);
+}
+
+
+/**
+ * Copy a 2D block of rows between buffers with different row strides.
+ *
+ * If both buffers are contiguous for the given row size, this is a single copy.
+ *
+ * @param dst_stride  distance in bytes between the starts of consecutive rows in `dst`
+ * @param src_stride  idem for `src`
+ * @param row_bytes   number of bytes to copy per row
+ * @param to_shared   true if `dst` is shared memory. Only then are non-temporal stores used.
+ */
+void copy_strided(void *dst, size_t dst_stride, void const *src, size_t src_stride, size_t row_bytes, size_t num_rows,
+                  bool to_shared) {
+  assert(row_bytes <= dst_stride && row_bytes <= src_stride);
+
+  if (dst_stride == row_bytes && src_stride == row_bytes) {
+    if (to_shared) {
+      bulk_copy(dst, src, row_bytes*num_rows);
+    } else if (row_bytes*num_rows > 0) {
+      memcpy(dst, src, row_bytes*num_rows);
+    }
+    return;
+  }
+
+  auto d = (uint8_t *) dst;
+  auto s = (uint8_t const *) src;
+
+  for (size_t r = 0; r < num_rows; ++r) {
+    memcpy(d, s, row_bytes);
+    d += dst_stride;
+    s += src_stride;
+  }
+}
+
+
+/**
+ * Transpose a row-major 2D array.
+ *
+ * The array is processed in square tiles, so that both the reads and the writes stay
+ * within the cache. For 32-bit elements, the tiles are transposed in 4x4 register blocks.
+ *
+ * @param dst          output, `columns` rows of `rows` elements
+ * @param src          input, `rows` rows of `columns` elements
+ * @param elem_size    size of an element in bytes; 1, 2, 4 or 8
+ * @param num_threads  number of threads to use. If <= 0, determine from array size and number of cores
+ */
+void transpose(void *dst, void const *src, int rows, int columns, size_t elem_size, int num_threads) {
+  assert(dst != nullptr && src != nullptr);
+  assert(dst != src);  // Not in place
+  assert(rows > 0 && columns > 0);
+
+  switch (elem_size) {
+    case 1: transpose_typed<uint8_t >(dst, src, rows, columns, num_threads); break;
+    case 2: transpose_typed<uint16_t>(dst, src, rows, columns, num_threads); break;
+    case 4: transpose_typed<uint32_t>(dst, src, rows, columns, num_threads); break;
+    case 8: transpose_typed<uint64_t>(dst, src, rows, columns, num_threads); break;
+    default:
+      assertq(false, "transpose(): unsupported element size", true);
+      break;
+  }
+}
+
+}  // namespace V3DLib
@@ -0,0 +1,19 @@
+#ifndef _V3DLIB_SUPPORT_MEMCOPY_H_
+#define _V3DLIB_SUPPORT_MEMCOPY_H_
+#include <cstddef>
+
+namespace V3DLib {
+
+/**
+ * Size in bytes above which `bulk_copy()` bypasses the cache, if supported on the platform
+ */
+size_t const STREAM_COPY_THRESHOLD = 256*1024;
+
+void bulk_copy(void *dst, void const *src, size_t num_bytes);
+void copy_strided(void *dst, size_t dst_stride, void const *src, size_t src_stride, size_t row_bytes, size_t num_rows,
+                  bool to_shared);
+void transpose(void *dst, void const *src, int rows, int columns, size_t elem_size, int num_threads = 0);
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_SUPPORT_MEMCOPY_H_
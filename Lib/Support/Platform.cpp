@@ -5,6 +5,7 @@
 #include <string.h>  // strstr()
 #include "defines.h"
 #include "basics.h"
+#include "Common/CompileContext.h"
 
 namespace V3DLib {
 namespace {
@@ -170,7 +171,6 @@ public:
 
   bool is_pi_platform;
   bool m_use_main_memory   = false;
-  bool m_compiling_for_vc4 = true;
 
   std::string output() const;
 };
@@ -261,10 +261,12 @@ void Platform::use_main_memory(bool val) {
  *
  * This is distinct from the platform we are actually running on.
  * The compilation can occur on any platform, including non-pi.
+ *
+ * The setting is part of the current compile context, see `CompileContext`.
  */
-void Platform::compiling_for_vc4(bool val) { instance().m_compiling_for_vc4 = val; }
+void Platform::compiling_for_vc4(bool val) { CompileContext::current().for_vc4 = val; }
 
-bool Platform::compiling_for_vc4() { return instance().m_compiling_for_vc4; }
+bool Platform::compiling_for_vc4() { return CompileContext::current().for_vc4; }
 bool Platform::use_main_memory()   { return instance().m_use_main_memory; }
 std::string Platform::platform_info() { return instance().output(); }
 bool Platform::is_pi_platform()    { return instance().is_pi_platform; }
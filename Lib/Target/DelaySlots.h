@@ -0,0 +1,228 @@
+#ifndef _V3DLIB_TARGET_DELAYSLOTS_H_
+#define _V3DLIB_TARGET_DELAYSLOTS_H_
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "Target/instr/Label.h"
+#include "Support/basics.h"
+
+namespace V3DLib {
+
+/**
+ * Fill branch delay slots with useful instructions.
+ *
+ * A branch is followed by three delay slots, which are executed whether the branch is taken or not.
+ * Initially, these are filled with NOPs. This replaces the NOPs with:
+ *
+ *  - independent instructions from directly before the branch. These would have been executed
+ *    on both paths anyway.
+ *  - for unconditional branches, copies of the first instructions at the branch target.
+ *    The branch is redirected past the copied instructions, with a new label.
+ *
+ * This works on instruction sequences with labels, i.e. before `removeLabels()`.
+ * Instructions inside delay slots are never moved, so that slots of preceding branches stay intact.
+ *
+ * The target-specific details are supplied by `rules`, which must have:
+ *
+ *   - `is_slot_nop(instr)`      - true if instruction is a NOP in a delay slot
+ *   - `is_plain(instr)`         - true if instruction may be put in a delay slot
+ *   - `can_cross(instr)`        - true if plain instructions may be moved past this instruction,
+ *                                 if they do not depend on it. Must hold for plain instructions and NOPs
+ *   - `depends(first, second)`  - true if the relative order of the instructions must be kept
+ *   - `hazard(prev, next)`      - true if `next` may not directly follow `prev`
+ *   - `is_unconditional(instr)` - true if the branch is always taken
+ *   - `nop()`, `label(label)`   - create a NOP or label instruction
+ *   - `retarget(branch, label)` - set the label of a branch
+ *
+ * @return number of delay slots filled
+ */
+template<typename Instructions, typename Rules>
+int fillDelaySlots(Instructions &instrs, Rules const &rules) {
+  using ::operator<<;  // C++ weirdness
+  using Instr = typename std::decay<decltype(instrs[0])>::type;
+
+  int const NUM_SLOTS = 3;
+  int const MAX_SCAN  = 16;  // Max number of instructions before a branch to consider
+
+  std::vector<Instr> v;
+  for (int i = 0; i < (int) instrs.size(); i++) {
+    v.push_back(instrs[i]);
+  }
+
+  auto is_branch = [&v] (int i) -> bool {
+    return 0 <= i && i < (int) v.size() && v[i].is_branch_label();
+  };
+
+  // True if the instruction at given position is in the delay slot of a branch
+  auto in_slot = [&is_branch] (int i) -> bool {
+    return is_branch(i - 1) || is_branch(i - 2) || is_branch(i - 3);
+  };
+
+  // Skip labels, return -1 if no instruction
+  auto first_real = [&v] (int i) -> int {
+    while (i < (int) v.size() && v[i].is_label()) i++;
+    return (i < (int) v.size())? i : -1;
+  };
+
+  auto find_label = [&v] (Label label) -> int {
+    for (int i = 0; i < (int) v.size(); i++) {
+      if (v[i].is_label() && v[i].label() == label) return i;
+    }
+    return -1;
+  };
+
+  int count = 0;
+
+  for (int b = 0; b < (int) v.size(); b++) {
+    if (!is_branch(b)) continue;
+    if (b + NUM_SLOTS >= (int) v.size()) continue;
+
+    bool empty_slots = true;
+    for (int s = 1; s <= NUM_SLOTS; s++) {
+      if (!rules.is_slot_nop(v[b + s])) empty_slots = false;
+    }
+    if (!empty_slots) continue;
+
+    bool unconditional = rules.is_unconditional(v[b]);
+
+    int label_index = find_label(v[b].branch_label());
+    assertq(label_index != -1, "fillDelaySlots(): branch label not found", true);
+    int target = first_real(label_index);
+    int fall   = unconditional? -1 : first_real(b + NUM_SLOTS + 1);
+
+    //
+    // Select independent instructions from before the branch
+    //
+    std::vector<int> sel;  // Selected positions, ascending
+    int w0 = b;            // Lowest position considered
+
+    // Check the rf hazards of the arrangement with given selection and target copies
+    auto valid = [&] (std::vector<int> const &sel, std::vector<int> const &copies) -> bool {
+      std::vector<Instr const *> seq;
+      if (w0 > 0) seq.push_back(&v[w0 - 1]);
+
+      for (int i = w0; i < b; i++) {
+        if (!std::binary_search(sel.begin(), sel.end(), i)) seq.push_back(&v[i]);
+      }
+
+      for (size_t i = 1; i < seq.size(); i++) {
+        if (rules.hazard(*seq[i - 1], *seq[i])) return false;
+      }
+
+      std::vector<Instr const *> slots;
+      for (auto i : sel)    slots.push_back(&v[i]);
+      for (auto i : copies) slots.push_back(&v[i]);
+
+      for (size_t i = 1; i < slots.size(); i++) {
+        if (rules.hazard(*slots[i - 1], *slots[i])) return false;
+      }
+
+      if (slots.empty() || (int) slots.size() < NUM_SLOTS) return true;  // A NOP comes last
+
+      Instr const &last = *slots.back();
+      int next_taken = copies.empty()? target : (copies.back() + 1);
+      if (next_taken != -1 && rules.hazard(last, v[next_taken])) return false;
+      if (fall != -1 && rules.hazard(last, v[fall])) return false;
+
+      return true;
+    };
+
+    for (int j = b - 1; j >= 0 && j >= b - MAX_SCAN; j--) {
+      auto const &instr = v[j];
+      if (instr.is_label() || instr.is_branch() || in_slot(j)) break;
+
+      if (!rules.can_cross(instr)) break;
+      w0 = j;
+
+      bool plain = rules.is_plain(instr);
+
+      if (!plain || (int) sel.size() == NUM_SLOTS) continue;
+
+      bool independent = true;
+      for (int x = j + 1; x < b && independent; x++) {
+        if (std::binary_search(sel.begin(), sel.end(), x)) continue;  // Moves along
+        if (rules.depends(instr, v[x])) independent = false;
+      }
+      if (!independent) continue;
+
+      std::vector<int> tmp = sel;
+      tmp.insert(tmp.begin(), j);
+      if (valid(tmp, {})) sel = tmp;
+    }
+
+    //
+    // For unconditional branches, copy instructions from the branch target
+    //
+    std::vector<int> copies;
+
+    if (unconditional && target != -1) {
+      for (int t = target; t < (int) v.size() && (int) (sel.size() + copies.size()) < NUM_SLOTS; t++) {
+        if (w0 <= t && t <= b + NUM_SLOTS) break;  // Overlaps with current branch
+        if (!rules.is_plain(v[t])) break;
+
+        std::vector<int> tmp = copies;
+        tmp.push_back(t);
+        if (!valid(sel, tmp)) break;
+        copies = tmp;
+      }
+    }
+
+    if (sel.empty() && copies.empty()) continue;
+
+    //
+    // Rearrange
+    //
+    int new_label_at = -1;
+    Label new_label  = -1;
+
+    if (!copies.empty()) {
+      new_label_at = copies.back() + 1;
+      new_label    = freshLabel();
+      rules.retarget(v[b], new_label);
+    }
+
+    std::vector<Instr> ret;
+    int new_b = -1;
+
+    for (int i = 0; i < (int) v.size(); i++) {
+      if (i == new_label_at) ret.push_back(rules.label(new_label));
+      if (std::binary_search(sel.begin(), sel.end(), i)) continue;
+      if (b < i && i <= b + NUM_SLOTS) continue;
+
+      ret.push_back(v[i]);
+
+      if (i == b) {
+        new_b = (int) ret.size() - 1;
+
+        for (auto s : sel) ret.push_back(v[s]);
+
+        for (auto c : copies) {
+          Instr copy = v[c];
+          copy.clear_comments();
+          ret.push_back(copy);
+        }
+
+        for (int s = (int) (sel.size() + copies.size()); s < NUM_SLOTS; s++) {
+          ret.push_back(rules.nop());
+        }
+      }
+    }
+
+    if (new_label_at == (int) v.size()) ret.push_back(rules.label(new_label));
+
+    count += (int) (sel.size() + copies.size());
+    v = ret;
+    b = new_b + NUM_SLOTS;
+  }
+
+  instrs.clear();
+  for (auto const &instr : v) {
+    instrs << instr;
+  }
+
+  return count;
+}
+
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_TARGET_DELAYSLOTS_H_
@@ -1,7 +1,7 @@
 #include "EmuSupport.h"
 #include <cmath>
 #include <cstdio>
-#include <cstring>  // strlen()
+#include <cstring>  // strlen(), memcpy()
 #include "Support/basics.h"
 #include "Target/instr/ALUOp.h"
 #include "Source/Op.h"
@@ -9,13 +9,6 @@
 namespace V3DLib {
 namespace {
 
-// Bitwise rotate-right
-inline int32_t rotRight(int32_t x, int32_t n) {
-  uint32_t ux = (uint32_t) x;
-  return (ux >> n) | (x << (32-n));
-}
-
-
 // Count leading zeros
 inline int32_t clz(int32_t x) {
   int32_t count = 0;
@@ -30,14 +23,149 @@ inline int32_t clz(int32_t x) {
 }
 
 
+
+// ============================================================================
+// Lane-parallel operations
+// ============================================================================
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(V3DLIB_NO_SIMD)
+
 /**
- * Rotate a vector
+ * SIMD back end, using the vector extensions of gcc and clang.
+ *
+ * The compiler maps these onto SSE/AVX2 for x86 and NEON for ARM, depending on the target
+ * flags; a 16-lane vector is split into as many native registers as required.
+ * Define `V3DLIB_NO_SIMD` to use the scalar fallback below.
  */
-Vec rotate(Vec v, int n) {
-  Vec w;
-  for (int i = 0; i < NUM_LANES; i++)
-    w[(i+n) % NUM_LANES] = v[i];
-  return w;
+typedef int32_t  IntLanes   __attribute__((vector_size(NUM_LANES*sizeof(int32_t))));
+typedef uint32_t UIntLanes  __attribute__((vector_size(NUM_LANES*sizeof(uint32_t))));
+typedef float    FloatLanes __attribute__((vector_size(NUM_LANES*sizeof(float))));
+
+inline IntLanes   to_int(FloatLanes const &x) { return __builtin_convertvector(x, IntLanes); }
+inline FloatLanes to_float(IntLanes const &x) { return __builtin_convertvector(x, FloatLanes); }
+
+#else
+
+/**
+ * Scalar fallback, lane by lane.
+ *
+ * Provides the subset of vector extension operations which is used here.
+ * Comparisons return -1 for true and 0 for false, same as the vector extensions.
+ *
+ * The operators are in a separate namespace, so that they don't hide other `operator<<` definitions.
+ * They are found with argument-dependent lookup.
+ */
+namespace scalar {
+
+template<typename T>
+struct Lanes {
+  T v[NUM_LANES];
+
+  T &operator[](int i) { return v[i]; }
+  T  operator[](int i) const { return v[i]; }
+};
+
+#define LANES_BINOP(op)                                                \
+template<typename T>                                                   \
+Lanes<T> operator op(Lanes<T> const &a, Lanes<T> const &b) {           \
+  Lanes<T> r;                                                          \
+  for (int i = 0; i < NUM_LANES; i++) r[i] = (T) (a[i] op b[i]);       \
+  return r;                                                            \
+}
+
+#define LANES_CMPOP(op)                                                \
+template<typename T>                                                   \
+Lanes<int32_t> operator op(Lanes<T> const &a, Lanes<T> const &b) {     \
+  Lanes<int32_t> r;                                                    \
+  for (int i = 0; i < NUM_LANES; i++) r[i] = (a[i] op b[i])? -1 : 0;   \
+  return r;                                                            \
+}
+
+LANES_BINOP(+)
+LANES_BINOP(-)
+LANES_BINOP(*)
+LANES_BINOP(/)
+LANES_BINOP(&)
+LANES_BINOP(|)
+LANES_BINOP(^)
+LANES_BINOP(<<)
+LANES_BINOP(>>)
+LANES_CMPOP(==)
+LANES_CMPOP(!=)
+LANES_CMPOP(<)
+LANES_CMPOP(>)
+
+#undef LANES_BINOP
+#undef LANES_CMPOP
+
+template<typename T>
+Lanes<T> operator~(Lanes<T> const &a) {
+  Lanes<T> r;
+  for (int i = 0; i < NUM_LANES; i++) r[i] = ~a[i];
+  return r;
+}
+
+}  // namespace scalar
+
+typedef scalar::Lanes<int32_t>  IntLanes;
+typedef scalar::Lanes<uint32_t> UIntLanes;
+typedef scalar::Lanes<float>    FloatLanes;
+
+
+inline IntLanes to_int(FloatLanes const &x) {
+  IntLanes r;
+  for (int i = 0; i < NUM_LANES; i++) r[i] = (int32_t) x[i];
+  return r;
+}
+
+
+inline FloatLanes to_float(IntLanes const &x) {
+  FloatLanes r;
+  for (int i = 0; i < NUM_LANES; i++) r[i] = (float) x[i];
+  return r;
+}
+
+#endif  // SIMD back end
+
+static_assert(sizeof(IntLanes) == NUM_LANES*sizeof(Word), "Lanes size must match Vec");
+
+
+/**
+ * Reinterpret the bits of lanes or of a vector as another lane type
+ */
+template<typename T, typename U>
+inline T as(U const &x) {
+  static_assert(sizeof(T) == sizeof(U), "as(): size mismatch");
+  T ret;
+  memcpy((void *) &ret, (void const *) &x, sizeof(T));
+  return ret;
+}
+
+
+/**
+ * Create lanes with all elements set to the given value
+ */
+template<typename T>
+inline T splat(decltype(T{}[0] + 0) val) {
+  T ret;
+  for (int i = 0; i < NUM_LANES; i++) ret[i] = val;
+  return ret;
+}
+
+
+/**
+ * Select lanes from `a` where `mask` is set (-1), from `b` otherwise
+ */
+inline IntLanes select(IntLanes const &mask, IntLanes const &a, IntLanes const &b) {
+  return (a & mask) | (b & ~mask);
+}
+
+
+/**
+ * Convert a lane mask (-1/0) to a condition vector (1/0)
+ */
+inline Vec to_cond(IntLanes const &mask) {
+  return as<Vec>(mask & splat<IntLanes>(1));
 }
 
 }  // anon namespace
@@ -103,11 +231,7 @@ Vec &Vec::operator=(float rhs) {
 
 
 bool Vec::operator==(Vec const &rhs) const {
-  for (int i = 0; i < NUM_LANES; i++) {
-    if ((*this)[i].intVal != rhs[i].intVal) return false;
-  }
-
-  return true;
+  return memcmp(elems, rhs.elems, sizeof(elems)) == 0;
 }
 
 
@@ -139,26 +263,97 @@ std::string Vec::dump() const {
  * Negate a condition vector
  */
 Vec Vec::negate() const {
-  Vec v;
+  return to_cond(as<IntLanes>(*this) == splat<IntLanes>(0));
+}
 
-  for (int i = 0; i < NUM_LANES; i++)
-    v[i].intVal = !elems[i].intVal;
-  return v;
+
+/**
+ * Logical 'and' of two condition vectors
+ */
+Vec Vec::cond_and(Vec const &rhs) const {
+  auto zero = splat<IntLanes>(0);
+  return to_cond((as<IntLanes>(*this) != zero) & (as<IntLanes>(rhs) != zero));
 }
 
 
-Vec Vec::recip() const {
-  Vec ret;
+/**
+ * Logical 'or' of two condition vectors
+ */
+Vec Vec::cond_or(Vec const &rhs) const {
+  auto zero = splat<IntLanes>(0);
+  return to_cond((as<IntLanes>(*this) != zero) | (as<IntLanes>(rhs) != zero));
+}
+
 
+/**
+ * @return true if all elements of current condition vector are set
+ */
+bool Vec::all() const {
   for (int i = 0; i < NUM_LANES; i++) {
-    float a = elems[i].floatVal;
-    ret[i].floatVal = (a != 0)?1/a:0;      // TODO: not sure about value safeguard
+    if (!elems[i].intVal) return false;
   }
 
+  return true;
+}
+
+
+/**
+ * @return true if any element of current condition vector is set
+ */
+bool Vec::any() const {
+  for (int i = 0; i < NUM_LANES; i++) {
+    if (elems[i].intVal) return true;
+  }
+
+  return false;
+}
+
+
+/**
+ * Condition vector of the elements which are zero, as used for the zero flags
+ */
+Vec Vec::zero_flags() const {
+  return to_cond(as<IntLanes>(*this) == splat<IntLanes>(0));
+}
+
+
+/**
+ * Condition vector of the elements which are negative, as used for the negative flags
+ */
+Vec Vec::neg_flags() const {
+  return to_cond(as<IntLanes>(*this) < splat<IntLanes>(0));
+}
+
+
+/**
+ * Assign the elements of `rhs` for which the corresponding element of condition vector `cond` is set
+ */
+void Vec::assign_where(Vec const &cond, Vec const &rhs) {
+  IntLanes mask = as<IntLanes>(cond) != splat<IntLanes>(0);
+  *this = as<Vec>(select(mask, as<IntLanes>(rhs), as<IntLanes>(*this)));
+}
+
+
+/**
+ * Rotate the elements of the vector upward by `n` positions
+ */
+Vec Vec::rotate(int n) const {
+  n = ((n % NUM_LANES) + NUM_LANES) % NUM_LANES;
+
+  Vec ret;
+  memcpy(ret.elems + n, elems, (size_t) (NUM_LANES - n)*sizeof(Word));
+  memcpy(ret.elems, elems + (NUM_LANES - n), (size_t) n*sizeof(Word));
   return ret;
 }
 
 
+Vec Vec::recip() const {
+  auto a = as<FloatLanes>(*this);
+  auto mask = a != splat<FloatLanes>(0);   // TODO: not sure about value safeguard
+  return as<Vec>(select(mask, as<IntLanes>(splat<FloatLanes>(1)/a), splat<IntLanes>(0)));
+}
+
+
 Vec Vec::recip_sqrt() const {
   Vec ret;
 
@@ -194,7 +389,7 @@ Vec Vec::log() const {
 }
 
 
-bool Vec::apply(Op const &op, Vec a, Vec b) {
+bool Vec::apply(Op const &op, Vec const &a, Vec const &b) {
   bool handled = true;
 
   switch (op.op) {
@@ -210,58 +405,66 @@ bool Vec::apply(Op const &op, Vec a, Vec b) {
 }
 
 
-bool Vec::apply(ALUOp const &op, Vec a, Vec b) {
-  bool handled = true;
+/**
+ * Apply the given ALU operation on the elements of `a` and `b`, with the result stored in current.
+ *
+ * `a` and `b` may refer to current.
+ */
+bool Vec::apply(ALUOp const &op, Vec const &a, Vec const &b) {
   if (op.value() == ALUOp::NOP) return true;
 
-  // Floating-point operations
-  for (int i = 0; i < NUM_LANES; i++) {
-    float  x = a[i].floatVal;
-    float  y = b[i].floatVal;
-    float &d = elems[i].floatVal;
-
-    switch (op.value()) {
-    case ALUOp::A_FADD:    d = x+y;                       break;
-    case ALUOp::A_FSUB:    d = x-y;                       break;
-    case ALUOp::A_FMIN:    d = x<y?x:y;                   break;
-    case ALUOp::A_FMAX:    d = x>y?x:y;                   break;
-    case ALUOp::A_FMINABS: d = fabs(x) < fabs(y) ? x : y; break; // min of absolute values
-    case ALUOp::A_FMAXABS: d = fabs(x) > fabs(y) ? x : y; break; // max of absolute values
-    case ALUOp::A_FtoI:    elems[i].intVal = (int) x;     break;
-    case ALUOp::A_ItoF:    d = (float) a[i].intVal;       break;
-    case ALUOp::M_FMUL:    d = x*y;                       break;
+  auto const x  = as<IntLanes>(a);
+  auto const y  = as<IntLanes>(b);
+  auto const ux = as<UIntLanes>(a);
+  auto const uy = as<UIntLanes>(b);
+  auto const fx = as<FloatLanes>(a);
+  auto const fy = as<FloatLanes>(b);
 
-    default:
-      handled = false;
-      break;
-    }
-  }
+  auto abs_val = [] (IntLanes const &v) -> FloatLanes {
+    return as<FloatLanes>(v & splat<IntLanes>(0x7fffffff));
+  };
 
-  if (handled) return handled;
-  handled = true;
+  auto set = [this] (auto const &lanes) {
+    *this = as<Vec>(lanes);
+  };
 
-  // Integer operations
-  for (int i = 0; i < NUM_LANES; i++) {
-    int  x = a[i].intVal;
-    int  y = b[i].intVal;
-    int &d = elems[i].intVal;
-
-    switch (op.value()) {
-    case ALUOp::A_ADD:   d = x+y;            break;
-    case ALUOp::A_SUB:   d = x-y;            break;
-    case ALUOp::A_ROR:   d = rotRight(x, y); break;
-    case ALUOp::A_SHL:   d = x<<y;           break;
-    case ALUOp::A_SHR:   d = (int32_t) (((uint32_t) x) >> y); break;
-    case ALUOp::A_ASR:   d = x >> y; break;
-    case ALUOp::A_MIN:   d = x<y?x:y;        break;
-    case ALUOp::A_MAX:   d = x>y?x:y;        break;
-    case ALUOp::A_BAND:  d = x&y;            break;
-    case ALUOp::A_BOR:   d = x|y;            break;
-    case ALUOp::A_BXOR:  d = x^y;            break;
-    case ALUOp::A_BNOT:  d = ~x; break;
-    case ALUOp::M_MUL24: d = (x&0xffffff)*(y&0xffffff); break; // Integer multiply (24-bit)
-
-    case ALUOp::A_CLZ:    d = clz(x);         break; // Count leading zeros
+  switch (op.value()) {
+    // Floating-point operations
+    case ALUOp::A_FADD:    set(fx + fy);                                break;
+    case ALUOp::A_FSUB:    set(fx - fy);                                break;
+    case ALUOp::A_FMIN:    set(select(fx < fy, x, y));                  break;
+    case ALUOp::A_FMAX:    set(select(fx > fy, x, y));                  break;
+    case ALUOp::A_FMINABS: set(select(abs_val(x) < abs_val(y), x, y));  break; // min of absolute values
+    case ALUOp::A_FMAXABS: set(select(abs_val(x) > abs_val(y), x, y));  break; // max of absolute values
+    case ALUOp::A_FtoI:    set(to_int(fx));                             break;
+    case ALUOp::A_ItoF:    set(to_float(x));                            break;
+    case ALUOp::M_FMUL:    set(fx * fy);                                break;
+
+    // Integer operations
+    // Signed arithmetic is done unsigned, to get wraparound without UB
+    case ALUOp::A_ADD:   set(ux + uy);                                          break;
+    case ALUOp::A_SUB:   set(ux - uy);                                          break;
+    case ALUOp::A_ROR:   set((ux >> uy) | (ux << (splat<UIntLanes>(32) - uy))); break;
+    case ALUOp::A_SHL:   set(ux << uy);                                         break;
+    case ALUOp::A_SHR:   set(ux >> uy);                                         break;
+    case ALUOp::A_ASR:   set(x >> y);                                           break;
+    case ALUOp::A_MIN:   set(select(x < y, x, y));                              break;
+    case ALUOp::A_MAX:   set(select(x > y, x, y));                              break;
+    case ALUOp::A_BAND:  set(x & y);                                            break;
+    case ALUOp::A_BOR:   set(x | y);                                            break;
+    case ALUOp::A_BXOR:  set(x ^ y);                                            break;
+    case ALUOp::A_BNOT:  set(~x);                                               break;
+    case ALUOp::M_MUL24: {  // Integer multiply (24-bit)
+      auto mask = splat<UIntLanes>(0xffffff);
+      set((ux & mask)*(uy & mask));
+    }
+    break;
+
+    case ALUOp::A_CLZ:    // Count leading zeros
+      for (int i = 0; i < NUM_LANES; i++) {
+        elems[i].intVal = clz(a[i].intVal);
+      }
+      break;
 
     case ALUOp::A_V8ADDS:
     case ALUOp::A_V8SUBS:
@@ -276,32 +479,19 @@ bool Vec::apply(ALUOp const &op, Vec a, Vec b) {
     }
     break;
 
-    default:
-      handled = false;
-      break;
-    }
-  }
-
-  if (handled) return handled;
-  handled = true;
-
-  // Other operations
-  switch (op.value()) {
+    // Other operations
     case ALUOp::M_ROTATE: { // Vector rotation
       assert(b.is_uniform());
-      int n = b[0].intVal;
-
-      assign(rotate(a,n));
+      *this = a.rotate(b[0].intVal);
     }
     break;
 
     default:
-      handled = false;
-    break;
+      assertq(false, "Vec::apply(): Unhandled op value");
+      return false;
   }
 
-  assertq(handled, "Vec::apply(): Unhandled op value");
-  return handled;
+  return true;
 }
 
 
@@ -321,12 +511,6 @@ bool Vec::is_uniform() const {
 }
 
 
-void Vec::assign(Vec const &rhs) {
-  for (int i = 0; i < NUM_LANES; i++) {
-    elems[i] = rhs[i];
-  }
-}
-
 
 ///////////////////////////////////////////////////////////////////////////////
 // Class EmuState
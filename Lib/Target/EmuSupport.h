@@ -34,7 +34,7 @@ struct Vec {
   Vec(Imm imm);
   Vec(std::vector<int> const &rhs);
 
-  Vec &operator=(Vec const &rhs) { assign(rhs); return *this; }
+  Vec &operator=(Vec const &rhs) = default;
   Vec &operator=(int rhs);
   Vec &operator=(float rhs);
 
@@ -58,10 +58,20 @@ struct Vec {
   }
 
   std::string dump() const;
-  Vec negate() const;
-  bool apply(Op const &op, Vec a, Vec b);
-  bool apply(ALUOp const &op, Vec a, Vec b);
+  bool apply(Op const &op, Vec const &a, Vec const &b);
+  bool apply(ALUOp const &op, Vec const &a, Vec const &b);
   bool is_uniform() const;
+  Vec rotate(int n) const;
+
+  // Operations on condition vectors, elements are 0 (false) or 1 (true)
+  Vec negate() const;
+  Vec cond_and(Vec const &rhs) const;
+  Vec cond_or(Vec const &rhs) const;
+  bool all() const;
+  bool any() const;
+  Vec zero_flags() const;
+  Vec neg_flags() const;
+  void assign_where(Vec const &cond, Vec const &rhs);
 
   Vec recip() const;
   Vec recip_sqrt() const;
@@ -70,8 +80,6 @@ struct Vec {
 
 private:
   Word elems[NUM_LANES];
-
-  void assign(Vec const &rhs);
 };
 
 
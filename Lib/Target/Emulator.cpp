@@ -1,6 +1,14 @@
 #include "Target/Emulator.h"
 #include <cmath>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <condition_variable>
 #include "Support/basics.h"  // fatal()
+#include "LibSettings.h"
 #include "EmuSupport.h"
 #include "Common/SharedArray.h"
 #include "Target/SmallLiteral.h"
@@ -32,7 +40,7 @@ public:
   /**
    * @return true if input handled, false otherwise
    */
-  bool writeReg(Reg dest, Vec v) {
+  bool writeReg(Reg dest, Vec const &v) {
     if (dest.tag != SPECIAL) return false;
     bool handled = true;
 
@@ -75,6 +83,39 @@ private:
 };
 
 
+int const NUM_ACCS = 6;
+
+
+/**
+ * Index of a register in the register block of a QPU.
+ *
+ * The register block contains the accumulators, followed by register file A,
+ * followed by register file B.
+ *
+ * @return index of register, -1 if register is not an accumulator or in a register file
+ */
+int reg_slot(Reg reg, int size_regfile) {
+  int r = reg.regId;
+
+  switch (reg.tag) {
+    case ACC:
+      assert(r >= 0 && r < NUM_ACCS);
+      return r;
+
+    case REG_A:
+      assert(r >= 0 && r < size_regfile);
+      return NUM_ACCS + r;
+
+    case REG_B:
+      assert(r >= 0 && r < size_regfile);
+      return NUM_ACCS + size_regfile + r;
+
+    default:
+      return -1;
+  }
+}
+
+
 // State of a single QPU.
 struct QPUState {
   int id = 0;                          // QPU id
@@ -86,13 +127,12 @@ struct QPUState {
 
   bool running = false;                // Is QPU active, or has it halted?
   int pc = 0;                          // Program counter
-  Vec* regFileA = nullptr;             // Register file A
-  int sizeRegFileA = 0;                // (and size)
-  Vec* regFileB = nullptr;             // Register file B
-  int sizeRegFileB = 0;                // (and size)
-  Vec accum[6];                        // Accumulator registers
-  bool negFlags[NUM_LANES];            // Negative flags
-  bool zeroFlags[NUM_LANES];           // Zero flags
+  int branch_target = -1;              // pc to jump to after the branch delay slots
+  int delay_slots = 0;                 // Number of delay slots still to execute for a taken branch
+  Vec* regs = nullptr;                 // Register block, see `reg_slot()`
+  int sizeRegFile = 0;                 // Size of each of register files A and B
+  Vec negFlags;                        // Negative flags, as condition vector
+  Vec zeroFlags;                       // Zero flags, as condition vector
 
   DMAAddr dmaLoad;                     // DMA load address
   DMAAddr dmaStore;                    // DMA store address
@@ -106,47 +146,140 @@ struct QPUState {
   QPUState() {
     dmaLoad.active     = false;
     dmaStore.active    = false;
-    for (int i = 0; i < NUM_LANES; i++) negFlags[i] = false;
-    for (int i = 0; i < NUM_LANES; i++) zeroFlags[i] = false;
   }
 
 
   ~QPUState() {
-    delete [] regFileA;
-    delete [] regFileB;
+    delete [] regs;
   }
 
-  void init(int maxReg) {
+  void init(int size_regfile) {
     running            = true;
-    regFileA           = new Vec [maxReg+1];
-    sizeRegFileA       = maxReg+1;
-    regFileB           = new Vec [maxReg+1];
-    sizeRegFileB       = maxReg+1;
+    sizeRegFile        = size_regfile;
+    regs               = new Vec [NUM_ACCS + 2*sizeRegFile];
+  }
+
+  Vec &reg(Reg const &r) {
+    int slot = reg_slot(r, sizeRegFile);
+    assert(slot != -1);
+    return regs[slot];
   }
 
   void upkeep() {
-    sfu.upkeep(accum[4]);
+    sfu.upkeep(regs[4]);  // ACC4
+  }
+
+  /**
+   * Take a branch.
+   *
+   * The jump happens after the three delay slots following the branch have been executed.
+   */
+  void branch(int target) {
+    assertq(delay_slots == 0, "Branch in delay slot of another branch", true);
+    branch_target = target;
+    delay_slots   = 3;
   }
 };
 
 
 /**
  * State of the VideoCore
+ *
+ * When running in parallel, each QPU runs on its own thread. The VPM, the heap
+ * and the semaphores are then shared between threads; access to these is
+ * serialized with `mutex`. All other state is local to a QPU.
  */
 struct State : public EmuState {
   QPUState qpu[MAX_QPUS];  // State of each QPU
   Data emuHeap;
 
-  State(int in_num_qpus, IntList const &in_uniforms) : EmuState(in_num_qpus, in_uniforms, true) {}
+  bool const parallel;
+  std::mutex mutex;                      // Guards VPM, heap and semaphores
+  std::condition_variable sema_changed;  // Signalled on every semaphore update
+  std::atomic<bool> aborted{false};      // Set if a QPU thread threw
+  std::exception_ptr error;              // First exception thrown by a QPU thread
+
+  State(int in_num_qpus, IntList const &in_uniforms, bool in_parallel) :
+    EmuState(in_num_qpus, in_uniforms, true),
+    parallel(in_parallel)
+  {}
+
+  bool sema_op(Instr const &instr);
+  void abort(std::exception_ptr e);
+};
+
+
+/**
+ * Scoped lock on the resources shared between QPUs.
+ *
+ * Does nothing if the emulator is running sequentially.
+ */
+class SharedLock {
+public:
+  SharedLock(State &state) : m_lock(state.mutex, std::defer_lock) {
+    if (state.parallel) m_lock.lock();
+  }
+
+private:
+  std::unique_lock<std::mutex> m_lock;
 };
 
 
+/**
+ * Perform a semaphore operation.
+ *
+ * In sequential mode, a semaphore operation that can not proceed is retried
+ * on the next round of the emulator.
+ * In parallel mode, the calling thread blocks until the operation succeeds.
+ *
+ * @return true if the instruction needs to be retried, false otherwise
+ */
+bool State::sema_op(Instr const &instr) {
+  assert(instr.tag == SINC || instr.tag == SDEC);
+
+  auto try_op = [this, &instr] () -> bool {
+    return (instr.tag == SINC)? sema_inc(instr.semaId) : sema_dec(instr.semaId);
+  };
+
+  if (!parallel) {
+    return try_op();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  bool done = sema_changed.wait_for(lock, std::chrono::seconds(LibSettings::qpu_timeout()), [this, &try_op] {
+    return aborted || !try_op();
+  });
+
+  assertq(done, "Semaphore wait timed out in parallel emulator");
+  sema_changed.notify_all();
+  return false;
+}
+
+
+/**
+ * Register the exception thrown on a QPU thread and notify the other threads.
+ */
+void State::abort(std::exception_ptr e) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!error) error = e;
+  aborted = true;
+  sema_changed.notify_all();
+}
+
+
 Vec DMA_readReg(QPUState* s, State* g, Reg reg, bool &handled) {
   assert(reg.tag == SPECIAL);
 
   Vec v(0);
   handled = true;
 
+  if (reg.regId != SPECIAL_VPM_READ && reg.regId != SPECIAL_DMA_LD_WAIT && reg.regId != SPECIAL_DMA_ST_WAIT) {
+    handled = false;
+    return v;
+  }
+
+  SharedLock lock(*g);
+
   switch (reg.regId) {
       case SPECIAL_VPM_READ: {
         // Make sure there's a VPM load request waiting
@@ -261,7 +394,6 @@ Vec DMA_readReg(QPUState* s, State* g, Reg reg, bool &handled) {
  * Read a vector register
  */
 Vec readReg(QPUState* s, State* g, Reg reg) {
-  int r = reg.regId;
   Vec v(0);
 
   switch (reg.tag) {
@@ -269,16 +401,9 @@ Vec readReg(QPUState* s, State* g, Reg reg) {
       return v;
 
     case REG_A:
-      assert(r >= 0 && r < s->sizeRegFileA);
-      return s->regFileA[r];
-
     case REG_B:
-      assert(r >= 0 && r < s->sizeRegFileB);
-      return s->regFileB[reg.regId];
-
     case ACC:
-      assert(r >= 0 && r <= 5);
-      return s->accum[r];
+      return s->reg(reg);
 
     case SPECIAL:
       if (reg.regId == SPECIAL_ELEM_NUM) {
@@ -311,27 +436,20 @@ Vec readReg(QPUState* s, State* g, Reg reg) {
 // Check condition flags
 // ============================================================================
 
-// Given an assignment condition and an vector index, determine if the
-// condition is true at that index using the implicit condition flags.
-
-inline bool checkAssignCond(QPUState* s, AssignCond cond, int i) {
-  using Tag = AssignCond::Tag;
-
-  switch (cond.tag) {
-    case Tag::NEVER:  return false;
-    case Tag::ALWAYS: return true;
-    case Tag::FLAG:
-      switch (cond.flag) {
-        case ZS: return  s->zeroFlags[i];
-        case ZC: return !s->zeroFlags[i];
-        case NS: return  s->negFlags[i];
-        case NC: return !s->negFlags[i];
-      }
+/**
+ * Get the condition vector for the given flag, using the implicit condition flags.
+ */
+inline Vec flagCond(QPUState const *s, Flag flag) {
+  switch (flag) {
+    case ZS: return s->zeroFlags;
+    case ZC: return s->zeroFlags.negate();
+    case NS: return s->negFlags;
+    case NC: return s->negFlags.negate();
   }
 
   // Unreachable
   assert(false);
-  return false;
+  return Vec();
 }
 
 
@@ -340,35 +458,11 @@ inline bool checkAssignCond(QPUState* s, AssignCond cond, int i) {
  * the implicit condition flags.
  */
 inline bool checkBranchCond(QPUState* s, BranchCond cond) {
-  bool bools[NUM_LANES];
-
-  auto set_bools = [&bools] (QPUState *s, BranchCond const &cond) {
-    for (int i = 0; i < NUM_LANES; i++)
-      switch (cond.flag) {
-        case ZS: bools[i] =  s->zeroFlags[i]; break;
-        case ZC: bools[i] = !s->zeroFlags[i]; break;
-        case NS: bools[i] =  s->negFlags[i];  break;
-        case NC: bools[i] = !s->negFlags[i];  break;
-        default: assert(false); break;
-      }
-  };
-
   switch (cond.tag) {
     case BranchCond::COND_ALWAYS: return true;
-    case BranchCond::COND_NEVER: return false;
-    case BranchCond::COND_ALL:
-      set_bools(s, cond);
-
-      for (int i = 0; i < NUM_LANES; i++)
-        if (!bools[i]) return false;
-      return true;
-
-    case BranchCond::COND_ANY:
-      set_bools(s, cond);
-
-      for (int i = 0; i < NUM_LANES; i++)
-        if (bools[i]) return true;
-      return false;
+    case BranchCond::COND_NEVER:  return false;
+    case BranchCond::COND_ALL:    return flagCond(s, cond.flag).all();
+    case BranchCond::COND_ANY:    return flagCond(s, cond.flag).any();
 
     default:
       assertq(false, "checkBranchCond(): unexpected value");
@@ -377,39 +471,57 @@ inline bool checkBranchCond(QPUState* s, BranchCond cond) {
 }
 
 
+/**
+ * Write the lanes of a vector selected by the assignment condition
+ *
+ * @param w  register to write to; if null, only the flags are updated
+ */
+void writeLanes(QPUState* s, Vec *w, bool setFlags, AssignCond cond, Vec const &v) {
+  using Tag = AssignCond::Tag;
+
+  switch (cond.tag) {
+    case Tag::NEVER:
+      return;
+
+    case Tag::ALWAYS:
+      if (w != nullptr) *w = v;
+
+      if (setFlags) {
+        s->zeroFlags = v.zero_flags();
+        s->negFlags  = v.neg_flags();
+      }
+      return;
+
+    case Tag::FLAG: {
+      Vec mask = flagCond(s, cond.flag);
+      if (w != nullptr) w->assign_where(mask, v);
+
+      if (setFlags) {
+        s->zeroFlags.assign_where(mask, v.zero_flags());
+        s->negFlags.assign_where(mask, v.neg_flags());
+      }
+    }
+    return;
+  }
+
+  // Unreachable
+  assert(false);
+}
+
+
 /**
  * Write a vector to a register
  */
-void writeReg(QPUState* s, State* g, bool setFlags, AssignCond cond, Reg dest, Vec v) {
+void writeReg(QPUState* s, State* g, bool setFlags, AssignCond cond, Reg dest, Vec const &v) {
   switch (dest.tag) {
     case REG_A:
     case REG_B:
     case ACC:
-    case NONE:
-      Vec* w;
-
-      if (dest.tag == REG_A) {
-        assert(dest.regId >= 0 && dest.regId < s->sizeRegFileA);
-        w = &s->regFileA[dest.regId];
-      } else if (dest.tag == REG_B) {
-        assert(dest.regId >= 0 && dest.regId < s->sizeRegFileB);
-        w = &s->regFileB[dest.regId];
-      } else if (dest.tag == ACC) {
-        assert(dest.regId >= 0 && dest.regId <= 5);
-        w = &s->accum[dest.regId];
-      }
-      
-      for (int i = 0; i < NUM_LANES; i++)
-        if (checkAssignCond(s, cond, i)) {
-          Word x = v[i];
-          if (dest.tag != NONE) w->get(i) = x;
-
-          if (setFlags) {
-            s->zeroFlags[i] = x.intVal == 0;
-            s->negFlags[i]  = x.intVal < 0;
-          }
-        }
+      writeLanes(s, &s->reg(dest), setFlags, cond, v);
+      return;
 
+    case NONE:
+      writeLanes(s, nullptr, setFlags, cond, v);
       return;
 
     case SPECIAL:
@@ -481,6 +593,7 @@ void writeReg(QPUState* s, State* g, bool setFlags, AssignCond cond, Reg dest, V
         }
 
         case SPECIAL_VPM_WRITE: {
+          SharedLock lock(*g);
           VPMStoreReq* req = &s->vpmStoreSetup;
           if (req->hor) {
             // Horizontal store
@@ -525,6 +638,7 @@ void writeReg(QPUState* s, State* g, bool setFlags, AssignCond cond, Reg dest, V
 
         case SPECIAL_TMU0_S: {
           assert(s->loadBuffer.size() < 4);
+          SharedLock lock(*g);
           Vec val;
           for (int i = 0; i < NUM_LANES; i++) {
             uint32_t a = (uint32_t) v[i].intVal;
@@ -576,32 +690,406 @@ Vec readRegOrImm(QPUState* s, State &state, RegOrImm const &src) {
 }
 
 
+// ============================================================================
+// Pre-decoded program
+// ============================================================================
+
+namespace emu {
+
+struct MicroOp;
+
+}  // namespace emu
+
+namespace {
+
+using emu::MicroOp;
+using Handler = void (*)(State &state, QPUState *s, MicroOp const &op);
+
+
+/**
+ * Source operand of a micro-op
+ *
+ * Either a register in the register block of the QPU, or a value fixed at decode time.
+ */
+struct Operand {
+  int slot = -1;                // Slot in register block, if operand is a register
+  Vec const *value = nullptr;   // Pre-decoded value, if operand is constant
+
+  bool is_set() const { return slot != -1 || value != nullptr; }
+  Vec const &read(QPUState const *s) const { return (value != nullptr)? *value : s->regs[slot]; }
+};
+
+}  // anon namespace
+
+
+namespace emu {
+
+/**
+ * Single instruction of the pre-decoded program
+ *
+ * Instructions which can not be fully resolved at decode time, e.g. because
+ * they access special registers, are handled by `exec_generic()`, which
+ * interprets the original instruction.
+ */
+struct MicroOp {
+  Handler exec = nullptr;
+  Instr const *instr = nullptr;  // Original instruction
+
+  ALUOp op;
+  Operand srcA;
+  Operand srcB;
+  int dest = -1;                 // Slot of destination register, -1 if no register is written
+  bool set_flags = false;
+  AssignCond cond;
+
+  BranchCond branch_cond;
+  int target = -1;               // Branch target, pc value
+};
+
+
+/**
+ * Target code lowered to micro-ops for the emulator.
+ *
+ * Decoding is done once per kernel; the same program can be run any number of times.
+ */
+class Program {
+public:
+  Program(Instr::List const &instrs, int maxReg);
+  Program(Program const &rhs) = delete;
+
+  int size_regfile() const { return m_size_regfile; }
+  int size() const { return (int) m_ops.size(); }
+
+  MicroOp const &op(int pc) const {
+    assert(0 <= pc && pc < size());
+    return m_ops[pc];
+  }
+
+private:
+  Instr::List m_instrs;         // Local copy, micro-ops point into this
+  int m_size_regfile = 0;
+  std::vector<MicroOp> m_ops;
+  std::deque<Vec> m_constants;  // deque, so that pointers to elements stay valid
+
+  Vec const *constant(Vec const &v);
+  bool decode_src(RegOrImm const &src, Operand &dst);
+  void decode(int pc);
+};
+
+}  // namespace emu
+
+
+namespace {
+
+/**
+ * Execute original instruction of micro-op.
+ *
+ * This is the fallback for everything which is not pre-decoded.
+ */
+void exec_generic(State &state, QPUState *s, MicroOp const &op) {
+  auto ALWAYS = AssignCond::Tag::ALWAYS;
+  Instr const &instr = *op.instr;
+
+  if (instr.break_point()) {
+#ifdef DEBUG
+    printf("Emulator: hit breakpoint\n");
+    breakpoint
+#endif
+  }
+
+  switch (instr.tag) {
+    case LI: {
+      Vec imm(instr.LI.imm);
+      writeReg(s, &state, instr.set_cond().flags_set(), instr.assign_cond(), instr.dest(), imm);
+    }
+    break;
+
+    case ALU:
+    if (!instr.ALU.op.isNOP()) {
+      Vec a;
+      Vec b;
+
+      if (instr.isUniformLoad()) {
+        a = state.get_uniform(s->id, s->nextUniform);
+        b = a; 
+      } else {
+        a = readRegOrImm(s, state, instr.ALU.srcA);
+        b = readRegOrImm(s, state, instr.ALU.srcB);
+      }
+
+      Vec result;
+      result.apply(instr.ALU.op, a, b);
+
+      writeReg(s, &state, instr.set_cond().flags_set(), instr.assign_cond(), instr.dest(), result);
+    }
+    break;
+
+    case BR: {  // Branch to target
+      if (checkBranchCond(s, instr.branch_cond())) {
+        BranchTarget t = instr.branch_target();
+        if (t.relative && !t.useRegOffset) {
+          s->branch(s->pc + 3 + t.immOffset);
+        } else {
+          fatal("V3DLib: found unsupported form of branch target");
+        }
+      }
+    }
+    break;
+
+    case RECV: {                             // receive load-via-TMU response
+      assert(s->loadBuffer.size() > 0);
+      Vec val = s->loadBuffer.remove(0);
+      AssignCond always;
+      always.tag = ALWAYS;
+      writeReg(s, &state, false, always, instr.dest(), val);
+    }
+    break;
+
+    case SINC:
+    case SDEC:
+      if (state.sema_op(instr)) s->pc--;
+      break;
+
+    case END:                                // End program (halt)
+      s->running = false;
+      break;
+
+    case BRL:                                // Branch to label
+    case LAB:                                // Label
+      fatal("V3DLib: emulator does not support labels");
+      // Fall-thru
+    case NO_OP:
+    case IRQ:
+    case INIT_BEGIN:
+    case INIT_END:
+      break;  // ignore
+
+    default: assert(false);
+  }
+}
+
+
+void exec_nop(State &state, QPUState *s, MicroOp const &op) {}
+
+
+void exec_li(State &state, QPUState *s, MicroOp const &op) {
+  writeLanes(s, (op.dest == -1)? nullptr : &s->regs[op.dest], op.set_flags, op.cond, *op.srcA.value);
+}
+
+
+void exec_alu(State &state, QPUState *s, MicroOp const &op) {
+  Vec result;
+  result.apply(op.op, op.srcA.read(s), op.srcB.read(s));
+  writeLanes(s, (op.dest == -1)? nullptr : &s->regs[op.dest], op.set_flags, op.cond, result);
+}
+
+
+void exec_uniform(State &state, QPUState *s, MicroOp const &op) {
+  Vec a = state.get_uniform(s->id, s->nextUniform);
+  Vec result;
+  result.apply(op.op, a, a);
+  writeLanes(s, (op.dest == -1)? nullptr : &s->regs[op.dest], op.set_flags, op.cond, result);
+}
+
+
+void exec_branch(State &state, QPUState *s, MicroOp const &op) {
+  if (checkBranchCond(s, op.branch_cond)) {
+    s->branch(op.target);
+  }
+}
+
+
+void exec_recv(State &state, QPUState *s, MicroOp const &op) {
+  assert(s->loadBuffer.size() > 0);
+  s->regs[op.dest] = s->loadBuffer.remove(0);
+}
+
+
+void exec_end(State &state, QPUState *s, MicroOp const &op) {
+  s->running = false;
+}
+
+}  // anon namespace
+
+
+namespace emu {
+
+/**
+ * @param maxReg  Max reg id used. Register files are sized to hold at least this many registers.
+ */
+Program::Program(Instr::List const &instrs, int maxReg) :
+  m_instrs(instrs),
+  m_size_regfile(maxReg + 1),
+  m_ops(instrs.size())
+{
+  // After register allocation, register id's are hardware register numbers,
+  // which may exceed maxReg. Make sure these fit as well.
+  for (int pc = 0; pc < m_instrs.size(); pc++) {
+    Instr const &instr = m_instrs[pc];
+    auto fit = [this] (Reg const &r) {
+      if ((r.tag == REG_A || r.tag == REG_B) && r.regId >= m_size_regfile) {
+        m_size_regfile = r.regId + 1;
+      }
+    };
+
+    if (instr.has_dest()) fit(instr.dest());
+    for (auto const &r : instr.src_regs()) fit(r);
+  }
+
+  for (int pc = 0; pc < m_instrs.size(); pc++) {
+    decode(pc);
+  }
+}
+
+
+Vec const *Program::constant(Vec const &v) {
+  m_constants.push_back(v);
+  return &m_constants.back();
+}
+
+
+/**
+ * Resolve a source operand
+ *
+ * @return true if operand could be resolved, false otherwise
+ */
+bool Program::decode_src(RegOrImm const &src, Operand &dst) {
+  if (src.is_imm()) {
+    dst.value = constant(Vec(decodeSmallLit(src.imm().val).intVal));
+    return true;
+  }
+
+  Reg reg = src.reg();
+
+  if (reg.tag == NONE) {
+    dst.value = constant(Vec(0));
+  } else if (reg.tag == SPECIAL && reg.regId == SPECIAL_ELEM_NUM) {
+    dst.value = &EmuState::index_vec;
+  } else {
+    dst.slot = reg_slot(reg, m_size_regfile);
+  }
+
+  return dst.is_set();
+}
+
+
+/**
+ * Lower a single instruction to a micro-op
+ *
+ * Anything that can not be resolved here is left to `exec_generic()`.
+ */
+void Program::decode(int pc) {
+  Instr const &instr = m_instrs.get(pc);
+  MicroOp &op = m_ops[pc];
+
+  op.instr = &instr;
+  op.exec  = exec_generic;
+
+  if (instr.break_point()) return;
+
+  auto decode_dest = [this, &instr, &op] () -> bool {
+    op.set_flags = instr.set_cond().flags_set();
+    op.cond      = instr.assign_cond();
+
+    Reg dest = instr.dest();
+    if (dest.tag == NONE) return true;
+
+    op.dest = reg_slot(dest, m_size_regfile);
+    return (op.dest != -1);
+  };
+
+  switch (instr.tag) {
+    case LI:
+      if (decode_dest()) {
+        op.srcA.value = constant(Vec(instr.LI.imm));
+        op.exec = exec_li;
+      }
+      break;
+
+    case ALU:
+      op.op = instr.ALU.op;
+
+      if (op.op.isNOP()) {
+        op.exec = exec_nop;
+      } else if (!decode_dest()) {
+        break;
+      } else if (instr.isUniformLoad()) {
+        op.exec = exec_uniform;
+      } else if (decode_src(instr.ALU.srcA, op.srcA) && decode_src(instr.ALU.srcB, op.srcB)) {
+        op.exec = exec_alu;
+      }
+      break;
+
+    case BR: {
+      BranchTarget t = instr.branch_target();
+      if (t.relative && !t.useRegOffset) {
+        op.branch_cond = instr.branch_cond();
+        op.target      = pc + 1 + 3 + t.immOffset;
+        op.exec        = exec_branch;
+      }
+    }
+    break;
+
+    case RECV:
+      op.dest = reg_slot(instr.dest(), m_size_regfile);
+      if (op.dest != -1) {
+        op.exec = exec_recv;
+      }
+      break;
+
+    case END:
+      op.exec = exec_end;
+      break;
+
+    case NO_OP:
+    case IRQ:
+    case INIT_BEGIN:
+    case INIT_END:
+      op.exec = exec_nop;
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+std::shared_ptr<Program> decode(Instr::List const &instrs, int maxReg) {
+  return std::make_shared<Program>(instrs, maxReg);
+}
+
+}  // namespace emu
+
+
 // ============================================================================
 // Emulator
 // ============================================================================
 
+namespace {
+
 /**
- * @param numQPUs   Number of QPUs active
- * @param instrs    Instruction sequence
- * @param maxReg    Max reg id used
- * @param uniforms  Kernel parameters
- * @param heap
+ * Execute the next instruction on given QPU
  */
-void emulate(int numQPUs, Instr::List &instrs, int maxReg, IntList &uniforms, BufferObject &heap) {
-  State state(numQPUs, uniforms);
-  state.emuHeap.heap_view(heap);
+inline void step(State &state, QPUState *s, emu::Program const &program) {
+  s->upkeep();
+  bool in_delay_slot = (s->delay_slots > 0);
 
-  // Initialise state
-  for (int i = 0; i < numQPUs; i++) {
-    QPUState &q = state.qpu[i];
-    q.id                 = i;
-    q.init(maxReg);
+  MicroOp const &op = program.op(s->pc++);
+  op.exec(state, s, op);
+
+  if (in_delay_slot && --s->delay_slots == 0) {
+    s->pc = s->branch_target;
   }
+}
+
 
+/**
+ * Run all QPUs on the current thread, one instruction per QPU per round
+ */
+void run_sequential(State &state, int numQPUs, emu::Program const &program) {
   bool anyRunning = true;
 
   while (anyRunning) {
-    auto ALWAYS = AssignCond::Tag::ALWAYS;
     anyRunning = false;
 
     // Execute an instruction in each active QPU
@@ -610,93 +1098,85 @@ void emulate(int numQPUs, Instr::List &instrs, int maxReg, IntList &uniforms, Bu
 
       if (s->running) {
         anyRunning = true;
-        assert(s->pc < instrs.size());
+        step(state, s, program);
+      }
+    }
+  }
+}
 
-        s->upkeep();
 
-        //
-        // Run next instruction
-        //
-        Instr const instr = instrs.get(s->pc++);
+/**
+ * Run each QPU on a thread of its own
+ *
+ * An exception thrown on any of the QPU threads stops all threads,
+ * and is rethrown on the calling thread.
+ */
+void run_parallel(State &state, int numQPUs, emu::Program const &program) {
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < numQPUs; i++) {
+    QPUState* s = &state.qpu[i];
 
-        if (instr.break_point()) {
-#ifdef DEBUG
-          printf("Emulator: hit breakpoint\n");
-          breakpoint
-#endif
+    threads.emplace_back([&state, s, &program] () {
+      try {
+        while (s->running && !state.aborted) {
+          step(state, s, program);
         }
+      } catch (...) {
+        state.abort(std::current_exception());
+      }
+    });
+  }
 
-        switch (instr.tag) {
-          case LI: {
-            Vec imm(instr.LI.imm);
-            writeReg(s, &state, instr.set_cond().flags_set(), instr.assign_cond(), instr.dest(), imm);
-          }
-          break;
+  for (auto &t : threads) {
+    t.join();
+  }
 
-          case ALU:
-          if (!instr.ALU.op.isNOP()) {
-            Vec a;
-            Vec b;
-
-            if (instr.isUniformLoad()) {
-              a = state.get_uniform(s->id, s->nextUniform);
-              b = a; 
-            } else {
-              a = readRegOrImm(s, state, instr.ALU.srcA);
-              b = readRegOrImm(s, state, instr.ALU.srcB);
-            }
+  if (state.error) {
+    std::rethrow_exception(state.error);
+  }
+}
 
-            Vec result;
-            result.apply(instr.ALU.op, a, b);
+}  // anon namespace
 
-            writeReg(s, &state, instr.set_cond().flags_set(), instr.assign_cond(), instr.dest(), result);
-          }
-          break;
 
-          case BR: {  // Branch to target
-            if (checkBranchCond(s, instr.branch_cond())) {
-              BranchTarget t = instr.branch_target();
-              if (t.relative && !t.useRegOffset) {
-                s->pc += 3+t.immOffset;
-              } else {
-                fatal("V3DLib: found unsupported form of branch target");
-              }
-            }
-          }
-          break;
+/**
+ * @param numQPUs   Number of QPUs active
+ * @param instrs    Instruction sequence
+ * @param maxReg    Max reg id used
+ * @param uniforms  Kernel parameters
+ * @param heap
+ */
+void emulate(int numQPUs, Instr::List &instrs, int maxReg, IntList &uniforms, BufferObject &heap) {
+  emu::Program program(instrs, maxReg);
+  emulate(numQPUs, program, uniforms, heap);
+}
 
-          case RECV: {                             // receive load-via-TMU response
-            assert(s->loadBuffer.size() > 0);
-            Vec val = s->loadBuffer.remove(0);
-            AssignCond always;
-            always.tag = ALWAYS;
-            writeReg(s, &state, false, always, instr.dest(), val);
-          }
-          break;
 
-          case SINC: if (state.sema_inc(instr.semaId)) s->pc--; break;
-          case SDEC: if (state.sema_dec(instr.semaId)) s->pc--; break;
+/**
+ * @param numQPUs   Number of QPUs active
+ * @param program   Pre-decoded instruction sequence
+ * @param uniforms  Kernel parameters
+ * @param heap
+ */
+void emulate(int numQPUs, emu::Program const &program, IntList &uniforms, BufferObject &heap) {
+  bool parallel = LibSettings::use_parallel_emulator() && numQPUs > 1;
 
-          case END:                                // End program (halt)
-            s->running = false;
-            break;
+  State state(numQPUs, uniforms, parallel);
+  state.emuHeap.heap_view(heap);
 
-          case BRL:                                // Branch to label
-          case LAB:                                // Label
-            fatal("V3DLib: emulator does not support labels");
-            // Fall-thru
-          case NO_OP:
-          case IRQ:
-          case INIT_BEGIN:
-          case INIT_END:
-            break;  // ignore
+  // Initialise state
+  for (int i = 0; i < numQPUs; i++) {
+    QPUState &q = state.qpu[i];
+    q.id                 = i;
+    q.init(program.size_regfile());
+  }
 
-          default: assert(false);
-        }
-      }
-    }
+  if (parallel) {
+    run_parallel(state, numQPUs, program);
+  } else {
+    run_sequential(state, numQPUs, program);
   }
 }
 
 }  // namespace V3DLib
-
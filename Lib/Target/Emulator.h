@@ -1,12 +1,22 @@
 #ifndef _V3DLIB_TARGET_EMULATOR_H_
 #define _V3DLIB_TARGET_EMULATOR_H_
+#include <memory>
 #include "instr/Instr.h"
 
 namespace V3DLib {
 
 class BufferObject;
 
+namespace emu {
+
+class Program;  // Target code pre-decoded for the emulator, defined in Emulator.cpp
+
+std::shared_ptr<Program> decode(Instr::List const &instrs, int maxReg);
+
+}  // namespace emu
+
 void emulate(int numQPUs, Instr::List &instrs, int maxReg, IntList &uniforms, BufferObject &heap);
+void emulate(int numQPUs, emu::Program const &program, IntList &uniforms, BufferObject &heap);
 
 }  // namespace V3DLib
 
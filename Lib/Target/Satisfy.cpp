@@ -1,10 +1,13 @@
 #include "Satisfy.h"
 #include <assert.h>
 #include <stdio.h>
+#include <vector>
 #include "Support/Platform.h"
 #include "Liveness/Liveness.h"
+#include "Liveness/CFG.h"
 #include "Target/instr/Mnemonics.h"
 #include "Liveness/UseDef.h"
+#include "Support/basics.h"
 
 namespace V3DLib {
 namespace {
@@ -23,6 +26,134 @@ bool hasRegFileConflict(Instr const &instr) {
 }
 
 
+uint32_t const ACC_CANDIDATES = 0xf;  // r0-r3, r4 and r5 have special usages
+
+
+uint32_t acc_mask(Reg const &reg) {
+  return (reg.tag == ACC)? (1u << reg.regId) : 0;
+}
+
+
+/**
+ * Determine the accumulators which are live after each instruction (vc4).
+ *
+ * Accumulators introduced by `introduceAccum()` can hold a value across instructions,
+ * also around loops. This is the same backward dataflow over the CFG as for the variables
+ * in `Liveness`, with the accumulators as bit mask. Conditional writes do not end a live range.
+ */
+std::vector<uint32_t> acc_live_out(Instr::List &instrs) {
+  int const size = instrs.size();
+
+  CFG cfg;
+  cfg.build(instrs);
+
+  std::vector<uint32_t> use(size, 0);
+  std::vector<uint32_t> def(size, 0);
+
+  for (int i = 0; i < size; i++) {
+    for (auto const &reg : instrs[i].src_regs()) {
+      use[i] |= acc_mask(reg);
+    }
+
+    if (instrs[i].is_always()) {
+      def[i] = acc_mask(instrs[i].dst_reg());
+    }
+  }
+
+  std::vector<uint32_t> live_in(size, 0);
+  std::vector<uint32_t> live_out(size, 0);
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (int i = size - 1; i >= 0; i--) {
+      uint32_t out = 0;
+      for (auto succ : cfg[i]) {
+        out |= live_in[succ];
+      }
+
+      uint32_t in = use[i] | (out & ~def[i]);
+
+      if (in != live_in[i] || out != live_out[i]) {
+        live_in[i]  = in;
+        live_out[i] = out;
+        changed     = true;
+      }
+    }
+  }
+
+  return live_out;
+}
+
+
+/**
+ * Check if the register can be written and read back without side effects
+ */
+bool is_general(RegOrImm const &rhs) {
+  return rhs.is_reg() && (rhs.reg().tag == REG_A || rhs.reg().tag == REG_B);
+}
+
+
+/**
+ * Place an operand of the instruction in an accumulator (vc4).
+ *
+ * If an accumulator is free, the operand is moved into it. Otherwise, the value of an
+ * accumulator which the instruction does not use is exchanged with the operand register
+ * by three XOR's, and exchanged back after the instruction. This needs no extra register.
+ * If the instruction writes the operand register, the result goes to the accumulator,
+ * and ends up in the register with the second exchange.
+ *
+ * @param use_a     if true, replace srcA, otherwise srcB
+ * @param live_out  accumulators live after the instruction
+ */
+void operand_to_acc(Instr::List &out, Instr const &instr, bool use_a, uint32_t live_out) {
+  using namespace Target::instr;
+
+  uint32_t const used = instr.get_acc_usage();
+  uint32_t const free = ACC_CANDIDATES & ~used & ~live_out;
+
+  for (int n = 0; n < 4; n++) {
+    if (!(free & (1u << n))) continue;
+
+    Reg acc(ACC, n);
+    RegOrImm const &src = use_a? instr.ALU.srcA : instr.ALU.srcB;
+    Instr instr2 = instr.clone();
+
+    if (use_a) instr2.src_a(acc); else instr2.src_b(acc);
+    out << mov(acc, src) << instr2;
+    return;
+  }
+
+  // All candidates live, evict one. The exchange needs a general register
+  if (!is_general(use_a? instr.ALU.srcA : instr.ALU.srcB)) {
+    use_a = !use_a;
+  }
+
+  RegOrImm const &src = use_a? instr.ALU.srcA : instr.ALU.srcB;
+  assertq(is_general(src), "operand_to_acc(): no free accumulator, and no register operand to exchange with");
+
+  int n = 0;
+  while (used & (1u << n)) n++;
+  assert(n < 4);  // At most three accumulators are used by a single instruction
+
+  Reg acc(ACC, n);
+  Reg reg = src.reg();
+  Instr instr2 = instr.clone();
+
+  if (use_a) instr2.src_a(acc); else instr2.src_b(acc);
+  if (instr.dst_reg() == reg) instr2.dest(acc);
+
+  out << bxor(acc, acc, reg)
+      << bxor(reg, acc, reg)
+      << bxor(acc, acc, reg)
+      << instr2
+      << bxor(acc, acc, reg)
+      << bxor(reg, acc, reg)
+      << bxor(acc, acc, reg);
+}
+
+
 /**
  * First pass for satisfy constraints: insert move-to-accumulator instructions
  */
@@ -30,30 +161,27 @@ Instr::List insertMoves_vc4(Instr::List &instrs) {
   assert(Platform::compiling_for_vc4());  // Not an issue for v3d
 
   Instr::List newInstrs(instrs.size() * 2);
+  std::vector<uint32_t> live_out = acc_live_out(instrs);
 
   for (int i = 0; i < instrs.size(); i++) {
-    using namespace Target::instr;
     Instr instr = instrs[i];
 
     if (instr.tag == ALU && instr.ALU.srcA.is_imm() &&
         instr.ALU.srcB.is_reg() && instr.ALU.srcB.reg().regfile() == REG_B) {
       // Insert moves for an operation with a small immediate whose
       // register operand must reside in reg file B.
-      newInstrs << mov(ACC0, instr.ALU.srcB)
-                << instr.clone().src_b(ACC0);
+      operand_to_acc(newInstrs, instr, false, live_out[i]);
     } else if (instr.tag == ALU && instr.ALU.srcB.is_imm() &&
                instr.ALU.srcA.is_reg() && instr.ALU.srcA.reg().regfile() == REG_B) {
       // Insert moves for an operation with a small immediate whose
       // register operand must reside in reg file B.
-      newInstrs << mov(ACC0, instr.ALU.srcA)
-                << instr.clone().src_a(ACC0);
+      operand_to_acc(newInstrs, instr, true, live_out[i]);
     } else if (hasRegFileConflict(instr)) {
       // Insert moves for operands that are mapped to the same reg file.
       //
       // When an instruction uses two (different) registers that are mapped
       // to the same register file, then remap one of them to an accumulator.
-      newInstrs << mov(ACC0, instr.ALU.srcA)
-                << instr.clone().src_a(ACC0);
+      operand_to_acc(newInstrs, instr, true, live_out[i]);
     } else {
       newInstrs << instr;
     }
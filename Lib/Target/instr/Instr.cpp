@@ -1,4 +1,6 @@
 #include "Instr.h"         // Location of definition struct Instr
+#include <cstring>          // memcpy
+#include <type_traits>
 #include "Support/debug.h"
 #include "Target/Pretty.h"  // pretty_instr_tag()
 #include "Support/basics.h"
@@ -7,6 +9,50 @@
 #include "LibSettings.h"
 
 namespace V3DLib {
+namespace {
+
+/**
+ * Raw (de)serialization of plain fields.
+ *
+ * Only used for the kernel cache. Cache files record the library build and `sizeof(Instr)`,
+ * and are rejected on a mismatch, so the in-memory layout is fine as storage format.
+ */
+template<typename T>
+void write_raw(std::string &buf, T const &val) {
+  static_assert(std::is_trivially_copyable<T>::value, "write_raw(): type must be trivially copyable");
+  buf.append((char const *) &val, sizeof(T));
+}
+
+
+template<typename T>
+bool read_raw(std::string const &buf, size_t &pos, T &val) {
+  static_assert(std::is_trivially_copyable<T>::value, "read_raw(): type must be trivially copyable");
+  if (pos + sizeof(T) > buf.size()) return false;
+
+  memcpy((void *) &val, buf.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+
+void write_string(std::string &buf, std::string const &str) {
+  write_raw(buf, (uint32_t) str.size());
+  buf.append(str);
+}
+
+
+bool read_string(std::string const &buf, size_t &pos, std::string &str) {
+  uint32_t size;
+  if (!read_raw(buf, pos, size)) return false;
+  if (pos + size > buf.size()) return false;
+
+  str.assign(buf, pos, size);
+  pos += size;
+  return true;
+}
+
+}  // anon namespace
+
 
 // ============================================================================
 // Class BranchTarget
@@ -708,4 +754,61 @@ std::string Instr::mnemonic(bool with_comments, std::string const &prefix) const
   return ret;
 }
 
+
+/**
+ * Append a binary representation of this instruction to the given buffer.
+ *
+ * Comments are retained, so that a restored instruction list displays identically.
+ */
+void Instr::serialize(std::string &buf) const {
+  write_raw(buf, tag);
+  write_raw(buf, ALU);
+  write_raw(buf, semaId);
+  write_raw(buf, LI);
+  write_raw(buf, m_break_point);
+  write_raw(buf, m_set_cond);
+  write_raw(buf, m_assign_cond);
+  write_raw(buf, m_branch_cond);
+  write_raw(buf, m_dest);
+  write_raw(buf, m_branch_target);
+  write_raw(buf, m_branch_label);
+  write_raw(buf, m_label);
+
+  write_string(buf, header());
+  write_string(buf, comment());
+}
+
+
+/**
+ * Read an instruction from the given buffer, as written by `serialize()`.
+ *
+ * @param pos  position in buffer to read from; on success, set to the position after the instruction
+ *
+ * @return true if read successfully, false if the buffer is truncated
+ */
+bool Instr::deserialize(std::string const &buf, size_t &pos) {
+  std::string header_str;
+  std::string comment_str;
+
+  bool ok = read_raw(buf, pos, tag)
+         && read_raw(buf, pos, ALU)
+         && read_raw(buf, pos, semaId)
+         && read_raw(buf, pos, LI)
+         && read_raw(buf, pos, m_break_point)
+         && read_raw(buf, pos, m_set_cond)
+         && read_raw(buf, pos, m_assign_cond)
+         && read_raw(buf, pos, m_branch_cond)
+         && read_raw(buf, pos, m_dest)
+         && read_raw(buf, pos, m_branch_target)
+         && read_raw(buf, pos, m_branch_label)
+         && read_raw(buf, pos, m_label)
+         && read_string(buf, pos, header_str)
+         && read_string(buf, pos, comment_str);
+
+  if (!ok) return false;
+
+  restore_comments(header_str, comment_str);
+  return true;
+}
+
 }  // namespace V3DLib
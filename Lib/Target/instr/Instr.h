@@ -205,6 +205,12 @@ struct Instr : public InstructionComment {
   Instr &pushz();
   Instr &allzc();
 
+  // ==================================================
+  // Serialization, used by the kernel cache
+  // ==================================================
+  void serialize(std::string &buf) const;
+  bool deserialize(std::string const &buf, size_t &pos);
+
 private:
   bool m_break_point = false;
   SetCond    m_set_cond;
@@ -1,18 +1,14 @@
 #include "Label.h"
+#include "Common/CompileContext.h"
 
 namespace V3DLib {
-namespace {
-
-int globalLabelId = 0;  // Used for fresh label generation
-
-}  // anon namespace
 
 
 /**
  * Obtain a fresh label
  */
 Label freshLabel() {
-  return globalLabelId++;
+  return CompileContext::current().label_count++;
 }
 
 
@@ -20,7 +16,7 @@ Label freshLabel() {
  * Number of fresh labels used
  */
 int getFreshLabelCount() {
-  return globalLabelId;
+  return CompileContext::current().label_count;
 }
 
 
@@ -28,7 +24,7 @@ int getFreshLabelCount() {
  * Reset fresh label generator
  */
 void resetFreshLabelGen() {
-  globalLabelId = 0;
+  CompileContext::current().label_count = 0;
 }
 
 
@@ -36,7 +32,7 @@ void resetFreshLabelGen() {
  * Reset fresh label generator to specified value
  */
 void resetFreshLabelGen(int val) {
-  globalLabelId = val;
+  CompileContext::current().label_count = val;
 }
 
 
@@ -96,6 +96,7 @@ Instr bor(Reg dst, RegOrImm const &srcA, RegOrImm const &srcB)  { return genInst
 Instr band(Reg dst, Reg srcA, Reg srcB)   { return genInstr(ALUOp::A_BAND, dst, srcA, srcB); }
 Instr band(Reg dst, Reg srcA, int n)      { return genInstr(ALUOp::A_BAND, dst, srcA, n); }
 Instr bxor(Var dst, RegOrImm srcA, int n) { return genInstr(ALUOp::A_BXOR, dst, srcA, n); }
+Instr bxor(Reg dst, Reg srcA, Reg srcB)   { return genInstr(ALUOp::A_BXOR, dst, srcA, srcB); }
 
 
 /**
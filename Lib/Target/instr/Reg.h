@@ -61,7 +61,7 @@ struct Reg {
   bool isUniformPtr = false;
 
   Reg() = default;
-  Reg(Reg const &rhs) : tag(rhs.tag), regId(rhs.regId), isUniformPtr(rhs.isUniformPtr) {}
+  Reg(Reg const &rhs) = default;
   Reg(RegTag in_tag, RegId in_regId) : tag(in_tag), regId(in_regId) {}
   Reg(Var var);
 
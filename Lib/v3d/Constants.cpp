@@ -0,0 +1,173 @@
+#include "Constants.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "Support/basics.h"
+#include "Source/Var.h"
+#include "Target/instr/Mnemonics.h"
+#include "Common/CompileData.h"
+#include "KernelDriver.h"
+
+namespace V3DLib {
+namespace v3d {
+
+using ::operator<<;  // C++ weirdness
+
+namespace {
+
+int const MAX_CACHED   = 8;  // Max number of constants kept in registers, to limit register pressure
+int const UNIFORM_COST = 2;  // Cost of loading a constant as uniform: one instruction plus the uniform stream
+int const LOOP_WEIGHT  = 4;  // Estimated number of iterations per loop, to weigh loads within loops
+int const MAX_DEPTH    = 3;  // Max loop depth taken into account for weighing
+
+struct Constant {
+  Imm imm;
+  int cost   = 0;            // Number of instructions to synthesize the constant
+  int saved  = 0;            // Weighted number of instructions saved over all loads
+  std::vector<int> loads;    // Positions of the load instructions
+
+  int setup() const { return std::min(cost, UNIFORM_COST); }
+  int benefit() const { return saved - setup(); }
+  bool as_uniform() const { return cost > UNIFORM_COST; }
+};
+
+
+/**
+ * Determine the loop nesting depth per instruction.
+ *
+ * Loops are detected by branches to a preceding label.
+ */
+std::vector<int> loop_depths(Instr::List const &instrs) {
+  std::map<Label, int> label_at;
+  for (int i = 0; i < instrs.size(); i++) {
+    if (instrs[i].is_label()) label_at[instrs[i].label()] = i;
+  }
+
+  std::vector<int> depth(instrs.size(), 0);
+
+  for (int i = 0; i < instrs.size(); i++) {
+    if (!instrs[i].is_branch_label()) continue;
+
+    auto it = label_at.find(instrs[i].branch_label());
+    if (it == label_at.end() || it->second >= i) continue;
+
+    for (int j = it->second; j <= i; j++) {
+      depth[j]++;
+    }
+  }
+
+  return depth;
+}
+
+}  // anon namespace
+
+
+/**
+ * Cache expensive constants in registers.
+ *
+ * v3d can only encode small immediates directly, other values need to be synthesized with
+ * a sequence of instructions (see `encodeLoadImmediate()`). This is done separately for
+ * every load of the same constant.
+ *
+ * This pass determines per constant if it is cheaper to load it once at the start of the kernel
+ * and copy it from there on. Loads within loops are weighted more heavily.
+ * Constants which are expensive to synthesize are passed as extra uniforms, the others are
+ * synthesized once after the init block.
+ *
+ * Only constants loaded after the init block are considered. The copies from the cached
+ * constants will mostly be removed by the SSA optimizer (copy propagation).
+ *
+ * @param uniforms  output parameter, values of the extra uniforms. These need to be
+ *                  passed directly after the kernel parameters.
+ *
+ * @return number of constants cached
+ */
+int materialize_constants(Instr::List &instrs, IntList &uniforms) {
+  using namespace V3DLib::Target::instr;
+
+  int init_end = instrs.tag_index(INIT_END, false);
+  if (init_end == -1) return 0;
+
+  auto depth = loop_depths(instrs);
+
+  //
+  // Collect the loads of constants which can not be encoded directly
+  //
+  std::map<uint64_t, Constant> constants;
+
+  for (int i = init_end + 1; i < instrs.size(); i++) {
+    auto const &instr = instrs[i];
+    if (instr.tag != InstrTag::LI) continue;
+    if (instr.set_cond().flags_set()) continue;
+
+    auto const &imm = instr.LI.imm;
+    if (!imm.is_int() && !imm.is_float()) continue;
+
+    uint64_t key = ((uint64_t) imm.tag() << 32) | imm.encode();
+    auto &c = constants[key];
+
+    if (c.loads.empty()) {
+      c.imm  = imm;
+      c.cost = load_imm_cost(imm);
+    }
+
+    if (c.cost <= 1) continue;
+
+    int weight = 1;
+    for (int d = 0; d < std::min(depth[i], MAX_DEPTH); d++) weight *= LOOP_WEIGHT;
+
+    c.loads.push_back(i);
+    c.saved += weight*(c.cost - 1);  // Remaining load is a single copy
+  }
+
+  std::vector<Constant const *> selected;
+  for (auto const &it : constants) {
+    if (it.second.benefit() > 0) selected.push_back(&it.second);
+  }
+
+  std::sort(selected.begin(), selected.end(), [] (Constant const *a, Constant const *b) {
+    return a->benefit() > b->benefit();
+  });
+
+  if ((int) selected.size() > MAX_CACHED) selected.resize(MAX_CACHED);
+  if (selected.empty()) return 0;
+
+  //
+  // Replace the loads with copies and generate the cached values
+  //
+  Instr::List uniform_loads;
+  Instr::List synthesized;
+
+  for (auto c : selected) {
+    Reg var(REG_A, VarGen::fresh().id());
+
+    std::string cmt;
+    cmt << "Cached constant " << c->imm.pretty();
+
+    if (c->as_uniform()) {
+      uniform_loads << mov(var, UNIFORM_READ).comment(cmt);
+      uniforms << (int32_t) c->imm.encode();
+      compile_data().num_const_uniforms++;
+    } else {
+      synthesized << li(var, c->imm).comment(cmt);
+    }
+
+    for (auto i : c->loads) {
+      auto &instr = instrs[i];
+
+      Instr copy = mov(instr.dest(), var);
+      copy.cond(instr.assign_cond());
+      copy.transfer_comments(instr);
+      instr = copy;
+    }
+  }
+
+  if (!synthesized.empty())   instrs.insert(init_end + 1, synthesized);
+  if (!uniform_loads.empty()) instrs.insert(instrs.lastUniformOffset() + 1, uniform_loads);
+
+  compile_data().num_consts_cached += (int) selected.size();
+  return (int) selected.size();
+}
+
+}  // namespace v3d
+}  // namespace V3DLib
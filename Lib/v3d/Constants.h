@@ -0,0 +1,14 @@
+#ifndef _V3DLIB_V3D_CONSTANTS_H_
+#define _V3DLIB_V3D_CONSTANTS_H_
+#include "Common/Seq.h"
+#include "Target/instr/Instr.h"
+
+namespace V3DLib {
+namespace v3d {
+
+int materialize_constants(Instr::List &instrs, IntList &uniforms);
+
+}  // namespace v3d
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_V3D_CONSTANTS_H_
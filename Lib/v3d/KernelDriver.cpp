@@ -2,13 +2,17 @@
 #include <iostream>
 #include <memory>
 #include "Driver.h"
+#include "LibSettings.h"
 #include "Source/Translate.h"
 #include "Target/SmallLiteral.h"  // decodeSmallLit()
 #include "Target/RemoveLabels.h"
+#include "Target/instr/Mnemonics.h"
 #include "instr/Snippets.h"
 #include "Support/basics.h"
 #include "Support/Timer.h"
 #include "SourceTranslate.h"
+#include "Schedule.h"
+#include "Constants.h"
 #include "instr/Encode.h"
 #include "instr/Mnemonics.h"
 #include "instr/OpItems.h"
@@ -27,7 +31,7 @@ namespace {
 // Also: the << definitions in `basics.h` DID get picked up; the std::string versions did not.
 using ::operator<<; // C++ weirdness
 
-std::vector<std::string> local_errors;
+thread_local std::vector<std::string> local_errors;
 
 
 /**
@@ -333,23 +337,26 @@ bool translateRotate(V3DLib::Instr const &instr, Instructions &ret) {
 
 /**
  * Convert powers of 2 of direct small immediates
+ *
+ * The small immediate may be negative, e.g. -256 == -1 << 8.
+ * Register r0 is used as temp value.
  */
-bool convert_int_powers(Instructions &output, int in_value) {
-  if (in_value < 0)  return false;  // only positive values for now
-  if (in_value < 16) return false;  // don't bother with values within range
+bool convert_int_powers(Instructions &output, int in_value, Location const &dst = r0) {
+  int rep_value;
+  if (in_value == 0) return false;
+  if (SmallImm::int_to_opcode_value(in_value, rep_value)) return false;  // don't bother with values within range
 
   int value = in_value;
   int left_shift = 0;
 
-  while (value != 0 && (value & 1) == 0) {
+  while ((value & 1) == 0) {
     left_shift++;
-    value >>= 1;
+    value /= 2;
   }
 
   if (left_shift == 0) return false;
   if (left_shift >= 16) return false;  // Must be positive small int
 
-  int rep_value;
   if (!SmallImm::int_to_opcode_value(value, rep_value)) return false;
 
   SmallImm imm(rep_value);
@@ -359,13 +366,33 @@ bool convert_int_powers(Instructions &output, int in_value) {
 
   Instructions ret;
   ret << mov(r0, imm).comment(cmt);
-  ret << shl(r0, r0, SmallImm(left_shift));
+  ret << shl(dst, r0, SmallImm(left_shift));
 
   output << ret;
   return true;
 }
 
 
+/**
+ * Convert values which are a small immediate away from a power of 2 of a small immediate,
+ * e.g. 257 == (1 << 8) + 1.
+ */
+bool convert_int_offset(Instructions &output, int in_value, Location const &dst) {
+  for (int offset = -16; offset <= 15; offset++) {
+    if (offset == 0) continue;
+
+    Instructions ret;
+    if (!convert_int_powers(ret, (int) ((uint32_t) in_value - (uint32_t) offset))) continue;
+
+    ret << add(dst, r0, SmallImm(offset));
+    output << ret;
+    return true;
+  }
+
+  return false;
+}
+
+
 /**
  * Blunt tool for converting all int's.
  *
@@ -440,22 +467,60 @@ bool encode_int_immediate(Instructions &output, int in_value) {
 }
 
 
+/**
+ * Encode an int value.
+ *
+ * With constant caching enabled, the shortest available instruction sequence is used.
+ * Otherwise, only the sequences from before constant caching are used; the shorter ones are
+ * not yet verified on hardware.
+ */
 bool encode_int(Instructions &ret, std::unique_ptr<Location> &dst, int value) {
-  bool success = true;
   int rep_value;
 
   if (SmallImm::int_to_opcode_value(value, rep_value)) {  // direct translation
     SmallImm imm(rep_value);
     ret << mov(*dst, imm);
-  } else if (convert_int_powers(ret, value)) {            // powers of 2 of basic small int's 
-    ret << mov(*dst, r0);
-  } else if (encode_int_immediate(ret, value)) {          // Use full blunt conversion (heavy but always works)
-    ret << mov(*dst, r1);
-  } else {
-    success = false;                                      // Conversion failed
+    return true;
   }
 
-  return success;
+  if (!LibSettings::use_constant_caching()) {
+    if (value > 0 && convert_int_powers(ret, value)) {     // powers of 2 of basic small int's
+      ret << mov(*dst, r0);
+    } else if (encode_int_immediate(ret, value)) {         // Use full blunt conversion (heavy but always works)
+      ret << mov(*dst, r1);
+    } else {
+      return false;                                        // Conversion failed
+    }
+
+    return true;
+  }
+
+  Instructions best;
+
+  auto select = [&best] (Instructions const &candidate) {
+    if (best.empty() || candidate.size() < best.size()) best = candidate;
+  };
+
+  Instructions tmp;
+  if (convert_int_powers(tmp, value, *dst)) {              // powers of 2 of basic small int's 
+    select(tmp);
+  }
+
+  tmp.clear();
+  if (convert_int_offset(tmp, value, *dst)) {              // powers of 2 plus a small int
+    select(tmp);
+  }
+
+  tmp.clear();
+  if (encode_int_immediate(tmp, value)) {                  // Use full blunt conversion (heavy but always works)
+    tmp << mov(*dst, r1);
+    select(tmp);
+  }
+
+  if (best.empty()) return false;                          // Conversion failed
+
+  ret << best;
+  return true;
 }
 
 
@@ -769,202 +834,6 @@ void _encode(V3DLib::Instr::List const &instrs, Instructions &instructions) {
 }
 
 
-template<typename AddAlu>
-bool can_be_mul_alu(AddAlu const &add_alu) {
-  return ((add_alu.op == V3D_QPU_A_OR && add_alu.a == add_alu.b)       // ORs with 1 source can be translated to mul alu MOV
-        || add_alu.op == V3D_QPU_A_ADD
-        || add_alu.op == V3D_QPU_A_SUB)
-       && (!add_alu.magic_write || add_alu.waddr < V3D_QPU_WADDR_NOP)  // Don't write to special registers in the mul alu
-  ;
-}
-
-
-/**
- * Check if given instructions have a dependency on each other.
- *
- * Pre: Instruction 'first' is predecessor of 'second'.
- * There is a dependency if:
- *   - instruction 'second' has a source which is a destination of 'first'.
- *   - instruction 'second' has a destination which is a destination of 'first'.
- */
-bool have_dependency(v3d::instr::Instr const &first, v3d::instr::Instr const &second) {
-  return second.is_src(first.sig_dest())
-      || second.is_src(first.add_dest())
-      || second.is_src(first.mul_dest())
-      || second.is_dst(first.sig_dest())
-      || second.is_dst(first.add_dest())
-      || second.is_dst(first.mul_dest());
-}
-
-
-bool can_combine(v3d::instr::Instr const &instr1, v3d::instr::Instr const &instr2, bool &do_converse) {
-  assert(instr1.add_nop() || instr1.mul_nop());  // Not expecting fully filled instructions
-  assert(instr2.add_nop() || instr2.mul_nop());  // idem
-
-  // Skip branches
-  if (instr1.type == V3D_QPU_INSTR_TYPE_BRANCH || instr2.type == V3D_QPU_INSTR_TYPE_BRANCH) return false;
-
-  // Skip special signals for now - there might be something to be won with the ld's
-  if (instr1.has_signal() || instr2.has_signal()) return false;
-
-  // Skip full NOPs, they are there for a reason
-  if (instr1.is_nop()) return false;
-  if (instr2.is_nop()) return false;
-
-  // skip both mul for now, needs extra logic and is probably scarce
-  if (!instr1.mul_nop() && !instr2.mul_nop())  {
-    return false;
-  }
-
-
-  auto magic_write1 = instr1.mul_nop()?instr1.alu.add.magic_write:instr1.alu.mul.magic_write;
-  auto waddr1       = instr1.mul_nop()?instr1.alu.add.waddr:instr1.alu.mul.waddr;
-  auto magic_write2 = instr2.mul_nop()?instr2.alu.add.magic_write:instr2.alu.mul.magic_write;
-  auto waddr2       = instr2.mul_nop()?instr2.alu.add.waddr:instr2.alu.mul.waddr;
-
-  // Skip combined special waddresses - important for tmu operations
-  if ((magic_write1 && waddr1 >= V3D_QPU_WADDR_NOP)
-   && (magic_write2 && waddr2 >= V3D_QPU_WADDR_NOP)) return false;
-
-  // Disallow same dest reg
-  if (waddr1 == waddr2 && magic_write1 == magic_write2) return false;
-
-
-  // Don't combine set conditional with use conditional
-  if (instr1.flags.apf && instr2.flags.ac) return false;
-
-
-  // Output instr1 should not be used as input instr2
-  auto a2 = instr2.mul_nop()?instr2.alu.add.a:instr2.alu.mul.a;
-  auto b2 = instr2.mul_nop()?instr2.alu.add.b:instr2.alu.mul.b;
-
-  bool is_rf1 = !magic_write1;
-  if (is_rf1) {
-    if (a2 == V3D_QPU_MUX_A && instr2.raddr_a == waddr1) return false;
-    if (b2 == V3D_QPU_MUX_A && instr2.raddr_a == waddr1) return false;
-
-    if (a2 == V3D_QPU_MUX_B && !instr2.sig.small_imm && instr2.raddr_b == waddr1) return false;
-    if (b2 == V3D_QPU_MUX_B && !instr2.sig.small_imm && instr2.raddr_b == waddr1) return false;
-  } else {
-    if (a2 < V3D_QPU_MUX_A && a2 == waddr1) return false;
-    if (b2 < V3D_QPU_MUX_A && b2 == waddr1) return false;
-  }
-
-  // mul/alu splits can always be combined
-  if (instr1.mul_nop() && !instr2.mul_nop()) {
-    do_converse = false;
-    return true;
-  }
-
-  if (!instr1.mul_nop() && instr2.mul_nop()) {
-    do_converse = true;
-    return true;
-  }
-
-
-  //
-  // Determine add alu instructions with mul alu equivalents
-  //
-  if (can_be_mul_alu(instr2.alu.add)) {
-    do_converse = false;
-    return true;
-  }
-
-  if (can_be_mul_alu(instr1.alu.add)) {
-    do_converse = true;
-    return true;
-  }
-
-  return false;
-}
-
-
-bool convert_alu_op_to_mul_op(v3d_qpu_mul_op &mul_op, v3d::instr::Instr const &add_instr) {
-  switch (add_instr.alu.add.op) {
-    case V3D_QPU_A_OR:
-      if (add_instr.alu.add.a == add_instr.alu.add.b) {
-        mul_op = V3D_QPU_M_MOV;
-        return true;
-      }
-
-    case V3D_QPU_A_ADD:
-      mul_op = V3D_QPU_M_ADD;
-      return true;
-
-    case V3D_QPU_A_SUB:
-      mul_op = V3D_QPU_M_SUB;
-      return true;
-
-    default: break;
-  }
-
-  return false;
-}
-
-
-/**
- * Set the mul alu with the add alu part of in_instr
- */
-bool add_alu_to_mul_alu(Instr const &in_instr, Instr &dst) {
-  assert((!in_instr.add_nop() &&  in_instr.mul_nop()) 
-      || ( in_instr.add_nop() && !in_instr.mul_nop())); 
-  assert(dst.mul_nop()); 
-
-  //
-  // Get used dst and src
-  //
-  std::unique_ptr<Location> dst_loc;
-  std::unique_ptr<Source> src_a;
-  std::unique_ptr<Source> src_b;
-
-  if (in_instr.mul_nop()) {
-    v3d_qpu_mul_op mul_op;
-    if (!convert_alu_op_to_mul_op(mul_op, in_instr)) return false;
-    dst.alu.mul.op = mul_op;
-
-    // Take values from add alu 
-    dst_loc = in_instr.add_alu_dst();
-    src_a   = in_instr.add_alu_a();
-    src_b   = in_instr.add_alu_b();
-  } else {
-    dst.alu.mul.op = in_instr.alu.mul.op;
-
-    // Take values from mul alu 
-    dst_loc = in_instr.mul_alu_dst();
-    src_a   = in_instr.mul_alu_a();
-    src_b   = in_instr.mul_alu_b();
-  }
-  assert(dst_loc.get() != nullptr);
-  assert(src_a.get()   != nullptr);
-  assert(src_b.get()   != nullptr);
-
-  if (!dst.alu_mul_set(*dst_loc, *src_a, *src_b)) return false;
-
-  if (in_instr.mul_nop()) {
-    dst.alu.mul.output_pack = in_instr.alu.add.output_pack;
-    dst.alu.mul.a_unpack    = in_instr.alu.add.a_unpack;
-    dst.alu.mul.b_unpack    = in_instr.alu.add.b_unpack;
-
-    dst.flags.mc  = in_instr.flags.ac;
-    dst.flags.mpf = in_instr.flags.apf;
-    dst.flags.muf = in_instr.flags.auf;
-  } else {
-    dst.alu.mul.output_pack = in_instr.alu.mul.output_pack;
-    dst.alu.mul.a_unpack    = in_instr.alu.mul.a_unpack;
-    dst.alu.mul.b_unpack    = in_instr.alu.mul.b_unpack;
-
-    dst.flags.mc  = in_instr.flags.mc;
-    dst.flags.mpf = in_instr.flags.mpf;
-    dst.flags.muf = in_instr.flags.muf;
-  }
-
-  dst.header(in_instr.header());
-  dst.comment(in_instr.comment());
-
-  return true;
-}
-
-
 void combine(Instructions &instructions) {
 
   //
@@ -1013,80 +882,6 @@ void combine(Instructions &instructions) {
     assertq(!(instr1.skip() && instr2.skip()), "Deal with skips when they happen");
     if (instr1.skip()) continue;
 
-    //
-    // Combine pure nop ldtmu instruction with next
-    // 
-    if (false && instr1.is_ldtmu() && instr1.is_nop()) {
-
-      // There can be multiple consecutive tmu loads, shift them all in reverse order
-      int first = i - 1;
-      int last  = i - 1;
-      for (int n = last + 1; n < (int) instructions.size(); n++) {
-        auto &instr = instructions[n];
-
-        //breakpoint
-
-        assert(!instr.skip());
-        if (!instr.is_nop()) break;  // pure nop ldtmu only
-        if (!instr.is_ldtmu()) break;
-        last = n;
-      }
-
-      for (int n = last; n >= first; n--) {
-        auto &instr = instructions[n];
-        int shift_to = 0;
-         
-        int max_shift = -1;  // If set > 0, max number of instructions to look forward
-
-        int end_m = (int) instructions.size();
-        if (max_shift > 0 && end_m > n + max_shift) {
-          end_m = n + max_shift;
-        }
-
-        for (int m = n + 1; m < end_m; m++) {
-          auto &instr2 = instructions[m];
-          if (instr2.skip()) continue;
-          if (instr2.is_branch()) break;   // Paranoia safeguard; it might actually be possible
-          if (instr2.uses_sig_dst()) break;
-          if (have_dependency(instr, instr2)) break;
-
-          // Specials
-          if (!instr2.is_branch()) 
-            if (instr2.alu.add.op == V3D_QPU_A_BARRIERID    // In program end, syncs last TMU operation
-
-            //
-            // Following empirically determined
-            //
-
-            // TMU read and load don't mix
-            || (instr2.alu.add.waddr == V3D_QPU_WADDR_TMUA && instr2.alu.add.magic_write)
-
-            // Apparently, can't combine setting flags with TMU loads
-            || (instr2.flags.ac != V3D_QPU_COND_NONE || instr2.flags.mc != V3D_QPU_COND_NONE)
-            ) {
-            break;
-          }
-          
-          shift_to = m;
-        }
-
-        //breakpoint
-
-        if (shift_to != 0) {
-          auto &instr2 = instructions[shift_to];
-          instr2.sig.ldtmu = true;
-          instr2.sig_addr  = instr.sig_addr;
-          instr2.sig_magic = instr.sig_magic;
-          instr.skip(true);
-        }
-      }
-
-      //breakpoint
-      i += (last - first);
-      continue;
-    }
-
-
     //
     // Skip instructions that have both add and mul alu
     //
@@ -1145,7 +940,7 @@ void combine(Instructions &instructions) {
     break;       // ...as we encounter them
   }
 
-  compile_data.num_instructions_combined += combine_count;
+  compile_data().num_instructions_combined += combine_count;
 /*
   if (combine_count > 0) {
     std::string msg;
@@ -1196,14 +991,17 @@ void load_uniforms(Data &unif, int numQPUs, Data const &devnull, Data const &don
 }
 
 
-void invoke(int numQPUs, Data &devnull, Code &codeMem, IntList &params) {
+/**
+ * @param unif  memory for the uniforms, at least `params.size() + 4` values
+ * @param done  memory for the 'done' location
+ */
+void invoke(int numQPUs, Data &devnull, Code &codeMem, Data &unif, Data &done, IntList &params) {
 #ifndef QPU_MODE
   assertq(false, "Cannot run v3d invoke(), QPU_MODE not enabled");
 #else
   assert(!codeMem.empty());
+  assert((int) unif.size() >= params.size() + 4);
 
-  Data unif(params.size() + 4);
-  Data done(1);
   done[0] = 0;
 
   load_uniforms(unif, numQPUs, devnull, done, params);
@@ -1217,6 +1015,20 @@ void invoke(int numQPUs, Data &devnull, Code &codeMem, IntList &params) {
 }  // anon namespace
 
 
+/**
+ * Determine the number of v3d instructions needed to load the given immediate value.
+ *
+ * This is the size of the sequence generated by `encodeLoadImmediate()`, which depends
+ * on `LibSettings::use_constant_caching()`.
+ */
+int load_imm_cost(Imm const &imm) {
+  if (!imm.is_int() && !imm.is_float()) return 1;
+
+  Instructions tmp = encodeLoadImmediate(V3DLib::Target::instr::li(V3DLib::Target::instr::rf(0), imm));
+  return (int) tmp.size();
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Class KernelDriver
 ///////////////////////////////////////////////////////////////////////////////
@@ -1229,10 +1041,32 @@ void KernelDriver::encode() {
   if (has_errors()) return;              // Don't do this if compile errors occured
   assert(!qpuCodeMem.allocated());
 
-  // Encode target instructions
-  _encode(m_targetCode, instructions);
-  combine(instructions);
-  removeLabels(instructions);
+  {
+    // Encode target instructions
+    PassTimer t("encode", m_targetCode);
+    _encode(m_targetCode, instructions);
+    t.instrs_after((int) instructions.size());
+  }
+
+  if (LibSettings::use_v3d_scheduler()) {
+    PassTimer t("schedule", instructions);
+    schedule(instructions);
+  }
+
+  {
+    PassTimer t("combine", instructions);
+    combine(instructions);
+  }
+
+  if (LibSettings::use_v3d_delay_slots()) {
+    PassTimer t("delay_slots", instructions);
+    fill_delay_slots(instructions);
+  }
+
+  {
+    PassTimer t("removeLabels", instructions);
+    removeLabels(instructions);
+  }
 
   if (!instructions.check_consistent()) {
     std::string err;
@@ -1268,22 +1102,43 @@ std::vector<uint64_t> KernelDriver::to_opcodes() {
 
 
 void KernelDriver::compile_intern() {
-  //Timer t1("compile_intern", true);
-
   obtain_ast();
+  if (load_from_cache()) return;
+
+  {
+    PassTimer t("translate_stmt", m_targetCode);
+    translate_stmt(m_targetCode, m_body);  // performance hog 2 12/45s
+  }
 
-  //Timer t3("translate_stmt");
-  translate_stmt(m_targetCode, m_body);  // performance hog 2 12/45s
-  //t3.end();
+  {
+    PassTimer t("insertInitBlock", m_targetCode);
+    insertInitBlock(m_targetCode);
+    add_init(m_targetCode);
+  }
 
-  insertInitBlock(m_targetCode);
-  add_init(m_targetCode);
+  if (LibSettings::use_constant_caching()) {
+    PassTimer t("constants", m_targetCode);
+    materialize_constants(m_targetCode, m_uniforms);
+  }
 
-  //Timer t5("compile_postprocess");
   compile_postprocess(m_targetCode);  // performance hog 1 31/45s
-  //t5.end();
 
   encode();
+  store_in_cache();
+}
+
+
+/**
+ * Restore the v3d instructions from opcodes retrieved from the kernel cache
+ *
+ * The instructions are decoded from the opcodes, so the comments are lost.
+ */
+void KernelDriver::cache_opcodes(std::vector<uint64_t> const &code) {
+  assert(instructions.empty());
+
+  for (auto op : code) {
+    instructions << Instruction(op);
+  }
 }
 
 
@@ -1307,7 +1162,10 @@ void KernelDriver::allocate() {
 }
 
 
-void KernelDriver::invoke_intern(int numQPUs, IntList &params) {
+/**
+ * Allocate the code, devnull and uniform memory, if not done already
+ */
+void KernelDriver::prepare_invoke_intern(int numQPUs, IntList const &params) {
   if (numQPUs != 1 && numQPUs != 8) {
     error("Num QPU's must be 1 or 8", true);
   }
@@ -1321,7 +1179,23 @@ void KernelDriver::invoke_intern(int numQPUs, IntList &params) {
     devnull.alloc(16);
   }
 
-  v3d::invoke(numQPUs, devnull, qpuCodeMem, params);
+  if (!m_unif.allocated()) {
+    m_unif.alloc((uint32_t) (params.size() + m_uniforms.size() + 4));
+    m_done.alloc(1);
+  }
+}
+
+
+void KernelDriver::invoke_intern(int numQPUs, IntList &params) {
+  prepare_invoke_intern(numQPUs, params);
+
+  if (m_uniforms.empty()) {
+    v3d::invoke(numQPUs, devnull, qpuCodeMem, m_unif, m_done, params);
+  } else {
+    IntList all_params = params;
+    all_params << m_uniforms;
+    v3d::invoke(numQPUs, devnull, qpuCodeMem, m_unif, m_done, all_params);
+  }
 }
 
 
@@ -35,15 +35,23 @@ private:
   BufferObject  code_bo;
   Code          qpuCodeMem;
   Data          devnull;
+  Data          m_unif;   // Uniforms for invocation
+  Data          m_done;   // 'done' location for invocation
 
   void compile_intern() override;
   void invoke_intern(int numQPUs, IntList &params) override;
+  void prepare_invoke_intern(int numQPUs, IntList const &params) override;
+  std::vector<uint64_t> cache_opcodes() override { return to_opcodes(); }
+  void cache_opcodes(std::vector<uint64_t> const &code) override;
 
   void allocate();
   std::vector<uint64_t> to_opcodes();
   void emit_opcodes(FILE *f) override;
 };
 
+
+int load_imm_cost(Imm const &imm);
+
 }  // namespace v3d
 }  // namespace V3DLib
 
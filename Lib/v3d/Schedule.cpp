@@ -0,0 +1,590 @@
+#include "Schedule.h"
+#include <algorithm>
+#include <memory>
+#include "Support/basics.h"
+#include "Common/CompileData.h"
+#include "Target/DelaySlots.h"
+
+namespace V3DLib {
+namespace v3d {
+
+using namespace V3DLib::v3d::instr;
+
+namespace {
+
+template<typename AddAlu>
+bool can_be_mul_alu(AddAlu const &add_alu) {
+  return ((add_alu.op == V3D_QPU_A_OR && add_alu.a == add_alu.b)       // ORs with 1 source can be translated to mul alu MOV
+        || add_alu.op == V3D_QPU_A_ADD
+        || add_alu.op == V3D_QPU_A_SUB)
+       && (!add_alu.magic_write || add_alu.waddr < V3D_QPU_WADDR_NOP)  // Don't write to special registers in the mul alu
+  ;
+}
+
+
+bool convert_alu_op_to_mul_op(v3d_qpu_mul_op &mul_op, v3d::instr::Instr const &add_instr) {
+  switch (add_instr.alu.add.op) {
+    case V3D_QPU_A_OR:
+      if (add_instr.alu.add.a == add_instr.alu.add.b) {
+        mul_op = V3D_QPU_M_MOV;
+        return true;
+      }
+
+    case V3D_QPU_A_ADD:
+      mul_op = V3D_QPU_M_ADD;
+      return true;
+
+    case V3D_QPU_A_SUB:
+      mul_op = V3D_QPU_M_SUB;
+      return true;
+
+    default: break;
+  }
+
+  return false;
+}
+
+
+int const MAX_BLOCK_SIZE = 256;  // Limits the quadratic dependency determination
+
+
+/**
+ * Barriers are not moved and nothing is moved across them.
+ *
+ * These are instructions with control flow, implicit destinations or timing constraints
+ * on surrounding instructions.
+ */
+bool is_barrier(Instr const &instr) {
+  if (instr.is_label() || instr.is_branch()) return true;
+
+  // Full NOPs are there for a reason, e.g. branch delay slots and SFU waits
+  if (instr.is_nop() && !instr.has_signal(true)) return true;
+
+  auto const &sig = instr.sig;
+  if (sig.thrsw  || sig.ldunif || sig.ldunifa || sig.ldunifarf || sig.ldvary || sig.ldvpm
+   || sig.ldtlb  || sig.ldtlbu || sig.ucb     || sig.wrtmuc    || sig.rotate) {
+    return true;
+  }
+
+  if (instr_uses_sfu(&instr) || instr_uses_vpm(&instr)) return true;
+
+  switch (instr.alu.add.op) {
+    case V3D_QPU_A_FLAPUSH:
+    case V3D_QPU_A_FLBPUSH:
+    case V3D_QPU_A_FLPOP:
+    case V3D_QPU_A_SETMSF:
+    case V3D_QPU_A_SETREVF:
+    case V3D_QPU_A_MSF:
+    case V3D_QPU_A_REVF:
+    case V3D_QPU_A_VDWWT:
+    case V3D_QPU_A_BARRIERID:
+    case V3D_QPU_A_TMUWT:
+      return true;
+
+    default: break;
+  }
+
+  // Magic writes to anything but the accumulators and the TMU
+  auto special_write = [] (bool magic_write, uint8_t waddr) -> bool {
+    return magic_write && waddr > V3D_QPU_WADDR_NOP;
+  };
+
+  bool special = (!instr.add_nop() && special_write(instr.alu.add.magic_write, instr.alu.add.waddr))
+              || (!instr.mul_nop() && special_write(instr.alu.mul.magic_write, instr.alu.mul.waddr));
+
+  return special && !instr_writes_tmu(&instr);
+}
+
+
+/**
+ * Ordered instructions keep their relative order: uniform loads and TMU accesses.
+ */
+bool is_ordered(Instr const &instr) {
+  return instr.sig.ldunifrf || instr.sig.ldtmu || instr_writes_tmu(&instr);
+}
+
+
+/**
+ * @return true if instruction is a NOP with only a load signal, which can be merged into an ALU instruction
+ */
+bool is_signal_only(Instr const &instr) {
+  return instr.is_nop() && (instr.sig.ldunifrf || instr.sig.ldtmu) && !instr.sig.small_imm && !instr.flag_set();
+}
+
+
+/**
+ * Moves to self are removed by `combine()`, these should stay as they are
+ */
+bool is_self_move(Instr const &instr) {
+  if (instr.add_nop() || !instr.mul_nop() || instr.alu.add.op != V3D_QPU_A_OR) return false;
+
+  auto dst = instr.add_alu_dst();
+  auto a   = instr.add_alu_a();
+  auto b   = instr.add_alu_b();
+  return *a == *b && *dst == *a;
+}
+
+
+/**
+ * Pre: `first` comes before `second` in the original order
+ */
+bool depends(Instr const &first, Instr const &second) {
+  return have_dependency(first, second) || have_dependency(second, first)
+      || (is_ordered(first) && is_ordered(second))
+      || (instr_uses_flags(&first) && instr_uses_flags(&second));
+}
+
+
+/**
+ * Rules for filling branch delay slots on v3d, see `fillDelaySlots()`
+ */
+struct DelaySlotRules {
+  static bool reads_r4_r5(Instr const &instr) {
+    auto is_r4_r5 = [] (v3d_qpu_mux mux) -> bool {
+      return mux == V3D_QPU_MUX_R4 || mux == V3D_QPU_MUX_R5;
+    };
+
+    return (!instr.add_nop() && (is_r4_r5(instr.alu.add.a) || is_r4_r5(instr.alu.add.b)))
+        || (!instr.mul_nop() && (is_r4_r5(instr.alu.mul.a) || is_r4_r5(instr.alu.mul.b)));
+  }
+
+  bool is_slot_nop(Instr const &instr) const {
+    return !instr.is_label() && !instr.is_branch() && instr.is_nop() && !instr.has_signal(true);
+  }
+
+  /**
+   * Reads of r4 and r5 are excluded, because they may depend on the distance to an SFU write.
+   */
+  bool can_cross(Instr const &instr) const {
+    if (is_slot_nop(instr)) return true;
+    return instr.type == V3D_QPU_INSTR_TYPE_ALU && !is_barrier(instr) && !reads_r4_r5(instr);
+  }
+
+  bool is_plain(Instr const &instr) const {
+    return !is_slot_nop(instr) && can_cross(instr) && !is_ordered(instr) && !instr_uses_flags(&instr);
+  }
+
+  bool depends(Instr const &first, Instr const &second) const { return v3d::depends(first, second); }
+  bool hazard(Instr const &prev, Instr const &next) const     { return false; }
+  bool is_unconditional(Instr const &instr) const { return instr.branch.cond == V3D_QPU_BRANCH_COND_ALWAYS; }
+  Instr nop() const                               { return Instr(); }
+  void retarget(Instr &instr, int label) const    { instr.label(label); }
+
+  Instr label(int val) const {
+    Instr ret;
+    ret.is_label(true);
+    ret.label(val);
+    return ret;
+  }
+};
+
+
+/**
+ * Put the load signal of `sig_instr` in `alu_instr`
+ */
+bool fill_signal(Instr const &sig_instr, Instr const &alu_instr, Instr &dst) {
+  if (alu_instr.is_nop() || alu_instr.has_signal() || alu_instr.flag_set()) return false;
+
+  // Empirically determined: TMU read and load don't mix
+  if (instr_writes_tmu(&alu_instr)) return false;
+
+  dst = alu_instr;
+  dst.sig.ldunifrf = sig_instr.sig.ldunifrf;
+  dst.sig.ldtmu    = sig_instr.sig.ldtmu;
+  dst.sig_addr     = sig_instr.sig_addr;
+  dst.sig_magic    = sig_instr.sig_magic;
+  dst.comment(sig_instr.comment());
+
+  return true;
+}
+
+
+/**
+ * Put the ALU operations of two independent instructions in a single instruction
+ *
+ * Pre: `first` comes before `second` in the original order
+ */
+bool pair_alu(Instr const &first, Instr const &second, Instr &dst) {
+  if (first.has_signal() || second.has_signal()) return false;
+  if (!first.add_nop()  && !first.mul_nop())  return false;
+  if (!second.add_nop() && !second.mul_nop()) return false;
+
+  // Don't mix TMU writes and flags, same as for loads
+  if (instr_writes_tmu(&first)  && instr_uses_flags(&second)) return false;
+  if (instr_writes_tmu(&second) && instr_uses_flags(&first))  return false;
+
+  bool do_converse;
+  if (!can_combine(first, second, do_converse)) return false;
+
+  auto const &add_instr = do_converse?second:first;
+  auto const &mul_instr = do_converse?first:second;
+  if (mul_instr.flag_set()) return false;  // See `combine()`
+
+  dst = add_instr;
+  return add_alu_to_mul_alu(mul_instr, dst);
+}
+
+
+/**
+ * Try to merge two independent instructions of a block into one
+ */
+bool merge(Instructions const &block, int a, int b, Instr &dst) {
+  if (is_self_move(block[a]) || is_self_move(block[b])) return false;
+
+  int first  = std::min(a, b);
+  int second = std::max(a, b);
+  bool success;
+
+  if (is_signal_only(block[a])) {
+    success = fill_signal(block[a], block[b], dst);
+  } else if (is_signal_only(block[b])) {
+    success = fill_signal(block[b], block[a], dst);
+  } else {
+    success = pair_alu(block[first], block[second], dst);
+  }
+
+  return success && instr_can_pack(&dst);
+}
+
+
+/**
+ * List scheduling of a block of instructions without barriers
+ *
+ * In each step, the ready instruction with highest priority is selected, together
+ * with the best other ready instruction it can be merged with. Priority is, in order:
+ *
+ *  - TMU writes first, `ldtmu` last. This moves TMU requests away from the loads, to hide the latency.
+ *  - length of the dependency chain to the end of the block
+ *  - original order
+ *
+ * @return number of merged instructions
+ */
+int schedule_block(Instructions &block, Instructions &ret) {
+  int const n = (int) block.size();
+  assert(n > 0);
+
+  // The header belongs to the start of the block, not to the instruction
+  std::string header = block[0].header();
+  if (!header.empty()) {
+    std::string comment = block[0].comment();
+    block[0].clear_comments();
+    block[0].comment(comment);
+  }
+
+  std::vector<std::vector<int>> succs(n);
+  std::vector<int> num_preds(n, 0);
+
+  for (int i = 0; i < n; i++) {
+    for (int j = i + 1; j < n; j++) {
+      if (depends(block[i], block[j])) {
+        succs[i].push_back(j);
+        num_preds[j]++;
+      }
+    }
+  }
+
+  std::vector<int> height(n, 1);
+  for (int i = n - 1; i >= 0; i--) {
+    for (auto s : succs[i]) {
+      height[i] = std::max(height[i], height[s] + 1);
+    }
+  }
+
+  auto prio_class = [&block] (int i) -> int {
+    if (instr_writes_tmu(&block[i])) return 2;
+    if (block[i].sig.ldtmu) return 0;
+    return 1;
+  };
+
+  auto better = [&] (int a, int b) -> bool {
+    if (prio_class(a) != prio_class(b)) return prio_class(a) > prio_class(b);
+    if (height[a] != height[b]) return height[a] > height[b];
+    return a < b;
+  };
+
+  std::vector<int> ready;
+  for (int i = 0; i < n; i++) {
+    if (num_preds[i] == 0) ready.push_back(i);
+  }
+
+  auto release = [&] (int i) {
+    for (auto s : succs[i]) {
+      num_preds[s]--;
+      if (num_preds[s] == 0) ready.push_back(s);
+    }
+  };
+
+  int first_out = (int) ret.size();
+  int count     = 0;
+  int emitted   = 0;
+
+  while (!ready.empty()) {
+    std::sort(ready.begin(), ready.end(), better);
+    int best = ready.front();
+    ready.erase(ready.begin());
+
+    Instr out = block[best];
+    int partner = -1;
+
+    for (int p = 0; p < (int) ready.size(); p++) {
+      Instr tmp;
+      if (merge(block, best, ready[p], tmp)) {
+        partner = ready[p];
+        out = tmp;
+        ready.erase(ready.begin() + p);
+        break;
+      }
+    }
+
+    ret << out;
+    emitted++;
+    release(best);
+
+    if (partner != -1) {
+      release(partner);
+      count++;
+    }
+  }
+
+  assertq(emitted + count == n, "schedule_block(): not all instructions scheduled", true);
+
+  if (!header.empty()) {
+    ret[first_out].header(header);
+  }
+
+  return count;
+}
+
+}  // anon namespace
+
+
+/**
+ * Check if given instructions have a dependency on each other.
+ *
+ * Pre: Instruction 'first' is predecessor of 'second'.
+ * There is a dependency if:
+ *   - instruction 'second' has a source which is a destination of 'first'.
+ *   - instruction 'second' has a destination which is a destination of 'first'.
+ */
+bool have_dependency(v3d::instr::Instr const &first, v3d::instr::Instr const &second) {
+  return second.is_src(first.sig_dest())
+      || second.is_src(first.add_dest())
+      || second.is_src(first.mul_dest())
+      || second.is_dst(first.sig_dest())
+      || second.is_dst(first.add_dest())
+      || second.is_dst(first.mul_dest());
+}
+
+
+bool can_combine(v3d::instr::Instr const &instr1, v3d::instr::Instr const &instr2, bool &do_converse) {
+  assert(instr1.add_nop() || instr1.mul_nop());  // Not expecting fully filled instructions
+  assert(instr2.add_nop() || instr2.mul_nop());  // idem
+
+  // Skip branches
+  if (instr1.type == V3D_QPU_INSTR_TYPE_BRANCH || instr2.type == V3D_QPU_INSTR_TYPE_BRANCH) return false;
+
+  // Skip special signals for now - there might be something to be won with the ld's
+  if (instr1.has_signal() || instr2.has_signal()) return false;
+
+  // Skip full NOPs, they are there for a reason
+  if (instr1.is_nop()) return false;
+  if (instr2.is_nop()) return false;
+
+  // skip both mul for now, needs extra logic and is probably scarce
+  if (!instr1.mul_nop() && !instr2.mul_nop())  {
+    return false;
+  }
+
+
+  auto magic_write1 = instr1.mul_nop()?instr1.alu.add.magic_write:instr1.alu.mul.magic_write;
+  auto waddr1       = instr1.mul_nop()?instr1.alu.add.waddr:instr1.alu.mul.waddr;
+  auto magic_write2 = instr2.mul_nop()?instr2.alu.add.magic_write:instr2.alu.mul.magic_write;
+  auto waddr2       = instr2.mul_nop()?instr2.alu.add.waddr:instr2.alu.mul.waddr;
+
+  // Skip combined special waddresses - important for tmu operations
+  if ((magic_write1 && waddr1 >= V3D_QPU_WADDR_NOP)
+   && (magic_write2 && waddr2 >= V3D_QPU_WADDR_NOP)) return false;
+
+  // Disallow same dest reg
+  if (waddr1 == waddr2 && magic_write1 == magic_write2) return false;
+
+
+  // Don't combine set conditional with use conditional
+  if (instr1.flags.apf && instr2.flags.ac) return false;
+
+
+  // Output instr1 should not be used as input instr2
+  auto a2 = instr2.mul_nop()?instr2.alu.add.a:instr2.alu.mul.a;
+  auto b2 = instr2.mul_nop()?instr2.alu.add.b:instr2.alu.mul.b;
+
+  bool is_rf1 = !magic_write1;
+  if (is_rf1) {
+    if (a2 == V3D_QPU_MUX_A && instr2.raddr_a == waddr1) return false;
+    if (b2 == V3D_QPU_MUX_A && instr2.raddr_a == waddr1) return false;
+
+    if (a2 == V3D_QPU_MUX_B && !instr2.sig.small_imm && instr2.raddr_b == waddr1) return false;
+    if (b2 == V3D_QPU_MUX_B && !instr2.sig.small_imm && instr2.raddr_b == waddr1) return false;
+  } else {
+    if (a2 < V3D_QPU_MUX_A && a2 == waddr1) return false;
+    if (b2 < V3D_QPU_MUX_A && b2 == waddr1) return false;
+  }
+
+  // mul/alu splits can always be combined
+  if (instr1.mul_nop() && !instr2.mul_nop()) {
+    do_converse = false;
+    return true;
+  }
+
+  if (!instr1.mul_nop() && instr2.mul_nop()) {
+    do_converse = true;
+    return true;
+  }
+
+
+  //
+  // Determine add alu instructions with mul alu equivalents
+  //
+  if (can_be_mul_alu(instr2.alu.add)) {
+    do_converse = false;
+    return true;
+  }
+
+  if (can_be_mul_alu(instr1.alu.add)) {
+    do_converse = true;
+    return true;
+  }
+
+  return false;
+}
+
+
+/**
+ * Set the mul alu with the add alu part of in_instr
+ */
+bool add_alu_to_mul_alu(Instr const &in_instr, Instr &dst) {
+  assert((!in_instr.add_nop() &&  in_instr.mul_nop()) 
+      || ( in_instr.add_nop() && !in_instr.mul_nop())); 
+  assert(dst.mul_nop()); 
+
+  //
+  // Get used dst and src
+  //
+  std::unique_ptr<Location> dst_loc;
+  std::unique_ptr<Source> src_a;
+  std::unique_ptr<Source> src_b;
+
+  if (in_instr.mul_nop()) {
+    v3d_qpu_mul_op mul_op;
+    if (!convert_alu_op_to_mul_op(mul_op, in_instr)) return false;
+    dst.alu.mul.op = mul_op;
+
+    // Take values from add alu 
+    dst_loc = in_instr.add_alu_dst();
+    src_a   = in_instr.add_alu_a();
+    src_b   = in_instr.add_alu_b();
+  } else {
+    dst.alu.mul.op = in_instr.alu.mul.op;
+
+    // Take values from mul alu 
+    dst_loc = in_instr.mul_alu_dst();
+    src_a   = in_instr.mul_alu_a();
+    src_b   = in_instr.mul_alu_b();
+  }
+  assert(dst_loc.get() != nullptr);
+  assert(src_a.get()   != nullptr);
+  assert(src_b.get()   != nullptr);
+
+  if (!dst.alu_mul_set(*dst_loc, *src_a, *src_b)) return false;
+
+  if (in_instr.mul_nop()) {
+    dst.alu.mul.output_pack = in_instr.alu.add.output_pack;
+    dst.alu.mul.a_unpack    = in_instr.alu.add.a_unpack;
+    dst.alu.mul.b_unpack    = in_instr.alu.add.b_unpack;
+
+    dst.flags.mc  = in_instr.flags.ac;
+    dst.flags.mpf = in_instr.flags.apf;
+    dst.flags.muf = in_instr.flags.auf;
+  } else {
+    dst.alu.mul.output_pack = in_instr.alu.mul.output_pack;
+    dst.alu.mul.a_unpack    = in_instr.alu.mul.a_unpack;
+    dst.alu.mul.b_unpack    = in_instr.alu.mul.b_unpack;
+
+    dst.flags.mc  = in_instr.flags.mc;
+    dst.flags.mpf = in_instr.flags.mpf;
+    dst.flags.muf = in_instr.flags.muf;
+  }
+
+  dst.header(in_instr.header());
+  dst.comment(in_instr.comment());
+
+  return true;
+}
+
+
+
+/**
+ * Reorder and pack the instructions within basic blocks.
+ *
+ * v3d can issue an add and a mul ALU operation together with a signal in a single instruction.
+ * Unlike `combine()`, which only looks at adjacent instructions, this builds the dependency
+ * graph of each block and fills the instructions from anywhere within it:
+ *
+ *  - independent add and mul operations are paired
+ *  - `ldunifrf` and `ldtmu` signals are moved into ALU instructions
+ *  - TMU requests are moved up and `ldtmu` down, so that other work is done while waiting for memory
+ *
+ * Dependencies are register reads and writes, the order of uniform loads and TMU accesses,
+ * and the setting and use of flags. Blocks are delimited by barriers (see `is_barrier()`)
+ * and instructions with a header.
+ *
+ * @return number of packed slots, i.e. the number of instructions removed
+ */
+int schedule(Instructions &instructions) {
+  Instructions ret;
+  Instructions block;
+  int count = 0;
+
+  auto flush = [&] () {
+    if (block.empty()) return;
+    count += schedule_block(block, ret);
+    block.clear();
+  };
+
+  for (auto const &instr : instructions) {
+    if (is_barrier(instr)) {
+      flush();
+      ret << instr;
+      continue;
+    }
+
+    if (!instr.header().empty() || (int) block.size() >= MAX_BLOCK_SIZE) {
+      flush();
+    }
+
+    block << instr;
+  }
+
+  flush();
+
+  instructions = ret;
+  compile_data().num_packed_slots += count;
+  return count;
+}
+
+
+/**
+ * Fill the branch delay slots with useful instructions.
+ *
+ * To be called after `schedule()` and `combine()`, so that the instructions put in
+ * the delay slots are already packed.
+ *
+ * @return number of delay slots filled
+ */
+int fill_delay_slots(Instructions &instructions) {
+  int count = fillDelaySlots(instructions, DelaySlotRules());
+  compile_data().num_delay_slots_filled += count;
+  return count;
+}
+
+}  // namespace v3d
+}  // namespace V3DLib
@@ -0,0 +1,18 @@
+#ifndef _V3DLIB_V3D_SCHEDULE_H_
+#define _V3DLIB_V3D_SCHEDULE_H_
+#include "instr/Instr.h"
+
+namespace V3DLib {
+namespace v3d {
+
+bool have_dependency(instr::Instr const &first, instr::Instr const &second);
+bool can_combine(instr::Instr const &instr1, instr::Instr const &instr2, bool &do_converse);
+bool add_alu_to_mul_alu(instr::Instr const &in_instr, instr::Instr &dst);
+
+int schedule(Instructions &instructions);
+int fill_delay_slots(Instructions &instructions);
+
+}  // namespace v3d
+}  // namespace V3DLib
+
+#endif  // _V3DLIB_V3D_SCHEDULE_H_
@@ -2,9 +2,12 @@
 #include <iostream>
 #include "Support/basics.h"
 #include "Support/Timer.h"
+#include "Support/Platform.h"
 #include "Source/Translate.h"
 #include "Source/Stmt.h"
 #include "Liveness/Liveness.h"
+#include "Liveness/Spill.h"
+#include "Liveness/Coloring.h"
 #include "Target/Subst.h"
 #include "vc4/DMA/DMA.h"
 #include "Target/instr/Mnemonics.h"
@@ -34,53 +37,73 @@ Instr::List SourceTranslate::store_var(Var dst_addr, Var src) {
 
 
 void SourceTranslate::regAlloc(Instr::List &instrs) {
-  //Timer t1("regAlloc", true);
-  int numVars = VarGen::count();
+  {
+    PassTimer t("liveness", instrs);
+    Liveness::optimize(instrs, VarGen::count());
+  }
+
+  PassTimer t("regalloc", instrs);
+
+  Spiller spiller(instrs);
+  bool done = false;
+
+  while (!done) {
+    done = true;
+    int numVars = VarGen::count();  // Spilling adds variables
+
+    // Step 0 - Perform liveness analysis
+    //Timer t3("regAlloc compute");
+    Liveness live(numVars);
+    live.compute(instrs);
+    //t3.end();
 
-  //Timer t2("regAlloc optimize");
-  Liveness::optimize(instrs, numVars);
-  //t2.end();
+    // Step 2 - For each variable, determine all variables ever live at the same time
+    //Timer t4("regAlloc liveWith");
+    LiveSets liveWith(numVars);
+    liveWith.init(instrs, live);
+    //t4.end();
 
-  // Step 0 - Perform liveness analysis
-  //Timer t3("regAlloc compute");
-  Liveness live(numVars);
-  live.compute(instrs);
-  //t3.end();
+    //Timer t5("regAlloc Allocate reg to var");
 
-  // Step 2 - For each variable, determine all variables ever live at the same time
-  //Timer t4("regAlloc liveWith");
-  LiveSets liveWith(numVars);
-  liveWith.init(instrs, live);
-  //t4.end();
+    // Step 3 - Allocate a register to each variable, in graph-coloring order
+    Coloring coloring(instrs, liveWith, live.reg_usage(), Platform::size_regfile());
 
-  //Timer t5("regAlloc Allocate reg to var");
+    for (auto i : coloring.order()) {
+      if (live.reg_usage()[i].reg.tag != NONE) continue;
 
-  // Step 3 - Allocate a register to each variable
-  for (int i = 0; i < numVars; i++) {
-    if (live.reg_usage()[i].reg.tag != NONE) continue;
+      auto possible = liveWith.possible_registers(i, live.reg_usage());
 
-    auto possible = liveWith.possible_registers(i, live.reg_usage());
+      live.reg_usage()[i].reg.tag = REG_A;
+      RegId regId = coloring.choose_register(i, possible);
 
-    live.reg_usage()[i].reg.tag = REG_A;
-    RegId regId = LiveSets::choose_register(possible, false);
+      if (regId >= 0) {
+        live.reg_usage()[i].reg.regId = regId;
+        continue;
+      }
+
+      if (spiller.spill(live, liveWith, i)) {
+        done = false;  // Code changed, start over
+        break;
+      }
 
-    if (regId < 0) {
       std::string buf = "v3d regAlloc(): register allocation failed for target instruction ";
       buf << i << ": " << instrs[i].mnemonic();
       error(buf, true);
-    } else {
-      live.reg_usage()[i].reg.regId = regId;
     }
-  }
 
-  //t5.end();
+    //t5.end();
 
-  compile_data.allocated_registers_dump = live.reg_usage().dump(true);
+    if (!done) continue;
 
-  // Step 4 - Apply the allocation to the code
-  //Timer t6("regAlloc allocate_registers");
-  allocate_registers(instrs, live.reg_usage());
-  //t6.end();
+    spiller.finish();
+    compile_data().allocated_registers_dump = live.reg_usage().dump(true);
+
+    // Step 4 - Apply the allocation to the code
+    //Timer t6("regAlloc allocate_registers");
+    allocate_registers(instrs, live.reg_usage());
+    compile_data().num_moves_removed = remove_redundant_moves(instrs);
+    //t6.end();
+  }
 }
 
 
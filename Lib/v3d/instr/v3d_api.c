@@ -499,6 +499,35 @@ uint64_t instr_pack(struct v3d_qpu_instr const *instr) {
 }
 
 
+/**
+ * @return true if the instruction can be encoded, false otherwise
+ */
+bool instr_can_pack(struct v3d_qpu_instr const *instr) {
+  uint64_t packed_instr;
+  return v3d_qpu_instr_pack(&devinfo, instr, &packed_instr);
+}
+
+
+bool instr_writes_tmu(struct v3d_qpu_instr const *instr) {
+  return v3d_qpu_writes_tmu(instr);
+}
+
+
+bool instr_uses_flags(struct v3d_qpu_instr const *instr) {
+  return v3d_qpu_reads_flags(instr) || v3d_qpu_writes_flags(instr);
+}
+
+
+bool instr_uses_sfu(struct v3d_qpu_instr const *instr) {
+  return v3d_qpu_uses_sfu(instr);
+}
+
+
+bool instr_uses_vpm(struct v3d_qpu_instr const *instr) {
+  return v3d_qpu_uses_vpm(instr);
+}
+
+
 const char *instr_mnemonic(const struct v3d_qpu_instr *instr) {
   static char buffer[256];
 
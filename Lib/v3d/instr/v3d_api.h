@@ -17,6 +17,11 @@ extern struct v3d_device_info const v3d_devinfo;
 void instr_dump(char *buffer, struct v3d_qpu_instr *instr);
 bool instr_unpack(uint64_t packed_instr, struct v3d_qpu_instr *instr);
 uint64_t instr_pack(struct v3d_qpu_instr const *instr);
+bool instr_can_pack(struct v3d_qpu_instr const *instr);
+bool instr_writes_tmu(struct v3d_qpu_instr const *instr);
+bool instr_uses_flags(struct v3d_qpu_instr const *instr);
+bool instr_uses_sfu(struct v3d_qpu_instr const *instr);
+bool instr_uses_vpm(struct v3d_qpu_instr const *instr);
 const char *instr_mnemonic(const struct v3d_qpu_instr *instr);
 bool small_imm_pack(uint32_t value, uint32_t *packed_small_immediate);
 
@@ -568,19 +568,35 @@ Instr::List Stmt::setupVPMWrite() {
  * Load vector `dst` from address in main memory as specified by `e`
  */
 Instr::List loadRequest(Var &dst, Expr &e) {
+  return loadRequest(Reg(dst), Reg(e.deref_ptr()->var()));
+}
+
+
+/**
+ * Load vector `dst` from the address in register `addr`
+ *
+ * @param wait_store  if true, first complete any pending DMA store.
+ *                    Needed if a previous store may have been to the same address.
+ */
+Instr::List loadRequest(Reg dst, Reg addr, bool wait_store) {
   using namespace V3DLib::Target::instr;
 
-  Reg reg(e.deref_ptr()->var());
   int setup = vpmSetupReadCode(1, 0, 1);
 
   Instr::List ret;
-  ret << genSetReadPitch(4).comment("Start DMA load var")                          // Setup DMA
+
+  if (wait_store) {
+    ret << genWaitDMAStore();
+  }
+
+  ret << genSetReadPitch(4)                                                        // Setup DMA
       << genSetupDMALoad(16, 1, 1, 1, QPU_ID)
-      << genStartDMALoad(reg)                                                      // Start DMA load
+      << genStartDMALoad(addr)                                                     // Start DMA load
       << genWaitDMALoad(false)                                                     // Wait for DMA
       << genSetupVPMLoad(QPU_ID, setup)                                            // Setup VPM
       << shl(dst, Target::instr::VPM_READ, 0).comment("End DMA load var");         // Get from VPM
 
+  ret.front().comment("Start DMA load var");
   return ret;
 }
 
@@ -7,6 +7,7 @@ namespace V3DLib {
 namespace DMA {
 
 Instr::List loadRequest(Var &dst, Expr &e);
+Instr::List loadRequest(Reg dst, Reg addr, bool wait_store = false);
 Instr::List storeRequest(Var dst_addr, Var src);
 bool translate_stmt(Instr::List &seq, int in_tag, Stmt &s);
 
@@ -43,12 +43,7 @@ int num_params(IntList const &params) {
  */
 void load_uniforms(Data &uniforms, IntList const &params, int numQPUs) {
   assert(0 < numQPUs && numQPUs <= Platform::max_qpus());
-
-  if (!uniforms.allocated()) {
-    uniforms.alloc(num_params(params)*Platform::max_qpus());
-  } else {
-    assert((int) uniforms.size() == num_params(params)*Platform::max_qpus());
-  }
+  assert((int) uniforms.size() == num_params(params)*Platform::max_qpus());
 
   int offset = 0;
   for (int i = 0; i < numQPUs; i++) {
@@ -72,7 +67,7 @@ void load_uniforms(Data &uniforms, IntList const &params, int numQPUs) {
  * Doing this for max number of QPUs, so that num QPUs can be changed dynamically on calls.
  */
 void init_launch_messages(Data &launch_messages, Code const &code, IntList const &params, Data const &uniforms) {
-  assertq(!uniforms.empty(), "init_launch_messages(): expecting values for uniforms");
+  assertq(uniforms.allocated(), "init_launch_messages(): expecting memory for uniforms");
   if (launch_messages.allocated()) return;  // Already done, don't redo
 
   launch_messages.alloc(2*Platform::max_qpus());
@@ -116,12 +111,27 @@ void invoke(int numQPUs, Data const &launch_messages) {
 }  // anon namespace
 
 
+/**
+ * Allocate the uniforms and launch messages, if not already done so
+ *
+ * For asynchronous launches, this is called on the calling thread, so that `invoke()`
+ * does not allocate on the worker thread.
+ */
+void MailBoxInvoke::prepare(Code const &code, IntList const &params) {
+  assertq(!code.empty(), "MailBoxInvoke::prepare(): no code to invoke", true );
+
+  if (!m_uniforms.allocated()) {
+    m_uniforms.alloc(num_params(params)*Platform::max_qpus());
+  }
+
+  init_launch_messages(launch_messages, code, params, m_uniforms);
+}
+
+
 void MailBoxInvoke::invoke(int numQPUs, Code const &code, IntList const &params) {
   //debug("Calling MailBoxInvoke::invoke()");
-  assertq(!code.empty(), "MailBoxInvoke::invoke(): no code to invoke", true );
-
+  prepare(code, params);  // Does nothing if already prepared
   load_uniforms(m_uniforms, params, numQPUs);
-  init_launch_messages(launch_messages, code, params, m_uniforms);
 
   V3DLib::invoke(numQPUs, launch_messages);
 }
@@ -13,6 +13,7 @@ namespace V3DLib {
  */
 class MailBoxInvoke {
 public:
+  void prepare(Code const &code, IntList const &params);
   void invoke(int numQPUs, Code const &code, IntList const &params);
 
 private:
@@ -4,12 +4,14 @@
 #include "Source/Lang.h"
 #include "Source/Translate.h"
 #include "Target/RemoveLabels.h"
+#include "Target/DelaySlots.h"
 #include "vc4.h"
 #include "DMA/Operations.h"
 #include "dump_instr.h"
 #include "Target/instr/Mnemonics.h"
 #include "SourceTranslate.h"  // add_uniform_pointer_offset()
 #include "Instr.h"
+#include "Common/CompileData.h"
 
 namespace V3DLib {
 namespace vc4 {
@@ -73,6 +75,89 @@ CodeList encode_instructions(V3DLib::Instr::List &instrs) {
 }
 
 
+/**
+ * Rules for filling branch delay slots on vc4, see `fillDelaySlots()`
+ */
+struct DelaySlotRules {
+  using Instr = V3DLib::Instr;
+
+  static bool is_plain_reg(Reg const &reg) {
+    if (reg.tag == REG_A || reg.tag == REG_B) return true;
+    if (reg.tag == ACC)                       return (0 <= reg.regId && reg.regId <= 3);  // Not r4 and r5
+    return false;
+  }
+
+  bool is_slot_nop(Instr const &instr) const {
+    return instr.tag == NO_OP && !instr.break_point();
+  }
+
+  /**
+   * ALU operations on regfile registers and the general-purpose accumulators only.
+   * This excludes everything with side effects or timing constraints: uniform loads, rotates,
+   * and the special registers for TMU, SFU, DMA and VPM.
+   */
+  bool can_cross(Instr const &instr) const {
+    if (is_slot_nop(instr)) return true;
+    if (instr.tag != LI && instr.tag != ALU) return false;
+    if (instr.break_point()) return false;
+    if (instr.tag == ALU && (instr.isUniformLoad() || instr.isRot())) return false;
+    if (!is_plain_reg(instr.dst_reg())) return false;
+
+    for (auto const &reg : instr.src_regs()) {
+      if (is_plain_reg(reg)) continue;
+      if (reg.tag == SPECIAL && (reg.regId == SPECIAL_ELEM_NUM || reg.regId == SPECIAL_QPU_NUM)) continue;
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Flag settings stay where they are, so that the branch conditions are not affected
+   */
+  bool is_plain(Instr const &instr) const {
+    return instr.tag != NO_OP && can_cross(instr) && !instr.set_cond().flags_set();
+  }
+
+  bool depends(Instr const &first, Instr const &second) const {
+    auto first_src  = first.src_regs(true);
+    auto second_src = second.src_regs(true);
+    Reg first_dst   = first.dst_reg();
+    Reg second_dst  = second.dst_reg();
+
+    if (first_dst.tag != NONE) {
+      if (first_dst == second_dst || second_src.count(first_dst) > 0) return true;
+    }
+
+    if (second_dst.tag != NONE && first_src.count(second_dst) > 0) return true;
+
+    bool first_flags  = first.set_cond().flags_set();
+    bool second_flags = second.set_cond().flags_set();
+    bool first_cond   = first.has_dest() && !first.is_always();
+    bool second_cond  = second.has_dest() && !second.is_always();
+
+    return (first_flags && (second_flags || second_cond)) || (first_cond && second_flags);
+  }
+
+  /**
+   * A regfile register can not be read in the instruction directly after it was written,
+   * and an accumulator can not be rotated directly after it was written.
+   */
+  bool hazard(Instr const &prev, Instr const &next) const {
+    if (!prev.has_dest() || !next.has_dest()) return false;
+
+    Reg dst = prev.dst_reg();
+    if (dst.tag == REG_A || dst.tag == REG_B) return next.is_src_reg(dst);
+    if (dst.tag == ACC && next.tag == ALU && next.isRot()) return next.is_src_reg(dst);
+    return false;
+  }
+
+  bool is_unconditional(Instr const &instr) const { return instr.branch_cond().is_always(); }
+  Instr nop() const                               { return Instr::nop(); }
+  Instr label(Label val) const                    { return Target::instr::label(val); }
+  void retarget(Instr &instr, Label val) const    { instr.branch_label(val); }
+};
+
 } // anon namespace
 
 KernelDriver::KernelDriver() : V3DLib::KernelDriver(Vc4Buffer) {}
@@ -115,7 +200,9 @@ void KernelDriver::encode() {
   if (!qpuCodeMem.empty()) return;  // Don't bother if already encoded
   if (has_errors()) return;         // Don't do this if compile errors occured
 
+  PassTimer t("encode", m_targetCode);
   CodeList code = encode_instructions(m_targetCode);
+  t.instrs_after(code.size());
 
   // Allocate memory for QPU code
   qpuCodeMem.alloc(code.size());
@@ -155,8 +242,12 @@ void KernelDriver::compile_intern() {
   // TODO Fix it one day (sigh)
 
   obtain_ast();
+  if (load_from_cache()) return;
 
-  V3DLib::translate_stmt(m_targetCode, m_body);
+  {
+    PassTimer t("translate_stmt", m_targetCode);
+    V3DLib::translate_stmt(m_targetCode, m_body);
+  }
 
   {
     using namespace V3DLib::Target::instr;  // for mov()
@@ -177,10 +268,37 @@ void KernelDriver::compile_intern() {
 
   compile_postprocess(m_targetCode);
 
-  // Translate branch-to-labels to relative branches
-  removeLabels(m_targetCode);
+  {
+    PassTimer t("delay_slots", m_targetCode);
+    compile_data().num_delay_slots_filled += fillDelaySlots(m_targetCode, DelaySlotRules());
+  }
+
+  {
+    // Translate branch-to-labels to relative branches
+    PassTimer t("removeLabels", m_targetCode);
+    removeLabels(m_targetCode);
+  }
 
   encode();
+  store_in_cache();
+}
+
+
+std::vector<uint64_t> KernelDriver::cache_opcodes() {
+  assert(!qpuCodeMem.empty());
+  return std::vector<uint64_t>(qpuCodeMem.ptr(), qpuCodeMem.ptr() + qpuCodeMem.size());
+}
+
+
+/**
+ * Set the code memory from opcodes retrieved from the kernel cache
+ */
+void KernelDriver::cache_opcodes(std::vector<uint64_t> const &code) {
+  assert(qpuCodeMem.empty());
+  assert(!code.empty());
+
+  qpuCodeMem.alloc((uint32_t) code.size());
+  qpuCodeMem.copyFrom(code);
 }
 
 
@@ -188,6 +306,11 @@ void KernelDriver::invoke_intern(int numQPUs, IntList &params) {
   MailBoxInvoke::invoke(numQPUs, qpuCodeMem, params);
 }
 
+
+void KernelDriver::prepare_invoke_intern(int numQPUs, IntList const &params) {
+  MailBoxInvoke::prepare(qpuCodeMem, params);
+}
+
 }  // namespace vc4
 }  // namespace V3DLib
 
@@ -24,6 +24,9 @@ private:
   void kernelFinish();
   void compile_intern() override;
   void invoke_intern(int numQPUs, IntList &params) override;
+  void prepare_invoke_intern(int numQPUs, IntList const &params) override;
+  std::vector<uint64_t> cache_opcodes() override;
+  void cache_opcodes(std::vector<uint64_t> const &code) override;
 
   void emit_opcodes(FILE *f) override;
 };
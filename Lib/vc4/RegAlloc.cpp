@@ -4,6 +4,9 @@
 #include "Support/basics.h"
 #include "Support/Timer.h"
 #include "Target/Subst.h"
+#include "Liveness/Spill.h"
+#include "Liveness/Coloring.h"
+#include "Support/Platform.h"
 #include "SourceTranslate.h"
 #include "Common/CompileData.h"
 
@@ -150,85 +153,108 @@ void regAlloc(Instr::List &instrs) {
   //Timer t1("vc4 regAlloc", true);
   //std::cout << count_reg_types(instrs).dump() << std::endl;
 
-  int numVars = VarGen::count();
+  {
+    PassTimer t("liveness", instrs);
+    Liveness::optimize(instrs, VarGen::count());
+  }
 
-//{
-//  Timer t("vc4 regAlloc optimize", true);
-  Liveness::optimize(instrs, numVars);
-//}
+  PassTimer t("regalloc", instrs);
+
+  Spiller spiller(instrs);
+  bool done = false;
+
+  while (!done) {
+    done = true;
+    int numVars = VarGen::count();  // Spilling adds variables
 
-  // Step 0 - Perform liveness analysis
-  Liveness live(numVars);
+    // Step 0 - Perform liveness analysis
+    Liveness live(numVars);
 //{
 //  Timer t("vc4 regAlloc compute", true);
-  live.compute(instrs);
+    live.compute(instrs);
 //}
 
+    // Step 1 - For each variable, determine a preference for register file A or B.
+    std::vector<int> prefA(numVars);
+    std::vector<int> prefB(numVars);
 
-  // Step 1 - For each variable, determine a preference for register file A or B.
-  int *prefA = new int [numVars];
-  int *prefB = new int [numVars];
+    regalloc_determine_regfileAB(instrs, prefA.data(), prefB.data(), numVars);
 
-  regalloc_determine_regfileAB(instrs, prefA, prefB, numVars);
-
-  // Step 2 - For each variable, determine all variables ever live at same time
-  LiveSets liveWith(numVars);
+    // Step 2 - For each variable, determine all variables ever live at same time
+    LiveSets liveWith(numVars);
 //{
 //  Timer t("vc4 regAlloc liveWith", true);
-  liveWith.init(instrs, live);
+    liveWith.init(instrs, live);
 //}
-  //debug(liveWith.dump());
+    //debug(liveWith.dump());
 
-  // Step 3 - Allocate a register to each variable
-  RegTag prevChosenRegFile = REG_B;
+    // Step 3 - Allocate a register to each variable, in graph-coloring order
+    // Variables can go in either register file, so both count for the number of registers
+    Coloring coloring(instrs, liveWith, live.reg_usage(), 2*Platform::size_regfile());
+    RegTag prevChosenRegFile = REG_B;
 
 //{
 //  Timer t("vc4 regAlloc allocate_reg", true);
 
-  for (int i = 0; i < numVars; i++) {
-    if (live.reg_usage()[i].reg.tag != NONE) continue;
-    if (live.reg_usage()[i].unused()) continue;
+    for (auto i : coloring.order()) {
+      if (live.reg_usage()[i].reg.tag != NONE) continue;
+      if (live.reg_usage()[i].unused()) continue;
 
-    auto possibleA = liveWith.possible_registers(i, live.reg_usage());
-    auto possibleB = liveWith.possible_registers(i, live.reg_usage(), REG_B);
+      auto possibleA = liveWith.possible_registers(i, live.reg_usage());
+      auto possibleB = liveWith.possible_registers(i, live.reg_usage(), REG_B);
 
-    // Find possible register in each register file
-    RegId chosenA = LiveSets::choose_register(possibleA, false);
-    RegId chosenB = LiveSets::choose_register(possibleB, false);
+      // Find possible register in each register file
+      RegId chosenA = coloring.choose_register(i, possibleA, REG_A);
+      RegId chosenB = coloring.choose_register(i, possibleB, REG_B);
 
-    // Choose a register file
-    RegTag chosenRegFile;
-    if (chosenA < 0 && chosenB < 0) {
-      error("regAlloc(): register allocation failed, insufficient capacity", true);
-    }
-    else if (chosenA < 0) chosenRegFile = REG_B;
-    else if (chosenB < 0) chosenRegFile = REG_A;
-    else {
-      if (prefA[i] > prefB[i]) chosenRegFile = REG_A;
-      else if (prefA[i] < prefB[i]) chosenRegFile = REG_B;
-      else chosenRegFile = prevChosenRegFile == REG_A ? REG_B : REG_A;
-    }
-    prevChosenRegFile = chosenRegFile;
+      // Choose a register file
+      RegTag chosenRegFile;
+      if (chosenA < 0 && chosenB < 0) {
+        if (spiller.spill(live, liveWith, i)) {
+          done = false;  // Code changed, start over
+          break;
+        }
 
-    // Finally, allocate a register to the variable
-    live.reg_usage()[i].reg = Reg(chosenRegFile, (chosenRegFile == REG_A)? chosenA : chosenB);
-  }
+        error("regAlloc(): register allocation failed, insufficient capacity", true);
+        return;
+      }
+      else if (chosenA < 0) chosenRegFile = REG_B;
+      else if (chosenB < 0) chosenRegFile = REG_A;
+      else {
+        // Prefer the file which coalesces a move, then the one with the least operand conflicts
+        bool moveA = coloring.move_partner_in(i, chosenA, REG_A);
+        bool moveB = coloring.move_partner_in(i, chosenB, REG_B);
+        int conflictsA = coloring.conflicts(i, REG_A);
+        int conflictsB = coloring.conflicts(i, REG_B);
+
+        if (moveA != moveB) chosenRegFile = moveA? REG_A : REG_B;
+        else if (conflictsA != conflictsB) chosenRegFile = (conflictsA < conflictsB)? REG_A : REG_B;
+        else if (prefA[i] > prefB[i]) chosenRegFile = REG_A;
+        else if (prefA[i] < prefB[i]) chosenRegFile = REG_B;
+        else chosenRegFile = prevChosenRegFile == REG_A ? REG_B : REG_A;
+      }
+      prevChosenRegFile = chosenRegFile;
+
+      // Finally, allocate a register to the variable
+      live.reg_usage()[i].reg = Reg(chosenRegFile, (chosenRegFile == REG_A)? chosenA : chosenB);
+    }
 //}
-  
-  compile_data.allocated_registers_dump = live.reg_usage().dump(true);
-  //std::cout << count_reg_types(instrs).dump() << std::endl;
 
-  // Step 4 - Apply the allocation to the code
+    if (!done) continue;
+
+    spiller.finish();
+    compile_data().allocated_registers_dump = live.reg_usage().dump(true);
+    //std::cout << count_reg_types(instrs).dump() << std::endl;
+
+    // Step 4 - Apply the allocation to the code
 //{
 //  Timer t("vc4 regAlloc apply allocate_registers", true);
-  allocate_registers(instrs, live.reg_usage());
+    allocate_registers(instrs, live.reg_usage());
+    compile_data().num_moves_removed = remove_redundant_moves(instrs);
 //}
 
-  //std::cout << instrs.check_acc_usage() << std::endl;
-
-  // Free memory
-  delete [] prefA;
-  delete [] prefB;
+    //std::cout << instrs.check_acc_usage() << std::endl;
+  }
 }
 
 }  // namespace vc4; 
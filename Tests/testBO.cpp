@@ -1,6 +1,9 @@
 #include "doctest.h"
 #include <memory>
+#include <algorithm>  // sort
+#include <thread>
 #include "Common/SharedArray.h"
+#include "Common/SharedArrayPool.h"
 #include "Target/BufferObject.h"
 
 
@@ -135,4 +138,264 @@ TEST_CASE("Test Buffer Objects [bo]") {
       REQUIRE(heap.num_free_ranges() == 0);
     }
   }
+
+
+  SUBCASE("Freed ranges should be reused best-fit and coalesced") {
+    const int NUM_ARRAYS = 6;
+    const int ELEM = 4;  // bytes per element
+
+    SharedArrays arrays(NUM_ARRAYS);
+    uint32_t sizes[NUM_ARRAYS] = { 64, 16, 64, 32, 64, 16 };
+
+    for (int i = 0; i < NUM_ARRAYS; ++i) {
+      arrays[i].reset(new Data(sizes[i], heap));
+    }
+
+    uint32_t used = 256*ELEM;
+    REQUIRE(heap.stats().used == used);
+    REQUIRE(heap.stats().fragmentation() == 0.0f);
+
+    // Free ranges of 16 and 32 elements, separated by allocated arrays
+    arrays[1]->dealloc();
+    arrays[3]->dealloc();
+    REQUIRE(heap.num_free_ranges() == 2);
+    REQUIRE(heap.stats().used == used - 48*ELEM);
+    REQUIRE(heap.stats().fragmentation() > 0.0f);
+
+    // Smallest fitting range should be used
+    Data arr(16, heap);
+    REQUIRE(arr.getAddress() == arrays[0]->getAddress() + 64*ELEM);
+    REQUIRE(heap.num_free_ranges() == 1);
+    arr.dealloc();
+
+    // Freeing array 2 merges the ranges on both sides into one
+    arrays[2]->dealloc();
+    REQUIRE(heap.num_free_ranges() == 1);
+    REQUIRE(heap.stats().largest_free >= 112*ELEM);
+
+    // Freeing the last arrays returns the range to the top of the heap
+    arrays[5]->dealloc();
+    arrays[4]->dealloc();
+    REQUIRE(heap.num_free_ranges() == 0);
+    REQUIRE(heap.stats().used == 64*ELEM);
+    REQUIRE(heap.stats().fragmentation() == 0.0f);
+
+    arrays[0]->dealloc();
+    REQUIRE(heap.empty());
+  }
+
+
+  SUBCASE("SharedArrayPool should reuse arrays in steady state") {
+    using Pool = V3DLib::SharedArrayPool;
+    const int NUM_FRAMES = 5;
+
+    {
+      Pool pool(heap);
+      std::vector<uint32_t> addresses;
+
+      for (int frame = 0; frame < NUM_FRAMES; ++frame) {
+        auto a = pool.acquire<float>(256);
+        auto b = pool.acquire<float>(256);
+        auto c = pool.acquire<int>(64);
+        REQUIRE(pool.num_leased() == 3);
+
+        a->fill(1.0f);
+        (*c)[63] = frame;
+
+        if (frame == 0) {
+          addresses = { a->getAddress(), b->getAddress(), c->getAddress() };
+        } else {
+          INFO("frame " << frame);
+          std::vector<uint32_t> cur = { a->getAddress(), b->getAddress(), c->getAddress() };
+          std::sort(cur.begin(), cur.end());
+          std::vector<uint32_t> first = addresses;
+          std::sort(first.begin(), first.end());
+          REQUIRE(cur == first);     // Same buffers, possibly in different order
+          REQUIRE(pool.num_idle() == 0);
+        }
+
+        REQUIRE(pool.num_allocs() == 3);  // No allocations after first frame
+      }
+
+      REQUIRE(pool.num_leased() == 0);
+      REQUIRE(pool.num_idle() == 3);
+
+      // Same element size and count, different type
+      {
+        auto d = pool.acquire<uint32_t>(64);
+        REQUIRE(pool.num_allocs() == 3);
+
+        auto e = pool.acquire<float>(128);  // New size
+        REQUIRE(pool.num_allocs() == 4);
+
+        auto f = std::move(e);
+        REQUIRE(e->size() == 0);
+        REQUIRE(f->size() == 128);
+        REQUIRE(pool.num_leased() == 2);
+      }
+
+      REQUIRE(pool.num_idle() == 4);
+      REQUIRE(!heap.empty());
+    }
+
+    REQUIRE(heap.empty());  // Pool frees idle arrays on destruction
+  }
+
+
+  SUBCASE("Concurrent allocation should leave the heap consistent") {
+    const int NUM_THREADS    = 4;
+    const int NUM_ITERATIONS = 500;
+
+    auto run = [&heap] (int t) {
+      SharedArrays arrays(8);
+
+      for (int i = 0; i < NUM_ITERATIONS; ++i) {
+        int j = (i*7 + t) % 8;
+        if (arrays[j]) {
+          arrays[j].reset();
+        } else {
+          arrays[j].reset(new Data((uint32_t) (16*(1 + (i + t) % 5)), heap));
+          arrays[j]->fill((uint32_t) t);
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t) {
+      threads.emplace_back(run, t);
+    }
+
+    for (auto &th : threads) {
+      th.join();
+    }
+
+    REQUIRE(heap.empty());
+    REQUIRE(heap.num_free_ranges() == 0);
+  }
+}
+
+
+TEST_CASE("Test bulk transfers of shared arrays [bo][copy]") {
+  V3DLib::emu::BufferObject heap;
+  heap.alloc(4*1024*1024);
+
+  SUBCASE("Contiguous copies, small and streaming") {
+    // Second size is above the streaming threshold, with odd length to check tail handling
+    uint32_t const sizes[] = { 37, (uint32_t) (V3DLib::STREAM_COPY_THRESHOLD/sizeof(float)) + 13 };
+
+    for (auto n : sizes) {
+      INFO("size " << n);
+      std::vector<float> src(n);
+      for (uint32_t i = 0; i < n; ++i) src[i] = 0.5f*(float) i;
+
+      V3DLib::SharedArray<float> arr(n + 1, heap);
+      arr[n] = -1.0f;
+      arr.copyFrom(src.data(), n);
+
+      bool ok = true;
+      for (uint32_t i = 0; i < n; ++i) ok = ok && (arr[i] == src[i]);
+      REQUIRE(ok);
+      REQUIRE(arr[n] == -1.0f);  // Not overwritten
+
+      std::vector<float> dst;
+      arr.copyTo(dst);
+      REQUIRE(dst.size() == n + 1);
+      REQUIRE(std::equal(src.begin(), src.end(), dst.begin()));
+
+      arr.fill(3.0f);
+      auto view = arr.view();
+      REQUIRE(view.size() == n + 1);
+      REQUIRE(std::all_of(view.begin(), view.end(), [] (float v) { return v == 3.0f; }));
+    }
+  }
+
+  SUBCASE("Strided 2D copies") {
+    int const ROWS = 4;
+    int const COLS = 16;
+    int const STRIDE = 20;
+
+    std::vector<int> src(ROWS*STRIDE);
+    for (int i = 0; i < (int) src.size(); ++i) src[i] = i;
+
+    V3DLib::Shared2DArray<int> arr(ROWS, COLS);
+    arr.copyFrom(src.data(), STRIDE);
+
+    for (int r = 0; r < ROWS; ++r) {
+      auto row = arr.row_view(r);
+      REQUIRE(row.size() == COLS);
+      for (int c = 0; c < COLS; ++c) {
+        REQUIRE(row[c] == r*STRIDE + c);
+      }
+    }
+
+    std::vector<int> dst(ROWS*STRIDE, -1);
+    arr.copyTo(dst.data(), STRIDE);
+
+    for (int i = 0; i < (int) dst.size(); ++i) {
+      int c = i % STRIDE;
+      REQUIRE(dst[i] == ((c < COLS)? i : -1));  // Gaps between rows untouched
+    }
+  }
+}
+
+
+TEST_CASE("Test transpose of shared arrays [bo][transpose]") {
+  // Reference version
+  auto naive = [] (std::vector<int> const &src, int rows, int columns) -> std::vector<int> {
+    std::vector<int> ret(rows*columns);
+    for (int r = 0; r < rows; ++r) {
+      for (int c = 0; c < columns; ++c) {
+        ret[c*rows + r] = src[r*columns + c];
+      }
+    }
+    return ret;
+  };
+
+  SUBCASE("Raw transpose with partial tiles, multiple threads") {
+    int const ROWS = 37;  // Not multiples of 4 or the tile size
+    int const COLS = 53;
+
+    std::vector<int> src(ROWS*COLS);
+    for (int i = 0; i < (int) src.size(); ++i) src[i] = i;
+    auto expected = naive(src, ROWS, COLS);
+
+    for (int num_threads : { 1, 3 }) {
+      INFO("num_threads " << num_threads);
+      std::vector<int> dst(ROWS*COLS, -1);
+      V3DLib::transpose(dst.data(), src.data(), ROWS, COLS, sizeof(int), num_threads);
+      REQUIRE(dst == expected);
+    }
+
+    std::vector<uint8_t> src8(ROWS*COLS);
+    for (int i = 0; i < (int) src8.size(); ++i) src8[i] = (uint8_t) i;
+    std::vector<uint8_t> dst8(ROWS*COLS);
+    V3DLib::transpose(dst8.data(), src8.data(), ROWS, COLS, sizeof(uint8_t));
+    REQUIRE(dst8[5*ROWS + 2] == src8[2*COLS + 5]);
+    REQUIRE(dst8[(COLS - 1)*ROWS + ROWS - 1] == src8[ROWS*COLS - 1]);
+  }
+
+  SUBCASE("Non-square shared arrays") {
+    int const ROWS = 48;
+    int const COLS = 80;
+
+    V3DLib::Shared2DArray<int> a(ROWS, COLS);
+    std::vector<int> src(ROWS*COLS);
+    for (int i = 0; i < (int) src.size(); ++i) src[i] = 3*i + 1;
+    a.copyFrom(src.data(), COLS);
+
+    V3DLib::Shared2DArray<int> b;  // Allocated by copy_transposed()
+    b.copy_transposed(a, 3);
+    REQUIRE(b.rows() == COLS);
+    REQUIRE(b.columns() == ROWS);
+
+    std::vector<int> dst;
+    b.copyTo(dst);
+    REQUIRE(dst == naive(src, ROWS, COLS));
+
+    // Transposing back should give the original
+    V3DLib::Shared2DArray<int> c(ROWS, COLS);
+    c.copy_transposed(b);
+    c.copyTo(dst);
+    REQUIRE(dst == src);
+  }
 }
@@ -0,0 +1,95 @@
+#include "doctest.h"
+#include <V3DLib.h>
+#include "LibSettings.h"
+#include "v3d/KernelDriver.h"
+#include "v3d/Constants.h"
+#include "Target/instr/Mnemonics.h"
+
+using namespace V3DLib;
+
+namespace {
+
+void const_kernel(Int::Ptr result, Int n) {
+  Int sum = 0;
+
+  For (Int i = 0, i < n, i++)
+    Int x = i*0x12345;
+
+    Where (x > 1000)
+      x = x ^ 0x7fff0000;
+    End
+
+    sum = sum + (x & 0x0f0f0f0f) - 1000000;
+  End
+
+  *result = sum;
+}
+
+}  // anon namespace
+
+
+TEST_CASE("Test v3d constant materialization [v3d][constants]") {
+
+  SUBCASE("Constants should be loaded with the cheapest sequence") {
+    // Without constant caching, the previous sequences are used
+    REQUIRE(v3d::load_imm_cost(Imm(15))    == 1);
+    REQUIRE(v3d::load_imm_cost(Imm(256))   == 3);   // 1 << 8, via r0
+    REQUIRE(v3d::load_imm_cost(Imm(-256))  > 3);    // Nibble-wise
+
+    LibSettings::use_constant_caching(true);
+    REQUIRE(v3d::load_imm_cost(Imm(15))    == 1);   // Small immediate
+    REQUIRE(v3d::load_imm_cost(Imm(-16))   == 1);
+    REQUIRE(v3d::load_imm_cost(Imm(-256))  == 2);   // -1 << 8
+    REQUIRE(v3d::load_imm_cost(Imm(257))   == 3);   // (1 << 8) + 1
+    REQUIRE(v3d::load_imm_cost(Imm(-17))   == 3);   // (-1 << 4) - 1
+    REQUIRE(v3d::load_imm_cost(Imm(1.0f))  == 1);   // Small float immediate
+    REQUIRE(v3d::load_imm_cost(Imm(0x12345)) > 3);
+    LibSettings::use_constant_caching(false);
+  }
+
+  SUBCASE("Expensive constants in loops should be cached") {
+    using namespace V3DLib::Target::instr;
+
+    Reg a(REG_A, 0);
+    Reg b(REG_A, 1);
+    Label loop_start = freshLabel();
+    BranchCond zc = { BranchCond::COND_ANY, ZC };
+
+    Instr::List instrs;
+    instrs << mov(a, UNIFORM_READ)
+           << mov(b, UNIFORM_READ)
+           << Instr(INIT_BEGIN)
+           << Instr(INIT_END)
+           << label(loop_start)
+           << li(a, 0x12345)                   // Expensive, as uniform
+           << li(b, -256)                      // Cheap, synthesized once
+           << li(b, 3)                         // Small immediate, left alone
+           << branch(loop_start).branch_cond(zc)
+           << li(a, 257);                      // Once outside loop, left alone
+
+    IntList uniforms;
+    LibSettings::use_constant_caching(true);   // Cost model uses the shortest sequences
+    REQUIRE(v3d::materialize_constants(instrs, uniforms) == 2);
+    LibSettings::use_constant_caching(false);
+    INFO(instrs.dump());
+
+    REQUIRE(uniforms.size() == 1);
+    REQUIRE(uniforms[0] == 0x12345);
+    REQUIRE(instrs[2].isUniformLoad());        // Uniform load added at the top
+    REQUIRE(instrs.tag_count(InstrTag::LI) == 3);
+    REQUIRE(instrs[instrs.size() - 1].tag == InstrTag::LI);
+  }
+
+  SUBCASE("Caching constants should reduce the size of compiled kernels") {
+    auto k0 = compile(const_kernel);
+    LibSettings::use_constant_caching(true);
+    auto k1 = compile(const_kernel);
+    LibSettings::use_constant_caching(false);
+
+    INFO(k1.v3d().compile_info());
+    REQUIRE(!k0.has_errors());
+    REQUIRE(!k1.has_errors());
+    REQUIRE(k1.v3d().compile_info().find("num constants cached (v3d)     : 0") == std::string::npos);
+    REQUIRE(k1.v3d_kernel_size() < k0.v3d_kernel_size());
+  }
+}
@@ -0,0 +1,177 @@
+#include "doctest.h"
+#include <vector>
+#include <V3DLib.h>
+#include "Kernels/Cursor.h"
+
+using namespace V3DLib;
+
+namespace {
+
+float const K = 0.25f;   // Heat dissipation constant, as in example HeatMap
+
+
+// ============================================================================
+// Support routines
+// ============================================================================
+
+/**
+ * Scalar version of a single heat map step
+ */
+void scalar_step(std::vector<float> const &map, std::vector<float> &out, int width, int height) {
+  for (int y = 1; y < height - 1; y++) {
+    for (int x = 1; x < width - 1; x++) {
+      auto m = [&map, width] (int y, int x) { return map[y*width + x]; };
+
+      float surroundings =
+        m(y-1, x-1) + m(y-1, x) + m(y-1, x+1) +
+        m(y,   x-1) +             m(y,   x+1) +
+        m(y+1, x-1) + m(y+1, x) + m(y+1, x+1);
+      surroundings *= 0.125f;
+      out[y*width + x] = m(y, x) - K*(m(y, x) - surroundings);
+    }
+  }
+}
+
+
+/**
+ * Heat map stencil, with the left and right borders set to zero
+ */
+void heat_stencil(Cursor::Block const &b, Int const &x, Int const &width, Float &output) {
+  Float sum = b.left(0) + b.current(0) + b.right(0) +
+              b.left(1) +                b.right(1) +
+              b.left(2) + b.current(2) + b.right(2);
+
+  output = b.current(1) - K * (b.current(1) - sum * 0.125);
+
+  Int actual_x = x + index();
+  Where (actual_x == 0 || actual_x == width - 1)
+    output = 0.0f;
+  End
+}
+
+
+/**
+ * Single heat map step with the regular cursor
+ */
+void cursor_kernel(Float::Ptr map, Float::Ptr mapOut, Int height, Int width) {
+  Cursor cursor(width);
+
+  For (Int offset = me() + 1, offset < height - 1, offset += numQPUs())
+    cursor.init(map + offset*width, mapOut + offset*width);
+
+    For (Int x = 0, x < width, x = x + 16)
+      cursor.step([&x, &width] (Cursor::Block const &b, Float &output) {
+        heat_stencil(b, x, width, output);
+      });
+    End
+
+    cursor.finish();
+  End
+}
+
+
+/**
+ * Multiple heat map steps with the temporal cursor
+ */
+template<int Rows, int Steps>
+void temporal_kernel(Float::Ptr map, Float::Ptr mapOut, Int height, Int width) {
+  TemporalCursor cursor(width, height, Rows, Steps);
+
+  For (Int row = 1 + Rows*me(), row < height - 1, row += Rows*numQPUs())
+    cursor.run(map, mapOut, row, [&width] (Cursor::Block const &b, Int const &x, Float &output) {
+      heat_stencil(b, x, width, output);
+    });
+  End
+}
+
+
+/**
+ * Initialize map with a pattern, borders are zero
+ */
+void init_map(Float::Array &map, int width, int height) {
+  map.fill(0.0f);
+
+  for (int y = 1; y < height - 1; y++) {
+    for (int x = 1; x < width - 1; x++) {
+      map[y*width + x] = (float) ((x*7 + y*13) % 31);
+    }
+  }
+}
+
+
+void compare_map(Float::Array &map, std::vector<float> const &expected) {
+  REQUIRE(map.size() == expected.size());
+
+  for (int i = 0; i < (int) expected.size(); i++) {
+    INFO("index: " << i);
+    REQUIRE(map[i] == doctest::Approx(expected[i]).epsilon(0.0001));
+  }
+}
+
+
+/**
+ * Run a number of heat map steps with the given kernel, and compare with the scalar version.
+ */
+template<typename Kernel>
+void check_heatmap(Kernel &k, int steps_per_call, int num_calls, int width, int height, int num_qpus) {
+  INFO("width: " << width << ", height: " << height << ", num QPUs: " << num_qpus
+       << ", steps per call: " << steps_per_call);
+  REQUIRE(!k.has_errors());
+
+  int const size = width*height;
+  Float::Array mapA(size);
+  Float::Array mapB(size);
+  init_map(mapA, width, height);
+  init_map(mapB, width, height);
+
+  std::vector<float> expected(size);
+  std::vector<float> tmp(size);
+  for (int i = 0; i < size; i++) expected[i] = tmp[i] = mapA[i];
+
+  for (int i = 0; i < steps_per_call*num_calls; i++) {
+    scalar_step(expected, tmp, width, height);
+    expected.swap(tmp);
+  }
+
+  k.setNumQPUs(num_qpus);
+
+  for (int i = 0; i < num_calls; i++) {
+    if (i & 1) {
+      k.load(&mapB, &mapA, height, width);
+    } else {
+      k.load(&mapA, &mapB, height, width);
+    }
+    k.call();
+  }
+
+  compare_map((num_calls & 1)? mapB : mapA, expected);
+}
+
+}  // anon namespace
+
+
+TEST_CASE("Test temporal blocking of cursor [cursor]") {
+  int const width  = 64;
+  int const height = 23;
+
+  SUBCASE("Check regular cursor") {
+    auto k = compile(cursor_kernel);
+    check_heatmap(k, 1, 4, width, height, 1);
+    check_heatmap(k, 1, 4, width, height, 8);
+  }
+
+  SUBCASE("Check temporal cursor") {
+    auto k1 = compile(temporal_kernel<1, 1>);
+    check_heatmap(k1, 1, 4, width, height, 1);
+
+    auto k2 = compile(temporal_kernel<2, 2>);
+    check_heatmap(k2, 2, 2, width, height, 1);
+    check_heatmap(k2, 2, 3, width, height, 8);
+
+    auto k3 = compile(temporal_kernel<4, 2>);
+    check_heatmap(k3, 2, 2, width, height, 5);
+
+    auto k4 = compile(temporal_kernel<1, 3>);
+    check_heatmap(k4, 3, 2, width, height, 3);
+  }
+}
@@ -1,12 +1,18 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <functional>
+#include <cstdlib>     // mkdtemp
+#include <dirent.h>
+#include <unistd.h>    // unlink, rmdir
 #include <V3DLib.h>
 #include "LibSettings.h"
 #include "Support/pgm.h"
 #include "support/support.h"
 #include "Source/Complex.h"
 #include "Source/Functions.h"
+#include "Target/EmuSupport.h"
+#include "Target/instr/ALUOp.h"
 
 using namespace V3DLib;
 using namespace std;
@@ -616,6 +622,561 @@ TEST_CASE("Test For-loops [dsl][for]") {
 } 
 
 
+void interp_kernel(Int::Ptr result, Int::Ptr input) {
+  Int a = *input;
+  Int count = 0;
+
+  Where (a > 3)
+    a = 2*a;
+
+    Where (a > 20)
+      a = a - 20;
+    End
+  Else
+    a = 0 - a;
+  End
+
+  While (any(count < a))
+    Where (count < a)
+      count++;
+    End
+  End
+
+  If (any(a < 0))
+    a = a + 100;
+  End
+
+  *result = a + 1000*count;
+}
+
+
+/**
+ * The interpreter compiles the source code on the first call, and reuses it for further calls.
+ * Compare with emulator for different inputs.
+ */
+TEST_CASE("Test repeated interpreter runs [dsl][interp]") {
+  Platform::use_main_memory(true);
+
+  auto k = compile(interp_kernel);
+
+  Int::Array input(16);
+  Int::Array result1(16);
+  Int::Array result2(16);
+
+  for (int run = 0; run < 3; run++) {
+    for (int i = 0; i < 16; i++) {
+      input[i] = (i + 5*run) % 16;
+    }
+
+    result1.fill(-1);
+    result2.fill(-1);
+
+    k.load(&result1, &input).interpret();
+    k.load(&result2, &input).emu();
+
+    INFO("run " << run);
+    REQUIRE(result1 == result2);
+
+    // Spot checks
+    if (run == 0) {
+      // Lanes 1-3 are negative, so 100 is added to all lanes
+      REQUIRE(result1[0]  == 100);                 // a = 0
+      REQUIRE(result1[4]  == 100 + 8 + 1000*8);    // a = 2*4
+      REQUIRE(result1[10] == 100 + 20 + 1000*20);  // a = 2*10, not > 20
+      REQUIRE(result1[11] == 100 + 2 + 1000*2);    // a = 2*11 - 20
+    }
+  }
+
+  Platform::use_main_memory(false);
+}
+
+
+namespace {
+
+/**
+ * Remove a directory with the files in it. Subdirectories are not expected.
+ */
+void remove_dir(std::string const &dir) {
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr) return;
+
+  while (dirent *entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name == "." || name == "..") continue;
+    unlink((dir + "/" + name).c_str());
+  }
+
+  closedir(d);
+  rmdir(dir.c_str());
+}
+
+}  // anon namespace
+
+
+/**
+ * A kernel compiled with the kernel cache enabled should be identical to
+ * a kernel compiled without it.
+ */
+TEST_CASE("Test kernel cache [dsl][cache]") {
+  Platform::use_main_memory(true);
+  std::string const LOADED = "loaded from kernel cache       : yes";
+
+  auto k0 = compile(interp_kernel);
+  REQUIRE(k0.compile_info().find(LOADED) == std::string::npos);
+
+  // Fresh directory, so that files from previous runs can not influence the result
+  char dir[] = "/tmp/v3dlib_kernel_cache_XXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+
+  LibSettings::kernel_cache_dir(dir);
+  auto k1 = compile(interp_kernel);  // Compiled and stored
+  auto k2 = compile(interp_kernel);  // Loaded
+  LibSettings::kernel_cache_dir("");
+  remove_dir(dir);
+
+  INFO(k2.compile_info());
+  REQUIRE(!k1.has_errors());
+  REQUIRE(k1.vc4().compile_info().find(LOADED) == std::string::npos);
+  REQUIRE(k1.v3d().compile_info().find(LOADED) == std::string::npos);
+
+  REQUIRE(!k2.has_errors());
+  REQUIRE(k2.vc4().compile_info().find(LOADED) != std::string::npos);
+  REQUIRE(k2.v3d().compile_info().find(LOADED) != std::string::npos);
+
+  REQUIRE(k0.vc4().numVars() == k2.vc4().numVars());
+  REQUIRE(k0.vc4().targetCode().mnemonics(true) == k2.vc4().targetCode().mnemonics(true));
+  REQUIRE(k0.v3d().targetCode().mnemonics(true) == k2.v3d().targetCode().mnemonics(true));
+  REQUIRE(k0.v3d_kernel_size() == k2.v3d_kernel_size());
+
+  Int::Array input(16);
+  Int::Array result0(16);
+  Int::Array result2(16);
+
+  for (int i = 0; i < 16; i++) {
+    input[i] = i;
+  }
+
+  k0.load(&result0, &input).emu();
+  k2.load(&result2, &input).emu();
+  REQUIRE(result0 == result2);
+
+  result2.fill(-1);
+  k2.load(&result2, &input).interpret();
+  REQUIRE(result0 == result2);
+
+  Platform::use_main_memory(false);
+}
+
+
+int const NUM_SPILL_VARS = 100;
+
+/**
+ * Keeps more variables live at the same time than there are registers
+ */
+void spill_kernel(Int::Ptr result) {
+  Int v[NUM_SPILL_VARS];
+
+  for (int i = 0; i < NUM_SPILL_VARS; i++) {
+    v[i] = index() + i;
+  }
+
+  Int sum = 0;
+  for (int i = 0; i < NUM_SPILL_VARS; i++) {
+    sum = sum + v[i]*v[NUM_SPILL_VARS - 1 - i];
+  }
+
+  *result = sum;
+}
+
+
+TEST_CASE("Test spilling of variables to memory [dsl][spill]") {
+  Platform::use_main_memory(true);
+
+  auto k = compile(spill_kernel);
+  INFO(k.compile_info());
+  REQUIRE(!k.has_errors());
+  REQUIRE(k.vc4().numSpills() > 0);
+  REQUIRE(k.v3d().numSpills() > 0);
+
+  Int::Array result(16);
+  Int::Array expected(16);
+
+  for (int n = 0; n < 16; n++) {
+    int sum = 0;
+    for (int i = 0; i < NUM_SPILL_VARS; i++) {
+      sum += (n + i)*(n + NUM_SPILL_VARS - 1 - i);
+    }
+    expected[n] = sum;
+  }
+
+  result.fill(-1);
+  k.load(&result).emu();
+  REQUIRE(result == expected);
+
+  result.fill(-1);
+  k.load(&result).interpret();
+  REQUIRE(result == expected);
+
+  Platform::use_main_memory(false);
+}
+
+
+/**
+ * Nested control flow, so that there are plenty of branches with delay slots to fill
+ */
+void delay_slot_kernel(Int::Ptr result) {
+  Int a = index();
+  Int b = 0;
+  Int c = 1;
+
+  For (Int n = 0, n < 10, n++)
+    b = b + a;
+    c = c + n;
+
+    If ((n & 1) == 0)
+      c = c ^ a;
+    Else
+      b = b - 3;
+    End
+
+    Where (b > 20)
+      b = b - 7;
+    End
+
+    a = a + 1;
+  End
+
+  *result = 3*b + c;
+}
+
+
+TEST_CASE("Test filling of branch delay slots [dsl][delay]") {
+  Platform::use_main_memory(true);
+
+  // v3d delay slots are only checked for compiling, the emulator can not run v3d code
+  LibSettings::use_v3d_delay_slots(true);
+  auto k = compile(delay_slot_kernel);
+  LibSettings::use_v3d_delay_slots(false);
+
+  INFO(k.compile_info());
+  REQUIRE(!k.has_errors());
+  REQUIRE(k.vc4().compile_info().find("num delay slots filled         : 0") == std::string::npos);
+  REQUIRE(k.v3d().compile_info().find("num delay slots filled         : 0") == std::string::npos);
+
+  Int::Array result(16);
+  Int::Array expected(16);
+
+  for (int i = 0; i < 16; i++) {
+    int a = i;
+    int b = 0;
+    int c = 1;
+
+    for (int n = 0; n < 10; n++) {
+      b += a;
+      c += n;
+
+      if ((n & 1) == 0) {
+        c ^= a;
+      } else {
+        b -= 3;
+      }
+
+      if (b > 20) b -= 7;
+      a++;
+    }
+
+    expected[i] = 3*b + c;
+  }
+
+  // The emulator executes the delay slots
+  result.fill(-1);
+  k.load(&result).emu();
+  REQUIRE(result == expected);
+
+  result.fill(-1);
+  k.load(&result).interpret();
+  REQUIRE(result == expected);
+
+  Platform::use_main_memory(false);
+}
+
+
+int unroll_factor  = 1;
+int pipeline_depth = 0;
+
+void unroll_kernel(Int::Ptr result, Int::Ptr a, Int::Ptr b) {
+  Int sum = 0;
+
+  loop_unroll(unroll_factor);
+  loop_pipeline(pipeline_depth);
+  For (Int n = 0, n < 10, n++)
+    Int x = *a;
+    a.inc();
+    Int y = *b;
+    b.inc();
+
+    sum = sum + x*y + n;
+  End
+
+  *result = sum;
+}
+
+
+TEST_CASE("Test loop unrolling and pipelining [dsl][unroll]") {
+  Platform::use_main_memory(true);
+
+  int const N = 10;
+
+  Int::Array a(16*N);
+  Int::Array b(16*N);
+  Int::Array result(16);
+  Int::Array expected(16);
+
+  for (int i = 0; i < (int) a.size(); i++) {
+    a[i] = i;
+    b[i] = (i % 7) + 1;
+  }
+
+  for (int i = 0; i < 16; i++) {
+    int sum = 0;
+
+    for (int n = 0; n < N; n++) {
+      sum += a[16*n + i]*b[16*n + i] + n;
+    }
+
+    expected[i] = sum;
+  }
+
+  auto check = [&] (int unroll, int pipeline, int num_unrolled, int num_pipelined) {
+    unroll_factor  = unroll;
+    pipeline_depth = pipeline;
+    auto k = compile(unroll_kernel);
+
+    INFO(k.compile_info());
+    REQUIRE(!k.has_errors());
+
+    std::string unrolled  = "num loops unrolled             : ";
+    std::string pipelined = "num loops pipelined            : ";
+    unrolled  << num_unrolled;
+    pipelined << num_pipelined;
+    REQUIRE(k.vc4().compile_info().find(unrolled)  != std::string::npos);
+    REQUIRE(k.v3d().compile_info().find(unrolled)  != std::string::npos);
+    REQUIRE(k.vc4().compile_info().find(pipelined) != std::string::npos);
+    REQUIRE(k.v3d().compile_info().find(pipelined) != std::string::npos);
+
+    result.fill(-1);
+    k.load(&result, &a, &b).emu();
+    REQUIRE(result == expected);
+
+    result.fill(-1);
+    k.load(&result, &a, &b).interpret();
+    REQUIRE(result == expected);
+  };
+
+  check(1,  0, 0, 0);  // No hints
+  check(4,  0, 1, 0);  // Trip count not a multiple of unroll factor
+  check(1, -1, 0, 1);
+  check(4, -1, 1, 1);
+  check(3,  1, 1, 1);
+  check(20, 2, 1, 1);  // Unroll factor larger than trip count
+
+  Platform::use_main_memory(false);
+}
+
+
+/**
+ * All compile passes should be present in the compile profile
+ */
+TEST_CASE("Test compile profile [dsl][profile]") {
+  Platform::use_main_memory(true);
+
+  auto k = compile(nested_for_kernel);
+  INFO(k.compile_info());
+  REQUIRE(!k.has_errors());
+  REQUIRE(k.compile_info().find("compile time (ms)") != std::string::npos);
+
+  auto check = [] (KernelDriver &drv, std::vector<std::string> const &names) {
+    auto const &profile = drv.compile_profile();
+    REQUIRE(profile.total_ms() > 0);
+
+    double sum = 0;
+    for (auto const &name : names) {
+      INFO("Pass: " << name);
+      auto p = profile.find(name);
+      REQUIRE(p != nullptr);
+      REQUIRE(p->count >= 1);
+      REQUIRE(p->time_ms >= 0);
+      sum += p->time_ms;
+
+      if (name != "ast") {
+        REQUIRE(p->instrs_after > 0);
+      }
+    }
+
+    REQUIRE(sum <= profile.total_ms());
+    REQUIRE(profile.find("translate_stmt")->instrs_after > 0);
+    REQUIRE(profile.find("regalloc")->instrs_before == profile.find("liveness")->instrs_after);
+  };
+
+  check(k.vc4(), {"ast", "translate_stmt", "loadStorePass", "liveness", "regalloc", "satisfy",
+                  "removeLabels", "encode"});
+  check(k.v3d(), {"ast", "translate_stmt", "insertInitBlock", "liveness", "regalloc", "satisfy",
+                  "removeLabels", "encode", "combine"});
+
+  auto json = k.compile_profile_json();
+  REQUIRE(json.find("{\"vc4\": {\"total_ms\": ") == 0);
+  REQUIRE(json.find("\"v3d\": {\"total_ms\": ") != std::string::npos);
+  REQUIRE(json.find("{\"name\": \"ast\", \"count\": 1, ") != std::string::npos);
+  REQUIRE(json.find("\"instrs_before\": null") != std::string::npos);
+  REQUIRE(json.find("{\"name\": \"combine\"") != std::string::npos);
+  REQUIRE(json.back() == '}');
+
+  Platform::use_main_memory(false);
+}
+
+
+/**
+ * Kernels compiled concurrently should be identical to kernels compiled one by one
+ */
+TEST_CASE("Test concurrent compilation of kernels [dsl][compile_all]") {
+  Platform::use_main_memory(true);
+
+  std::vector<void (*)(Int::Ptr)> fs = {
+    kernel_specific_instructions,
+    kernelIfWhen,
+    int_ops_kernel,
+    nested_for_kernel,
+    spill_kernel,
+    delay_slot_kernel
+  };
+
+  auto kernels = compile_all(fs);
+  REQUIRE(kernels.size() == fs.size());
+
+  // Every kernel has its own spill buffer, skip its address
+  auto code = [] (Instr::List const &instrs) {
+    std::istringstream in(instrs.mnemonics(true));
+    std::string ret;
+    std::string line;
+
+    while (std::getline(in, line)) {
+      if (line.find("address scratch buffer") != std::string::npos) continue;
+      ret += line + "\n";
+    }
+
+    return ret;
+  };
+
+  Int::Array expected(16);
+  Int::Array result(16);
+
+  for (int i = 0; i < (int) fs.size(); i++) {
+    auto k = compile(fs[i]);
+    auto &k_all = kernels[i];
+
+    INFO("Kernel index: " << i);
+    REQUIRE(!k.has_errors());
+    REQUIRE(!k_all.has_errors());
+    REQUIRE(k.vc4().numVars() == k_all.vc4().numVars());
+    REQUIRE(code(k.vc4().targetCode()) == code(k_all.vc4().targetCode()));
+    REQUIRE(code(k.v3d().targetCode()) == code(k_all.v3d().targetCode()));
+    if (k.v3d().numSpills() == 0) {
+      REQUIRE(k.v3d_kernel_size() == k_all.v3d_kernel_size());  // Otherwise, address load may differ in size
+    }
+
+    expected.fill(-1);
+    k.load(&expected).emu();
+    result.fill(-1);
+    k_all.load(&result).emu();
+    REQUIRE(result == expected);
+  }
+
+  Platform::use_main_memory(false);
+}
+
+
+/**
+ * Queue multiple launches with different arrays, and compare with synchronous calls
+ */
+TEST_CASE("Test asynchronous launch [dsl][launch]") {
+  int const NUM_LAUNCHES = 4;
+
+  auto k = compile(interp_kernel);
+  k.setNumQPUs(4);
+
+  std::vector<std::unique_ptr<Int::Array>> inputs;
+  std::vector<std::unique_ptr<Int::Array>> results;
+  std::vector<std::shared_future<void>> done;
+
+  for (int n = 0; n < NUM_LAUNCHES; n++) {
+    inputs.emplace_back(new Int::Array(16));
+    results.emplace_back(new Int::Array(16));
+
+    for (int i = 0; i < 16; i++) {
+      (*inputs[n])[i] = (i + 3*n) % 16;
+    }
+    results[n]->fill(-1);
+
+    done.push_back(k.load(results[n].get(), inputs[n].get()).launch());
+  }
+
+  Int::Array expected(16);
+
+  for (int n = NUM_LAUNCHES - 1; n >= 0; n--) {
+    done[n].get();
+    REQUIRE(done[0].wait_for(std::chrono::seconds(0)) == std::future_status::ready);  // Completed in order
+
+    expected.fill(-1);
+    k.load(&expected, inputs[n].get()).emu();
+
+    INFO("launch " << n);
+    REQUIRE(*results[n] == expected);
+  }
+
+  k.wait();
+}
+
+
+/**
+ * The host should be able to allocate and free shared arrays while launches are pending
+ */
+TEST_CASE("Test allocation during asynchronous launch [dsl][launch]") {
+  int const NUM_LAUNCHES = 4;
+
+  auto k = compile(interp_kernel);
+  k.setNumQPUs(4);
+
+  Int::Array input(16);
+  for (int i = 0; i < 16; i++) input[i] = (5*i) % 16;
+
+  Int::Array expected(16);
+  k.load(&expected, &input).emu();
+
+  std::vector<std::unique_ptr<Int::Array>> results;
+  std::vector<std::shared_future<void>> done;
+
+  for (int n = 0; n < NUM_LAUNCHES; n++) {
+    results.emplace_back(new Int::Array(16));
+    results[n]->fill(-1);
+    done.push_back(k.load(results[n].get(), &input).launch());
+
+    // Churn the heap while the launches run
+    std::vector<std::unique_ptr<Int::Array>> tmp;
+    for (int i = 0; i < 50; i++) {
+      tmp.emplace_back(new Int::Array(16*(1 + i % 7)));
+      tmp.back()->fill(i);
+      if (i % 3 == 0) tmp.erase(tmp.begin());
+    }
+  }
+
+  for (int n = 0; n < NUM_LAUNCHES; n++) {
+    done[n].get();
+    INFO("launch " << n);
+    REQUIRE(*results[n] == expected);
+  }
+}
+
+
 template<typename T, typename Ptr>
 void rot_kernel(Ptr result, Ptr a) {
   T val = *a;
@@ -673,6 +1234,123 @@ TEST_CASE("Test rotate on emulator [emu][rotate]") {
 }
 
 
+/**
+ * Compare the vector operations used by emulator and interpreter with lane-by-lane scalar results
+ */
+TEST_CASE("Test vector operations [emu][vec]") {
+  std::vector<int> ints   = { 0, 1, -1, 2, -2, 7, -7, 31, 32, 0x7fffffff, (int) 0x80000000, 0xffffff, 12345, -12345, 3, 16 };
+  std::vector<int> shifts = { 0, 1, 31, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 1 };
+  std::vector<float> floats = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 3.25f, -3.25f, 100.0f,
+                                -100.0f, 1e-3f, -1e-3f, 7.0f, -7.0f, 2.5f, -2.5f, 1e6f };
+
+  Vec a(ints);
+  Vec b(shifts);
+  Vec fa;
+  Vec fb;
+  for (int i = 0; i < NUM_LANES; i++) {
+    fa[i].floatVal = floats[i];
+    fb[i].floatVal = floats[(i + 5) % NUM_LANES];
+  }
+
+  auto check_int = [&a, &b] (ALUOp::Enum op, std::function<int32_t(int32_t, int32_t)> f) {
+    Vec v;
+    REQUIRE(v.apply(ALUOp(op), a, b));
+
+    for (int i = 0; i < NUM_LANES; i++) {
+      INFO("op: " << op << ", lane: " << i);
+      REQUIRE(v[i].intVal == f(a[i].intVal, b[i].intVal));
+    }
+  };
+
+  auto check_float = [&fa, &fb] (ALUOp::Enum op, std::function<float(float, float)> f) {
+    Vec v;
+    REQUIRE(v.apply(ALUOp(op), fa, fb));
+
+    for (int i = 0; i < NUM_LANES; i++) {
+      INFO("op: " << op << ", lane: " << i);
+      REQUIRE(v[i].floatVal == f(fa[i].floatVal, fb[i].floatVal));
+    }
+  };
+
+  auto u = [] (int32_t x) { return (uint32_t) x; };
+
+  check_int(ALUOp::A_ADD,  [u] (int32_t x, int32_t y) { return (int32_t) (u(x) + u(y)); });
+  check_int(ALUOp::A_SUB,  [u] (int32_t x, int32_t y) { return (int32_t) (u(x) - u(y)); });
+  check_int(ALUOp::A_SHL,  [u] (int32_t x, int32_t y) { return (int32_t) (u(x) << y); });
+  check_int(ALUOp::A_SHR,  [u] (int32_t x, int32_t y) { return (int32_t) (u(x) >> y); });
+  check_int(ALUOp::A_ASR,  [] (int32_t x, int32_t y) { return x >> y; });
+  check_int(ALUOp::A_MIN,  [] (int32_t x, int32_t y) { return std::min(x, y); });
+  check_int(ALUOp::A_MAX,  [] (int32_t x, int32_t y) { return std::max(x, y); });
+  check_int(ALUOp::A_BAND, [] (int32_t x, int32_t y) { return x & y; });
+  check_int(ALUOp::A_BOR,  [] (int32_t x, int32_t y) { return x | y; });
+  check_int(ALUOp::A_BXOR, [] (int32_t x, int32_t y) { return x ^ y; });
+  check_int(ALUOp::A_BNOT, [] (int32_t x, int32_t) { return ~x; });
+  check_int(ALUOp::M_MUL24, [u] (int32_t x, int32_t y) { return (int32_t) ((u(x) & 0xffffff)*(u(y) & 0xffffff)); });
+  check_int(ALUOp::A_ROR,  [u] (int32_t x, int32_t y) {
+    return (y == 0)? x : (int32_t) ((u(x) >> y) | (u(x) << (32 - y)));
+  });
+
+  check_float(ALUOp::A_FADD, [] (float x, float y) { return x + y; });
+  check_float(ALUOp::A_FSUB, [] (float x, float y) { return x - y; });
+  check_float(ALUOp::M_FMUL, [] (float x, float y) { return x * y; });
+  check_float(ALUOp::A_FMIN, [] (float x, float y) { return x < y ? x : y; });
+  check_float(ALUOp::A_FMAX, [] (float x, float y) { return x > y ? x : y; });
+  check_float(ALUOp::A_FMINABS, [] (float x, float y) { return fabsf(x) < fabsf(y) ? x : y; });
+  check_float(ALUOp::A_FMAXABS, [] (float x, float y) { return fabsf(x) > fabsf(y) ? x : y; });
+
+  {
+    Vec v;
+    v.apply(ALUOp(ALUOp::A_FtoI), fa, fb);
+    for (int i = 0; i < NUM_LANES; i++) REQUIRE(v[i].intVal == (int) floats[i]);
+
+    v.apply(ALUOp(ALUOp::A_ItoF), a, b);
+    for (int i = 0; i < NUM_LANES; i++) REQUIRE(v[i].floatVal == (float) ints[i]);
+  }
+
+  // Result may be one of the operands
+  {
+    Vec v = a;
+    v.apply(ALUOp(ALUOp::A_ADD), v, v);
+    for (int i = 0; i < NUM_LANES; i++) REQUIRE(v[i].intVal == (int32_t) (u(ints[i]) + u(ints[i])));
+  }
+
+  // Rotation
+  for (int n = -17; n <= 17; n++) {
+    Vec v;
+    v.apply(ALUOp(ALUOp::M_ROTATE), a, Vec(n));
+
+    for (int i = 0; i < NUM_LANES; i++) {
+      int src = (((i - n) % NUM_LANES) + NUM_LANES) % NUM_LANES;
+      REQUIRE(v[i].intVal == ints[src]);
+    }
+  }
+
+  // Condition vectors and flags
+  Vec zero  = a.zero_flags();
+  Vec neg   = a.neg_flags();
+  Vec recip = fa.recip();
+
+  for (int i = 0; i < NUM_LANES; i++) {
+    REQUIRE(zero[i].intVal == (ints[i] == 0));
+    REQUIRE(neg[i].intVal  == (ints[i] < 0));
+    REQUIRE(zero.negate()[i].intVal == (ints[i] != 0));
+    REQUIRE(zero.cond_and(neg)[i].intVal == 0);
+    REQUIRE(zero.cond_or(neg)[i].intVal == (ints[i] <= 0));
+    REQUIRE(recip[i].floatVal == ((floats[i] != 0)? 1/floats[i] : 0));
+  }
+
+  REQUIRE(zero.any());
+  REQUIRE(!zero.all());
+  REQUIRE(zero.cond_or(zero.negate()).all());
+
+  Vec w(-3);
+  w.assign_where(neg, a);
+  for (int i = 0; i < NUM_LANES; i++) {
+    REQUIRE(w[i].intVal == ((ints[i] < 0)? ints[i] : -3));
+  }
+}
+
+
 /**
  * This should try out all the possible ways of reading and writing
  * main memory.
@@ -7,6 +7,7 @@
 #include "Support/pgm.h"
 #include "support/dft_support.h"
 #include "Kernels/Matrix.h"
+#include "Kernels/FFT.h"
 #include "Source/gather.h"
 #include "Source/Functions.h"
 
@@ -1203,7 +1204,7 @@ TEST_CASE("FFT test with DFT [fft][test2]") {
       k.pretty(false, "obj/test/dft_compare_v3d.txt");
       timer1.end();
       //std::cout << "DFT kernel size: " << k.v3d_kernel_size() << std::endl;
-      //std::cout << "combined " << compile_data.num_instructions_combined << " instructions" << std::endl;
+      //std::cout << "combined " << compile_data().num_instructions_combined << " instructions" << std::endl;
 
       Timer timer2("DFT run time");
       k.load(&result_dft, &a);
@@ -1233,7 +1234,7 @@ TEST_CASE("FFT test with DFT [fft][test2]") {
       k.dump_compile_data(false, "./obj/test/fft_dump_v3d.txt");
       //timer1.end();
       //std::cout << "FFT kernel size: " << k.v3d_kernel_size() << std::endl;
-      //std::cout << "combined " << compile_data.num_instructions_combined << " instructions" << std::endl;
+      //std::cout << "combined " << compile_data().num_instructions_combined << " instructions" << std::endl;
 
       //Timer timer2("FFT run time");
       k.setNumQPUs(fft_context.num_qpus);
@@ -1494,3 +1495,164 @@ TEST_CASE("FFT Support [fft]") {
     }
   }
 }
+
+
+namespace {
+
+/**
+ * Input values for the library FFT tests, with some variation per transform
+ */
+cx fft_input(int i, int n, int b = 0) {
+  double x = ((double) i)/n;
+  return cx(std::sin(2*M_PI*3*x) + 0.5*std::cos(2*M_PI*45*x*x) + 0.1*b, 0.01*((i*7 + b) % 13));
+}
+
+
+/**
+ * Max difference with the scalar FFT, relative to the largest output value
+ */
+float rel_diff(std::vector<cx> const &expected, Complex::Array const &result, int offset = 0) {
+  double max_val  = 0;
+  double max_diff = 0;
+
+  for (int i = 0; i < (int) expected.size(); i++) {
+    max_val  = std::max(max_val, abs(expected[i]));
+    max_diff = std::max(max_diff, (double) abs(expected[i] - result[offset + i].to_complex()));
+  }
+
+  return (float) (max_diff/max_val);
+}
+
+}  // anon namespace
+
+
+TEST_CASE("FFT library kernel [fft][plan]") {
+  Platform::use_main_memory(true);
+
+  float const precision = 2.0e-5f;
+
+  auto expected = [] (int log2n, int b) {
+    int n = 1 << log2n;
+    std::vector<cx> a(n);
+    std::vector<cx> ret(n);
+
+    for (int i = 0; i < n; i++) a[i] = fft_input(i, n, b);
+    fft(a.data(), ret.data(), log2n);
+    return ret;
+  };
+
+
+  SUBCASE("Plan stages should be radix 4 with radix 2 for odd sizes") {
+    kernels::FFTPlan plan6(6);
+    REQUIRE(!plan6.has_errors());
+    REQUIRE(plan6.num_stages() == 3);
+    REQUIRE(plan6.radix(0) == 4);
+
+    kernels::FFTPlan plan7(7);
+    REQUIRE(!plan7.has_errors());
+    REQUIRE(plan7.num_stages() == 4);
+    REQUIRE(plan7.radix(0) == 2);
+    REQUIRE(plan7.radix(3) == 4);
+  }
+
+
+  SUBCASE("Single and batched 1D FFT should match scalar FFT") {
+    for (int log2n : {6, 7, 10, 16}) {
+      int n = 1 << log2n;
+      int batch = (log2n >= 10)? 1 : 3;
+
+      Complex::Array in(batch*n);
+      Complex::Array out(batch*n);
+
+      for (int b = 0; b < batch; b++) {
+        for (int i = 0; i < n; i++) {
+          cx v = fft_input(i, n, b);
+          in[b*n + i] = complex((float) v.real(), (float) v.imag());
+        }
+      }
+
+      kernels::FFTPlan plan(log2n);
+      plan.setNumQPUs(4);
+      out.fill(complex(-1.0f, -1.0f));
+      plan.execute(in, out, batch);
+
+      for (int b = 0; b < batch; b++) {
+        INFO("log2n: " << log2n << ", batch: " << b);
+        REQUIRE(rel_diff(expected(log2n, b), out, b*n) < precision);
+      }
+
+      // Scalar version in library should match as well
+      std::vector<complex> s_in(n);
+      std::vector<complex> s_out(n);
+      for (int i = 0; i < n; i++) s_in[i] = in[i].to_complex();
+      kernels::fft_scalar(s_in.data(), s_out.data(), log2n);
+
+      auto expected0 = expected(log2n, 0);
+      for (int i = 0; i < n; i++) {
+        INFO("log2n: " << log2n << ", i: " << i);
+        REQUIRE(abs(expected0[i] - s_out[i]) < 1.0e-3f*((float) n));
+      }
+    }
+  }
+
+
+  SUBCASE("2D FFT should match scalar FFT over rows and columns") {
+    int const log2_rows = 6;
+    int const log2_cols = 7;
+    int const rows = 1 << log2_rows;
+    int const cols = 1 << log2_cols;
+
+    std::vector<std::vector<cx>> data(rows, std::vector<cx>(cols));
+    Complex::Array2D in(rows, cols);
+    Complex::Array2D out(rows, cols);
+
+    for (int r = 0; r < rows; r++) {
+      for (int c = 0; c < cols; c++) {
+        data[r][c] = fft_input(c, cols, r % 5) + cx(0.0, 0.001*r);
+        in[r][c] = complex((float) data[r][c].real(), (float) data[r][c].imag());
+      }
+    }
+
+    // Scalar 2D FFT
+    std::vector<cx> tmp_in(std::max(rows, cols));
+    std::vector<cx> tmp_out(std::max(rows, cols));
+
+    for (int r = 0; r < rows; r++) {
+      for (int c = 0; c < cols; c++) tmp_in[c] = data[r][c];
+      fft(tmp_in.data(), tmp_out.data(), log2_cols);
+      for (int c = 0; c < cols; c++) data[r][c] = tmp_out[c];
+    }
+
+    for (int c = 0; c < cols; c++) {
+      for (int r = 0; r < rows; r++) tmp_in[r] = data[r][c];
+      fft(tmp_in.data(), tmp_out.data(), log2_rows);
+      for (int r = 0; r < rows; r++) data[r][c] = tmp_out[r];
+    }
+
+    kernels::FFT2DPlan plan(log2_rows, log2_cols);
+    REQUIRE(!plan.has_errors());
+    plan.setNumQPUs(4);
+    plan.execute(in, out);
+
+    double max_val  = 0;
+    double max_diff = 0;
+    for (int r = 0; r < rows; r++) {
+      for (int c = 0; c < cols; c++) {
+        max_val  = std::max(max_val, abs(data[r][c]));
+        max_diff = std::max(max_diff, (double) abs(data[r][c] - out[r][c]));
+      }
+    }
+
+    REQUIRE(max_diff/max_val < precision);
+
+    // In-place should work as well
+    plan.execute(in, in);
+    for (int r = 0; r < rows; r++) {
+      for (int c = 0; c < cols; c++) {
+        REQUIRE(in[r][c] == out[r][c]);
+      }
+    }
+  }
+
+  Platform::use_main_memory(false);
+}
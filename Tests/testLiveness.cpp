@@ -0,0 +1,430 @@
+#include "doctest.h"
+#include <set>
+#include <map>
+#include "Support/BitSet.h"
+#include "Liveness/Liveness.h"
+#include "Liveness/UseDef.h"
+#include "Liveness/Coloring.h"
+#include "Liveness/SSA.h"
+#include "Kernels/Reduce.h"
+#include "Common/CompileData.h"
+#include "Target/instr/Mnemonics.h"
+#include "Target/Satisfy.h"
+#include "LibSettings.h"
+#include "V3DLib.h"
+
+using namespace V3DLib;
+
+namespace {
+
+/**
+ * Kernel with opportunities for all SSA optimizations
+ */
+void ssa_kernel(Int::Ptr result, Int::Ptr a) {
+  Int x = *a;
+  Int c = 2 + 3;
+  Int d = x + c;
+  Int e = x + c;
+  Int unused = x*7;
+  Int n = 0;
+
+  For (Int i = 0, i < 10, i++)
+    Int f = x*3 + me();
+    n += f + i;
+  End
+
+  *result = n + d + e;
+}
+
+
+/**
+ * Reference liveness, per instruction with std::set's, iterated until fixed point
+ */
+std::vector<std::set<int>> naive_liveness(Instr::List &instrs, CFG const &cfg) {
+  std::vector<std::set<int>> live_in(instrs.size());
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (int i = instrs.size() - 1; i >= 0; i--) {
+      std::set<int> in;
+      for (auto succ : cfg[i]) {
+        in.insert(live_in[succ].begin(), live_in[succ].end());
+      }
+
+      UseDef useDef(instrs[i]);
+      if (useDef.def.tag != NONE) in.erase(useDef.def.regId);
+      in.insert(useDef.use.begin(), useDef.use.end());
+
+      if (in != live_in[i]) {
+        live_in[i] = in;
+        changed = true;
+      }
+    }
+  }
+
+  return live_in;
+}
+
+
+/**
+ * Run straight-line target code on scalar values.
+ *
+ * Only handles the instructions used in the satisfy tests.
+ */
+std::map<Reg, int> run_scalar(Instr::List &instrs) {
+  std::map<Reg, int> regs;
+
+  auto val = [&regs] (RegOrImm const &src) -> int {
+    return src.is_reg()? regs[src.reg()] : src.imm().val;
+  };
+
+  for (int i = 0; i < instrs.size(); i++) {
+    auto const &instr = instrs[i];
+
+    if (instr.tag == LI) {
+      regs[instr.dest()] = instr.LI.imm.intVal();
+    } else if (instr.tag == ALU) {
+      int a = val(instr.ALU.srcA);
+      int b = val(instr.ALU.srcB);
+
+      switch (instr.ALU.op.value()) {
+        case ALUOp::A_ADD:  regs[instr.dest()] = a + b; break;
+        case ALUOp::A_BOR:  regs[instr.dest()] = a | b; break;
+        case ALUOp::A_BXOR: regs[instr.dest()] = a ^ b; break;
+        default: FAIL("run_scalar(): unexpected ALU op");
+      }
+    } else {
+      REQUIRE(instr.tag == NO_OP);
+    }
+  }
+
+  return regs;
+}
+
+}  // anon namespace
+
+
+TEST_CASE("Test liveness analysis [liveness]") {
+
+  SUBCASE("BitSet should behave as a set") {
+    BitSet a(130);  // Spans three words
+    REQUIRE(a.empty());
+
+    a.insert(0);
+    a.insert(64);
+    a.insert(129);
+    REQUIRE(a.count() == 3);
+    REQUIRE(a.member(64));
+    REQUIRE(!a.member(63));
+    REQUIRE(a.first() == 0);
+    REQUIRE(a.dump() == "(0, 64, 129, )");
+
+    BitSet b(130);
+    b.insert(5);
+    b.insert(64);
+    REQUIRE(a.add(b));
+    REQUIRE(!a.add(b));  // No change second time
+    REQUIRE(a.count() == 4);
+
+    a.remove(b);
+    std::vector<int> members;
+    for (auto v : a) members.push_back(v);
+    REQUIRE(members == std::vector<int>({0, 129}));
+
+    a.resize(100);
+    REQUIRE(a.count() == 1);
+    a.remove(0);
+    REQUIRE(a.empty());
+  }
+
+  SUBCASE("Block-level solver should match per-instruction iteration") {
+    using namespace V3DLib::Target::instr;
+    int const NUM_VARS = 5;
+
+    Reg a(REG_A, 0);
+    Reg b(REG_A, 1);
+    Reg c(REG_A, 2);
+    Reg d(REG_A, 3);
+    Reg e(REG_A, 4);
+
+    Label loop_start = freshLabel();
+    Label skip       = freshLabel();
+    BranchCond zc = { BranchCond::COND_ANY, ZC };
+
+    // Nested control flow: a loop with a conditional block inside
+    Instr::List instrs;
+    instrs << li(a, 0)
+           << li(b, 1)
+           << li(d, 0)
+           << li(e, 7)                         // Only used after the loop
+           << label(loop_start)
+           << add(a, a, b)
+           << add(c, a, 1)
+           << branch(skip).branch_cond(zc)
+           << add(d, d, c)
+           << label(skip)
+           << sub(c, c, 4)
+           << branch(loop_start).branch_cond(zc)
+           << add(e, e, d)
+           << mov(ACC0, e);
+
+    Liveness live(NUM_VARS);
+    live.compute(instrs);
+    REQUIRE(live.size() == instrs.size());
+    REQUIRE(live.cfg().basic_blocks().size() == 5);
+
+    auto expected = naive_liveness(instrs, live.cfg());
+
+    for (int i = 0; i < instrs.size(); i++) {
+      INFO("instr " << i << ": " << instrs[i].dump());
+      std::set<int> result;
+      for (auto v : live[i]) result.insert(v);
+      REQUIRE(result == expected[i]);
+    }
+
+    // Variables used in later iterations and after the loop are live at the loop end
+    BitSet liveOut;
+    live.computeLiveOut(11, liveOut);
+    REQUIRE(liveOut.member(0));
+    REQUIRE(liveOut.member(1));
+    REQUIRE(liveOut.member(3));
+    REQUIRE(liveOut.member(4));
+    REQUIRE(!liveOut.member(2));
+  }
+
+  SUBCASE("Coloring should coalesce moves") {
+    using namespace V3DLib::Target::instr;
+    int const NUM_VARS = 4;
+
+    Reg a(REG_A, 0);
+    Reg b(REG_A, 1);
+    Reg c(REG_A, 2);
+    Reg d(REG_A, 3);
+
+    Instr::List instrs;
+    instrs << li(a, 1)
+           << li(d, 2)
+           << mov(b, a)                        // a dies here, b can take its register
+           << add(c, b, d)
+           << mov(ACC0, c);
+
+    Liveness live(NUM_VARS);
+    live.compute(instrs);
+    LiveSets liveWith(NUM_VARS);
+    liveWith.init(instrs, live);
+
+    Coloring coloring(instrs, liveWith, live.reg_usage(), 64);
+    REQUIRE(coloring.order().size() == NUM_VARS);
+
+    for (auto i : coloring.order()) {
+      auto possible = liveWith.possible_registers(i, live.reg_usage());
+      live.reg_usage()[i].reg.tag = REG_A;
+      live.reg_usage()[i].reg.regId = coloring.choose_register(i, possible);
+    }
+
+    auto &alloc = live.reg_usage();
+    REQUIRE(alloc[0].reg == alloc[1].reg);
+    REQUIRE(!(alloc[0].reg == alloc[3].reg));  // a and d interfere
+
+    allocate_registers(instrs, alloc);
+    REQUIRE(remove_redundant_moves(instrs) == 1);
+    REQUIRE(instrs.size() == 4);
+  }
+}
+
+
+TEST_CASE("Test SSA optimizations [liveness][ssa]") {
+  using namespace V3DLib::Target::instr;
+
+  Reg a(REG_A, 0);
+  Reg b(REG_A, 1);
+  Reg c(REG_A, 2);
+  Reg d(REG_A, 3);
+  Reg e(REG_A, 4);
+  Reg f(REG_A, 5);
+  Reg g(REG_A, 6);
+  Reg n(REG_A, 7);
+  Reg x(REG_A, 8);
+
+  Label loop_start = freshLabel();
+  BranchCond zc = { BranchCond::COND_ANY, ZC };
+
+  Instr::List instrs;
+  instrs << li(a, 2)
+         << li(b, 3)
+         << mov(x, ACC0)                       // Value unknown at compile time
+         << add(c, a, b)                       // Folded to constant 5
+         << add(d, x, b)
+         << add(e, x, b)                       // Same as d
+         << add(g, x, 7)                       // Never used
+         << li(n, 0)
+         << label(loop_start)
+         << add(f, x, 4)                       // Loop invariant
+         << add(n, n, f)
+         << branch(loop_start).branch_cond(zc)
+         << add(n, n, c)
+         << add(n, n, e)
+         << mov(ACC1, n);
+
+  compile_data().clear();
+  optimize_ssa(instrs);
+  INFO(instrs.dump());
+
+  REQUIRE(compile_data().num_consts_folded == 1);
+  REQUIRE(compile_data().num_cse_removed == 1);
+  REQUIRE(compile_data().num_invariants_hoisted == 1);
+  REQUIRE(compile_data().num_dead_removed == 2);  // g, and a after folding
+  REQUIRE(instrs.size() == 12);
+
+  // The invariant is computed before the loop
+  int label_at = -1;
+  int f_at     = -1;
+  for (int i = 0; i < instrs.size(); i++) {
+    if (instrs[i].is_label()) label_at = i;
+    if (instrs[i].dst_a_reg() == f) f_at = i;
+  }
+  REQUIRE(f_at != -1);
+  REQUIRE(f_at < label_at);
+
+  // e has been replaced by d
+  for (int i = 0; i < instrs.size(); i++) {
+    for (auto v : instrs[i].src_a_regs()) {
+      REQUIRE(v != e.regId);
+    }
+  }
+}
+
+
+/**
+ * The optimized kernels should give the same results as the unoptimized kernels.
+ *
+ * This runs on the emulator, so only vc4 code is executed.
+ */
+TEST_CASE("Test SSA optimizer on compiled kernels [liveness][ssa]") {
+  LibSettings::use_ssa_optimizer(true);
+
+  SUBCASE("Check small kernel") {
+    Int::Array a(16);
+    for (int i = 0; i < 16; i++) a[i] = 3*i + 1;  // Non-negative, mul24 is unsigned
+
+    Int::Array result(16);
+    Int::Array expected(16);
+
+    auto k = compile(ssa_kernel);
+    REQUIRE(!k.has_errors());
+    INFO(k.vc4().compile_info());
+    REQUIRE(k.vc4().compile_info().find("num invariants hoisted         : 0") == std::string::npos);
+    k.setNumQPUs(4);
+    k.load(&result, &a).emu();
+
+    LibSettings::use_ssa_optimizer(false);
+    auto k0 = compile(ssa_kernel);
+    k0.setNumQPUs(4);
+    k0.load(&expected, &a).emu();
+
+    REQUIRE(result == expected);
+  }
+
+  SUBCASE("Check library kernels") {
+    int const size = 1000;
+    Float::Array in(size);
+    std::vector<float> in_scalar(size);
+    for (int i = 0; i < size; i++) in[i] = in_scalar[i] = (float) ((i*13) % 29) - 14.0f;
+
+    kernels::Reduction argmax(kernels::Reduction::ARGMAX);
+    argmax.setNumQPUs(5);
+    int expected_index;
+    float expected = kernels::reduce_scalar(kernels::Reduction::ARGMAX, in_scalar.data(), size, &expected_index);
+    REQUIRE(argmax.execute(in) == expected);
+    REQUIRE(argmax.index() == expected_index);
+
+    kernels::Scan scan;
+    scan.setNumQPUs(3);
+    Float::Array out(size);
+    std::vector<float> expected_scan(size);
+    kernels::scan_scalar(in_scalar.data(), expected_scan.data(), size);
+    scan.execute(in, out);
+
+    for (int i = 0; i < size; i++) {
+      INFO("i: " << i);
+      REQUIRE(out[i] == expected_scan[i]);
+    }
+  }
+
+  LibSettings::use_ssa_optimizer(false);
+}
+
+
+TEST_CASE("Test accumulator selection for operand moves [liveness][satisfy]") {
+  using namespace V3DLib::Target::instr;
+
+  Platform::compiling_for_vc4(true);
+
+  Reg a1(REG_A, 1);
+  Reg a2(REG_A, 2);
+  Reg a3(REG_A, 3);
+  Reg b0(REG_B, 0);
+  Reg b1(REG_B, 1);
+  Reg b2(REG_B, 2);
+
+  auto count_xor = [] (Instr::List &instrs) -> int {
+    int ret = 0;
+    for (int i = 0; i < instrs.size(); i++) {
+      if (instrs[i].tag == ALU && instrs[i].ALU.op == ALUOp::A_BXOR) ret++;
+    }
+    return ret;
+  };
+
+  SUBCASE("An accumulator live around a loop should not be taken") {
+    Label loop_start = freshLabel();
+    BranchCond zc = { BranchCond::COND_ANY, ZC };
+
+    Instr::List instrs;
+    instrs << li(ACC1, 4)
+           << label(loop_start)
+           << add(a3, a1, a2)                  // Regfile conflict
+           << add(ACC1, ACC1, a3)
+           << branch(loop_start).branch_cond(zc)
+           << mov(b0, ACC1);
+
+    satisfy(instrs);
+    INFO(instrs.dump());
+    REQUIRE(count_xor(instrs) == 0);
+
+    for (int i = 0; i < instrs.size(); i++) {
+      if (instrs[i].dst_reg() == a3) {
+        REQUIRE(instrs[i].ALU.srcA.is_reg());
+        REQUIRE(instrs[i].ALU.srcA.reg().tag == ACC);
+        REQUIRE(!(instrs[i].ALU.srcA.reg() == ACC1));
+      }
+    }
+  }
+
+  SUBCASE("A live accumulator should be exchanged and restored if none is free") {
+    Instr::List instrs;
+    instrs << li(ACC0, 10) << li(ACC1, 11) << li(ACC2, 12) << li(ACC3, 13)
+           << li(a1, 5) << li(a2, 7) << li(b2, 9)
+           << add(a3, a1, a2)                  // Regfile conflict
+           << add(a1, a1, a2)                  // Idem, result replaces operand
+           << add(b1, b2, 3)                   // Small immediate with regfile B operand
+           << add(b0, ACC0, ACC1)
+           << add(b0, ACC2, ACC3);
+
+    satisfy(instrs);
+    INFO(instrs.dump());
+    REQUIRE(count_xor(instrs) == 3*6);
+
+    auto regs = run_scalar(instrs);
+    REQUIRE(regs[a3] == 12);
+    REQUIRE(regs[a1] == 12);
+    REQUIRE(regs[a2] == 7);
+    REQUIRE(regs[b1] == 12);
+    REQUIRE(regs[b2] == 9);
+    REQUIRE(regs[ACC0] == 10);
+    REQUIRE(regs[ACC1] == 11);
+    REQUIRE(regs[ACC2] == 12);
+    REQUIRE(regs[ACC3] == 13);
+  }
+}
@@ -4,6 +4,7 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 #include <string>
+#include <cstring>  // memcmp()
 #include <iostream>
 #include <V3DLib.h>
 #include "LibSettings.h"
@@ -267,6 +268,46 @@ void test_matrix_multiplication(int rows, int inner, int cols, float init_a = 1,
   }
 }
 
+
+
+/**
+ * Compare the tiled matrix multiplication with the dot product version
+ */
+void test_tiled_matrix_multiplication(int rows, int inner, int cols, int num_qpus) {
+  INFO("rows: " << rows << ", inner: " << inner << ", cols: " << cols << ", num QPUs: " << num_qpus);
+  auto &settings = kernels::get_matrix_settings();
+
+  Float::Array2D a(rows, inner);
+  Float::Array2D b(cols, inner);  // Transposed!
+
+  std::vector<float> tmp(rows*inner);
+  fill_random(tmp);
+  copy_array(a, tmp);
+  tmp.resize(cols*inner);
+  fill_random(tmp);
+  copy_array(b, tmp);
+
+  auto run = [&] (Float::Array2D &result) {
+    auto k = compile(kernels::matrix_mult_decorator(a, b, result));
+    REQUIRE(!k.has_errors());
+    k.setNumQPUs(num_qpus);
+    result.fill(-1.0f);
+    k.load(&result, &a, &b);
+    k.call();
+  };
+
+  Float::Array2D expected;
+  settings.method = kernels::matrix_settings::DOT_PRODUCT;
+  run(expected);
+
+  Float::Array2D result;
+  settings.method = kernels::matrix_settings::TILED;
+  run(result);
+  settings.method = kernels::matrix_settings::DOT_PRODUCT;
+
+  compare_arrays(result, expected, 1.0e-4f);
+}
+
 }  // anon namespace
 
 
@@ -392,6 +433,53 @@ TEST_CASE("Test matrix algebra with varying sizes [matrix][mult][varying]") {
 }
 
 
+TEST_CASE("Test tiled matrix multiplication [matrix][tiled]") {
+  auto &settings = kernels::get_matrix_settings();
+
+  SUBCASE("Check tile rows") {
+    settings.set(8, 16, 16);  REQUIRE(settings.tile_rows() == 4);
+    settings.set(6, 16, 16);  REQUIRE(settings.tile_rows() == 3);
+    settings.set(10, 16, 16); REQUIRE(settings.tile_rows() == 2);
+    settings.set(7, 16, 16);  REQUIRE(settings.tile_rows() == 1);
+  }
+
+  SUBCASE("Compare with dot product") {
+    auto test = [] (int num_qpus) {
+      test_tiled_matrix_multiplication( 1,    16,   1, num_qpus);
+      test_tiled_matrix_multiplication( 4,  3*16,  16, num_qpus);
+      test_tiled_matrix_multiplication(10,    16,   5, num_qpus);
+      test_tiled_matrix_multiplication( 7,  2*16,  37, num_qpus);
+      test_tiled_matrix_multiplication(64,  4*16,  48, num_qpus);
+    };
+
+    test(1);
+    test(8);
+  }
+
+  SUBCASE("Compare block matrix") {
+    int const dimension = 4*16;
+    Float::Array2D a(dimension);
+    std::vector<float> expected;
+    prepare_random(a, expected, dimension);
+
+    Matrix m(a, a);
+    m.setNumQPUs(8);
+
+    for (int num_blocks = 1; num_blocks <= 2; num_blocks++) {
+      INFO("num blocks: " << num_blocks);
+      m.num_blocks(num_blocks);
+
+      settings.method = kernels::matrix_settings::TILED;
+      m.call();
+      settings.method = kernels::matrix_settings::DOT_PRODUCT;
+
+      REQUIRE(m.info().find("tiled") != std::string::npos);
+      compare_arrays(m.result(), expected, 1.5e-4f);
+    }
+  }
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Complex arrays
 ///////////////////////////////////////////////////////////////////////////////
@@ -805,3 +893,58 @@ TEST_CASE("Test matrix mult on emulator [matrix][emu]") {
 
   Platform::use_main_memory(false);
 }
+
+
+TEST_CASE("Test parallel emulator [matrix][emu][parallel]") {
+  Platform::use_main_memory(true);
+
+  auto compare = [] (bool use_tmu, int num_qpus) {
+    INFO("use TMU: " << use_tmu << ", num QPUs: " << num_qpus);
+    LibSettings::use_tmu_for_load(use_tmu);
+
+    int const rows  = 12;
+    int const inner = 4*16;
+    int const cols  = 20;
+
+    Float::Array2D a(rows, inner);
+    Float::Array2D b(cols, inner);  // Transposed!
+    Float::Array2D result;
+
+    std::vector<float> tmp(rows*inner);
+    fill_random(tmp);
+    copy_array(a, tmp);
+    tmp.resize(cols*inner);
+    fill_random(tmp);
+    copy_array(b, tmp);
+
+    auto k = compile(kernels::matrix_mult_decorator(a, b, result));
+    REQUIRE(!k.has_errors());
+    k.setNumQPUs(num_qpus);
+
+    // Sequential run as reference
+    result.fill(-1.0f);
+    k.load(&result, &a, &b);
+    k.emu();
+
+    std::vector<float> expected;
+    result.copyTo(expected);
+
+    // Same thing with a thread per QPU, output must be bit-identical
+    LibSettings::use_parallel_emulator(true);
+    result.fill(-1.0f);
+    k.emu();
+    LibSettings::use_parallel_emulator(false);
+
+    std::vector<float> received;
+    result.copyTo(received);
+    REQUIRE(expected.size() == received.size());
+    REQUIRE(memcmp(expected.data(), received.data(), expected.size()*sizeof(float)) == 0);
+  };
+
+  compare(true, 8);
+  compare(false, 8);
+  compare(true, 12);
+
+  LibSettings::use_tmu_for_load(true);
+  Platform::use_main_memory(false);
+}
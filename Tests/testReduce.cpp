@@ -0,0 +1,134 @@
+#include "doctest.h"
+#include <vector>
+#include <V3DLib.h>
+#include "Kernels/Reduce.h"
+
+using namespace V3DLib;
+using namespace kernels;
+
+namespace {
+
+// Sizes which are not multiples of 16, and sizes with less vectors than QPUs
+std::vector<int> const sizes    = { 1, 13, 16, 100, 1000, 4099 };
+std::vector<int> const num_qpus = { 1, 3, 8, 12 };
+
+
+/**
+ * Fill the array with values which sum exactly in float, so that the order of summation does not matter
+ */
+void init_array(Float::Array &a) {
+  for (int i = 0; i < (int) a.size(); i++) {
+    a[i] = 0.25f*((float) ((i*7) % 23) - 11.0f);
+  }
+}
+
+
+std::vector<float> to_vector(Float::Array &a) {
+  std::vector<float> ret(a.size());
+  for (int i = 0; i < (int) a.size(); i++) ret[i] = a[i];
+  return ret;
+}
+
+
+void check_reduction(Reduction &r, Float::Array &in) {
+  REQUIRE(!r.has_errors());
+  auto in_scalar = to_vector(in);
+
+  for (auto size : sizes) {
+    int expected_index;
+    float expected = reduce_scalar(r.op(), in_scalar.data(), size, &expected_index);
+
+    for (auto qpus : num_qpus) {
+      INFO("op: " << r.op() << ", size: " << size << ", num QPUs: " << qpus);
+      r.setNumQPUs(qpus);
+      REQUIRE(r.execute(in, size) == expected);
+
+      if (r.op() == Reduction::ARGMAX) {
+        REQUIRE(r.index() == expected_index);
+      }
+    }
+  }
+}
+
+
+void check_scan(Scan &scan, Float::Array &in) {
+  REQUIRE(!scan.has_errors());
+  auto in_scalar = to_vector(in);
+
+  Float::Array out(in.size());
+  std::vector<float> expected(in.size());
+
+  for (auto size : sizes) {
+    scan_scalar(in_scalar.data(), expected.data(), size, scan.inclusive());
+
+    for (auto qpus : num_qpus) {
+      INFO("inclusive: " << scan.inclusive() << ", size: " << size << ", num QPUs: " << qpus);
+      out.fill(-1.0f);
+      scan.setNumQPUs(qpus);
+      scan.execute(in, out, size);
+
+      for (int i = 0; i < size; i++) {
+        INFO("i: " << i);
+        REQUIRE(out[i] == expected[i]);
+      }
+
+      // Values beyond size should not be touched
+      for (int i = size; i < (int) out.size(); i++) {
+        INFO("i: " << i);
+        REQUIRE(out[i] == -1.0f);
+      }
+    }
+  }
+}
+
+}  // anon namespace
+
+
+TEST_CASE("Test reduction and scan primitives [reduce]") {
+  Float::Array in(4099 + 16);  // Extra space to check that the tail is not touched
+  init_array(in);
+
+  SUBCASE("Check reductions") {
+    // Place the maximum and minimum values more than once, the first index should be returned
+    in[57]   = in[900]  = 20.0f;
+    in[2000] = in[3000] = 30.0f;
+    in[11]   = -20.0f;
+
+    Reduction sum(Reduction::SUM);
+    check_reduction(sum, in);
+
+    Reduction r_min(Reduction::MIN);
+    check_reduction(r_min, in);
+
+    Reduction r_max(Reduction::MAX);
+    check_reduction(r_max, in);
+
+    Reduction argmax(Reduction::ARGMAX);
+    check_reduction(argmax, in);
+  }
+
+  SUBCASE("Check scans") {
+    Scan inclusive(true);
+    check_scan(inclusive, in);
+
+    Scan exclusive(false);
+    check_scan(exclusive, in);
+  }
+
+  SUBCASE("Scan in-place") {
+    Float::Array a(500);
+    init_array(a);
+    auto in_scalar = to_vector(a);
+    std::vector<float> expected(a.size());
+    scan_scalar(in_scalar.data(), expected.data(), (int) a.size());
+
+    Scan scan;
+    scan.setNumQPUs(8);
+    scan.execute(a, a);
+
+    for (int i = 0; i < (int) a.size(); i++) {
+      INFO("i: " << i);
+      REQUIRE(a[i] == expected[i]);
+    }
+  }
+}
@@ -0,0 +1,107 @@
+#include "doctest.h"
+#include <V3DLib.h>
+#include "LibSettings.h"
+#include "v3d/Schedule.h"
+#include "v3d/instr/Mnemonics.h"
+
+using namespace V3DLib;
+using namespace V3DLib::v3d::instr;
+using Instructions = V3DLib::v3d::Instructions;
+
+namespace {
+
+/**
+ * @return sequence of uniform loads, TMU writes and TMU loads in the instructions
+ */
+std::vector<std::string> memory_order(Instructions const &instrs) {
+  std::vector<std::string> ret;
+
+  for (auto const &instr : instrs) {
+    if (instr.sig.ldunifrf)          ret.push_back("unif");
+    if (instr_writes_tmu(&instr))    ret.push_back("tmu");
+    if (instr.sig.ldtmu)             ret.push_back("ldtmu");
+  }
+
+  return ret;
+}
+
+
+/**
+ * @return index of the instruction writing to the given regfile location, -1 if not found
+ */
+int writer(Instructions const &instrs, uint8_t addr) {
+  for (int i = 0; i < (int) instrs.size(); i++) {
+    auto const &instr = instrs[i];
+
+    if (instr.uses_sig_dst() && !instr.sig_magic && instr.sig_addr == addr) return i;
+    if (!instr.add_nop() && !instr.alu.add.magic_write && instr.alu.add.waddr == addr) return i;
+    if (!instr.mul_nop() && !instr.alu.mul.magic_write && instr.alu.mul.waddr == addr) return i;
+  }
+
+  return -1;
+}
+
+
+void sched_kernel(Int::Ptr result, Int::Ptr a, Int::Ptr b) {
+  Int x = *a;
+  Int y = *b;
+  Int z = (x + 3)*(y - 2) + (index() << 2);
+
+  For (Int n = 0, n < 4, n++)
+    z = z + (x ^ n) - (y & n);
+  End
+
+  *result = z;
+}
+
+}  // anon namespace
+
+
+TEST_CASE("Test v3d instruction scheduling [v3d][schedule]") {
+
+  SUBCASE("Scheduling should pack instructions and respect dependencies") {
+    Instructions instrs;
+    instrs << nop().ldunifrf(rf(0))
+           << mov(tmua, rf(0))
+           << add(rf(1), rf(2), rf(3))
+           << nop().ldtmu(rf(4))
+           << add(rf(5), rf(4), rf(4))       // Uses the TMU load
+           << sub(rf(6), rf(7), rf(8))
+           << mov(tmua, rf(9))
+           << nop().ldtmu(rf(10))
+           << nop()                          // Barrier
+           << add(rf(11), rf(10), rf(1));
+
+    int const size   = (int) instrs.size();
+    auto const order = memory_order(instrs);
+
+    int count = v3d::schedule(instrs);
+    INFO(instrs.size() << " instructions after scheduling");
+    REQUIRE(count > 0);
+    REQUIRE((int) instrs.size() == size - count);
+
+    // Memory accesses keep their order
+    REQUIRE(memory_order(instrs) == order);
+
+    // Other work is done between a TMU request and its load
+    REQUIRE(writer(instrs, 4) - writer(instrs, 0) > 1);
+
+    REQUIRE(writer(instrs, 4) < writer(instrs, 5));
+    REQUIRE(writer(instrs, 1) < writer(instrs, 11));
+    REQUIRE(writer(instrs, 11) == (int) instrs.size() - 1);  // Not moved across the barrier
+    REQUIRE(instrs.check_consistent());
+  }
+
+  SUBCASE("Scheduling should reduce the size of compiled kernels") {
+    auto k0 = compile(sched_kernel);
+    LibSettings::use_v3d_scheduler(true);
+    auto k1 = compile(sched_kernel);
+    LibSettings::use_v3d_scheduler(false);
+
+    INFO(k1.v3d().compile_info());
+    REQUIRE(!k0.has_errors());
+    REQUIRE(!k1.has_errors());
+    REQUIRE(k1.v3d().compile_info().find("num packed slots (v3d)         : 0") == std::string::npos);
+    REQUIRE(k1.v3d_kernel_size() < k0.v3d_kernel_size());
+  }
+}
@@ -0,0 +1,135 @@
+#include "doctest.h"
+#include <vector>
+#include <V3DLib.h>
+#include "Kernels/Stencil.h"
+
+using namespace V3DLib;
+using namespace kernels;
+
+namespace {
+
+// ============================================================================
+// Support routines
+// ============================================================================
+
+void init_image(Float::Array2D &image) {
+  for (int y = 0; y < image.rows(); y++) {
+    for (int x = 0; x < image.columns(); x++) {
+      image[y][x] = (float) ((x*5 + y*11) % 17) - 8.0f;
+    }
+  }
+}
+
+
+void compare_image(Float::Array2D &image, std::vector<float> const &expected, float precision) {
+  REQUIRE((int) expected.size() == image.rows()*image.columns());
+
+  for (int y = 0; y < image.rows(); y++) {
+    for (int x = 0; x < image.columns(); x++) {
+      INFO("y: " << y << ", x: " << x);
+      REQUIRE(abs(image[y][x] - expected[y*image.columns() + x]) < precision);
+    }
+  }
+}
+
+
+/**
+ * Run the convolution on the QPUs and compare with the scalar version for the given mask
+ */
+void check_convolution(Convolution &conv, std::vector<float> const &mask, int rows, int columns, int num_qpus) {
+  INFO("rows: " << rows << ", columns: " << columns << ", num QPUs: " << num_qpus
+       << ", radius: " << conv.radius() << ", separable: " << conv.separable());
+  REQUIRE(!conv.has_errors());
+
+  Float::Array2D in(rows, columns);
+  Float::Array2D out(rows, columns);
+  init_image(in);
+  out.fill(-1.0f);
+
+  std::vector<float> in_scalar(rows*columns);
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < columns; x++) {
+      in_scalar[y*columns + x] = in[y][x];
+    }
+  }
+
+  std::vector<float> expected(rows*columns);
+  convolution_scalar(in_scalar.data(), expected.data(), columns, rows, conv.radius(), conv.radius(), mask);
+
+  conv.setNumQPUs(num_qpus);
+  conv.execute(in, out);
+  compare_image(out, expected, 1.0e-4f);
+}
+
+}  // anon namespace
+
+
+TEST_CASE("Test convolution kernels [stencil]") {
+  SUBCASE("Check full mask") {
+    // 3x3, all neighbours, asymmetric so that orientation errors show up
+    std::vector<float> mask3 = {
+      1, 2, 3,
+      4, 5, 6,
+      7, 8, 9
+    };
+
+    Convolution conv3(1, mask3);
+    check_convolution(conv3, mask3, 10, 32, 1);
+    check_convolution(conv3, mask3, 21, 48, 8);
+
+    // 5x5 cross-shaped mask, zeros are skipped
+    std::vector<float> mask5(25, 0.0f);
+    for (int i = 0; i < 5; i++) {
+      mask5[2*5 + i] = (float) (i + 1);
+      mask5[i*5 + 2] = (float) (i + 1);
+    }
+
+    Convolution conv5(2, mask5);
+    check_convolution(conv5, mask5, 13, 32, 3);
+
+    // 7x7 with all values
+    std::vector<float> mask7(49);
+    for (int i = 0; i < 49; i++) mask7[i] = (float) ((i % 5) - 2)*0.25f;
+
+    Convolution conv7(3, mask7);
+    check_convolution(conv7, mask7, 9, 64, 4);
+  }
+
+  SUBCASE("Check separable") {
+    std::vector<float> row_filter = { 1, 4, 6, 4, 1 };
+    std::vector<float> col_filter = { 0.5f, -1, 2, -1, 0.25f };
+
+    Convolution conv(row_filter, col_filter);
+    REQUIRE(conv.separable());
+    REQUIRE(conv.radius() == 2);
+
+    auto mask = Convolution::outer(row_filter, col_filter);
+    check_convolution(conv, mask, 11, 32, 1);
+    check_convolution(conv, mask, 30, 64, 8);
+
+    // Larger filter than possible with a full mask
+    std::vector<float> wide(17);
+    for (int i = 0; i < 17; i++) wide[i] = 1.0f/((float) (1 + abs(i - 8)));
+
+    Convolution conv_wide(wide, wide);
+    check_convolution(conv_wide, Convolution::outer(wide, wide), 20, 32, 5);
+  }
+
+  SUBCASE("Separable in-place") {
+    std::vector<float> filter = { 1, 2, 1 };
+    Convolution conv(filter, filter);
+
+    Float::Array2D image(8, 16);
+    Float::Array2D expected(8, 16);
+    init_image(image);
+
+    conv.execute(image, expected);
+    conv.execute(image, image);
+
+    for (int y = 0; y < 8; y++) {
+      for (int x = 0; x < 16; x++) {
+        REQUIRE(image[y][x] == expected[y][x]);
+      }
+    }
+  }
+}
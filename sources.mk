@@ -43,24 +43,35 @@ OBJ := \
   Source/Complex.o  \
   Source/Var.o  \
   Source/Stmt.o  \
+  Source/LoopTransform.o  \
   Support/debug.o  \
   Support/Timer.o  \
   Support/InstructionComment.o  \
   Support/basics.o  \
   Support/RegIdSet.o  \
+  Support/BitSet.o  \
   Support/pgm.o  \
   Support/Helpers.o  \
   Support/Platform.o  \
   Support/HeapManager.o  \
+  Support/MemCopy.o  \
   SourceTranslate.o  \
   Common/SharedArray.o  \
+  Common/SharedArrayPool.o  \
   Common/BufferObject.o  \
   Common/CompileData.o  \
+  Common/CompileContext.o  \
+  Common/CompileProfile.o  \
+  Common/KernelCache.o  \
+  Common/LaunchQueue.o  \
   Kernels/DotVector.o  \
   Kernels/Cursor.o  \
   Kernels/Rot3D.o  \
   Kernels/ComplexDotVector.o  \
   Kernels/Matrix.o  \
+  Kernels/FFT.o  \
+  Kernels/Stencil.o  \
+  Kernels/Reduce.o  \
   Liveness/Range.o  \
   Liveness/LiveSet.o  \
   Liveness/UseDef.o  \
@@ -68,11 +79,16 @@ OBJ := \
   Liveness/RegUsage.o  \
   Liveness/Liveness.o  \
   Liveness/CFG.o  \
+  Liveness/Spill.o  \
+  Liveness/Coloring.o  \
+  Liveness/SSA.o  \
   LibSettings.o  \
   v3d/PerformanceCounters.o  \
   v3d/v3d.o  \
   v3d/BufferObject.o  \
   v3d/SourceTranslate.o  \
+  v3d/Schedule.o  \
+  v3d/Constants.o  \
   v3d/instr/Source.o  \
   v3d/instr/RFAddress.o  \
   v3d/instr/OpItems.o  \
@@ -116,6 +132,8 @@ EXAMPLES := \
   DMA  \
   Rot3D  \
   Matrix  \
+  FFT  \
+  Reduce  \
   detectPlatform  \
 
 # support files for examples
@@ -130,6 +148,9 @@ TESTS_FILES := \
   Tests/testFFT.o  \
   Tests/testV3d.o  \
   Tests/testRot3D.o  \
+  Tests/testCursor.o  \
+  Tests/testStencil.o  \
+  Tests/testReduce.o  \
   Tests/testPrefetch.o  \
   Tests/testFunctions.o  \
   Tests/support/ProfileOutput.o  \
@@ -144,6 +165,9 @@ TESTS_FILES := \
   Tests/testConditionCodes.o  \
   Tests/testMain.o  \
   Tests/testDSL.o  \
+  Tests/testLiveness.o  \
+  Tests/testSchedule.o  \
+  Tests/testConstants.o  \
   Tests/testCmdLine.o  \
   Tests/support/qpu_disasm.o  \
 